@@ -0,0 +1,112 @@
+#!/usr/bin/env python2.7
+# -*- coding: utf-8 -*-
+"""
+Micro-benchmark for per-call overhead of the extension functions
+
+Times the zero- and one-argument functions, whose cost is dominated by the
+calling convention (METH_NOARGS / METH_O versus building an argument tuple
+for METH_VARARGS and parsing it with PyArg_ParseTuple), next to a few
+multi-argument functions and builtins for reference.
+
+Save a run with --save and compare a later build against it with
+--compare to see the effect of a change:
+
+    python benchmarks/bench_call_overhead.py --save before.json
+    (rebuild)
+    python benchmarks/bench_call_overhead.py --compare before.json
+"""
+
+import json
+import os
+import sys
+import timeit
+
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+
+import advanced_module  # noqa: E402
+import basics_module  # noqa: E402
+import example_module  # noqa: E402
+import exceptions_module  # noqa: E402
+import memory_module  # noqa: E402
+import objects_module  # noqa: E402
+
+OBJ = object()
+LST = [1, 2, 3]
+POINT = advanced_module.create_point(1, 2, "p")
+
+CASES = [
+    ('basics.hello_world()', basics_module.hello_world, ()),
+    ('basics.return_none()', basics_module.return_none, ()),
+    ('example.hello_world()', example_module.hello_world, ()),
+    ('objects.create_dict()', objects_module.create_dict, ()),
+    (
+        'exceptions.check_error_occurred()',
+        exceptions_module.check_error_occurred,
+        (),
+    ),
+    ('basics.greet_name(s)', basics_module.greet_name, ("world",)),
+    ('basics.is_even(n)', basics_module.is_even, (4,)),
+    ('basics.get_statistics(x)', basics_module.get_statistics, (1.5,)),
+    ('memory.get_refcount(o)', memory_module.get_refcount, (OBJ,)),
+    ('objects.get_type(o)', objects_module.get_type, (OBJ,)),
+    ('objects.check_type(o)', objects_module.check_type, (LST,)),
+    ('objects.sum_list(l)', objects_module.sum_list, (LST,)),
+    ('objects.create_tuple(n)', objects_module.create_tuple, (2,)),
+    ('advanced.get_point(p)', advanced_module.get_point, (POINT,)),
+    ('basics.add_numbers(a, b)', basics_module.add_numbers, (1, 2)),
+    ('objects.compare(a, b)', objects_module.compare, (1, 2)),
+    ('builtin len(l) [METH_O]', len, (LST,)),
+    ('builtin globals() [METH_NOARGS]', globals, ()),
+]
+
+
+def ns_per_call(func, args, number):
+    """Best-of-5 nanoseconds per direct call of func(*args)
+
+    The call is spelled out (f(a0, a1)) rather than f(*a): the interpreter
+    only skips building an argument tuple for METH_NOARGS / METH_O on a
+    direct call.
+    """
+    namespace = {'f': func}
+    names = []
+    for index, value in enumerate(args):
+        namespace['a%d' % index] = value
+        names.append('a%d' % index)
+    stmt = 'f(%s)' % ', '.join(names)
+
+    module = sys.modules[__name__]
+    module._namespace = namespace
+    setup = 'from %s import _namespace; globals().update(_namespace)' % __name__
+    timer = timeit.Timer(stmt, setup=setup)
+    return min(timer.repeat(5, number)) / number * 1e9
+
+
+def main():
+    argv = sys.argv[1:]
+    number = 200000
+    previous = {}
+    if '--compare' in argv:
+        with open(argv[argv.index('--compare') + 1]) as handle:
+            previous = json.load(handle)
+
+    results = {}
+    print "%-36s %10s %10s %8s" % ("call", "ns/call", "before", "change")
+    print "-" * 68
+    for name, func, args in CASES:
+        elapsed = ns_per_call(func, args, number)
+        results[name] = elapsed
+        if name in previous:
+            change = "%+7.1f%%" % ((elapsed / previous[name] - 1.0) * 100.0)
+            row = (name, elapsed, previous[name], change)
+            print "%-36s %10.1f %10.1f %8s" % row
+        else:
+            print "%-36s %10.1f %10s %8s" % (name, elapsed, "-", "-")
+
+    if '--save' in argv:
+        with open(argv[argv.index('--save') + 1], 'w') as handle:
+            json.dump(results, handle, indent=2, sort_keys=True)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,67 @@
+#!/usr/bin/env python2.7
+# -*- coding: utf-8 -*-
+"""
+Benchmark for objects_module.create_list
+
+Compares the original list-of-squares path against the other generators
+and the compact array.array('l') result at 1e3, 1e6 and (with --large)
+1e8 elements.
+
+Usage:
+    python benchmarks/bench_create_list.py [--large]
+"""
+
+import gc
+import os
+import sys
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+
+import objects_module  # noqa: E402
+
+VARIANTS = [
+    ('squares list (original)', {}),
+    ('range list', {'kind': 'range'}),
+    ('const list', {'kind': 'const', 'value': 7}),
+    ('squares array', {'as_array': True}),
+    ('const array', {'kind': 'const', 'value': 7, 'as_array': True}),
+]
+
+
+def best_time(size, kwargs, repeat):
+    """Return the best wall-clock time of `repeat` create_list calls"""
+    best = None
+    for _ in range(repeat):
+        gc.collect()
+        start = time.time()
+        result = objects_module.create_list(size, **kwargs)
+        elapsed = time.time() - start
+        del result
+        if best is None or elapsed < best:
+            best = elapsed
+    return best
+
+
+def main():
+    sizes = [10**3, 10**6]
+    if '--large' in sys.argv[1:]:
+        sizes.append(10**8)
+
+    print "%-26s %12s %14s %10s" % ("variant", "size", "seconds", "speedup")
+    print "-" * 66
+    for size in sizes:
+        repeat = 3 if size >= 10**8 else 20
+        baseline = None
+        for name, kwargs in VARIANTS:
+            elapsed = best_time(size, kwargs, repeat)
+            if baseline is None:
+                baseline = elapsed
+            speedup = baseline / elapsed if elapsed > 0 else float('inf')
+            print "%-26s %12d %14.6f %9.2fx" % (name, size, elapsed, speedup)
+        print ""
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,85 @@
+#!/usr/bin/env python2.7
+# -*- coding: utf-8 -*-
+"""
+Benchmark for the bulk dictionary builders
+
+Compares memory_module.create_populated_dict, which formats every key with
+PyString_FromFormat and grows the dict one insert at a time, against
+objects_module.dict_from_columns and dict_from_pairs at 1e4-1e6 keys
+(1e7 with --large). Every variant builds {'key_i': i * 100}.
+
+Usage:
+    python benchmarks/bench_dict_builders.py [--large]
+"""
+
+import array
+import gc
+import os
+import sys
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+
+import memory_module  # noqa: E402
+import objects_module  # noqa: E402
+
+
+def variants(size):
+    """Return (name, callable) pairs; inputs are built outside the timing"""
+    column = array.array('l', xrange(0, size * 100, 100))
+    values = column.tolist()
+    keys = ['key_%d' % i for i in xrange(size)]
+    pairs = zip(keys, values)
+    from_columns = objects_module.dict_from_columns
+    return [
+        ('create_populated_dict', lambda: memory_module.create_populated_dict(size)),
+        ('columns, array values', lambda: from_columns(size, column)),
+        ('columns, list values', lambda: from_columns(size, values)),
+        ('columns, key list', lambda: from_columns(keys, values)),
+        ('dict_from_pairs', lambda: objects_module.dict_from_pairs(pairs)),
+        ('dict(zip()) (python)', lambda: dict(zip(keys, values))),
+    ]
+
+def best_time(func, repeat):
+    """Return the best wall-clock time of `repeat` calls"""
+    best = None
+    for _ in range(repeat):
+        gc.collect()
+        start = time.time()
+        result = func()
+        elapsed = time.time() - start
+        del result
+        if best is None or elapsed < best:
+            best = elapsed
+    return best
+
+
+def main():
+    sizes = [10**4, 10**5, 10**6]
+    if '--large' in sys.argv[1:]:
+        sizes.append(10**7)
+
+    assert objects_module.dict_from_columns(
+        10, array.array('l', range(0, 1000, 100))
+    ) == memory_module.create_populated_dict(10)
+
+    header = ("variant", "keys", "seconds", "keys/sec", "speedup")
+    print "%-24s %10s %14s %14s %9s" % header
+    print "-" * 75
+    for size in sizes:
+        repeat = 3 if size >= 10**7 else 10
+        baseline = None
+        for name, func in variants(size):
+            elapsed = best_time(func, repeat)
+            if baseline is None:
+                baseline = elapsed
+            rate = size / elapsed if elapsed > 0 else float('inf')
+            speedup = baseline / elapsed if elapsed > 0 else float('inf')
+            row = (name, size, elapsed, rate, speedup)
+            print "%-24s %10d %14.6f %14.0f %8.2fx" % row
+        print ""
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,95 @@
+#!/usr/bin/env python2.7
+# -*- coding: utf-8 -*-
+"""
+Benchmark for the cost of failing calls: raising versus returning codes
+
+Every row times a call that fails, as validation-heavy code does most of
+the time, caught the way a caller would: try/except around the raising
+form, a tuple check for as_result=True, and one validate_range_many call
+with an error mask for the batch form (reported per value).
+
+Usage:
+    python benchmarks/bench_exceptions.py
+"""
+
+import os
+import sys
+import timeit
+
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+
+import exceptions_module  # noqa: E402
+
+SETUP = """
+from exceptions_module import (safe_divide, validate_range, validate_range_many,
+                               raise_custom_error, raise_validation_error,
+                               CustomError, ValidationError)
+values = [float(i) for i in range(1000)]
+mask = bytearray(len(values))
+"""
+
+# (name, statement, values handled per statement)
+CASES = [
+    (
+        'safe_divide: raise + except',
+        'try:\n    safe_divide(1.0, 0.0)\nexcept ZeroDivisionError:\n    pass',
+        1,
+    ),
+    (
+        'safe_divide: as_result',
+        'ok, code = safe_divide(1.0, 0.0, as_result=True)',
+        1,
+    ),
+    (
+        'raise_validation_error (formatted)',
+        'try:\n    raise_validation_error("age", "too large")\n'
+        'except ValidationError:\n    pass',
+        1,
+    ),
+    (
+        'validate_range: raise + except',
+        'try:\n    validate_range(50.0, 0.0, 10.0)\nexcept ValidationError:\n    pass',
+        1,
+    ),
+    (
+        'validate_range: as_result',
+        'ok, code = validate_range(50.0, 0.0, 10.0, as_result=True)',
+        1,
+    ),
+    (
+        'validate_range_many: mask',
+        'validate_range_many(values, 0.0, 10.0, mask)',
+        1000,
+    ),
+    (
+        'raise_custom_error(message)',
+        'try:\n    raise_custom_error("failed")\nexcept CustomError:\n    pass',
+        1,
+    ),
+    (
+        'raise_custom_error(None) (shared)',
+        'try:\n    raise_custom_error(None)\nexcept CustomError:\n    pass',
+        1,
+    ),
+]
+
+
+def ns_per_value(stmt, per_stmt, number):
+    """Best-of-5 nanoseconds per validated value"""
+    timer = timeit.Timer(stmt, setup=SETUP)
+    return min(timer.repeat(5, number)) / (number * per_stmt) * 1e9
+
+
+def main():
+    assert exceptions_module.validate_range_many(range(20), 0.0, 10.0) == 9
+
+    print "%-38s %12s" % ("failing call", "ns/value")
+    print "-" * 51
+    for name, stmt, per_stmt in CASES:
+        number = 200000 // per_stmt
+        print "%-38s %12.1f" % (name, ns_per_value(stmt, per_stmt, number))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,96 @@
+#!/usr/bin/env python2.7
+# -*- coding: utf-8 -*-
+"""
+Benchmark for objects_module.dumps/loads
+
+Compares the tagged binary serializer against cPickle (protocol 2) and
+json on three shapes of data: a flat list of ints, a list of small dicts
+that repeat the same keys (where the string memo pays off), and a deeply
+nested structure. Reports the best time to serialize and deserialize and
+the size of the encoded data.
+
+Usage:
+    python benchmarks/bench_serializer.py [--large]
+"""
+
+import cPickle
+import gc
+import json
+import os
+import sys
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+
+import objects_module  # noqa: E402
+
+
+def datasets(scale):
+    """Return (name, data) pairs of roughly `scale` leaf values each"""
+    records = [
+        {'id': i, 'name': 'user%d' % (i % 100), 'score': i * 0.5, 'active': True}
+        for i in xrange(scale // 4)
+    ]
+    nested = 0
+    for i in xrange(200):
+        nested = {'level': i, 'items': range(scale // 400), 'child': [nested]}
+    return [
+        ('ints', range(scale)),
+        ('records', records),
+        ('nested', nested),
+    ]
+
+
+def codecs():
+    """Return (name, dumps, loads) triples"""
+    return [
+        ('objects_module', objects_module.dumps, objects_module.loads),
+        ('cPickle-2', lambda obj: cPickle.dumps(obj, 2), cPickle.loads),
+        ('json', json.dumps, json.loads),
+    ]
+
+
+def best_time(func, arg, repeat):
+    """Return the best wall-clock time of `repeat` calls of func(arg)"""
+    best = None
+    for _ in range(repeat):
+        gc.collect()
+        start = time.time()
+        result = func(arg)
+        elapsed = time.time() - start
+        del result
+        if best is None or elapsed < best:
+            best = elapsed
+    return best
+
+
+def main():
+    scale = 10**6 if '--large' in sys.argv[1:] else 10**5
+    repeat = 5
+
+    for _, data in datasets(100):
+        assert objects_module.loads(objects_module.dumps(data)) == data
+
+    header = ("data", "codec", "dumps s", "loads s", "bytes", "vs pickle")
+    print "%-10s %-16s %12s %12s %12s %10s" % header
+    print "-" * 77
+    for data_name, data in datasets(scale):
+        results = []
+        for codec_name, dumps, loads in codecs():
+            encoded = dumps(data)
+            dump_time = best_time(dumps, data, repeat)
+            load_time = best_time(loads, encoded, repeat)
+            results.append((codec_name, dump_time, load_time, len(encoded)))
+
+        pickle_total = [r[1] + r[2] for r in results if r[0] == 'cPickle-2'][0]
+        for codec_name, dump_time, load_time, size in results:
+            total = dump_time + load_time
+            speedup = pickle_total / total if total > 0 else float('inf')
+            row = (data_name, codec_name, dump_time, load_time, size, speedup)
+            print "%-10s %-16s %12.6f %12.6f %12d %9.2fx" % row
+        print ""
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
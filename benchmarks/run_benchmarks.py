@@ -0,0 +1,325 @@
+#!/usr/bin/env python2.7
+# -*- coding: utf-8 -*-
+"""
+Benchmark runner for the tutorial extension modules
+
+Times a fixed set of calls at several input sizes and reports, per case:
+the median and best ns/op over --repeat runs, the spread between runs
+(standard deviation as a percentage of the median), ns per item for sized
+cases, and objs/op: the net number of GC-tracked objects left alive per
+call. Python 2.7 exposes no allocation counter (sys.getallocatedblocks
+is 3.4+), so objs/op is the closest stable signal; anything above zero
+means a call keeps or leaks containers.
+
+Results can be saved as a JSON baseline and compared on a later run;
+a case whose median is more than --threshold percent slower than the
+baseline is a regression and makes the runner exit with status 1:
+
+    python benchmarks/run_benchmarks.py --save benchmarks/baseline.json
+    (rebuild)
+    python benchmarks/run_benchmarks.py --compare benchmarks/baseline.json
+
+--cpu N re-runs the process under taskset to pin it to one CPU, which
+removes most of the run-to-run noise from migrations. Python 2.7 has no
+os.sched_setaffinity, hence taskset. Any taskset list works, and the
+pool cases need more than one CPU to scale (--cpu 0-3).
+
+Usage:
+    python benchmarks/run_benchmarks.py [--cpu LIST] [--repeat R]
+        [--filter TEXT] [--save FILE] [--compare FILE] [--threshold PCT]
+"""
+
+import ctypes
+import gc
+import json
+import math
+import optparse
+import os
+import sys
+import timeit
+
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+
+import advanced_module  # noqa: E402
+import basics_module  # noqa: E402
+import memory_module  # noqa: E402
+import objects_module  # noqa: E402
+
+PINNED_ENV = 'PYCAPI_BENCH_PINNED'
+TARGET_SECONDS = 0.02
+
+
+POOL = advanced_module.Pool()
+
+
+def _doubles(n):
+    """Three new-style (GIL-releasing) buffers of n doubles"""
+    return tuple((ctypes.c_double * n)(*([1.5] * n)) for _ in range(3))
+
+
+def _records(n):
+    """n small dicts sharing their keys, as dumps/loads sees them"""
+    return [{'id': i, 'name': 'user%d' % (i % 10), 'score': i * 0.5} for i in range(n)]
+
+
+def _range_iterator_loop(stop):
+    for _ in advanced_module.range_iterator(0, stop):
+        pass
+
+
+# (name, function, argument builder, sizes); an argument builder turns a
+# size into the argument tuple, and cases without sizes use size None
+CASES = [
+    ('basics.add_numbers', basics_module.add_numbers, lambda n: (1, 2), [None]),
+    (
+        'objects.sum_list',
+        objects_module.sum_list,
+        lambda n: (range(n),),
+        [10, 1000, 100000],
+    ),
+    (
+        'memory.create_populated_dict',
+        memory_module.create_populated_dict,
+        lambda n: (n,),
+        [10, 1000],
+    ),
+    (
+        'advanced.iterate',
+        advanced_module.iterate,
+        lambda n: (range(n),),
+        [10, 1000, 100000],
+    ),
+    (
+        'advanced.RangeIterator loop',
+        _range_iterator_loop,
+        lambda n: (n,),
+        [10, 1000, 100000],
+    ),
+    (
+        'objects.dumps',
+        objects_module.dumps,
+        lambda n: (_records(n),),
+        [10, 1000],
+    ),
+    (
+        'objects.loads',
+        objects_module.loads,
+        lambda n: (objects_module.dumps(_records(n)),),
+        [10, 1000],
+    ),
+    # Sorts in place, so only the first run sees unsorted input; the radix
+    # kernel does the same work either way
+    (
+        'objects.sort_homogeneous',
+        objects_module.sort_homogeneous,
+        lambda n: ([(i * 7919 % n) / 7.0 for i in xrange(n)],),
+        [1000, 100000],
+    ),
+    ('basics.mul_many', basics_module.mul_many, _doubles, [1000, 1000000]),
+    (
+        'basics.mul_many pool',
+        basics_module.mul_many,
+        lambda n: _doubles(n) + (POOL,),
+        [1000, 1000000],
+    ),
+]
+
+
+def case_label(name, size):
+    """Name a case and size the way results are keyed"""
+    if size is None:
+        return name
+    return '%s[%d]' % (name, size)
+
+
+def make_timer(func, args):
+    """Build a Timer for a direct call of func with args
+
+    The call is spelled out (f(a0, a1)) rather than f(*a) so METH_O and
+    METH_NOARGS functions skip building an argument tuple, as they would
+    in real code.
+    """
+    namespace = {'f': func}
+    names = []
+    for index, value in enumerate(args):
+        namespace['a%d' % index] = value
+        names.append('a%d' % index)
+    stmt = 'f(%s)' % ', '.join(names)
+
+    module = sys.modules[__name__]
+    module._namespace = namespace
+    setup = 'from %s import _namespace; globals().update(_namespace)' % __name__
+    return timeit.Timer(stmt, setup=setup)
+
+
+def calibrate(timer):
+    """Smallest power-of-ten loop count that runs for TARGET_SECONDS"""
+    number = 1
+    while True:
+        if timer.timeit(number) >= TARGET_SECONDS or number >= 10 ** 7:
+            return number
+        number *= 10
+
+
+def _noop():
+    pass
+
+
+def _net_objects(func, args, calls):
+    """Generation-0 counter growth over calls of func(*args)"""
+    before = gc.get_count()[0]
+    for _ in xrange(calls):
+        func(*args)
+    return gc.get_count()[0] - before
+
+
+def objects_per_call(func, args, calls=1000):
+    """Net GC-tracked objects left alive per call of func(*args)
+
+    Collection is disabled so the generation-0 counter, which rises on
+    every container allocation and falls on every container free, is not
+    reset halfway through. The growth of the same loop around a no-op is
+    subtracted, so the loop's own bookkeeping does not count.
+    """
+    gc.collect()
+    enabled = gc.isenabled()
+    gc.disable()
+    try:
+        overhead = _net_objects(_noop, (), calls)
+        growth = _net_objects(func, args, calls)
+    finally:
+        if enabled:
+            gc.enable()
+    return float(growth - overhead) / calls
+
+
+def measure(func, args, repeat):
+    """Time func(*args) and return the statistics for one case"""
+    timer = make_timer(func, args)
+    number = calibrate(timer)
+    runs = [elapsed / number * 1e9 for elapsed in timer.repeat(repeat, number)]
+    runs.sort()
+
+    middle = len(runs) // 2
+    if len(runs) % 2:
+        median = runs[middle]
+    else:
+        median = (runs[middle - 1] + runs[middle]) / 2.0
+    mean = sum(runs) / len(runs)
+    stdev = math.sqrt(sum((run - mean) ** 2 for run in runs) / len(runs))
+
+    return {
+        'median_ns': median,
+        'best_ns': runs[0],
+        'spread_pct': stdev / median * 100.0 if median else 0.0,
+        # + 0.0 turns a rounded -0.0 into 0.0
+        'objs_per_op': round(objects_per_call(func, args), 2) + 0.0,
+    }
+
+
+def pin_to_cpus(cpus):
+    """Re-execute under taskset pinned to cpus; returns only on failure"""
+    if os.environ.get(PINNED_ENV) == cpus:
+        return
+    env = dict(os.environ)
+    env[PINNED_ENV] = cpus
+    command = ['taskset', '-c', cpus, sys.executable] + sys.argv
+    try:
+        os.execvpe('taskset', command, env)
+    except OSError as error:
+        print >> sys.stderr, "warning: not pinned to CPUs %s: %s" % (cpus, error)
+
+
+def parse_args(argv):
+    parser = optparse.OptionParser(usage='%prog [options]')
+    parser.add_option('--cpu', help='pin the run to these CPUs (taskset list)')
+    parser.add_option(
+        '--repeat', type='int', default=7, help='timed runs per case [%default]'
+    )
+    parser.add_option('--filter', default='', help='only cases containing TEXT')
+    parser.add_option('--save', metavar='FILE', help='write results as JSON')
+    parser.add_option('--compare', metavar='FILE', help='JSON baseline to compare')
+    parser.add_option(
+        '--threshold',
+        type='float',
+        default=10.0,
+        help='regression threshold in percent [%default]',
+    )
+    options, _ = parser.parse_args(argv)
+    if options.repeat < 1:
+        parser.error('--repeat must be positive')
+    return options
+
+
+def main():
+    options = parse_args(sys.argv[1:])
+    if options.cpu is not None:
+        pin_to_cpus(options.cpu)
+
+    baseline = {}
+    if options.compare:
+        if os.path.exists(options.compare):
+            with open(options.compare) as handle:
+                baseline = json.load(handle)
+        else:
+            print >> sys.stderr, "warning: no baseline at %s" % options.compare
+
+    results = {}
+    regressions = []
+    header = (
+        "case",
+        "median ns",
+        "best ns",
+        "spread",
+        "ns/item",
+        "objs/op",
+        "baseline",
+        "change",
+    )
+    print "%-36s %11s %11s %7s %8s %7s %11s %8s" % header
+    print "-" * 107
+    for name, func, build_args, sizes in CASES:
+        for size in sizes:
+            label = case_label(name, size)
+            if options.filter not in label:
+                continue
+
+            stats = measure(func, build_args(size), options.repeat)
+            results[label] = stats
+            per_item = "%8.2f" % (stats['median_ns'] / size) if size else "-"
+
+            before, change = "-", "-"
+            if label in baseline:
+                old = baseline[label]['median_ns']
+                ratio = stats['median_ns'] / old - 1.0
+                before, change = "%.1f" % old, "%+.1f%%" % (ratio * 100.0)
+                if ratio * 100.0 > options.threshold:
+                    regressions.append((label, ratio * 100.0))
+
+            row = (
+                label,
+                stats['median_ns'],
+                stats['best_ns'],
+                "%.1f%%" % stats['spread_pct'],
+                per_item,
+                stats['objs_per_op'],
+                before,
+                change,
+            )
+            print "%-36s %11.1f %11.1f %7s %8s %7.2f %11s %8s" % row
+
+    if options.save:
+        with open(options.save, 'w') as handle:
+            json.dump(results, handle, indent=2, sort_keys=True)
+
+    if regressions:
+        print
+        print "Regressions over %.1f%%:" % options.threshold
+        for label, change in regressions:
+            print "  %-36s %+.1f%%" % (label, change)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -1,31 +1,104 @@
+import os
+import sys
 from distutils.core import Extension, setup
 
-# Define all C extension modules
-example_module = Extension('example_module', sources=['src/example_module.c'])
+# PYCAPI_INSTRUMENT=1 wraps every module function with call counters and
+# latency histograms (src/instrument.c). Switching it on or off needs
+# build_ext --force, since the sources themselves do not change.
+define_macros = []
+if os.environ.get('PYCAPI_INSTRUMENT', '0') not in ('', '0'):
+    define_macros.append(('PYCAPI_INSTRUMENT', '1'))
 
-basics_module = Extension('basics_module', sources=['src/basics_module.c'])
+# PYCAPI_BUILD selects an optimization profile; like PYCAPI_INSTRUMENT,
+# switching needs build_ext --force. "default" keeps the flags Python was
+# built with. "release" compiles and links with -O3 and link-time
+# optimization. The two pgo-* stages add profile-guided optimization:
+# build with pgo-generate, run a training load that writes .gcda files
+# next to the objects, then rebuild with pgo-use. `make release` runs all
+# three with the benchmark suite as the load.
+BUILD_PROFILES = {
+    'default': ([], []),
+    'release': (['-O3', '-flto'], ['-O3', '-flto']),
+    'pgo-generate': (
+        ['-O3', '-flto', '-fprofile-generate'],
+        ['-O3', '-flto', '-fprofile-generate'],
+    ),
+    'pgo-use': (
+        ['-O3', '-flto', '-fprofile-use', '-fprofile-correction'],
+        ['-O3', '-flto', '-fprofile-use', '-fprofile-correction'],
+    ),
+}
 
-objects_module = Extension('objects_module', sources=['src/objects_module.c'])
+build_profile = os.environ.get('PYCAPI_BUILD', '') or 'default'
+if build_profile not in BUILD_PROFILES:
+    raise SystemExit(
+        'unknown PYCAPI_BUILD=%r, expected one of: %s'
+        % (build_profile, ', '.join(sorted(BUILD_PROFILES)))
+    )
+compile_args, link_args = [list(flags) for flags in BUILD_PROFILES[build_profile]]
 
-memory_module = Extension(
-    'memory_module', sources=['src/memory_module.c'], extra_compile_args=['-lm']
-)
+# PYCAPI_NATIVE=1 tunes for the build machine's CPU. Leave it off for
+# anything that runs elsewhere, such as wheels: the batch kernels in
+# basics_module already choose AVX2 or AVX-512 code at load time.
+if os.environ.get('PYCAPI_NATIVE', '0') not in ('', '0'):
+    compile_args.append('-march=native')
+
+
+# PYCAPI_COMBINED=1 also builds _pycapi, a single shared object holding
+# all six modules (src/pycapi.c). Importing it first registers every
+# module, so later `import basics_module` statements need no dlopen.
+combined = os.environ.get('PYCAPI_COMBINED', '0') not in ('', '0')
+
+MODULE_NAMES = [
+    'example_module',
+    'basics_module',
+    'objects_module',
+    'memory_module',
+    'exceptions_module',
+    'advanced_module',
+]
+
+# Compiled into every extension: once per module, or once in _pycapi
+SHARED_SOURCES = ['src/instrument.c', 'src/shared.c']
+SHARED_HEADERS = ['src/instrument.h', 'src/shared.h']
 
-exceptions_module = Extension('exceptions_module', sources=['src/exceptions_module.c'])
+# pthread for advanced_module.Pool; shm_open lives in librt before glibc 2.34
+LIBRARIES = ['pthread']
+if sys.platform.startswith('linux'):
+    LIBRARIES.append('rt')
+
+
+def tutorial_extension(name, sources=None, **kwargs):
+    """Extension built from src/<name>.c and the shared sources"""
+    if sources is None:
+        sources = ['src/%s.c' % name]
+    return Extension(
+        name,
+        sources=sources + SHARED_SOURCES,
+        depends=SHARED_HEADERS,
+        define_macros=define_macros,
+        libraries=LIBRARIES,
+        extra_compile_args=compile_args,
+        extra_link_args=link_args,
+        **kwargs
+    )
+
+
+# Define all C extension modules
+ext_modules = [tutorial_extension(name) for name in MODULE_NAMES]
 
-advanced_module = Extension('advanced_module', sources=['src/advanced_module.c'])
+if combined:
+    ext_modules.append(
+        tutorial_extension(
+            '_pycapi',
+            sources=['src/pycapi.c'] + ['src/%s.c' % name for name in MODULE_NAMES],
+        )
+    )
 
 setup(
     name='PyCAPI Tutorial Suite',
     version='2.0',
     description='Comprehensive Python 2.7 C-API Tutorial Package',
     author='C-API Tutorial',
-    ext_modules=[
-        example_module,
-        basics_module,
-        objects_module,
-        memory_module,
-        exceptions_module,
-        advanced_module,
-    ],
+    ext_modules=ext_modules,
 )
@@ -4,13 +4,25 @@
  * This module covers advanced topics:
  * - Callable objects and function calls
  * - Iterator protocol
+ * - Memory-mapped record files
  * - Context managers
  * - Module state
  * - Capsules for C data
  * - Weak references
+ * - A worker thread pool
  */
 
 #include <Python.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <structmember.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "instrument.h"
+#include "shared.h"
 
 /* ============================================================================
  * CALLABLE OBJECTS
@@ -43,303 +55,4207 @@ static PyObject* call_with_kwargs(PyObject* self, PyObject* args) {
   PyObject* kwargs;
   PyObject* result;
 
-  if (!PyArg_ParseTuple(args, "OOO", &callable, &call_args, &kwargs)) {
+  if (!PyArg_ParseTuple(args, "OOO", &callable, &call_args, &kwargs)) {
+    return NULL;
+  }
+
+  if (!PyCallable_Check(callable)) {
+    PyErr_SetString(PyExc_TypeError, "first argument must be callable");
+    return NULL;
+  }
+
+  result = PyObject_Call(callable, call_args, kwargs);
+
+  return result;
+}
+
+static PyObject* call_many(PyObject* self, PyObject* args, PyObject* kwargs) {
+  PyObject* callable;
+  PyObject* iterable;
+  PyObject* call_kwargs = Py_None;
+  PyObject* collect = NULL;
+  static char* kwlist[] = {"func", "args", "kwargs", "collect", NULL};
+  PyObject* iterator = NULL;
+  PyObject* results = NULL;
+  PyObject* scratch = NULL; /* reusable 1-tuple for single arguments */
+  PyObject* item;
+  Py_ssize_t hint, count = 0;
+  int keep_results;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|OO", kwlist, &callable,
+                                   &iterable, &call_kwargs, &collect)) {
+    return NULL;
+  }
+
+  if (!PyCallable_Check(callable)) {
+    PyErr_SetString(PyExc_TypeError, "first argument must be callable");
+    return NULL;
+  }
+
+  if (call_kwargs == Py_None) {
+    call_kwargs = NULL;
+  } else if (!PyDict_Check(call_kwargs)) {
+    PyErr_SetString(PyExc_TypeError, "kwargs must be a dict or None");
+    return NULL;
+  }
+
+  keep_results = collect == NULL ? 1 : PyObject_IsTrue(collect);
+  if (keep_results < 0) {
+    return NULL;
+  }
+
+  iterator = PyObject_GetIter(iterable);
+  if (iterator == NULL) {
+    return NULL;
+  }
+
+  if (keep_results) {
+    hint = _PyObject_LengthHint(iterable, 0);
+    if (hint < 0 || (results = PyList_New(hint)) == NULL) {
+      goto error;
+    }
+  } else {
+    hint = 0;
+  }
+
+  while ((item = PyIter_Next(iterator))) {
+    PyObject* call_args;
+    PyObject* result;
+
+    if (PyTuple_CheckExact(item)) {
+      /* An argument tuple is passed through as-is */
+      call_args = item;
+    } else {
+      /* Anything else is a single argument. The 1-tuple is only reused
+       * when the previous callee did not keep a reference to it. */
+      if (scratch != NULL && Py_REFCNT(scratch) == 1) {
+        PyObject* old = PyTuple_GET_ITEM(scratch, 0);
+        Py_INCREF(item);
+        PyTuple_SET_ITEM(scratch, 0, item);
+        Py_DECREF(old);
+      } else {
+        Py_XDECREF(scratch);
+        scratch = PyTuple_Pack(1, item);
+        if (scratch == NULL) {
+          Py_DECREF(item);
+          goto error;
+        }
+      }
+      call_args = scratch;
+    }
+
+    result = PyObject_Call(callable, call_args, call_kwargs);
+    Py_DECREF(item);
+    if (result == NULL) {
+      goto error; /* First failure stops the batch */
+    }
+
+    if (!keep_results) {
+      Py_DECREF(result);
+    } else if (count < hint) {
+      PyList_SET_ITEM(results, count, result);
+    } else {
+      int status = PyList_Append(results, result);
+      Py_DECREF(result);
+      if (status < 0) {
+        goto error;
+      }
+    }
+    count++;
+  }
+
+  if (PyErr_Occurred()) {
+    goto error;
+  }
+
+  Py_DECREF(iterator);
+  Py_XDECREF(scratch);
+
+  if (!keep_results) {
+    return PyInt_FromSsize_t(count);
+  }
+
+  if (count < hint && PyList_SetSlice(results, count, hint, NULL) < 0) {
+    Py_DECREF(results);
+    return NULL;
+  }
+  return results;
+
+error:
+  Py_XDECREF(iterator);
+  Py_XDECREF(scratch);
+  Py_XDECREF(results);
+  return NULL;
+}
+
+static PyObject* call_method(PyObject* self, PyObject* args) {
+  PyObject* obj;
+  PyObject* method_name;
+  PyObject* method_args;
+  PyObject* name;
+  PyObject* method;
+  PyObject* result;
+
+  if (!PyArg_ParseTuple(args, "OOO", &obj, &method_name, &method_args)) {
+    return NULL;
+  }
+
+  name = pycapi_intern_name(method_name);
+  if (name == NULL) {
+    return NULL;
+  }
+
+  method = PyObject_GetAttr(obj, name);
+  Py_DECREF(name);
+  if (method == NULL) {
+    return NULL;
+  }
+
+  result = PyObject_CallFunctionObjArgs(method, method_args, NULL);
+  Py_DECREF(method);
+
+  return result;
+}
+
+/* A BoundMethod resolves obj.name once; calling the handle afterwards skips
+ * the attribute lookup and the bound-method allocation on every call. */
+typedef struct {
+  PyObject_HEAD PyObject* obj;
+  PyObject* name;
+  PyObject* func;
+} BoundMethod;
+
+static void BoundMethod_dealloc(BoundMethod* self) {
+  PyObject_GC_UnTrack(self);
+  Py_XDECREF(self->obj);
+  Py_XDECREF(self->name);
+  Py_XDECREF(self->func);
+  PyObject_GC_Del(self);
+}
+
+static int BoundMethod_traverse(BoundMethod* self, visitproc visit,
+                                void* arg) {
+  Py_VISIT(self->obj);
+  Py_VISIT(self->name);
+  Py_VISIT(self->func);
+  return 0;
+}
+
+static PyObject* BoundMethod_call(BoundMethod* self, PyObject* args,
+                                  PyObject* kwargs) {
+  return PyObject_Call(self->func, args, kwargs);
+}
+
+static PyObject* BoundMethod_repr(BoundMethod* self) {
+  PyObject* name_repr = PyObject_Repr(self->name);
+  PyObject* result;
+
+  if (name_repr == NULL) {
+    return NULL;
+  }
+
+  result = PyString_FromFormat("<BoundMethod %s of %s object at %p>",
+                               PyString_AS_STRING(name_repr),
+                               Py_TYPE(self->obj)->tp_name, self->obj);
+  Py_DECREF(name_repr);
+  return result;
+}
+
+static PyMemberDef BoundMethod_members[] = {
+    {"obj", T_OBJECT, offsetof(BoundMethod, obj), READONLY,
+     "Object the method was resolved on"},
+    {"name", T_OBJECT, offsetof(BoundMethod, name), READONLY,
+     "Interned attribute name"},
+    {"func", T_OBJECT, offsetof(BoundMethod, func), READONLY,
+     "Resolved callable"},
+    {NULL, 0, 0, 0, NULL}};
+
+static PyTypeObject BoundMethodType = {
+    PyObject_HEAD_INIT(NULL) 0,              /* ob_size */
+    "advanced_module.BoundMethod",           /* tp_name */
+    sizeof(BoundMethod),                     /* tp_basicsize */
+    0,                                       /* tp_itemsize */
+    (destructor)BoundMethod_dealloc,         /* tp_dealloc */
+    0,                                       /* tp_print */
+    0,                                       /* tp_getattr */
+    0,                                       /* tp_setattr */
+    0,                                       /* tp_compare */
+    (reprfunc)BoundMethod_repr,              /* tp_repr */
+    0,                                       /* tp_as_number */
+    0,                                       /* tp_as_sequence */
+    0,                                       /* tp_as_mapping */
+    0,                                       /* tp_hash */
+    (ternaryfunc)BoundMethod_call,           /* tp_call */
+    0,                                       /* tp_str */
+    0,                                       /* tp_getattro */
+    0,                                       /* tp_setattro */
+    0,                                       /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC, /* tp_flags */
+    "Pre-resolved method handle",            /* tp_doc */
+    (traverseproc)BoundMethod_traverse,      /* tp_traverse */
+    0,                                       /* tp_clear */
+    0,                                       /* tp_richcompare */
+    0,                                       /* tp_weaklistoffset */
+    0,                                       /* tp_iter */
+    0,                                       /* tp_iternext */
+    0,                                       /* tp_methods */
+    BoundMethod_members,                     /* tp_members */
+};
+
+static PyObject* bound_method(PyObject* self, PyObject* args) {
+  PyObject* obj;
+  PyObject* method_name;
+  BoundMethod* handle;
+  PyObject* name;
+  PyObject* func;
+
+  if (!PyArg_ParseTuple(args, "OO", &obj, &method_name)) {
+    return NULL;
+  }
+
+  name = pycapi_intern_name(method_name);
+  if (name == NULL) {
+    return NULL;
+  }
+
+  func = PyObject_GetAttr(obj, name);
+  if (func == NULL) {
+    Py_DECREF(name);
+    return NULL;
+  }
+
+  if (!PyCallable_Check(func)) {
+    Py_DECREF(name);
+    Py_DECREF(func);
+    PyErr_SetString(PyExc_TypeError, "attribute is not callable");
+    return NULL;
+  }
+
+  handle = PyObject_GC_New(BoundMethod, &BoundMethodType);
+  if (handle == NULL) {
+    Py_DECREF(name);
+    Py_DECREF(func);
+    return NULL;
+  }
+
+  Py_INCREF(obj);
+  handle->obj = obj;
+  handle->name = name;
+  handle->func = func;
+  PyObject_GC_Track(handle);
+
+  return (PyObject*)handle;
+}
+
+/* ============================================================================
+ * ITERATOR PROTOCOL
+ * ============================================================================
+ */
+
+/* A RangeIterator is both an iterator and a lazy sequence over the values it
+ * has not produced yet: len(), indexing, slicing and `in` all describe what
+ * the remaining iteration would yield, and nothing is materialized. */
+typedef struct {
+  PyObject_HEAD long start;
+  long step;
+  Py_ssize_t length; /* total number of values */
+  Py_ssize_t index;  /* values already consumed */
+} RangeIterator;
+
+static PyTypeObject RangeIteratorType;
+
+/* Number of values in [start, stop) with the given non-zero step, computed
+ * in unsigned arithmetic so extreme bounds cannot overflow. */
+static int range_length(long start, long stop, long step,
+                        Py_ssize_t* length) {
+  unsigned long span, ustep, count;
+
+  if (step > 0 && start < stop) {
+    span = (unsigned long)stop - (unsigned long)start - 1;
+    ustep = (unsigned long)step;
+  } else if (step < 0 && start > stop) {
+    span = (unsigned long)start - (unsigned long)stop - 1;
+    ustep = 0UL - (unsigned long)step;
+  } else {
+    *length = 0;
+    return 1;
+  }
+
+  count = span / ustep + 1;
+  if (count > (unsigned long)PY_SSIZE_T_MAX) {
+    PyErr_SetString(PyExc_OverflowError, "range has too many items");
+    return 0;
+  }
+
+  *length = (Py_ssize_t)count;
+  return 1;
+}
+
+/* Value at absolute position i. It always lies between start and stop, so
+ * wrapping unsigned arithmetic yields the exact result. */
+static long range_value(RangeIterator* self, Py_ssize_t i) {
+  return (long)((unsigned long)self->start +
+                (unsigned long)i * (unsigned long)self->step);
+}
+
+static RangeIterator* range_new(long start, long step, Py_ssize_t length) {
+  RangeIterator* iter = PyObject_New(RangeIterator, &RangeIteratorType);
+  if (iter == NULL) {
+    return NULL;
+  }
+
+  iter->start = start;
+  iter->step = step;
+  iter->length = length;
+  iter->index = 0;
+  return iter;
+}
+
+static void RangeIterator_dealloc(RangeIterator* self) { PyObject_Del(self); }
+
+static PyObject* RangeIterator_iter(PyObject* self) {
+  Py_INCREF(self);
+  return self;
+}
+
+static PyObject* RangeIterator_next(RangeIterator* self) {
+  if (self->index >= self->length) {
+    PyErr_SetNone(PyExc_StopIteration);
+    return NULL;
+  }
+
+  return PyInt_FromLong(range_value(self, self->index++));
+}
+
+static Py_ssize_t RangeIterator_length(RangeIterator* self) {
+  return self->length - self->index;
+}
+
+static PyObject* RangeIterator_item(RangeIterator* self, Py_ssize_t i) {
+  Py_ssize_t remaining = self->length - self->index;
+
+  if (i < 0 || i >= remaining) {
+    PyErr_SetString(PyExc_IndexError, "RangeIterator index out of range");
+    return NULL;
+  }
+
+  return PyInt_FromLong(range_value(self, self->index + i));
+}
+
+static PyObject* RangeIterator_subscript(RangeIterator* self, PyObject* key) {
+  Py_ssize_t remaining = self->length - self->index;
+
+  if (PySlice_Check(key)) {
+    Py_ssize_t start, stop, step, slicelength;
+    long new_step;
+
+    if (PySlice_GetIndicesEx((PySliceObject*)key, remaining, &start, &stop,
+                             &step, &slicelength) < 0) {
+      return NULL;
+    }
+
+    /* A slice of at most one element never uses its step. Otherwise
+     * multiply the steps in unsigned math and reject products that do not
+     * round-trip. */
+    if (slicelength <= 1) {
+      new_step = 1;
+    } else {
+      new_step = (long)((unsigned long)self->step * (unsigned long)step);
+      if (step == -1 ? self->step == LONG_MIN
+                     : new_step / step != self->step) {
+        PyErr_SetString(PyExc_OverflowError, "slice step too large");
+        return NULL;
+      }
+    }
+
+    return (PyObject*)range_new(
+        slicelength > 0 ? range_value(self, self->index + start) : 0,
+        new_step, slicelength);
+  }
+
+  if (PyIndex_Check(key)) {
+    Py_ssize_t i = PyNumber_AsSsize_t(key, PyExc_IndexError);
+    if (i == -1 && PyErr_Occurred()) {
+      return NULL;
+    }
+    if (i < 0) {
+      i += remaining;
+    }
+    return RangeIterator_item(self, i);
+  }
+
+  PyErr_Format(PyExc_TypeError,
+               "RangeIterator indices must be integers, not %.200s",
+               Py_TYPE(key)->tp_name);
+  return NULL;
+}
+
+/* O(1) membership: only integers can be members, anything else is not. */
+static int RangeIterator_contains(RangeIterator* self, PyObject* value) {
+  long v, first;
+  int overflow = 0;
+  unsigned long distance, ustep;
+  Py_ssize_t remaining = self->length - self->index;
+
+  if (remaining == 0 || !(PyInt_Check(value) || PyLong_Check(value))) {
+    return 0;
+  }
+
+  v = PyLong_AsLongAndOverflow(value, &overflow);
+  if (v == -1 && PyErr_Occurred()) {
+    return -1;
+  }
+  if (overflow) {
+    return 0;
+  }
+
+  first = range_value(self, self->index);
+  if (self->step > 0) {
+    if (v < first) return 0;
+    distance = (unsigned long)v - (unsigned long)first;
+    ustep = (unsigned long)self->step;
+  } else {
+    if (v > first) return 0;
+    distance = (unsigned long)first - (unsigned long)v;
+    ustep = 0UL - (unsigned long)self->step;
+  }
+  if (ustep == 0) {
+    return distance == 0;
+  }
+
+  return distance % ustep == 0 && distance / ustep < (unsigned long)remaining;
+}
+
+static PyObject* RangeIterator_next_n(RangeIterator* self, PyObject* args) {
+  Py_ssize_t k, count, i;
+  PyObject* out = NULL;
+  Py_ssize_t remaining = self->length - self->index;
+
+  if (!PyArg_ParseTuple(args, "n|O", &k, &out)) {
+    return NULL;
+  }
+
+  if (k < 0) {
+    PyErr_SetString(PyExc_ValueError, "k must be non-negative");
+    return NULL;
+  }
+
+  count = k < remaining ? k : remaining;
+
+  if (out != NULL) {
+    /* Fill a caller-provided buffer of C longs, e.g. array.array('l') */
+    void* data;
+    Py_ssize_t len;
+    long* items;
+
+    if (PyObject_AsWriteBuffer(out, &data, &len) < 0) {
+      return NULL;
+    }
+    if (len % sizeof(long) != 0) {
+      PyErr_SetString(PyExc_ValueError,
+                      "out buffer size is not a multiple of sizeof(long)");
+      return NULL;
+    }
+    if (count > len / (Py_ssize_t)sizeof(long)) {
+      count = len / (Py_ssize_t)sizeof(long);
+    }
+
+    items = (long*)data;
+    for (i = 0; i < count; i++) {
+      items[i] = range_value(self, self->index + i);
+    }
+    self->index += count;
+    return PyInt_FromSsize_t(count);
+  } else {
+    PyObject* result = PyList_New(count);
+    if (result == NULL) {
+      return NULL;
+    }
+
+    for (i = 0; i < count; i++) {
+      PyObject* item = PyInt_FromLong(range_value(self, self->index + i));
+      if (item == NULL) {
+        Py_DECREF(result);
+        return NULL;
+      }
+      PyList_SET_ITEM(result, i, item);
+    }
+    self->index += count;
+    return result;
+  }
+}
+
+static PySequenceMethods RangeIterator_as_sequence = {
+    (lenfunc)RangeIterator_length,        /* sq_length */
+    0,                                    /* sq_concat */
+    0,                                    /* sq_repeat */
+    (ssizeargfunc)RangeIterator_item,     /* sq_item */
+    0,                                    /* sq_slice */
+    0,                                    /* sq_ass_item */
+    0,                                    /* sq_ass_slice */
+    (objobjproc)RangeIterator_contains,   /* sq_contains */
+};
+
+static PyMappingMethods RangeIterator_as_mapping = {
+    (lenfunc)RangeIterator_length,        /* mp_length */
+    (binaryfunc)RangeIterator_subscript,  /* mp_subscript */
+    0,                                    /* mp_ass_subscript */
+};
+
+static PyMethodDef RangeIterator_methods[] = {
+    {"next_n", (PyCFunction)RangeIterator_next_n, METH_VARARGS,
+     "Consume up to k values in one call.\n\nArgs:\n    k (int): Maximum "
+     "number of values\n    out (buffer, optional): Writable buffer of C "
+     "longs, e.g. array.array('l'), to fill instead\n\nReturns:\n    list: "
+     "The values, or int: number written to out"},
+    {NULL, NULL, 0, NULL}};
+
+static PyTypeObject RangeIteratorType = {
+    PyObject_HEAD_INIT(NULL) 0,        /* ob_size */
+    "advanced_module.RangeIterator",   /* tp_name */
+    sizeof(RangeIterator),             /* tp_basicsize */
+    0,                                 /* tp_itemsize */
+    (destructor)RangeIterator_dealloc, /* tp_dealloc */
+    0,                                 /* tp_print */
+    0,                                 /* tp_getattr */
+    0,                                 /* tp_setattr */
+    0,                                 /* tp_compare */
+    0,                                 /* tp_repr */
+    0,                                 /* tp_as_number */
+    &RangeIterator_as_sequence,        /* tp_as_sequence */
+    &RangeIterator_as_mapping,         /* tp_as_mapping */
+    0,                                 /* tp_hash */
+    0,                                 /* tp_call */
+    0,                                 /* tp_str */
+    0,                                 /* tp_getattro */
+    0,                                 /* tp_setattro */
+    0,                                 /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                /* tp_flags */
+    "Range iterator object",           /* tp_doc */
+    0,                                 /* tp_traverse */
+    0,                                 /* tp_clear */
+    0,                                 /* tp_richcompare */
+    0,                                 /* tp_weaklistoffset */
+    RangeIterator_iter,                /* tp_iter */
+    (iternextfunc)RangeIterator_next,  /* tp_iternext */
+    RangeIterator_methods,             /* tp_methods */
+};
+
+static PyObject* create_range_iterator(PyObject* self, PyObject* args) {
+  long start, stop, step = 1;
+  Py_ssize_t length;
+
+  if (!PyArg_ParseTuple(args, "ll|l", &start, &stop, &step)) {
+    return NULL;
+  }
+
+  if (step == 0) {
+    PyErr_SetString(PyExc_ValueError, "step must not be zero");
+    return NULL;
+  }
+
+  if (!range_length(start, stop, step, &length)) {
+    return NULL;
+  }
+
+  return (PyObject*)range_new(start, step, length);
+}
+
+/* Copy up to `count` items of a list or tuple starting at `pos` into a new
+ * list. Used by both iterate() and ChunkIterator's fast path. */
+static PyObject* fast_sequence_slice(PyObject* seq, Py_ssize_t pos,
+                                     Py_ssize_t count) {
+  PyObject** items = PySequence_Fast_ITEMS(seq);
+  PyObject* result = PyList_New(count);
+  Py_ssize_t i;
+
+  if (result == NULL) {
+    return NULL;
+  }
+
+  for (i = 0; i < count; i++) {
+    Py_INCREF(items[pos + i]);
+    PyList_SET_ITEM(result, i, items[pos + i]);
+  }
+
+  return result;
+}
+
+/* Pull up to `limit` items from an iterator into a list presized to `hint`
+ * slots (limit < 0 means exhaust the iterator). The list grows past the hint
+ * if needed and is trimmed to the items actually produced. */
+static PyObject* drain_iterator(PyObject* iterator, Py_ssize_t hint,
+                                Py_ssize_t limit) {
+  PyObject* result;
+  PyObject* item;
+  Py_ssize_t filled = 0;
+
+  if (limit >= 0 && hint > limit) {
+    hint = limit;
+  }
+
+  result = PyList_New(hint);
+  if (result == NULL) {
+    return NULL;
+  }
+
+  while ((limit < 0 || filled < limit) && (item = PyIter_Next(iterator))) {
+    if (filled < hint) {
+      PyList_SET_ITEM(result, filled, item);
+    } else {
+      int status = PyList_Append(result, item);
+      Py_DECREF(item);
+      if (status < 0) {
+        Py_DECREF(result);
+        return NULL;
+      }
+    }
+    filled++;
+  }
+
+  if (PyErr_Occurred()) {
+    Py_DECREF(result);
+    return NULL;
+  }
+
+  /* Drop the unused presized slots, which are still NULL */
+  if (filled < hint && PyList_SetSlice(result, filled, hint, NULL) < 0) {
+    Py_DECREF(result);
+    return NULL;
+  }
+
+  return result;
+}
+
+typedef struct {
+  PyObject_HEAD PyObject* source; /* list/tuple, or an iterator */
+  Py_ssize_t pos;                 /* next index when source is a sequence */
+  Py_ssize_t chunk_size;
+  int is_sequence;
+} ChunkIterator;
+
+static void ChunkIterator_dealloc(ChunkIterator* self) {
+  PyObject_GC_UnTrack(self);
+  Py_XDECREF(self->source);
+  PyObject_GC_Del(self);
+}
+
+static int ChunkIterator_traverse(ChunkIterator* self, visitproc visit,
+                                  void* arg) {
+  Py_VISIT(self->source);
+  return 0;
+}
+
+static PyObject* ChunkIterator_iter(PyObject* self) {
+  Py_INCREF(self);
+  return self;
+}
+
+static PyObject* ChunkIterator_next(ChunkIterator* self) {
+  PyObject* chunk;
+
+  if (self->source == NULL) {
+    return NULL;
+  }
+
+  if (self->is_sequence) {
+    /* Re-read the size each time: a list may change between chunks */
+    Py_ssize_t size = PySequence_Fast_GET_SIZE(self->source);
+    Py_ssize_t count = size - self->pos;
+
+    if (count > self->chunk_size) {
+      count = self->chunk_size;
+    }
+    if (count <= 0) {
+      Py_CLEAR(self->source);
+      return NULL;
+    }
+
+    chunk = fast_sequence_slice(self->source, self->pos, count);
+    if (chunk != NULL) {
+      self->pos += count;
+    }
+    return chunk;
+  }
+
+  chunk = drain_iterator(self->source, self->chunk_size, self->chunk_size);
+  if (chunk != NULL && PyList_GET_SIZE(chunk) == 0) {
+    Py_DECREF(chunk);
+    Py_CLEAR(self->source);
+    return NULL;
+  }
+  return chunk;
+}
+
+static PyTypeObject ChunkIteratorType = {
+    PyObject_HEAD_INIT(NULL) 0,                /* ob_size */
+    "advanced_module.ChunkIterator",           /* tp_name */
+    sizeof(ChunkIterator),                     /* tp_basicsize */
+    0,                                         /* tp_itemsize */
+    (destructor)ChunkIterator_dealloc,         /* tp_dealloc */
+    0,                                         /* tp_print */
+    0,                                         /* tp_getattr */
+    0,                                         /* tp_setattr */
+    0,                                         /* tp_compare */
+    0,                                         /* tp_repr */
+    0,                                         /* tp_as_number */
+    0,                                         /* tp_as_sequence */
+    0,                                         /* tp_as_mapping */
+    0,                                         /* tp_hash */
+    0,                                         /* tp_call */
+    0,                                         /* tp_str */
+    0,                                         /* tp_getattro */
+    0,                                         /* tp_setattro */
+    0,                                         /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,   /* tp_flags */
+    "Iterator yielding lists of chunk_size items", /* tp_doc */
+    (traverseproc)ChunkIterator_traverse,      /* tp_traverse */
+    0,                                         /* tp_clear */
+    0,                                         /* tp_richcompare */
+    0,                                         /* tp_weaklistoffset */
+    ChunkIterator_iter,                        /* tp_iter */
+    (iternextfunc)ChunkIterator_next,          /* tp_iternext */
+};
+
+static PyObject* iterate_object(PyObject* self, PyObject* args,
+                                PyObject* kwargs) {
+  PyObject* iterable;
+  Py_ssize_t chunk_size = 0;
+  static char* kwlist[] = {"iterable", "chunk_size", NULL};
+  PyObject* iterator;
+  PyObject* result;
+  Py_ssize_t hint;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|n", kwlist, &iterable,
+                                   &chunk_size)) {
+    return NULL;
+  }
+
+  if (chunk_size < 0) {
+    PyErr_SetString(PyExc_ValueError, "chunk_size must be non-negative");
+    return NULL;
+  }
+
+  /* Chunked mode: hand back a lazy iterator of lists */
+  if (chunk_size > 0) {
+    ChunkIterator* chunks = PyObject_GC_New(ChunkIterator, &ChunkIteratorType);
+    if (chunks == NULL) {
+      return NULL;
+    }
+
+    chunks->pos = 0;
+    chunks->chunk_size = chunk_size;
+    chunks->is_sequence =
+        PyList_CheckExact(iterable) || PyTuple_CheckExact(iterable);
+    if (chunks->is_sequence) {
+      Py_INCREF(iterable);
+      chunks->source = iterable;
+    } else {
+      chunks->source = PyObject_GetIter(iterable);
+      if (chunks->source == NULL) {
+        Py_DECREF(chunks);
+        return NULL;
+      }
+    }
+
+    PyObject_GC_Track(chunks);
+    return (PyObject*)chunks;
+  }
+
+  /* Lists and tuples: copy the item array directly */
+  if (PyList_CheckExact(iterable) || PyTuple_CheckExact(iterable)) {
+    return fast_sequence_slice(iterable, 0,
+                               PySequence_Fast_GET_SIZE(iterable));
+  }
+
+  iterator = PyObject_GetIter(iterable);
+  if (iterator == NULL) {
+    return NULL;
+  }
+
+  /* Presize from len() or __length_hint__ when the iterable offers one */
+  hint = _PyObject_LengthHint(iterable, 0);
+  if (hint < 0) {
+    Py_DECREF(iterator);
+    return NULL;
+  }
+
+  result = drain_iterator(iterator, hint, -1);
+  Py_DECREF(iterator);
+
+  return result;
+}
+
+/* ============================================================================
+ * MEMORY-MAPPED RECORDS
+ * ============================================================================
+ */
+
+/* A MappedRecords maps a file of fixed-size binary records and, like
+ * RangeIterator, is both an iterator and a lazy sequence over the records
+ * it has not produced yet. Records are decoded only when they are read;
+ * the file itself is paged in by the kernel, so a scan touches each page
+ * once and never holds more of the file than the page cache chooses to.
+ *
+ * dtype is a struct format. A single native code ('d', 'i', 'Q', ...)
+ * decodes each record straight to an int or float; any other format, such
+ * as '<2id', goes through struct.Struct.unpack and yields tuples. Slices
+ * are new MappedRecords over the same mapping, so a slice with a step is
+ * as cheap as one without. */
+
+#define MAPPED_SCALAR_CODES "bBhHiIlLqQfd?"
+
+/* Shape and strides handed out with buffer views. A view's block must
+ * outlive it even after the cursor moves; Python 2.7's memoryview copies
+ * view->internal when re-exporting, so the blocks hang off the object
+ * instead and are freed once no view is left. */
+typedef struct RecordsDims {
+  struct RecordsDims* next;
+  Py_ssize_t shape[2];
+  Py_ssize_t strides[2];
+} RecordsDims;
+
+typedef struct MappedRecords {
+  PyObject_HEAD char* map;      /* mapping owned by this object, or NULL */
+  size_t map_size;
+  struct MappedRecords* owner;  /* object owning the mapping, for slices */
+  char* first;                  /* first record */
+  Py_ssize_t stride;            /* bytes between records, < 0 reversed */
+  Py_ssize_t record_size;
+  Py_ssize_t length;            /* total number of records */
+  Py_ssize_t index;             /* records already consumed */
+  Py_ssize_t readahead;         /* records to prefetch ahead of the cursor */
+  Py_ssize_t advised;           /* records prefetched so far */
+  Py_ssize_t exports;           /* buffer views and slices still alive */
+  int closed;
+  char format[2];               /* scalar struct code, or "" for compound */
+  PyObject* dtype;
+  PyObject* unpack;             /* Struct.unpack for compound records */
+  RecordsDims* dims;            /* newest first; dims->shape[0] is current */
+} MappedRecords;
+
+static PyTypeObject MappedRecordsType;
+
+static int records_check_open(MappedRecords* self) {
+  if (self->closed) {
+    PyErr_SetString(PyExc_ValueError, "MappedRecords is closed");
+    return -1;
+  }
+  return 0;
+}
+
+static Py_ssize_t scalar_size(char code) {
+  switch (code) {
+    case 'b':
+    case 'B':
+    case '?':
+      return 1;
+    case 'h':
+    case 'H':
+      return sizeof(short);
+    case 'i':
+    case 'I':
+      return sizeof(int);
+    case 'l':
+    case 'L':
+      return sizeof(long);
+    case 'q':
+    case 'Q':
+      return sizeof(PY_LONG_LONG);
+    case 'f':
+      return sizeof(float);
+    default:
+      return sizeof(double);
+  }
+}
+
+/* Records carry no alignment guarantee, so every load goes through memcpy,
+ * which compiles to a plain load where the target allows it */
+static PyObject* decode_scalar(char code, const char* p) {
+  switch (code) {
+    case 'b':
+      return PyInt_FromLong(*(const signed char*)p);
+    case 'B':
+      return PyInt_FromLong(*(const unsigned char*)p);
+    case '?':
+      return PyBool_FromLong(*p != 0);
+    case 'h': {
+      short v;
+      memcpy(&v, p, sizeof(v));
+      return PyInt_FromLong(v);
+    }
+    case 'H': {
+      unsigned short v;
+      memcpy(&v, p, sizeof(v));
+      return PyInt_FromLong(v);
+    }
+    case 'i': {
+      int v;
+      memcpy(&v, p, sizeof(v));
+      return PyInt_FromLong(v);
+    }
+    case 'I': {
+      unsigned int v;
+      memcpy(&v, p, sizeof(v));
+      return PyLong_FromUnsignedLong(v);
+    }
+    case 'l': {
+      long v;
+      memcpy(&v, p, sizeof(v));
+      return PyInt_FromLong(v);
+    }
+    case 'L': {
+      unsigned long v;
+      memcpy(&v, p, sizeof(v));
+      return PyLong_FromUnsignedLong(v);
+    }
+    case 'q': {
+      PY_LONG_LONG v;
+      memcpy(&v, p, sizeof(v));
+      return PyLong_FromLongLong(v);
+    }
+    case 'Q': {
+      unsigned PY_LONG_LONG v;
+      memcpy(&v, p, sizeof(v));
+      return PyLong_FromUnsignedLongLong(v);
+    }
+    case 'f': {
+      float v;
+      memcpy(&v, p, sizeof(v));
+      return PyFloat_FromDouble(v);
+    }
+    default: {
+      double v;
+      memcpy(&v, p, sizeof(v));
+      return PyFloat_FromDouble(v);
+    }
+  }
+}
+
+static char* record_ptr(MappedRecords* self, Py_ssize_t i) {
+  return self->first + i * self->stride;
+}
+
+static PyObject* record_value(MappedRecords* self, Py_ssize_t i) {
+  const char* p = record_ptr(self, i);
+  PyObject* raw;
+  PyObject* result;
+
+  if (self->format[0] != '\0') {
+    return decode_scalar(self->format[0], p);
+  }
+
+  raw = PyString_FromStringAndSize(p, self->record_size);
+  if (raw == NULL) {
+    return NULL;
+  }
+  result = PyObject_CallFunctionObjArgs(self->unpack, raw, NULL);
+  Py_DECREF(raw);
+  return result;
+}
+
+/* madvise() the pages holding records [start, start + count) */
+static int records_advise(MappedRecords* self, Py_ssize_t start,
+                          Py_ssize_t count, int advice) {
+  static uintptr_t page_size = 0;
+  uintptr_t lo, hi;
+
+  if (count <= 0) {
+    return 0;
+  }
+  if (page_size == 0) {
+    page_size = (uintptr_t)sysconf(_SC_PAGESIZE);
+  }
+
+  lo = (uintptr_t)record_ptr(self, start);
+  hi = (uintptr_t)record_ptr(self, start + count - 1);
+  if (lo > hi) {
+    uintptr_t swap = lo;
+    lo = hi;
+    hi = swap;
+  }
+  hi += self->record_size;
+
+  /* The mapping starts on a page, so rounding down stays inside it */
+  lo &= ~(page_size - 1);
+  return madvise((void*)lo, hi - lo, advice);
+}
+
+/* Before reading up to record `upto`, prefetch the next window if the
+ * cursor has caught up with the part already advised */
+static void records_prefetch(MappedRecords* self, Py_ssize_t upto) {
+  Py_ssize_t end;
+
+  if (self->readahead <= 0 || upto <= self->advised) {
+    return;
+  }
+
+  end = upto + self->readahead;
+  if (end > self->length || end < upto) {
+    end = self->length;
+  }
+  if (self->advised < self->index) {
+    self->advised = self->index;
+  }
+
+  /* Only a hint: a failure costs speed, not correctness */
+  records_advise(self, self->advised, end - self->advised, MADV_WILLNEED);
+  self->advised = end;
+}
+
+/* Split a dtype into a scalar code or a Struct.unpack callable */
+static int records_parse_dtype(MappedRecords* self, PyObject* dtype) {
+  const char* spec = PyString_AS_STRING(dtype);
+  PyObject* struct_module;
+  PyObject* compiled;
+  PyObject* size;
+
+  if (spec[0] == '@') {
+    spec++;
+  }
+  if (spec[0] != '\0' && spec[1] == '\0' &&
+      strchr(MAPPED_SCALAR_CODES, spec[0]) != NULL) {
+    self->format[0] = spec[0];
+    self->format[1] = '\0';
+    self->record_size = scalar_size(spec[0]);
+    return 0;
+  }
+
+  struct_module = PyImport_ImportModule("struct");
+  if (struct_module == NULL) {
+    return -1;
+  }
+  compiled = PyObject_CallMethod(struct_module, "Struct", "O", dtype);
+  Py_DECREF(struct_module);
+  if (compiled == NULL) {
+    return -1;
+  }
+
+  size = PyObject_GetAttrString(compiled, "size");
+  if (size != NULL) {
+    self->record_size = PyNumber_AsSsize_t(size, PyExc_OverflowError);
+    Py_DECREF(size);
+  }
+  self->unpack = PyObject_GetAttrString(compiled, "unpack");
+  Py_DECREF(compiled);
+  if (size == NULL || self->unpack == NULL || PyErr_Occurred()) {
+    return -1;
+  }
+
+  if (self->record_size <= 0) {
+    PyErr_SetString(PyExc_ValueError, "dtype must describe a non-empty record");
+    return -1;
+  }
+  return 0;
+}
+
+static PyObject* MappedRecords_new(PyTypeObject* type, PyObject* args,
+                                   PyObject* kwargs) {
+  const char* path;
+  PyObject* dtype;
+  Py_ssize_t readahead = 0;
+  static char* kwlist[] = {"path", "dtype", "readahead", NULL};
+  MappedRecords* self;
+  struct stat info;
+  int fd;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sS|n", kwlist, &path,
+                                   &dtype, &readahead)) {
+    return NULL;
+  }
+
+  if (readahead < 0) {
+    PyErr_SetString(PyExc_ValueError, "readahead must be non-negative");
+    return NULL;
+  }
+
+  self = (MappedRecords*)type->tp_alloc(type, 0);
+  if (self == NULL) {
+    return NULL;
+  }
+  Py_INCREF(dtype);
+  self->dtype = dtype;
+  self->readahead = readahead;
+
+  if (records_parse_dtype(self, dtype) < 0) {
+    goto error;
+  }
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    PyErr_SetFromErrnoWithFilename(PyExc_IOError, (char*)path);
+    goto error;
+  }
+  if (fstat(fd, &info) < 0) {
+    PyErr_SetFromErrnoWithFilename(PyExc_IOError, (char*)path);
+    close(fd);
+    goto error;
+  }
+  if (info.st_size % self->record_size != 0) {
+    close(fd);
+    PyErr_Format(PyExc_ValueError,
+                 "%s: size %lld is not a multiple of the %zd-byte record",
+                 path, (long long)info.st_size, self->record_size);
+    goto error;
+  }
+
+  /* An empty file cannot be mapped; it is simply a sequence of nothing */
+  if (info.st_size > 0) {
+    self->map = (char*)mmap(NULL, (size_t)info.st_size, PROT_READ,
+                            MAP_SHARED, fd, 0);
+    if (self->map == (char*)MAP_FAILED) {
+      self->map = NULL;
+      PyErr_SetFromErrnoWithFilename(PyExc_IOError, (char*)path);
+      close(fd);
+      goto error;
+    }
+    self->map_size = (size_t)info.st_size;
+  }
+  close(fd);
+
+  self->first = self->map;
+  self->stride = self->record_size;
+  self->length = (Py_ssize_t)(info.st_size / self->record_size);
+  return (PyObject*)self;
+
+error:
+  Py_DECREF(self);
+  return NULL;
+}
+
+/* Unmap, or for a slice let go of the mapping's owner */
+static void records_release(MappedRecords* self) {
+  if (self->map != NULL) {
+    munmap(self->map, self->map_size);
+    self->map = NULL;
+  }
+  if (self->owner != NULL) {
+    self->owner->exports--;
+    Py_CLEAR(self->owner);
+  }
+  self->closed = 1;
+}
+
+static void records_free_dims(MappedRecords* self) {
+  while (self->dims != NULL) {
+    RecordsDims* next = self->dims->next;
+    PyMem_Free(self->dims);
+    self->dims = next;
+  }
+}
+
+static void MappedRecords_dealloc(MappedRecords* self) {
+  records_release(self);
+  records_free_dims(self);
+  Py_XDECREF(self->dtype);
+  Py_XDECREF(self->unpack);
+  Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyObject* MappedRecords_iter(PyObject* self) {
+  Py_INCREF(self);
+  return self;
+}
+
+static PyObject* MappedRecords_next(MappedRecords* self) {
+  if (self->closed || self->index >= self->length) {
+    return NULL; /* StopIteration; a closed reader is exhausted */
+  }
+
+  records_prefetch(self, self->index + 1);
+  return record_value(self, self->index++);
+}
+
+static Py_ssize_t MappedRecords_length(MappedRecords* self) {
+  return self->length - self->index;
+}
+
+static PyObject* MappedRecords_item(MappedRecords* self, Py_ssize_t i) {
+  Py_ssize_t remaining = self->length - self->index;
+
+  if (records_check_open(self) < 0) {
+    return NULL;
+  }
+  if (i < 0 || i >= remaining) {
+    PyErr_SetString(PyExc_IndexError, "MappedRecords index out of range");
+    return NULL;
+  }
+
+  return record_value(self, self->index + i);
+}
+
+static PyObject* MappedRecords_subscript(MappedRecords* self, PyObject* key) {
+  Py_ssize_t remaining = self->length - self->index;
+
+  if (PySlice_Check(key)) {
+    Py_ssize_t start, stop, step, slicelength;
+    MappedRecords* owner = self->owner != NULL ? self->owner : self;
+    MappedRecords* slice;
+
+    if (records_check_open(self) < 0 ||
+        PySlice_GetIndicesEx((PySliceObject*)key, remaining, &start, &stop,
+                             &step, &slicelength) < 0) {
+      return NULL;
+    }
+
+    slice = (MappedRecords*)MappedRecordsType.tp_alloc(&MappedRecordsType, 0);
+    if (slice == NULL) {
+      return NULL;
+    }
+
+    Py_INCREF(owner);
+    owner->exports++;
+    slice->owner = owner;
+    slice->first = slicelength > 0 ? record_ptr(self, self->index + start)
+                                   : self->first;
+    /* A slice of at most one record never steps; otherwise the product
+     * stays within the mapping and cannot overflow */
+    slice->stride =
+        slicelength <= 1 ? self->record_size : self->stride * step;
+    slice->record_size = self->record_size;
+    slice->length = slicelength;
+    memcpy(slice->format, self->format, sizeof(slice->format));
+    Py_INCREF(self->dtype);
+    slice->dtype = self->dtype;
+    Py_XINCREF(self->unpack);
+    slice->unpack = self->unpack;
+    return (PyObject*)slice;
+  }
+
+  if (PyIndex_Check(key)) {
+    Py_ssize_t i = PyNumber_AsSsize_t(key, PyExc_IndexError);
+    if (i == -1 && PyErr_Occurred()) {
+      return NULL;
+    }
+    if (i < 0) {
+      i += remaining;
+    }
+    return MappedRecords_item(self, i);
+  }
+
+  PyErr_Format(PyExc_TypeError,
+               "MappedRecords indices must be integers, not %.200s",
+               Py_TYPE(key)->tp_name);
+  return NULL;
+}
+
+/* A linear scan that leaves the cursor alone; the default `in` would
+ * consume the iterator */
+static int MappedRecords_contains(MappedRecords* self, PyObject* value) {
+  Py_ssize_t i;
+
+  if (records_check_open(self) < 0) {
+    return -1;
+  }
+
+  for (i = self->index; i < self->length; i++) {
+    PyObject* item = record_value(self, i);
+    int equal;
+
+    if (item == NULL) {
+      return -1;
+    }
+    equal = PyObject_RichCompareBool(item, value, Py_EQ);
+    Py_DECREF(item);
+    if (equal != 0) {
+      return equal;
+    }
+  }
+  return 0;
+}
+
+static PyObject* MappedRecords_next_n(MappedRecords* self, PyObject* args) {
+  Py_ssize_t k, count, i;
+  PyObject* out = NULL;
+  Py_ssize_t remaining = self->length - self->index;
+
+  if (!PyArg_ParseTuple(args, "n|O", &k, &out) ||
+      records_check_open(self) < 0) {
+    return NULL;
+  }
+
+  if (k < 0) {
+    PyErr_SetString(PyExc_ValueError, "k must be non-negative");
+    return NULL;
+  }
+
+  count = k < remaining ? k : remaining;
+
+  if (out != NULL) {
+    /* Copy raw records into a caller-provided buffer, e.g. a reused
+     * bytearray or array.array of the matching type */
+    void* data;
+    Py_ssize_t len;
+    char* dest;
+
+    if (PyObject_AsWriteBuffer(out, &data, &len) < 0) {
+      return NULL;
+    }
+    if (count > len / self->record_size) {
+      count = len / self->record_size;
+    }
+
+    records_prefetch(self, self->index + count);
+    dest = (char*)data;
+    if (self->stride == self->record_size) {
+      memcpy(dest, record_ptr(self, self->index), count * self->record_size);
+    } else {
+      for (i = 0; i < count; i++) {
+        memcpy(dest + i * self->record_size,
+               record_ptr(self, self->index + i), self->record_size);
+      }
+    }
+    self->index += count;
+    return PyInt_FromSsize_t(count);
+  } else {
+    PyObject* result = PyList_New(count);
+    if (result == NULL) {
+      return NULL;
+    }
+
+    records_prefetch(self, self->index + count);
+    for (i = 0; i < count; i++) {
+      PyObject* item = record_value(self, self->index + i);
+      if (item == NULL) {
+        Py_DECREF(result);
+        return NULL;
+      }
+      PyList_SET_ITEM(result, i, item);
+    }
+    self->index += count;
+    return result;
+  }
+}
+
+static PyObject* MappedRecords_advise(MappedRecords* self, PyObject* args) {
+  int advice;
+  Py_ssize_t start = 0;
+  Py_ssize_t count = -1;
+  Py_ssize_t remaining = self->length - self->index;
+
+  if (!PyArg_ParseTuple(args, "i|nn", &advice, &start, &count) ||
+      records_check_open(self) < 0) {
+    return NULL;
+  }
+
+  if (start < 0 || start > remaining) {
+    PyErr_SetString(PyExc_ValueError, "start out of range");
+    return NULL;
+  }
+  if (count < 0 || count > remaining - start) {
+    count = remaining - start;
+  }
+
+  if (records_advise(self, self->index + start, count, advice) < 0) {
+    return PyErr_SetFromErrno(PyExc_OSError);
+  }
+  Py_RETURN_NONE;
+}
+
+static PyObject* MappedRecords_close(MappedRecords* self) {
+  if (self->exports > 0) {
+    PyErr_SetString(PyExc_BufferError,
+                    "cannot close MappedRecords with exported views or "
+                    "slices");
+    return NULL;
+  }
+  records_release(self);
+  Py_RETURN_NONE;
+}
+
+static PyObject* MappedRecords_enter(PyObject* self) {
+  Py_INCREF(self);
+  return self;
+}
+
+static PyObject* MappedRecords_exit(MappedRecords* self, PyObject* args) {
+  PyObject* result = MappedRecords_close(self);
+  if (result == NULL) {
+    return NULL;
+  }
+  Py_DECREF(result);
+  Py_RETURN_FALSE;
+}
+
+static PyObject* MappedRecords_get_closed(MappedRecords* self,
+                                          void* closure) {
+  return PyBool_FromLong(self->closed);
+}
+
+/* Read-only view of the remaining records: one dimension of scalars in
+ * their struct format, or rows of record_size bytes for compound dtypes.
+ * Strides are only left out when the records are contiguous. */
+static int MappedRecords_getbuffer(MappedRecords* self, Py_buffer* view,
+                                   int flags) {
+  Py_ssize_t remaining = self->length - self->index;
+  int scalar = self->format[0] != '\0';
+  RecordsDims* dims = self->dims;
+
+  if (records_check_open(self) < 0) {
+    return -1;
+  }
+  if (flags & PyBUF_WRITABLE) {
+    PyErr_SetString(PyExc_BufferError, "MappedRecords is read-only");
+    return -1;
+  }
+  if ((flags & PyBUF_STRIDES) != PyBUF_STRIDES &&
+      self->stride != self->record_size && remaining > 1) {
+    PyErr_SetString(PyExc_BufferError, "MappedRecords slice is not "
+                                       "contiguous");
+    return -1;
+  }
+
+  /* Views taken at the same cursor position share one block */
+  if (dims == NULL || dims->shape[0] != remaining) {
+    dims = (RecordsDims*)PyMem_Malloc(sizeof(RecordsDims));
+    if (dims == NULL) {
+      PyErr_NoMemory();
+      return -1;
+    }
+    dims->shape[0] = remaining;
+    dims->shape[1] = self->record_size;
+    dims->strides[0] = self->stride;
+    dims->strides[1] = 1;
+    dims->next = self->dims;
+    self->dims = dims;
+  }
+
+  view->obj = (PyObject*)self;
+  view->buf = remaining > 0 ? record_ptr(self, self->index) : self->first;
+  view->len = remaining * self->record_size;
+  view->readonly = 1;
+  view->itemsize = scalar ? self->record_size : 1;
+  view->format = (flags & PyBUF_FORMAT) ? (scalar ? self->format : "B") : NULL;
+  view->ndim = scalar ? 1 : 2;
+  view->shape = (flags & PyBUF_ND) ? dims->shape : NULL;
+  view->strides =
+      (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? dims->strides : NULL;
+  view->suboffsets = NULL;
+  view->internal = NULL;
+  if (!(flags & PyBUF_ND)) {
+    view->ndim = 1;
+    view->itemsize = 1;
+  }
+
+  Py_INCREF(self);
+  self->exports++;
+  return 0;
+}
+
+static void MappedRecords_releasebuffer(MappedRecords* self,
+                                        Py_buffer* view) {
+  if (--self->exports == 0) {
+    records_free_dims(self);
+  }
+}
+
+static PySequenceMethods MappedRecords_as_sequence = {
+    (lenfunc)MappedRecords_length,      /* sq_length */
+    0,                                  /* sq_concat */
+    0,                                  /* sq_repeat */
+    (ssizeargfunc)MappedRecords_item,   /* sq_item */
+    0,                                  /* sq_slice */
+    0,                                  /* sq_ass_item */
+    0,                                  /* sq_ass_slice */
+    (objobjproc)MappedRecords_contains, /* sq_contains */
+};
+
+static PyMappingMethods MappedRecords_as_mapping = {
+    (lenfunc)MappedRecords_length,       /* mp_length */
+    (binaryfunc)MappedRecords_subscript, /* mp_subscript */
+    0,                                   /* mp_ass_subscript */
+};
+
+static PyBufferProcs MappedRecords_as_buffer = {
+    0,                                              /* bf_getreadbuffer */
+    0,                                              /* bf_getwritebuffer */
+    0,                                              /* bf_getsegcount */
+    0,                                              /* bf_getcharbuffer */
+    (getbufferproc)MappedRecords_getbuffer,         /* bf_getbuffer */
+    (releasebufferproc)MappedRecords_releasebuffer, /* bf_releasebuffer */
+};
+
+static PyMethodDef MappedRecords_methods[] = {
+    {"next_n", (PyCFunction)MappedRecords_next_n, METH_VARARGS,
+     "Consume up to k records in one call.\n\nArgs:\n    k (int): Maximum "
+     "number of records\n    out (buffer, optional): Writable buffer to copy "
+     "the raw records into instead\n\nReturns:\n    list: The records, or "
+     "int: number copied to out"},
+    {"advise", (PyCFunction)MappedRecords_advise, METH_VARARGS,
+     "Pass an madvise() hint for the pages of the remaining "
+     "records.\n\nArgs:\n    advice (int): One of the MADV_* constants\n    "
+     "start (int, optional): First record, relative to the cursor\n    "
+     "count (int, optional): Number of records (default: all)"},
+    {"close", (PyCFunction)MappedRecords_close, METH_NOARGS,
+     "Unmap the file.\n\nRaises:\n    BufferError: If buffer views or "
+     "slices are still alive"},
+    {"__enter__", (PyCFunction)MappedRecords_enter, METH_NOARGS,
+     "Use the reader as a context manager."},
+    {"__exit__", (PyCFunction)MappedRecords_exit, METH_VARARGS,
+     "Close the reader when the with-block ends."},
+    {NULL, NULL, 0, NULL}};
+
+static PyMemberDef MappedRecords_members[] = {
+    {"dtype", T_OBJECT, offsetof(MappedRecords, dtype), READONLY,
+     "Struct format of one record"},
+    {"record_size", T_PYSSIZET, offsetof(MappedRecords, record_size),
+     READONLY, "Bytes per record"},
+    {"readahead", T_PYSSIZET, offsetof(MappedRecords, readahead), READONLY,
+     "Records prefetched with MADV_WILLNEED ahead of the cursor"},
+    {NULL}};
+
+static PyGetSetDef MappedRecords_getset[] = {
+    {"closed", (getter)MappedRecords_get_closed, NULL,
+     "Whether the reader has been closed", NULL},
+    {NULL}};
+
+static PyTypeObject MappedRecordsType = {
+    PyObject_HEAD_INIT(NULL) 0,                     /* ob_size */
+    "advanced_module.MappedRecords",                /* tp_name */
+    sizeof(MappedRecords),                          /* tp_basicsize */
+    0,                                              /* tp_itemsize */
+    (destructor)MappedRecords_dealloc,              /* tp_dealloc */
+    0,                                              /* tp_print */
+    0,                                              /* tp_getattr */
+    0,                                              /* tp_setattr */
+    0,                                              /* tp_compare */
+    0,                                              /* tp_repr */
+    0,                                              /* tp_as_number */
+    &MappedRecords_as_sequence,                     /* tp_as_sequence */
+    &MappedRecords_as_mapping,                      /* tp_as_mapping */
+    0,                                              /* tp_hash */
+    0,                                              /* tp_call */
+    0,                                              /* tp_str */
+    0,                                              /* tp_getattro */
+    0,                                              /* tp_setattro */
+    &MappedRecords_as_buffer,                       /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_NEWBUFFER, /* tp_flags */
+    "Memory-mapped file of fixed-size records",     /* tp_doc */
+    0,                                              /* tp_traverse */
+    0,                                              /* tp_clear */
+    0,                                              /* tp_richcompare */
+    0,                                              /* tp_weaklistoffset */
+    MappedRecords_iter,                             /* tp_iter */
+    (iternextfunc)MappedRecords_next,               /* tp_iternext */
+    MappedRecords_methods,                          /* tp_methods */
+    MappedRecords_members,                          /* tp_members */
+    MappedRecords_getset,                           /* tp_getset */
+    0,                                              /* tp_base */
+    0,                                              /* tp_dict */
+    0,                                              /* tp_descr_get */
+    0,                                              /* tp_descr_set */
+    0,                                              /* tp_dictoffset */
+    0,                                              /* tp_init */
+    0,                                              /* tp_alloc */
+    MappedRecords_new,                              /* tp_new */
+};
+
+/* ============================================================================
+ * CAPSULES (for C data)
+ * ============================================================================
+ */
+
+typedef struct {
+  int x;
+  int y;
+  char name[50];
+} Point;
+
+static void point_destructor(PyObject* capsule) {
+  Point* point = (Point*)PyCapsule_GetPointer(capsule, "Point");
+  if (point != NULL) {
+    PyMem_Free(point);
+  }
+}
+
+/* Capsules over a Point inside someone else's buffer (shared memory, a
+ * bytearray, ...) keep the buffer view as their context, so the memory
+ * stays exported until the capsule goes away */
+static void point_view_destructor(PyObject* capsule) {
+  Py_buffer* view = (Py_buffer*)PyCapsule_GetContext(capsule);
+  if (view != NULL) {
+    PyBuffer_Release(view);
+    PyMem_Free(view);
+  }
+}
+
+static PyObject* point_in_buffer(PyObject* buffer, Py_ssize_t offset) {
+  Py_buffer* view;
+  PyObject* capsule;
+
+  if (offset < 0 || offset % sizeof(int) != 0) {
+    PyErr_Format(PyExc_ValueError,
+                 "offset must be a non-negative multiple of %d",
+                 (int)sizeof(int));
+    return NULL;
+  }
+
+  view = (Py_buffer*)PyMem_Malloc(sizeof(Py_buffer));
+  if (view == NULL) {
+    return PyErr_NoMemory();
+  }
+  if (PyObject_GetBuffer(buffer, view, PyBUF_WRITABLE) < 0) {
+    PyMem_Free(view);
+    return NULL;
+  }
+
+  if (offset > view->len - (Py_ssize_t)sizeof(Point)) {
+    PyErr_Format(PyExc_ValueError,
+                 "a Point at offset %zd does not fit in %zd bytes", offset,
+                 view->len);
+    goto error;
+  }
+
+  capsule = PyCapsule_New((char*)view->buf + offset, "Point",
+                          point_view_destructor);
+  if (capsule == NULL) {
+    goto error;
+  }
+  if (PyCapsule_SetContext(capsule, view) < 0) {
+    Py_DECREF(capsule); /* no context yet: the destructor does nothing */
+    goto error;
+  }
+  return capsule;
+
+error:
+  PyBuffer_Release(view);
+  PyMem_Free(view);
+  return NULL;
+}
+
+static PyObject* create_point_capsule(PyObject* self, PyObject* args,
+                                      PyObject* kwargs) {
+  int x, y;
+  const char* name;
+  PyObject* buffer = Py_None;
+  Py_ssize_t offset = 0;
+  static char* kwlist[] = {"x", "y", "name", "buffer", "offset", NULL};
+  Point* point;
+  PyObject* capsule;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "iis|On", kwlist, &x, &y,
+                                   &name, &buffer, &offset)) {
+    return NULL;
+  }
+
+  if (buffer != Py_None) {
+    capsule = point_in_buffer(buffer, offset);
+    if (capsule == NULL) {
+      return NULL;
+    }
+    point = (Point*)PyCapsule_GetPointer(capsule, "Point");
+  } else {
+    point = (Point*)PyMem_Malloc(sizeof(Point));
+    if (point == NULL) {
+      return PyErr_NoMemory();
+    }
+
+    capsule = PyCapsule_New(point, "Point", point_destructor);
+    if (capsule == NULL) {
+      PyMem_Free(point);
+      return NULL;
+    }
+  }
+
+  point->x = x;
+  point->y = y;
+  strncpy(point->name, name, sizeof(point->name) - 1);
+  point->name[sizeof(point->name) - 1] = '\0';
+
+  return capsule;
+}
+
+static PyObject* point_at(PyObject* self, PyObject* args, PyObject* kwargs) {
+  PyObject* buffer;
+  Py_ssize_t offset = 0;
+  static char* kwlist[] = {"buffer", "offset", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|n", kwlist, &buffer,
+                                   &offset)) {
+    return NULL;
+  }
+
+  return point_in_buffer(buffer, offset);
+}
+
+static PyObject* get_point_data(PyObject* self, PyObject* capsule) {
+  Point* point;
+
+  if (!PyCapsule_CheckExact(capsule)) {
+    PyErr_SetString(PyExc_TypeError, "expected a capsule");
+    return NULL;
+  }
+
+  point = (Point*)PyCapsule_GetPointer(capsule, "Point");
+  if (point == NULL) {
+    return NULL;
+  }
+
+  /* A Point mapped over someone else's buffer (point_at) need not hold a
+   * NUL, so the name is never read past its field */
+  return Py_BuildValue(
+      "{s:i,s:i,s:N}", "x", point->x, "y", point->y, "name",
+      PyString_FromStringAndSize(point->name,
+                                 strnlen(point->name, sizeof(point->name))));
+}
+
+/* ============================================================================
+ * POINT ARRAYS (structure of arrays)
+ * ============================================================================
+ */
+
+/* PointArray stores many points without one capsule and one 50-byte name
+ * each: x and y live in contiguous int columns, and each point refers to
+ * its name by index into a table of unique interned strings. */
+typedef struct {
+  PyObject_HEAD Py_ssize_t length;
+  Py_ssize_t capacity;
+  int* x;
+  int* y;
+  Py_ssize_t* name_ids;
+  PyObject* names;      /* list: id -> interned name */
+  PyObject* name_index; /* dict: name -> id */
+  Py_ssize_t exports;   /* live column buffers; resizing is refused */
+} PointArray;
+
+/* Buffer view onto one column of a PointArray */
+typedef struct {
+  PyObject_HEAD PointArray* owner;
+  int column; /* 0 = x, 1 = y */
+  Py_ssize_t shape[1];
+  Py_ssize_t strides[1];
+} PointColumn;
+
+static PyTypeObject PointArrayType;
+static PyTypeObject PointColumnType;
+
+static int PointArray_reserve(PointArray* self, Py_ssize_t needed) {
+  Py_ssize_t capacity;
+  int* x;
+  int* y;
+  Py_ssize_t* ids;
+
+  /* Like bytearray, refuse to change size while a column is exported */
+  if (self->exports > 0) {
+    PyErr_SetString(PyExc_BufferError,
+                    "cannot resize a PointArray while a column is exported");
+    return -1;
+  }
+
+  if (needed <= self->capacity) {
+    return 0;
+  }
+
+  capacity = self->capacity < 8 ? 8 : self->capacity;
+  while (capacity < needed) {
+    if (capacity > PY_SSIZE_T_MAX / 2 / (Py_ssize_t)sizeof(Py_ssize_t)) {
+      PyErr_NoMemory();
+      return -1;
+    }
+    capacity *= 2;
+  }
+
+  /* Each column is reallocated in turn; the array stays consistent if a
+   * later realloc fails because capacity is only updated at the end. */
+  x = (int*)PyMem_Realloc(self->x, capacity * sizeof(int));
+  if (x == NULL) {
+    PyErr_NoMemory();
+    return -1;
+  }
+  self->x = x;
+
+  y = (int*)PyMem_Realloc(self->y, capacity * sizeof(int));
+  if (y == NULL) {
+    PyErr_NoMemory();
+    return -1;
+  }
+  self->y = y;
+
+  ids = (Py_ssize_t*)PyMem_Realloc(self->name_ids,
+                                   capacity * sizeof(Py_ssize_t));
+  if (ids == NULL) {
+    PyErr_NoMemory();
+    return -1;
+  }
+  self->name_ids = ids;
+
+  self->capacity = capacity;
+  return 0;
+}
+
+/* Look up (or add) a name in the string table and return its id */
+static Py_ssize_t PointArray_name_id(PointArray* self, PyObject* name) {
+  PyObject* found;
+  PyObject* id;
+  Py_ssize_t new_id;
+
+  if (!PyString_CheckExact(name)) {
+    PyErr_SetString(PyExc_TypeError, "point names must be str");
+    return -1;
+  }
+
+  found = PyDict_GetItem(self->name_index, name);
+  if (found != NULL) {
+    return PyInt_AS_LONG(found);
+  }
+
+  Py_INCREF(name);
+  PyString_InternInPlace(&name);
+
+  new_id = PyList_GET_SIZE(self->names);
+  id = PyInt_FromSsize_t(new_id);
+  if (id == NULL || PyDict_SetItem(self->name_index, name, id) < 0 ||
+      PyList_Append(self->names, name) < 0) {
+    Py_XDECREF(id);
+    Py_DECREF(name);
+    return -1;
+  }
+
+  Py_DECREF(id);
+  Py_DECREF(name);
+  return new_id;
+}
+
+static int PointArray_push(PointArray* self, int x, int y, PyObject* name) {
+  Py_ssize_t id = PointArray_name_id(self, name);
+
+  if (id < 0 || PointArray_reserve(self, self->length + 1) < 0) {
+    return -1;
+  }
+
+  self->x[self->length] = x;
+  self->y[self->length] = y;
+  self->name_ids[self->length] = id;
+  self->length++;
+  return 0;
+}
+
+static PointArray* PointArray_alloc(PyTypeObject* type) {
+  PointArray* self = (PointArray*)type->tp_alloc(type, 0);
+
+  if (self == NULL) {
+    return NULL;
+  }
+
+  self->names = PyList_New(0);
+  self->name_index = PyDict_New();
+  if (self->names == NULL || self->name_index == NULL) {
+    Py_DECREF(self);
+    return NULL;
+  }
+
+  return self;
+}
+
+static PyObject* PointArray_new(PyTypeObject* type, PyObject* args,
+                                PyObject* kwargs) {
+  PyObject* points = NULL;
+  static char* kwlist[] = {"points", NULL};
+  PointArray* self;
+  PyObject* iterator;
+  PyObject* item;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O", kwlist, &points)) {
+    return NULL;
+  }
+
+  self = PointArray_alloc(type);
+  if (self == NULL || points == NULL) {
+    return (PyObject*)self;
+  }
+
+  iterator = PyObject_GetIter(points);
+  if (iterator == NULL) {
+    Py_DECREF(self);
+    return NULL;
+  }
+
+  while ((item = PyIter_Next(iterator))) {
+    int x, y;
+    PyObject* name;
+    int ok = PyTuple_Check(item) &&
+             PyArg_ParseTuple(item, "iiS;points must be (x, y, name) tuples",
+                              &x, &y, &name) &&
+             PointArray_push(self, x, y, name) == 0;
+
+    if (!PyTuple_Check(item)) {
+      PyErr_SetString(PyExc_TypeError, "points must be (x, y, name) tuples");
+    }
+    Py_DECREF(item);
+    if (!ok) {
+      break;
+    }
+  }
+  Py_DECREF(iterator);
+
+  if (PyErr_Occurred()) {
+    Py_DECREF(self);
+    return NULL;
+  }
+
+  return (PyObject*)self;
+}
+
+static void PointArray_dealloc(PointArray* self) {
+  PyMem_Free(self->x);
+  PyMem_Free(self->y);
+  PyMem_Free(self->name_ids);
+  Py_XDECREF(self->names);
+  Py_XDECREF(self->name_index);
+  Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static Py_ssize_t PointArray_length(PointArray* self) { return self->length; }
+
+static PyObject* PointArray_item(PointArray* self, Py_ssize_t i) {
+  if (i < 0 || i >= self->length) {
+    PyErr_SetString(PyExc_IndexError, "PointArray index out of range");
+    return NULL;
+  }
+
+  return Py_BuildValue("(iiO)", self->x[i], self->y[i],
+                       PyList_GET_ITEM(self->names, self->name_ids[i]));
+}
+
+static PyObject* PointArray_from_columns(PyObject* cls, PyObject* args,
+                                         PyObject* kwargs) {
+  PyObject *xs, *ys, *names = NULL;
+  static char* kwlist[] = {"x", "y", "names", NULL};
+  PyObject *x_fast = NULL, *y_fast = NULL, *names_fast = NULL;
+  PyObject* empty = NULL;
+  PointArray* self = NULL;
+  Py_ssize_t n, i;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|O", kwlist, &xs, &ys,
+                                   &names)) {
+    return NULL;
+  }
+
+  x_fast = PySequence_Fast(xs, "x must be a sequence of ints");
+  y_fast = PySequence_Fast(ys, "y must be a sequence of ints");
+  if (x_fast == NULL || y_fast == NULL) {
+    goto error;
+  }
+
+  n = PySequence_Fast_GET_SIZE(x_fast);
+  if (PySequence_Fast_GET_SIZE(y_fast) != n) {
+    PyErr_SetString(PyExc_ValueError, "x and y must have the same length");
+    goto error;
+  }
+
+  if (names != NULL && names != Py_None) {
+    names_fast = PySequence_Fast(names, "names must be a sequence of str");
+    if (names_fast == NULL) {
+      goto error;
+    }
+    if (PySequence_Fast_GET_SIZE(names_fast) != n) {
+      PyErr_SetString(PyExc_ValueError,
+                      "names must have the same length as x and y");
+      goto error;
+    }
+  } else {
+    empty = PyString_FromString("");
+    if (empty == NULL) {
+      goto error;
+    }
+  }
+
+  self = PointArray_alloc((PyTypeObject*)cls);
+  if (self == NULL || PointArray_reserve(self, n) < 0) {
+    goto error;
+  }
+
+  for (i = 0; i < n; i++) {
+    long x = PyInt_AsLong(PySequence_Fast_GET_ITEM(x_fast, i));
+    long y = PyInt_AsLong(PySequence_Fast_GET_ITEM(y_fast, i));
+    PyObject* name =
+        names_fast ? PySequence_Fast_GET_ITEM(names_fast, i) : empty;
+
+    if ((x == -1 || y == -1) && PyErr_Occurred()) {
+      goto error;
+    }
+    if (x < INT_MIN || x > INT_MAX || y < INT_MIN || y > INT_MAX) {
+      PyErr_SetString(PyExc_OverflowError, "coordinate does not fit in int");
+      goto error;
+    }
+    if (PointArray_push(self, (int)x, (int)y, name) < 0) {
+      goto error;
+    }
+  }
+
+  Py_DECREF(x_fast);
+  Py_DECREF(y_fast);
+  Py_XDECREF(names_fast);
+  Py_XDECREF(empty);
+  return (PyObject*)self;
+
+error:
+  Py_XDECREF(x_fast);
+  Py_XDECREF(y_fast);
+  Py_XDECREF(names_fast);
+  Py_XDECREF(empty);
+  Py_XDECREF(self);
+  return NULL;
+}
+
+static PyObject* PointArray_append(PointArray* self, PyObject* args) {
+  int x, y;
+  PyObject* name = NULL;
+
+  if (!PyArg_ParseTuple(args, "ii|S", &x, &y, &name)) {
+    return NULL;
+  }
+
+  if (name == NULL) {
+    int status;
+    name = PyString_FromString("");
+    if (name == NULL) {
+      return NULL;
+    }
+    status = PointArray_push(self, x, y, name);
+    Py_DECREF(name);
+    if (status < 0) {
+      return NULL;
+    }
+  } else if (PointArray_push(self, x, y, name) < 0) {
+    return NULL;
+  }
+
+  Py_RETURN_NONE;
+}
+
+/* Column minimum and maximum in one pass; n must be positive */
+static void int_column_range(const int* values, Py_ssize_t n, int* lo,
+                             int* hi) {
+  int min_value = values[0], max_value = values[0];
+  Py_ssize_t i;
+
+  for (i = 1; i < n; i++) {
+    min_value = values[i] < min_value ? values[i] : min_value;
+    max_value = values[i] > max_value ? values[i] : max_value;
+  }
+
+  *lo = min_value;
+  *hi = max_value;
+}
+
+static PyObject* PointArray_bounding_box(PointArray* self) {
+  int min_x, max_x, min_y, max_y;
+
+  if (self->length == 0) {
+    PyErr_SetString(PyExc_ValueError, "bounding box of an empty PointArray");
+    return NULL;
+  }
+
+  int_column_range(self->x, self->length, &min_x, &max_x);
+  int_column_range(self->y, self->length, &min_y, &max_y);
+
+  return Py_BuildValue("(iiii)", min_x, min_y, max_x, max_y);
+}
+
+static PyObject* PointArray_translate(PointArray* self, PyObject* args) {
+  int dx, dy;
+  int min_x, max_x, min_y, max_y;
+  Py_ssize_t i;
+
+  if (!PyArg_ParseTuple(args, "ii", &dx, &dy)) {
+    return NULL;
+  }
+
+  if (self->length == 0) {
+    Py_RETURN_NONE;
+  }
+
+  /* Validate the whole shift up front so a failure leaves no partial move */
+  int_column_range(self->x, self->length, &min_x, &max_x);
+  int_column_range(self->y, self->length, &min_y, &max_y);
+  if ((PY_LONG_LONG)min_x + dx < INT_MIN ||
+      (PY_LONG_LONG)max_x + dx > INT_MAX ||
+      (PY_LONG_LONG)min_y + dy < INT_MIN ||
+      (PY_LONG_LONG)max_y + dy > INT_MAX) {
+    PyErr_SetString(PyExc_OverflowError,
+                    "translated point does not fit in int");
+    return NULL;
+  }
+
+  for (i = 0; i < self->length; i++) {
+    self->x[i] += dx;
+  }
+  for (i = 0; i < self->length; i++) {
+    self->y[i] += dy;
+  }
+
+  Py_RETURN_NONE;
+}
+
+static PyObject* PointArray_nearest(PointArray* self, PyObject* args) {
+  int qx, qy;
+  Py_ssize_t i, best = 0;
+  unsigned PY_LONG_LONG best_lo = 0;
+  int best_hi = 0;
+
+  if (!PyArg_ParseTuple(args, "ii", &qx, &qy)) {
+    return NULL;
+  }
+
+  if (self->length == 0) {
+    PyErr_SetString(PyExc_ValueError, "nearest point of an empty PointArray");
+    return NULL;
+  }
+
+  /* Each squared delta is below 2^64, so the squared distance is kept as
+   * a 65-bit (carry, low word) pair and compared exactly. */
+  for (i = 0; i < self->length; i++) {
+    PY_LONG_LONG dx = (PY_LONG_LONG)self->x[i] - qx;
+    PY_LONG_LONG dy = (PY_LONG_LONG)self->y[i] - qy;
+    unsigned PY_LONG_LONG adx = (unsigned PY_LONG_LONG)(dx < 0 ? -dx : dx);
+    unsigned PY_LONG_LONG ady = (unsigned PY_LONG_LONG)(dy < 0 ? -dy : dy);
+    unsigned PY_LONG_LONG ddx = adx * adx;
+    unsigned PY_LONG_LONG lo = ddx + ady * ady;
+    int hi = lo < ddx;
+
+    if (i == 0 || hi < best_hi || (hi == best_hi && lo < best_lo)) {
+      best = i;
+      best_lo = lo;
+      best_hi = hi;
+    }
+  }
+
+  return PyInt_FromSsize_t(best);
+}
+
+static PyObject* PointArray_get_column(PointArray* self, void* closure) {
+  PointColumn* column = PyObject_New(PointColumn, &PointColumnType);
+
+  if (column == NULL) {
+    return NULL;
+  }
+
+  Py_INCREF(self);
+  column->owner = self;
+  column->column = (int)(Py_intptr_t)closure;
+  return (PyObject*)column;
+}
+
+static PyObject* PointArray_get_names(PointArray* self, void* closure) {
+  return PyList_GetSlice(self->names, 0, PyList_GET_SIZE(self->names));
+}
+
+static PySequenceMethods PointArray_as_sequence = {
+    (lenfunc)PointArray_length,    /* sq_length */
+    0,                             /* sq_concat */
+    0,                             /* sq_repeat */
+    (ssizeargfunc)PointArray_item, /* sq_item */
+};
+
+static PyGetSetDef PointArray_getset[] = {
+    {"x", (getter)PointArray_get_column, NULL,
+     "Buffer view of the x column (format 'i')", (void*)0},
+    {"y", (getter)PointArray_get_column, NULL,
+     "Buffer view of the y column (format 'i')", (void*)1},
+    {"names", (getter)PointArray_get_names, NULL,
+     "Table of distinct point names", NULL},
+    {NULL, NULL, NULL, NULL, NULL}};
+
+static PyMethodDef PointArray_methods[] = {
+    {"from_columns", (PyCFunction)PointArray_from_columns,
+     METH_VARARGS | METH_KEYWORDS | METH_CLASS,
+     "Build from separate columns.\n\nArgs:\n    x (sequence): X "
+     "coordinates\n    y (sequence): Y coordinates\n    names (sequence, "
+     "optional): Point names (default: '')\n\nReturns:\n    PointArray"},
+    {"append", (PyCFunction)PointArray_append, METH_VARARGS,
+     "Append a point.\n\nArgs:\n    x (int): X coordinate\n    y (int): Y "
+     "coordinate\n    name (str, optional): Point name"},
+    {"bounding_box", (PyCFunction)PointArray_bounding_box, METH_NOARGS,
+     "Return the bounding box.\n\nReturns:\n    tuple: (min_x, min_y, "
+     "max_x, max_y)"},
+    {"translate", (PyCFunction)PointArray_translate, METH_VARARGS,
+     "Move every point in place.\n\nArgs:\n    dx (int): X offset\n    dy "
+     "(int): Y offset\n\nRaises:\n    OverflowError: If a point would leave "
+     "the int range (no point is moved)"},
+    {"nearest", (PyCFunction)PointArray_nearest, METH_VARARGS,
+     "Find the point nearest to (x, y).\n\nArgs:\n    x (int): Query X\n    "
+     "y (int): Query Y\n\nReturns:\n    int: Index of the nearest point"},
+    {NULL, NULL, 0, NULL}};
+
+static PyTypeObject PointArrayType = {
+    PyObject_HEAD_INIT(NULL) 0,                /* ob_size */
+    "advanced_module.PointArray",              /* tp_name */
+    sizeof(PointArray),                        /* tp_basicsize */
+    0,                                         /* tp_itemsize */
+    (destructor)PointArray_dealloc,            /* tp_dealloc */
+    0,                                         /* tp_print */
+    0,                                         /* tp_getattr */
+    0,                                         /* tp_setattr */
+    0,                                         /* tp_compare */
+    0,                                         /* tp_repr */
+    0,                                         /* tp_as_number */
+    &PointArray_as_sequence,                   /* tp_as_sequence */
+    0,                                         /* tp_as_mapping */
+    0,                                         /* tp_hash */
+    0,                                         /* tp_call */
+    0,                                         /* tp_str */
+    0,                                         /* tp_getattro */
+    0,                                         /* tp_setattro */
+    0,                                         /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                        /* tp_flags */
+    "Column-oriented array of points",         /* tp_doc */
+    0,                                         /* tp_traverse */
+    0,                                         /* tp_clear */
+    0,                                         /* tp_richcompare */
+    0,                                         /* tp_weaklistoffset */
+    0,                                         /* tp_iter */
+    0,                                         /* tp_iternext */
+    PointArray_methods,                        /* tp_methods */
+    0,                                         /* tp_members */
+    PointArray_getset,                         /* tp_getset */
+    0,                                         /* tp_base */
+    0,                                         /* tp_dict */
+    0,                                         /* tp_descr_get */
+    0,                                         /* tp_descr_set */
+    0,                                         /* tp_dictoffset */
+    0,                                         /* tp_init */
+    0,                                         /* tp_alloc */
+    PointArray_new,                            /* tp_new */
+};
+
+static void PointColumn_dealloc(PointColumn* self) {
+  Py_DECREF(self->owner);
+  PyObject_Del(self);
+}
+
+static Py_ssize_t PointColumn_length(PointColumn* self) {
+  return self->owner->length;
+}
+
+static int PointColumn_getbuffer(PointColumn* self, Py_buffer* view,
+                                 int flags) {
+  PointArray* owner = self->owner;
+
+  self->shape[0] = owner->length;
+  self->strides[0] = sizeof(int);
+
+  view->obj = (PyObject*)self;
+  view->buf = self->column == 0 ? (void*)owner->x : (void*)owner->y;
+  view->len = owner->length * sizeof(int);
+  view->readonly = 0;
+  view->itemsize = sizeof(int);
+  view->format = (flags & PyBUF_FORMAT) ? "i" : NULL;
+  view->ndim = 1;
+  view->shape = self->shape;
+  view->strides = self->strides;
+  view->suboffsets = NULL;
+  view->internal = NULL;
+
+  Py_INCREF(self);
+  owner->exports++;
+  return 0;
+}
+
+static void PointColumn_releasebuffer(PointColumn* self, Py_buffer* view) {
+  self->owner->exports--;
+}
+
+static PySequenceMethods PointColumn_as_sequence = {
+    (lenfunc)PointColumn_length, /* sq_length */
+};
+
+static PyBufferProcs PointColumn_as_buffer = {
+    0,                                         /* bf_getreadbuffer */
+    0,                                         /* bf_getwritebuffer */
+    0,                                         /* bf_getsegcount */
+    0,                                         /* bf_getcharbuffer */
+    (getbufferproc)PointColumn_getbuffer,      /* bf_getbuffer */
+    (releasebufferproc)PointColumn_releasebuffer, /* bf_releasebuffer */
+};
+
+static PyTypeObject PointColumnType = {
+    PyObject_HEAD_INIT(NULL) 0,                   /* ob_size */
+    "advanced_module.PointColumn",                /* tp_name */
+    sizeof(PointColumn),                          /* tp_basicsize */
+    0,                                            /* tp_itemsize */
+    (destructor)PointColumn_dealloc,              /* tp_dealloc */
+    0,                                            /* tp_print */
+    0,                                            /* tp_getattr */
+    0,                                            /* tp_setattr */
+    0,                                            /* tp_compare */
+    0,                                            /* tp_repr */
+    0,                                            /* tp_as_number */
+    &PointColumn_as_sequence,                     /* tp_as_sequence */
+    0,                                            /* tp_as_mapping */
+    0,                                            /* tp_hash */
+    0,                                            /* tp_call */
+    0,                                            /* tp_str */
+    0,                                            /* tp_getattro */
+    0,                                            /* tp_setattro */
+    &PointColumn_as_buffer,                       /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_NEWBUFFER, /* tp_flags */
+    "Buffer view of one PointArray column",       /* tp_doc */
+};
+
+/* ============================================================================
+ * IMPORTING MODULES
+ * ============================================================================
+ */
+
+/* Handles created by import_and_call and resolve, keyed on the
+ * (module_name, func_name) tuple (at most IMPORT_CACHE_MAX entries) */
+#define IMPORT_CACHE_MAX 256
+static PyObject* import_cache = NULL;
+
+/* A ResolvedCallable remembers module.func along with the module object it
+ * was found in. Before each call two dict lookups check that sys.modules
+ * still maps the name to that module and that the module still holds the
+ * same function; if either changed the import is redone. */
+typedef struct {
+  PyObject_HEAD PyObject* module_name;
+  PyObject* func_name;
+  PyObject* module;
+  PyObject* func;
+} ResolvedCallable;
+
+static PyTypeObject ResolvedCallableType;
+
+static int ResolvedCallable_refresh(ResolvedCallable* self) {
+  PyObject* module;
+  PyObject* func;
+  PyObject* old_module;
+  PyObject* old_func;
+
+  module = PyImport_Import(self->module_name);
+  if (module == NULL) {
+    return -1;
+  }
+
+  func = PyObject_GetAttr(module, self->func_name);
+  if (func == NULL) {
+    Py_DECREF(module);
+    return -1;
+  }
+
+  if (!PyCallable_Check(func)) {
+    Py_DECREF(module);
+    Py_DECREF(func);
+    PyErr_SetString(PyExc_TypeError, "attribute is not callable");
+    return -1;
+  }
+
+  /* The import and getattr can release the GIL and let another thread
+   * refresh this handle first, so the old values are read only now */
+  old_module = self->module;
+  old_func = self->func;
+  self->module = module;
+  self->func = func;
+  Py_XDECREF(old_module);
+  Py_XDECREF(old_func);
+  return 0;
+}
+
+static int ResolvedCallable_is_current(ResolvedCallable* self) {
+  PyObject* module =
+      PyDict_GetItem(PyImport_GetModuleDict(), self->module_name);
+
+  if (module != self->module || !PyModule_Check(module)) {
+    return 0; /* Anything but a plain module is looked up every time */
+  }
+  return PyDict_GetItem(PyModule_GetDict(module), self->func_name) ==
+         self->func;
+}
+
+/* New reference to the function to call, re-resolved if it went stale */
+static PyObject* ResolvedCallable_target(ResolvedCallable* self) {
+  if (!ResolvedCallable_is_current(self) &&
+      ResolvedCallable_refresh(self) < 0) {
+    return NULL;
+  }
+  Py_INCREF(self->func);
+  return self->func;
+}
+
+static void ResolvedCallable_dealloc(ResolvedCallable* self) {
+  PyObject_GC_UnTrack(self);
+  Py_XDECREF(self->module_name);
+  Py_XDECREF(self->func_name);
+  Py_XDECREF(self->module);
+  Py_XDECREF(self->func);
+  PyObject_GC_Del(self);
+}
+
+static int ResolvedCallable_traverse(ResolvedCallable* self, visitproc visit,
+                                     void* arg) {
+  Py_VISIT(self->module);
+  Py_VISIT(self->func);
+  return 0;
+}
+
+static PyObject* ResolvedCallable_call(ResolvedCallable* self,
+                                       PyObject* args, PyObject* kwargs) {
+  PyObject* func = ResolvedCallable_target(self);
+  PyObject* result;
+
+  if (func == NULL) {
+    return NULL;
+  }
+
+  result = PyObject_Call(func, args, kwargs);
+  Py_DECREF(func);
+  return result;
+}
+
+static PyObject* ResolvedCallable_repr(ResolvedCallable* self) {
+  return PyString_FromFormat("<ResolvedCallable %s.%s>",
+                             PyString_AS_STRING(self->module_name),
+                             PyString_AS_STRING(self->func_name));
+}
+
+static PyMemberDef ResolvedCallable_members[] = {
+    {"module_name", T_OBJECT, offsetof(ResolvedCallable, module_name),
+     READONLY, "Module the callable is imported from"},
+    {"func_name", T_OBJECT, offsetof(ResolvedCallable, func_name), READONLY,
+     "Attribute name of the callable"},
+    {"func", T_OBJECT, offsetof(ResolvedCallable, func), READONLY,
+     "Callable as of the last call or resolution"},
+    {NULL, 0, 0, 0, NULL}};
+
+static PyTypeObject ResolvedCallableType = {
+    PyObject_HEAD_INIT(NULL) 0,              /* ob_size */
+    "advanced_module.ResolvedCallable",      /* tp_name */
+    sizeof(ResolvedCallable),                /* tp_basicsize */
+    0,                                       /* tp_itemsize */
+    (destructor)ResolvedCallable_dealloc,    /* tp_dealloc */
+    0,                                       /* tp_print */
+    0,                                       /* tp_getattr */
+    0,                                       /* tp_setattr */
+    0,                                       /* tp_compare */
+    (reprfunc)ResolvedCallable_repr,         /* tp_repr */
+    0,                                       /* tp_as_number */
+    0,                                       /* tp_as_sequence */
+    0,                                       /* tp_as_mapping */
+    0,                                       /* tp_hash */
+    (ternaryfunc)ResolvedCallable_call,      /* tp_call */
+    0,                                       /* tp_str */
+    0,                                       /* tp_getattro */
+    0,                                       /* tp_setattro */
+    0,                                       /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC, /* tp_flags */
+    "Imported callable that follows sys.modules", /* tp_doc */
+    (traverseproc)ResolvedCallable_traverse, /* tp_traverse */
+    0,                                       /* tp_clear */
+    0,                                       /* tp_richcompare */
+    0,                                       /* tp_weaklistoffset */
+    0,                                       /* tp_iter */
+    0,                                       /* tp_iternext */
+    0,                                       /* tp_methods */
+    ResolvedCallable_members,                /* tp_members */
+};
+
+/* The (module_name, func_name) cache key; an args tuple of two exact str
+ * objects already is one */
+static PyObject* import_key(PyObject* args, const char* format) {
+  const char* module_name;
+  const char* func_name;
+
+  if (!PyArg_ParseTuple(args, format, &module_name, &func_name)) {
+    return NULL;
+  }
+
+  if (PyString_CheckExact(PyTuple_GET_ITEM(args, 0)) &&
+      PyString_CheckExact(PyTuple_GET_ITEM(args, 1))) {
+    Py_INCREF(args);
+    return args;
+  }
+  return Py_BuildValue("(ss)", module_name, func_name);
+}
+
+/* New reference to the cached handle for key, resolving it on a miss */
+static ResolvedCallable* resolve_cached(PyObject* key) {
+  ResolvedCallable* handle;
+
+  handle = (ResolvedCallable*)PyDict_GetItem(import_cache, key);
+  if (handle != NULL) {
+    Py_INCREF(handle);
+    return handle;
+  }
+
+  handle = PyObject_GC_New(ResolvedCallable, &ResolvedCallableType);
+  if (handle == NULL) {
+    return NULL;
+  }
+
+  handle->module_name = PyTuple_GET_ITEM(key, 0);
+  handle->func_name = PyTuple_GET_ITEM(key, 1);
+  Py_INCREF(handle->module_name);
+  Py_INCREF(handle->func_name);
+  handle->module = NULL;
+  handle->func = NULL;
+  PyObject_GC_Track(handle);
+
+  /* Failed lookups are not cached, so a later import can still succeed */
+  if (ResolvedCallable_refresh(handle) < 0 ||
+      (PyDict_Size(import_cache) < IMPORT_CACHE_MAX &&
+       PyDict_SetItem(import_cache, key, (PyObject*)handle) < 0)) {
+    Py_DECREF(handle);
+    return NULL;
+  }
+  return handle;
+}
+
+static PyObject* import_and_call(PyObject* self, PyObject* args) {
+  PyObject* key;
+  ResolvedCallable* handle;
+  PyObject* func;
+  PyObject* result;
+
+  key = import_key(args, "ss:import_and_call");
+  if (key == NULL) {
+    return NULL;
+  }
+
+  handle = resolve_cached(key);
+  Py_DECREF(key);
+  if (handle == NULL) {
+    return NULL;
+  }
+
+  func = ResolvedCallable_target(handle);
+  Py_DECREF(handle);
+  if (func == NULL) {
+    return NULL;
+  }
+
+  result = PyObject_CallObject(func, NULL);
+  Py_DECREF(func);
+
+  return result;
+}
+
+static PyObject* resolve(PyObject* self, PyObject* args) {
+  PyObject* key = import_key(args, "ss:resolve");
+  PyObject* handle;
+
+  if (key == NULL) {
+    return NULL;
+  }
+
+  handle = (PyObject*)resolve_cached(key);
+  Py_DECREF(key);
+  return handle;
+}
+
+/* ============================================================================
+ * STRING FORMATTING
+ * ============================================================================
+ */
+
+/* Compiled templates used by format_string (at most FORMAT_CACHE_MAX) */
+#define FORMAT_CACHE_MAX 256
+static PyObject* format_cache = NULL;
+
+/* One placeholder of a compiled template and the literal text before it.
+ * A "%%" is a field that writes nothing: its literal keeps one '%'. */
+typedef struct {
+  Py_ssize_t literal_start; /* offset of the preceding literal */
+  Py_ssize_t literal_len;
+  PyObject* key;  /* name inside %(...), or NULL for positional fields */
+  PyObject* spec; /* placeholder without its key, e.g. "%5.2f" */
+  char conversion;
+  int simple; /* no flags, width, precision or length modifier */
+} FormatField;
+
+typedef struct {
+  PyObject_HEAD PyObject* template;
+  FormatField* fields;
+  Py_ssize_t nfields;
+  Py_ssize_t nvalues;     /* fields that consume a value */
+  Py_ssize_t tail_start;  /* literal text after the last field */
+  Py_ssize_t size_hint;   /* allocation for the next render */
+  int keyed;              /* values are looked up in a mapping */
+  int generic;            /* every render goes through PyString_Format */
+} Formatter;
+
+static PyTypeObject FormatterType;
+
+/* Output string that grows by doubling and is trimmed once at the end */
+typedef struct {
+  PyObject* str;
+  Py_ssize_t len;
+} StringWriter;
+
+static int writer_write(StringWriter* w, const char* data, Py_ssize_t n) {
+  Py_ssize_t size = PyString_GET_SIZE(w->str);
+
+  if (n > size - w->len) {
+    Py_ssize_t new_size = size < PY_SSIZE_T_MAX / 2 ? size * 2 : size;
+
+    if (new_size - w->len < n) {
+      if (n > PY_SSIZE_T_MAX - w->len) {
+        PyErr_NoMemory();
+        return -1;
+      }
+      new_size = w->len + n;
+    }
+    if (_PyString_Resize(&w->str, new_size) < 0) {
+      return -1;
+    }
+  }
+  memcpy(PyString_AS_STRING(w->str) + w->len, data, n);
+  w->len += n;
+  return 0;
+}
+
+static int is_format_flag(char c) {
+  return c == '-' || c == '+' || c == ' ' || c == '#' || c == '0';
+}
+
+/* Split the template into literals and fields; ValueError on bad specs */
+static int Formatter_parse(Formatter* self) {
+  const char* text = PyString_AS_STRING(self->template);
+  Py_ssize_t n = PyString_GET_SIZE(self->template);
+  Py_ssize_t capacity = 0;
+  Py_ssize_t literal_start = 0;
+  Py_ssize_t literal_total;
+  Py_ssize_t i = 0;
+  int positional = 0;
+
+  while (i < n) {
+    Py_ssize_t start = i;
+    Py_ssize_t key_start = -1;
+    Py_ssize_t key_end = -1;
+    Py_ssize_t spec_start;
+    FormatField* field;
+    char conversion;
+
+    if (text[i++] != '%') {
+      continue;
+    }
+
+    if (i < n && text[i] == '(') {
+      int depth = 1;
+
+      key_start = ++i;
+      while (i < n && depth > 0) {
+        if (text[i] == '(') {
+          depth++;
+        } else if (text[i] == ')') {
+          depth--;
+        }
+        i++;
+      }
+      if (depth > 0) {
+        PyErr_SetString(PyExc_ValueError, "incomplete format key");
+        return -1;
+      }
+      key_end = i - 1;
+    }
+
+    spec_start = i;
+    while (i < n && is_format_flag(text[i])) i++;
+    while (i < n &&
+           ((text[i] >= '0' && text[i] <= '9') || text[i] == '*' ||
+            text[i] == '.')) {
+      if (text[i] == '*') {
+        self->generic = 1; /* width comes from the values */
+      }
+      i++;
+    }
+    while (i < n && (text[i] == 'h' || text[i] == 'l' || text[i] == 'L')) i++;
+
+    if (i >= n) {
+      PyErr_SetString(PyExc_ValueError, "incomplete format");
+      return -1;
+    }
+    conversion = text[i++];
+    if (conversion == '\0' || strchr("diouxXeEfFgGcrs%", conversion) == NULL) {
+      PyErr_Format(PyExc_ValueError,
+                   "unsupported format character '%c' (0x%x) at index %zd",
+                   conversion, (unsigned char)conversion, i - 1);
+      return -1;
+    }
+
+    if (self->nfields == capacity) {
+      FormatField* grown;
+
+      /* PyMem_Resize assigns NULL over the pointer it grows on failure */
+      capacity = capacity ? capacity * 2 : 8;
+      if ((size_t)capacity > PY_SSIZE_T_MAX / sizeof(FormatField)) {
+        PyErr_NoMemory();
+        return -1;
+      }
+      grown = (FormatField*)PyMem_Realloc(self->fields,
+                                          capacity * sizeof(FormatField));
+      if (grown == NULL) {
+        PyErr_NoMemory();
+        return -1;
+      }
+      self->fields = grown;
+    }
+
+    field = &self->fields[self->nfields++];
+    memset(field, 0, sizeof(*field));
+    field->literal_start = literal_start;
+    field->literal_len = start - literal_start;
+    field->conversion = conversion;
+    field->simple = (i - 1 == spec_start);
+    literal_start = i;
+
+    if (conversion == '%') {
+      field->literal_len++; /* keep the first '%' of the pair */
+      if (key_start >= 0 || !field->simple) {
+        self->generic = 1;
+      }
+      continue;
+    }
+
+    if (key_start >= 0) {
+      field->key =
+          PyString_FromStringAndSize(text + key_start, key_end - key_start);
+      if (field->key == NULL) {
+        return -1;
+      }
+      self->keyed = 1;
+    } else {
+      positional = 1;
+    }
+
+    field->spec = PyString_FromStringAndSize(NULL, i - spec_start + 1);
+    if (field->spec == NULL) {
+      return -1;
+    }
+    PyString_AS_STRING(field->spec)[0] = '%';
+    memcpy(PyString_AS_STRING(field->spec) + 1, text + spec_start,
+           i - spec_start);
+    self->nvalues++;
+  }
+  self->tail_start = literal_start;
+
+  /* Mixed keys, or templates that take no values, keep the exact
+   * argument checks of the % operator */
+  if ((self->keyed && positional) || self->nvalues == 0) {
+    self->generic = 1;
+  }
+
+  literal_total = n - self->tail_start;
+  for (i = 0; i < self->nfields; i++) {
+    literal_total += self->fields[i].literal_len;
+  }
+  self->size_hint = literal_total + 8 * self->nvalues + 1;
+  return 0;
+}
+
+static PyObject* Formatter_compile(PyTypeObject* type, PyObject* template) {
+  Formatter* self;
+
+  if (!PyString_Check(template)) {
+    PyErr_Format(PyExc_TypeError, "template must be a str, not %.200s",
+                 Py_TYPE(template)->tp_name);
+    return NULL;
+  }
+
+  self = (Formatter*)type->tp_alloc(type, 0);
+  if (self == NULL) {
+    return NULL;
+  }
+  Py_INCREF(template);
+  self->template = template;
+
+  if (Formatter_parse(self) < 0) {
+    Py_DECREF(self);
+    return NULL;
+  }
+  return (PyObject*)self;
+}
+
+static PyObject* Formatter_new(PyTypeObject* type, PyObject* args,
+                               PyObject* kwargs) {
+  PyObject* template;
+  static char* kwlist[] = {"template", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O:Formatter", kwlist,
+                                   &template)) {
+    return NULL;
+  }
+  return Formatter_compile(type, template);
+}
+
+static void Formatter_dealloc(Formatter* self) {
+  Py_ssize_t i;
+
+  for (i = 0; i < self->nfields; i++) {
+    Py_XDECREF(self->fields[i].key);
+    Py_XDECREF(self->fields[i].spec);
+  }
+  PyMem_Free(self->fields);
+  Py_XDECREF(self->template);
+  Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+/* Digits of value written backwards ending at end; returns the length */
+static Py_ssize_t format_long(long value, char* end) {
+  unsigned long magnitude =
+      value < 0 ? 0UL - (unsigned long)value : (unsigned long)value;
+  char* p = end;
+
+  do {
+    *--p = (char)('0' + magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude != 0);
+  if (value < 0) {
+    *--p = '-';
+  }
+  return end - p;
+}
+
+/* Whether a plain field renders value exactly as its decimal digits */
+static int field_writes_digits(const FormatField* field, PyObject* value) {
+  if (!field->simple) {
+    return 0;
+  }
+  switch (field->conversion) {
+    case 's':
+    case 'r':
+      return PyInt_CheckExact(value);
+    case 'd':
+    case 'i':
+    case 'u':
+      return PyInt_Check(value);
+  }
+  return 0;
+}
+
+/* Write one field; returns 1 without writing when the piece is unicode
+ * and the whole result has to be unicode instead */
+static int Formatter_write_field(StringWriter* w, FormatField* field,
+                                 PyObject* value) {
+  PyObject* piece;
+  int status;
+
+  if (field->simple && field->conversion == 's' &&
+      PyString_CheckExact(value)) {
+    return writer_write(w, PyString_AS_STRING(value),
+                        PyString_GET_SIZE(value));
+  }
+
+  if (field_writes_digits(field, value)) {
+    char digits[4 * sizeof(long)];
+    Py_ssize_t len = format_long(PyInt_AS_LONG(value), digits + sizeof(digits));
+
+    return writer_write(w, digits + sizeof(digits) - len, len);
+  }
+
+  if (field->simple && field->conversion == 'r') {
+    piece = PyObject_Repr(value);
+  } else {
+    /* Flags, widths and the remaining conversions: format this one
+     * field with its own small template */
+    PyObject* single = PyTuple_Pack(1, value);
+
+    if (single == NULL) {
+      return -1;
+    }
+    piece = PyString_Format(field->spec, single);
+    Py_DECREF(single);
+  }
+  if (piece == NULL) {
+    return -1;
+  }
+
+  if (PyUnicode_Check(piece)) {
+    Py_DECREF(piece);
+    return 1;
+  }
+  status = writer_write(w, PyString_AS_STRING(piece), PyString_GET_SIZE(piece));
+  Py_DECREF(piece);
+  return status;
+}
+
+static PyObject* Formatter_render(Formatter* self, PyObject* values) {
+  const char* text = PyString_AS_STRING(self->template);
+  Py_ssize_t template_len = PyString_GET_SIZE(self->template);
+  Py_ssize_t next_value = 0;
+  Py_ssize_t i;
+  StringWriter w;
+
+  if (self->generic) {
+    return PyString_Format(self->template, values);
+  }
+
+  if (self->keyed) {
+    if (PyTuple_Check(values) || PyString_Check(values) ||
+        PyUnicode_Check(values) || !PyMapping_Check(values)) {
+      PyErr_SetString(PyExc_TypeError, "format requires a mapping");
+      return NULL;
+    }
+  } else {
+    Py_ssize_t count = PyTuple_Check(values) ? PyTuple_GET_SIZE(values) : 1;
+
+    if (count < self->nvalues) {
+      PyErr_SetString(PyExc_TypeError,
+                      "not enough arguments for format string");
+      return NULL;
+    }
+    if (count > self->nvalues) {
+      PyErr_SetString(PyExc_TypeError,
+                      "not all arguments converted during string formatting");
+      return NULL;
+    }
+  }
+
+  w.str = PyString_FromStringAndSize(NULL, self->size_hint);
+  if (w.str == NULL) {
+    return NULL;
+  }
+  w.len = 0;
+
+  for (i = 0; i < self->nfields; i++) {
+    FormatField* field = &self->fields[i];
+    PyObject* value;
+    int status;
+
+    if (writer_write(&w, text + field->literal_start, field->literal_len) < 0) {
+      goto error;
+    }
+    if (field->conversion == '%') {
+      continue;
+    }
+
+    if (field->key != NULL) {
+      value = PyObject_GetItem(values, field->key);
+      if (value == NULL) {
+        goto error;
+      }
+    } else {
+      value = PyTuple_Check(values) ? PyTuple_GET_ITEM(values, next_value)
+                                    : values;
+      next_value++;
+      Py_INCREF(value);
+    }
+
+    status = Formatter_write_field(&w, field, value);
+    Py_DECREF(value);
+    if (status < 0) {
+      goto error;
+    }
+    if (status > 0) {
+      Py_XDECREF(w.str);
+      return PyString_Format(self->template, values);
+    }
+  }
+
+  if (writer_write(&w, text + self->tail_start,
+                   template_len - self->tail_start) < 0 ||
+      _PyString_Resize(&w.str, w.len) < 0) {
+    goto error;
+  }
+
+  /* Rows of one template tend to be alike: presize for the last one */
+  self->size_hint = w.len + w.len / 8 + 1;
+  return w.str;
+
+error:
+  Py_XDECREF(w.str);
+  return NULL;
+}
+
+static PyObject* Formatter_render_many(Formatter* self, PyObject* rows) {
+  PyObject* seq;
+  PyObject* result;
+  Py_ssize_t n;
+  Py_ssize_t i;
+
+  seq = PySequence_Fast(rows, "render_many() expects an iterable of rows");
+  if (seq == NULL) {
+    return NULL;
+  }
+
+  n = PySequence_Fast_GET_SIZE(seq);
+  result = PyList_New(n);
+  if (result == NULL) {
+    Py_DECREF(seq);
+    return NULL;
+  }
+
+  for (i = 0; i < n; i++) {
+    PyObject* line = Formatter_render(self, PySequence_Fast_GET_ITEM(seq, i));
+
+    if (line == NULL) {
+      Py_DECREF(result);
+      Py_DECREF(seq);
+      return NULL;
+    }
+    PyList_SET_ITEM(result, i, line);
+  }
+
+  Py_DECREF(seq);
+  return result;
+}
+
+static PyObject* Formatter_repr(Formatter* self) {
+  PyObject* template_repr = PyObject_Repr(self->template);
+  PyObject* result;
+
+  if (template_repr == NULL) {
+    return NULL;
+  }
+
+  result = PyString_FromFormat("<Formatter %s>",
+                               PyString_AS_STRING(template_repr));
+  Py_DECREF(template_repr);
+  return result;
+}
+
+static PyMemberDef Formatter_members[] = {
+    {"template", T_OBJECT, offsetof(Formatter, template), READONLY,
+     "Source template"},
+    {"fields", T_PYSSIZET, offsetof(Formatter, nvalues), READONLY,
+     "Number of placeholders that take a value"},
+    {"size_hint", T_PYSSIZET, offsetof(Formatter, size_hint), READONLY,
+     "Bytes preallocated for the next render"},
+    {NULL}};
+
+static PyMethodDef Formatter_methods[] = {
+    {"render", (PyCFunction)Formatter_render, METH_O,
+     "Render the template.\n\nArgs:\n    values (tuple/dict): Values, as for "
+     "the % operator\n\nReturns:\n    str: Formatted string (unicode if a "
+     "value formats as unicode)"},
+    {"render_many", (PyCFunction)Formatter_render_many, METH_O,
+     "Render the template once per row.\n\nArgs:\n    rows: Iterable of "
+     "value tuples or dicts\n\nReturns:\n    list: Formatted strings in "
+     "order"},
+    {NULL, NULL, 0, NULL}};
+
+static PyTypeObject FormatterType = {
+    PyObject_HEAD_INIT(NULL) 0,               /* ob_size */
+    "advanced_module.Formatter",              /* tp_name */
+    sizeof(Formatter),                        /* tp_basicsize */
+    0,                                        /* tp_itemsize */
+    (destructor)Formatter_dealloc,            /* tp_dealloc */
+    0,                                        /* tp_print */
+    0,                                        /* tp_getattr */
+    0,                                        /* tp_setattr */
+    0,                                        /* tp_compare */
+    (reprfunc)Formatter_repr,                 /* tp_repr */
+    0,                                        /* tp_as_number */
+    0,                                        /* tp_as_sequence */
+    0,                                        /* tp_as_mapping */
+    0,                                        /* tp_hash */
+    0,                                        /* tp_call */
+    0,                                        /* tp_str */
+    0,                                        /* tp_getattro */
+    0,                                        /* tp_setattro */
+    0,                                        /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                       /* tp_flags */
+    "Pre-parsed %-format template",           /* tp_doc */
+    0,                                        /* tp_traverse */
+    0,                                        /* tp_clear */
+    0,                                        /* tp_richcompare */
+    0,                                        /* tp_weaklistoffset */
+    0,                                        /* tp_iter */
+    0,                                        /* tp_iternext */
+    Formatter_methods,                        /* tp_methods */
+    Formatter_members,                        /* tp_members */
+    0,                                        /* tp_getset */
+    0,                                        /* tp_base */
+    0,                                        /* tp_dict */
+    0,                                        /* tp_descr_get */
+    0,                                        /* tp_descr_set */
+    0,                                        /* tp_dictoffset */
+    0,                                        /* tp_init */
+    0,                                        /* tp_alloc */
+    Formatter_new,                            /* tp_new */
+};
+
+static PyObject* compile_format(PyObject* self, PyObject* template) {
+  return Formatter_compile(&FormatterType, template);
+}
+
+static PyObject* format_string(PyObject* self, PyObject* args) {
+  PyObject* template;
+  PyObject* values;
+  PyObject* formatter;
+  PyObject* result;
+
+  if (!PyArg_ParseTuple(args, "OO:format_string", &template, &values)) {
+    return NULL;
+  }
+
+  if (!PyString_Check(template)) {
+    /* Keep accepting anything the "s" converter did, e.g. ASCII unicode */
+    const char* text;
+    PyObject* converted;
+
+    if (!PyArg_Parse(template, "s:format_string", &text)) {
+      return NULL;
+    }
+    converted = PyString_FromString(text);
+    if (converted == NULL) {
+      return NULL;
+    }
+    result = PyString_Format(converted, values);
+    Py_DECREF(converted);
+    return result;
+  }
+
+  formatter = PyDict_GetItem(format_cache, template);
+  if (formatter != NULL) {
+    return Formatter_render((Formatter*)formatter, values);
+  }
+
+  formatter = Formatter_compile(&FormatterType, template);
+  if (formatter == NULL) {
+    return NULL;
+  }
+  if (PyDict_Size(format_cache) < FORMAT_CACHE_MAX &&
+      PyDict_SetItem(format_cache, template, formatter) < 0) {
+    Py_DECREF(formatter);
+    return NULL;
+  }
+
+  result = Formatter_render((Formatter*)formatter, values);
+  Py_DECREF(formatter);
+  return result;
+}
+
+/* ============================================================================
+ * UNICODE HANDLING
+ * ============================================================================
+ */
+
+static PyObject* string_to_unicode(PyObject* self, PyObject* args) {
+  const char* str;
+  int length; /* s# stores an int without PY_SSIZE_T_CLEAN */
+  const char* encoding = "utf-8";
+
+  /* s# hands back the length the parser already knows; no strlen */
+  if (!PyArg_ParseTuple(args, "s#|s", &str, &length, &encoding)) {
+    return NULL;
+  }
+
+  return PyUnicode_Decode(str, length, encoding, "strict");
+}
+
+static PyObject* unicode_to_string(PyObject* self, PyObject* unicode) {
+  if (!PyUnicode_Check(unicode)) {
+    PyErr_Format(PyExc_TypeError,
+                 "unicode_to_str() argument must be unicode, not %.200s",
+                 Py_TYPE(unicode)->tp_name);
+    return NULL;
+  }
+
+  return PyUnicode_AsUTF8String(unicode);
+}
+
+/* ============================================================================
+ * STREAMING TRANSCODERS
+ * ============================================================================
+ */
+
+/* Utf8Decoder and Utf8Encoder convert a stream chunk by chunk, carrying
+ * partial code points across feed() calls, so arbitrarily large inputs
+ * never have to be held whole. UTF-8, ASCII and Latin-1 are handled here
+ * with an ASCII fast path. Any other encoding is delegated to the codec's
+ * incremental decoder/encoder, so the requested encoding is always
+ * honored. */
+
+/* Below this many bytes the thread switch costs more than the scan */
+#define TRANSCODE_GIL_RELEASE_BYTES (64 * 1024)
+
+/* Longest encoded name worth normalizing ("iso-8859-1" and friends) */
+#define ENCODING_NAME_MAX 32
+
+typedef enum {
+  CODEC_UTF8,
+  CODEC_ASCII,
+  CODEC_LATIN1,
+  CODEC_OTHER /* delegated to an incremental codec object */
+} CodecKind;
+
+static CodecKind codec_kind(const char* encoding) {
+  char name[ENCODING_NAME_MAX];
+  size_t i;
+
+  /* Normalize like the codec registry: case-insensitive, '_' == '-' */
+  for (i = 0; encoding[i] != '\0'; i++) {
+    char c = encoding[i];
+    if (i + 1 >= sizeof(name)) {
+      return CODEC_OTHER;
+    }
+    name[i] = (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a')
+                                     : (c == '_' ? '-' : c);
+  }
+  name[i] = '\0';
+
+  if (strcmp(name, "utf-8") == 0 || strcmp(name, "utf8") == 0 ||
+      strcmp(name, "u8") == 0) {
+    return CODEC_UTF8;
+  }
+  if (strcmp(name, "ascii") == 0 || strcmp(name, "us-ascii") == 0) {
+    return CODEC_ASCII;
+  }
+  if (strcmp(name, "latin-1") == 0 || strcmp(name, "latin1") == 0 ||
+      strcmp(name, "iso-8859-1") == 0 || strcmp(name, "iso8859-1") == 0) {
+    return CODEC_LATIN1;
+  }
+  return CODEC_OTHER;
+}
+
+/* Length of the leading run of ASCII bytes. Four 8-byte words are OR-ed
+ * per step and tested against the high bits at once; the loop has no
+ * data-dependent branch inside the block, so it vectorizes. */
+static Py_ssize_t ascii_prefix(const unsigned char* data, Py_ssize_t n) {
+  const unsigned PY_LONG_LONG high = 0x8080808080808080ULL;
+  Py_ssize_t i = 0;
+
+  while (i + 32 <= n) {
+    unsigned PY_LONG_LONG w[4];
+    memcpy(w, data + i, sizeof(w));
+    if (((w[0] | w[1] | w[2] | w[3]) & high) != 0) {
+      break;
+    }
+    i += 32;
+  }
+
+  while (i < n && data[i] < 0x80) {
+    i++;
+  }
+  return i;
+}
+
+/* Length of the leading run of code units below `limit` */
+static Py_ssize_t unicode_prefix_below(const Py_UNICODE* text, Py_ssize_t n,
+                                       Py_UNICODE limit) {
+  Py_ssize_t i = 0;
+
+  while (i + 16 <= n) {
+    Py_UNICODE any = 0;
+    Py_ssize_t j;
+    for (j = 0; j < 16; j++) {
+      any |= text[i + j];
+    }
+    /* limit is a power of two, so OR-ing finds any unit >= limit */
+    if (any >= limit) {
+      break;
+    }
+    i += 16;
+  }
+
+  while (i < n && text[i] < limit) {
+    i++;
+  }
+  return i;
+}
+
+static void widen_bytes(const unsigned char* data, Py_UNICODE* out,
+                        Py_ssize_t n) {
+  Py_ssize_t i;
+  for (i = 0; i < n; i++) {
+    out[i] = data[i];
+  }
+}
+
+static void narrow_units(const Py_UNICODE* text, char* out, Py_ssize_t n) {
+  Py_ssize_t i;
+  for (i = 0; i < n; i++) {
+    out[i] = (char)text[i];
+  }
+}
+
+/* Find the leading ASCII run, without the GIL when the input is large and
+ * cannot change underneath us */
+static Py_ssize_t scan_ascii(const unsigned char* data, Py_ssize_t n,
+                             int locked) {
+  Py_ssize_t k;
+
+  if (locked && n >= TRANSCODE_GIL_RELEASE_BYTES) {
+    Py_BEGIN_ALLOW_THREADS;
+    k = ascii_prefix(data, n);
+    Py_END_ALLOW_THREADS;
+  } else {
+    k = ascii_prefix(data, n);
+  }
+  return k;
+}
+
+/* New unicode holding `prefix` followed by data[0:n] widened (every byte
+ * below 0x100, as checked by the caller) */
+static PyObject* widen_to_unicode(PyObject* prefix, const unsigned char* data,
+                                  Py_ssize_t n, int locked) {
+  Py_ssize_t head = prefix == NULL ? 0 : PyUnicode_GET_SIZE(prefix);
+  PyObject* result = PyUnicode_FromUnicode(NULL, head + n);
+  Py_UNICODE* out;
+
+  if (result == NULL) {
+    return NULL;
+  }
+
+  out = PyUnicode_AS_UNICODE(result);
+  if (head > 0) {
+    memcpy(out, PyUnicode_AS_UNICODE(prefix), head * sizeof(Py_UNICODE));
+  }
+
+  if (locked && n >= TRANSCODE_GIL_RELEASE_BYTES) {
+    Py_BEGIN_ALLOW_THREADS;
+    widen_bytes(data, out + head, n);
+    Py_END_ALLOW_THREADS;
+  } else {
+    widen_bytes(data, out + head, n);
+  }
+  return result;
+}
+
+/* Look up codecs.getincremental{de,en}coder(encoding)(errors) */
+static PyObject* incremental_codec(const char* encoding, const char* errors,
+                                   int decoder) {
+  PyObject* codecs;
+  PyObject* factory;
+  PyObject* codec;
+
+  codecs = PyImport_ImportModule("codecs");
+  if (codecs == NULL) {
+    return NULL;
+  }
+
+  factory = PyObject_CallMethod(
+      codecs, decoder ? "getincrementaldecoder" : "getincrementalencoder",
+      "s", encoding);
+  Py_DECREF(codecs);
+  if (factory == NULL) {
+    return NULL;
+  }
+
+  codec = PyObject_CallFunction(factory, "s", errors);
+  Py_DECREF(factory);
+  return codec;
+}
+
+/* Shared layout of both transcoders */
+typedef struct {
+  PyObject_HEAD CodecKind kind;
+  PyObject* encoding; /* str, as given */
+  PyObject* errors;   /* str error handler name */
+  PyObject* codec;    /* incremental codec for CODEC_OTHER, else NULL */
+  /* Bytes of an incomplete UTF-8 sequence (decoder), or a trailing high
+   * surrogate on narrow builds (encoder) */
+  unsigned char pending[4];
+  Py_UNICODE pending_unit;
+  int pending_len;
+} Transcoder;
+
+static PyTypeObject Utf8DecoderType;
+static PyTypeObject Utf8EncoderType;
+
+static PyObject* Transcoder_new(PyTypeObject* type, PyObject* args,
+                                PyObject* kwargs) {
+  const char* encoding = "utf-8";
+  const char* errors = "strict";
+  static char* kwlist[] = {"encoding", "errors", NULL};
+  Transcoder* self;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|ss", kwlist, &encoding,
+                                   &errors)) {
     return NULL;
   }
 
-  if (!PyCallable_Check(callable)) {
-    PyErr_SetString(PyExc_TypeError, "first argument must be callable");
+  self = (Transcoder*)type->tp_alloc(type, 0);
+  if (self == NULL) {
     return NULL;
   }
 
-  result = PyObject_Call(callable, call_args, kwargs);
+  self->kind = codec_kind(encoding);
+  self->encoding = PyString_FromString(encoding);
+  self->errors = PyString_FromString(errors);
+  if (self->encoding == NULL || self->errors == NULL) {
+    Py_DECREF(self);
+    return NULL;
+  }
 
-  return result;
+  /* Unknown encodings fail here rather than on the first feed() */
+  if (self->kind == CODEC_OTHER) {
+    self->codec =
+        incremental_codec(encoding, errors,
+                                    PyType_IsSubtype(type, &Utf8DecoderType));
+    if (self->codec == NULL) {
+      Py_DECREF(self);
+      return NULL;
+    }
+  }
+
+  return (PyObject*)self;
 }
 
-static PyObject* call_method(PyObject* self, PyObject* args) {
-  PyObject* obj;
-  const char* method_name;
-  PyObject* method_args;
-  PyObject* result;
+static void Transcoder_dealloc(Transcoder* self) {
+  Py_XDECREF(self->encoding);
+  Py_XDECREF(self->errors);
+  Py_XDECREF(self->codec);
+  Py_TYPE(self)->tp_free((PyObject*)self);
+}
 
-  if (!PyArg_ParseTuple(args, "OsO", &obj, &method_name, &method_args)) {
-    return NULL;
+static PyObject* Transcoder_reset(Transcoder* self) {
+  self->pending_len = 0;
+  if (self->codec != NULL) {
+    return PyObject_CallMethod(self->codec, "reset", NULL);
   }
+  Py_RETURN_NONE;
+}
 
-  result = PyObject_CallMethod(obj, (char*)method_name, "O", method_args);
+static PyMemberDef Transcoder_members[] = {
+    {"encoding", T_OBJECT, offsetof(Transcoder, encoding), READONLY,
+     "Requested encoding"},
+    {"errors", T_OBJECT, offsetof(Transcoder, errors), READONLY,
+     "Error handler name"},
+    {"pending", T_INT, offsetof(Transcoder, pending_len), READONLY,
+     "Number of buffered units of an incomplete character"},
+    {NULL}};
 
-  return result;
-}
+/* Decode a UTF-8 chunk, carrying an incomplete trailing sequence over */
+static PyObject* decode_utf8_chunk(Transcoder* self, const unsigned char* data,
+                                   Py_ssize_t n, int final, int locked) {
+  const char* errors = PyString_AS_STRING(self->errors);
+  PyObject* head = NULL;
+  PyObject* body;
+  PyObject* result;
+  Py_ssize_t consumed;
+  Py_ssize_t k;
 
-/* ============================================================================
- * ITERATOR PROTOCOL
- * ============================================================================
- */
+  if (self->pending_len > 0) {
+    /* Finish the split character from a small boundary buffer: the
+     * pending bytes plus up to 8 new ones always complete it (or prove
+     * it invalid), and nothing large is copied */
+    unsigned char boundary[12];
+    Py_ssize_t plen = self->pending_len;
+    Py_ssize_t take = n < 8 ? n : 8;
+    int last = final && take == n;
 
-typedef struct {
-  PyObject_HEAD long current;
-  long stop;
-  long step;
-} RangeIterator;
+    memcpy(boundary, self->pending, plen);
+    memcpy(boundary + plen, data, take);
+    consumed = plen + take;
+    head = PyUnicode_DecodeUTF8Stateful((const char*)boundary, plen + take,
+                                        errors, last ? NULL : &consumed);
+    if (head == NULL) {
+      return NULL;
+    }
 
-static void RangeIterator_dealloc(RangeIterator* self) { PyObject_Del(self); }
+    if (take == n) {
+      /* The whole chunk fit in the boundary buffer */
+      self->pending_len = (int)(plen + take - consumed);
+      memcpy(self->pending, boundary + consumed, self->pending_len);
+      return head;
+    }
 
-static PyObject* RangeIterator_iter(PyObject* self) {
-  Py_INCREF(self);
-  return self;
-}
+    /* consumed >= plen here: an unfinished run would be < 4 bytes */
+    data += consumed - plen;
+    n -= consumed - plen;
+    self->pending_len = 0;
+  }
 
-static PyObject* RangeIterator_next(RangeIterator* self) {
-  if (self->current >= self->stop) {
-    PyErr_SetNone(PyExc_StopIteration);
+  k = scan_ascii(data, n, locked);
+  if (k == n) {
+    result = widen_to_unicode(head, data, n, locked);
+    Py_XDECREF(head);
+    return result;
+  }
+
+  consumed = n;
+  body = PyUnicode_DecodeUTF8Stateful((const char*)data, n, errors,
+                                      final ? NULL : &consumed);
+  if (body == NULL) {
+    Py_XDECREF(head);
     return NULL;
   }
 
-  long value = self->current;
-  self->current += self->step;
+  self->pending_len = (int)(n - consumed);
+  memcpy(self->pending, data + consumed, self->pending_len);
 
-  return PyInt_FromLong(value);
+  if (head == NULL) {
+    return body;
+  }
+  result = PyUnicode_Concat(head, body);
+  Py_DECREF(head);
+  Py_DECREF(body);
+  return result;
 }
 
-static PyTypeObject RangeIteratorType = {
-    PyObject_HEAD_INIT(NULL) 0,        /* ob_size */
-    "advanced_module.RangeIterator",   /* tp_name */
-    sizeof(RangeIterator),             /* tp_basicsize */
-    0,                                 /* tp_itemsize */
-    (destructor)RangeIterator_dealloc, /* tp_dealloc */
-    0,                                 /* tp_print */
-    0,                                 /* tp_getattr */
-    0,                                 /* tp_setattr */
-    0,                                 /* tp_compare */
-    0,                                 /* tp_repr */
-    0,                                 /* tp_as_number */
-    0,                                 /* tp_as_sequence */
-    0,                                 /* tp_as_mapping */
-    0,                                 /* tp_hash */
-    0,                                 /* tp_call */
-    0,                                 /* tp_str */
-    0,                                 /* tp_getattro */
-    0,                                 /* tp_setattro */
-    0,                                 /* tp_as_buffer */
-    Py_TPFLAGS_DEFAULT,                /* tp_flags */
-    "Range iterator object",           /* tp_doc */
-    0,                                 /* tp_traverse */
-    0,                                 /* tp_clear */
-    0,                                 /* tp_richcompare */
-    0,                                 /* tp_weaklistoffset */
-    RangeIterator_iter,                /* tp_iter */
-    (iternextfunc)RangeIterator_next,  /* tp_iternext */
-};
-
-static PyObject* create_range_iterator(PyObject* self, PyObject* args) {
-  long start, stop, step = 1;
-  RangeIterator* iter;
+static PyObject* Utf8Decoder_feed(Transcoder* self, PyObject* args,
+                                  PyObject* kwargs) {
+  PyObject* chunk;
+  int final = 0;
+  static char* kwlist[] = {"chunk", "final", NULL};
+  Py_buffer view;
+  int locked;
+  PyObject* result;
 
-  if (!PyArg_ParseTuple(args, "ll|l", &start, &stop, &step)) {
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|i", kwlist, &chunk,
+                                   &final)) {
     return NULL;
   }
 
-  iter = PyObject_New(RangeIterator, &RangeIteratorType);
-  if (iter == NULL) {
+  if (self->kind == CODEC_OTHER) {
+    return PyObject_CallMethod(self->codec, "decode", "Oi", chunk, final);
+  }
+
+  if (PyUnicode_Check(chunk)) {
+    PyErr_SetString(PyExc_TypeError, "feed() expects bytes, not unicode");
     return NULL;
   }
 
-  iter->current = start;
-  iter->stop = stop;
-  iter->step = step;
+  /* str and new-style exporters cannot change while the view is held, so
+   * they may be scanned without the GIL; old-style buffers may not */
+  if (PyObject_CheckBuffer(chunk)) {
+    if (PyObject_GetBuffer(chunk, &view, PyBUF_SIMPLE) < 0) {
+      return NULL;
+    }
+    locked = 1;
+  } else {
+    const void* data;
+    Py_ssize_t len;
+    if (PyObject_AsReadBuffer(chunk, &data, &len) < 0 ||
+        PyBuffer_FillInfo(&view, NULL, (void*)data, len, 1, PyBUF_SIMPLE) <
+            0) {
+      return NULL;
+    }
+    locked = 0;
+  }
+
+  switch (self->kind) {
+    case CODEC_UTF8:
+      result = decode_utf8_chunk(self, (const unsigned char*)view.buf,
+                                 view.len, final, locked);
+      break;
+    case CODEC_LATIN1:
+      result = widen_to_unicode(NULL, (const unsigned char*)view.buf,
+                                view.len, locked);
+      break;
+    default:
+      if (scan_ascii((const unsigned char*)view.buf, view.len, locked) ==
+          view.len) {
+        result = widen_to_unicode(NULL, (const unsigned char*)view.buf,
+                                  view.len, locked);
+      } else {
+        /* Let the codec report (or handle) the offending byte */
+        result = PyUnicode_DecodeASCII((const char*)view.buf, view.len,
+                                       PyString_AS_STRING(self->errors));
+      }
+      break;
+  }
 
-  return (PyObject*)iter;
+  PyBuffer_Release(&view);
+  return result;
 }
 
-static PyObject* iterate_object(PyObject* self, PyObject* args) {
-  PyObject* iterable;
-  PyObject* iterator;
-  PyObject* item;
+/* Encode text[0:n] with the transcoder's encoding and error handler */
+static PyObject* encode_units(Transcoder* self, const Py_UNICODE* text,
+                              Py_ssize_t n) {
+  const char* errors = PyString_AS_STRING(self->errors);
+  Py_UNICODE limit = self->kind == CODEC_LATIN1 ? 0x100 : 0x80;
   PyObject* result;
-  int count = 0;
+  Py_ssize_t k;
 
-  if (!PyArg_ParseTuple(args, "O", &iterable)) {
-    return NULL;
+  if (n >= TRANSCODE_GIL_RELEASE_BYTES) {
+    Py_BEGIN_ALLOW_THREADS;
+    k = unicode_prefix_below(text, n, limit);
+    Py_END_ALLOW_THREADS;
+  } else {
+    k = unicode_prefix_below(text, n, limit);
   }
 
-  iterator = PyObject_GetIter(iterable);
-  if (iterator == NULL) {
+  if (k < n) {
+    switch (self->kind) {
+      case CODEC_UTF8:
+        return PyUnicode_EncodeUTF8(text, n, errors);
+      case CODEC_LATIN1:
+        return PyUnicode_EncodeLatin1(text, n, errors);
+      default:
+        return PyUnicode_EncodeASCII(text, n, errors);
+    }
+  }
+
+  /* Every unit fits in one byte in all three encodings */
+  result = PyString_FromStringAndSize(NULL, n);
+  if (result == NULL) {
     return NULL;
   }
 
-  result = PyList_New(0);
+  if (n >= TRANSCODE_GIL_RELEASE_BYTES) {
+    Py_BEGIN_ALLOW_THREADS;
+    narrow_units(text, PyString_AS_STRING(result), n);
+    Py_END_ALLOW_THREADS;
+  } else {
+    narrow_units(text, PyString_AS_STRING(result), n);
+  }
+  return result;
+}
 
-  while ((item = PyIter_Next(iterator))) {
-    PyList_Append(result, item);
-    Py_DECREF(item);
-    count++;
+static PyObject* Utf8Encoder_feed(Transcoder* self, PyObject* args,
+                                  PyObject* kwargs) {
+  PyObject* text;
+  int final = 0;
+  static char* kwlist[] = {"text", "final", NULL};
+  const Py_UNICODE* units;
+  Py_ssize_t n;
+  PyObject* joined = NULL;
+  PyObject* result;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|i", kwlist, &text,
+                                   &final)) {
+    return NULL;
   }
 
-  Py_DECREF(iterator);
+  if (self->kind == CODEC_OTHER) {
+    return PyObject_CallMethod(self->codec, "encode", "Oi", text, final);
+  }
 
-  if (PyErr_Occurred()) {
-    Py_DECREF(result);
+  if (!PyUnicode_Check(text)) {
+    PyErr_Format(PyExc_TypeError, "feed() expects unicode, not %.200s",
+                 Py_TYPE(text)->tp_name);
     return NULL;
   }
 
+  units = PyUnicode_AS_UNICODE(text);
+  n = PyUnicode_GET_SIZE(text);
+
+#ifndef Py_UNICODE_WIDE
+  /* Narrow builds store astral characters as surrogate pairs, which a
+   * chunk boundary can split: rejoin a held high surrogate, and hold a
+   * trailing one back until the next chunk */
+  if (self->pending_len > 0) {
+    joined = PyUnicode_FromUnicode(NULL, n + 1);
+    if (joined == NULL) {
+      return NULL;
+    }
+    PyUnicode_AS_UNICODE(joined)[0] = self->pending_unit;
+    memcpy(PyUnicode_AS_UNICODE(joined) + 1, units, n * sizeof(Py_UNICODE));
+    units = PyUnicode_AS_UNICODE(joined);
+    n++;
+    self->pending_len = 0;
+  }
+  if (!final && n > 0 && units[n - 1] >= 0xD800 && units[n - 1] <= 0xDBFF) {
+    self->pending_unit = units[n - 1];
+    self->pending_len = 1;
+    n--;
+  }
+#endif
+
+  result = encode_units(self, units, n);
+  Py_XDECREF(joined);
   return result;
 }
 
+static PyMethodDef Utf8Decoder_methods[] = {
+    {"feed", (PyCFunction)Utf8Decoder_feed, METH_VARARGS | METH_KEYWORDS,
+     "Decode the next chunk.\n\nArgs:\n    chunk (str or buffer): Encoded "
+     "bytes\n    final (bool): Flush; a truncated character is an "
+     "error\n\nReturns:\n    unicode: Every complete character so far"},
+    {"reset", (PyCFunction)Transcoder_reset, METH_NOARGS,
+     "Discard any buffered partial character."},
+    {NULL, NULL, 0, NULL}};
+
+static PyMethodDef Utf8Encoder_methods[] = {
+    {"feed", (PyCFunction)Utf8Encoder_feed, METH_VARARGS | METH_KEYWORDS,
+     "Encode the next chunk.\n\nArgs:\n    text (unicode): Text to encode\n "
+     "   final (bool): Flush any held surrogate\n\nReturns:\n    str: Encoded "
+     "bytes"},
+    {"reset", (PyCFunction)Transcoder_reset, METH_NOARGS,
+     "Discard any buffered partial character."},
+    {NULL, NULL, 0, NULL}};
+
+static PyTypeObject Utf8DecoderType = {
+    PyObject_HEAD_INIT(NULL) 0,               /* ob_size */
+    "advanced_module.Utf8Decoder",            /* tp_name */
+    sizeof(Transcoder),                       /* tp_basicsize */
+    0,                                        /* tp_itemsize */
+    (destructor)Transcoder_dealloc,           /* tp_dealloc */
+    0,                                        /* tp_print */
+    0,                                        /* tp_getattr */
+    0,                                        /* tp_setattr */
+    0,                                        /* tp_compare */
+    0,                                        /* tp_repr */
+    0,                                        /* tp_as_number */
+    0,                                        /* tp_as_sequence */
+    0,                                        /* tp_as_mapping */
+    0,                                        /* tp_hash */
+    0,                                        /* tp_call */
+    0,                                        /* tp_str */
+    0,                                        /* tp_getattro */
+    0,                                        /* tp_setattro */
+    0,                                        /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                       /* tp_flags */
+    "Incremental bytes-to-unicode decoder",   /* tp_doc */
+    0,                                        /* tp_traverse */
+    0,                                        /* tp_clear */
+    0,                                        /* tp_richcompare */
+    0,                                        /* tp_weaklistoffset */
+    0,                                        /* tp_iter */
+    0,                                        /* tp_iternext */
+    Utf8Decoder_methods,                      /* tp_methods */
+    Transcoder_members,                       /* tp_members */
+    0,                                        /* tp_getset */
+    0,                                        /* tp_base */
+    0,                                        /* tp_dict */
+    0,                                        /* tp_descr_get */
+    0,                                        /* tp_descr_set */
+    0,                                        /* tp_dictoffset */
+    0,                                        /* tp_init */
+    0,                                        /* tp_alloc */
+    Transcoder_new,                           /* tp_new */
+};
+
+static PyTypeObject Utf8EncoderType = {
+    PyObject_HEAD_INIT(NULL) 0,               /* ob_size */
+    "advanced_module.Utf8Encoder",            /* tp_name */
+    sizeof(Transcoder),                       /* tp_basicsize */
+    0,                                        /* tp_itemsize */
+    (destructor)Transcoder_dealloc,           /* tp_dealloc */
+    0,                                        /* tp_print */
+    0,                                        /* tp_getattr */
+    0,                                        /* tp_setattr */
+    0,                                        /* tp_compare */
+    0,                                        /* tp_repr */
+    0,                                        /* tp_as_number */
+    0,                                        /* tp_as_sequence */
+    0,                                        /* tp_as_mapping */
+    0,                                        /* tp_hash */
+    0,                                        /* tp_call */
+    0,                                        /* tp_str */
+    0,                                        /* tp_getattro */
+    0,                                        /* tp_setattro */
+    0,                                        /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                       /* tp_flags */
+    "Incremental unicode-to-bytes encoder",   /* tp_doc */
+    0,                                        /* tp_traverse */
+    0,                                        /* tp_clear */
+    0,                                        /* tp_richcompare */
+    0,                                        /* tp_weaklistoffset */
+    0,                                        /* tp_iter */
+    0,                                        /* tp_iternext */
+    Utf8Encoder_methods,                      /* tp_methods */
+    Transcoder_members,                       /* tp_members */
+    0,                                        /* tp_getset */
+    0,                                        /* tp_base */
+    0,                                        /* tp_dict */
+    0,                                        /* tp_descr_get */
+    0,                                        /* tp_descr_set */
+    0,                                        /* tp_dictoffset */
+    0,                                        /* tp_init */
+    0,                                        /* tp_alloc */
+    Transcoder_new,                           /* tp_new */
+};
+
 /* ============================================================================
- * CAPSULES (for C data)
+ * THREAD POOL
  * ============================================================================
  */
 
+/* Pool(n) runs work items on n threads: n - 1 workers plus the thread
+ * that submits the job, which works instead of waiting. A job is a count
+ * of items and a function; each idle thread claims the next unclaimed
+ * item under the pool lock, so uneven items balance themselves. Kernels
+ * elsewhere submit GIL-free jobs through the capsule in shared.h;
+ * map() submits Python calls, and each of those takes the GIL. */
+
+#define POOL_MAX_THREADS 1024
+
 typedef struct {
-  int x;
-  int y;
-  char name[50];
-} Point;
+  pycapi_pool_fn fn;
+  void* ctx;
+  Py_ssize_t ntasks;
+  Py_ssize_t next; /* next unclaimed item */
+  int running;     /* workers that have not finished with the job */
+} PoolJob;
 
-static void point_destructor(PyObject* capsule) {
-  Point* point = (Point*)PyCapsule_GetPointer(capsule, "Point");
-  if (point != NULL) {
-    PyMem_Free(point);
+typedef struct {
+  PyObject_HEAD pthread_mutex_t lock;
+  pthread_cond_t wake; /* a job was posted, or the pool is shutting down */
+  pthread_cond_t done; /* a job finished */
+  pthread_t* threads;
+  int size;    /* threads doing the work, including the caller */
+  int started; /* worker threads running */
+  int shutdown;
+  PoolJob* job; /* the job in progress; one at a time */
+  unsigned long generation;
+  pid_t owner; /* the process whose threads these are */
+} Pool;
+
+static PyTypeObject PoolType;
+
+/* The pool whose item this thread is running, so that a job submitted from
+ * inside an item runs inline instead of waiting for itself */
+static __thread Pool* current_pool = NULL;
+
+/* Run the job's unclaimed items; called and returns with the lock held */
+static void pool_drain(Pool* pool, PoolJob* job) {
+  Pool* outer = current_pool;
+
+  current_pool = pool;
+  while (job->next < job->ntasks) {
+    Py_ssize_t index = job->next++;
+
+    pthread_mutex_unlock(&pool->lock);
+    job->fn(job->ctx, index);
+    pthread_mutex_lock(&pool->lock);
   }
+  current_pool = outer;
 }
 
-static PyObject* create_point_capsule(PyObject* self, PyObject* args) {
-  int x, y;
-  const char* name;
-  Point* point;
-  PyObject* capsule;
+/* A fork()ed child inherits the pool but not its workers, and its copy of
+ * the lock may have been held by one of them; it runs every job inline */
+static int pool_forked(Pool* pool) { return getpid() != pool->owner; }
 
-  if (!PyArg_ParseTuple(args, "iis", &x, &y, &name)) {
-    return NULL;
+static void* pool_worker(void* arg) {
+  Pool* pool = (Pool*)arg;
+  unsigned long seen = 0;
+
+  pthread_mutex_lock(&pool->lock);
+  for (;;) {
+    PoolJob* job;
+
+    while (!pool->shutdown &&
+           (pool->job == NULL || pool->generation == seen)) {
+      pthread_cond_wait(&pool->wake, &pool->lock);
+    }
+    if (pool->shutdown) {
+      break;
+    }
+
+    seen = pool->generation;
+    job = pool->job;
+    pool_drain(pool, job);
+    if (--job->running == 0) {
+      pthread_cond_broadcast(&pool->done);
+    }
   }
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+}
 
-  point = (Point*)PyMem_Malloc(sizeof(Point));
-  if (point == NULL) {
-    return PyErr_NoMemory();
+/* PycapiPoolAPI.run; called without the GIL */
+static void pool_run(PyObject* obj, Py_ssize_t ntasks, pycapi_pool_fn fn,
+                     void* ctx) {
+  Pool* pool = (Pool*)obj;
+  PoolJob job;
+  Py_ssize_t i;
+
+  job.fn = fn;
+  job.ctx = ctx;
+  job.ntasks = ntasks;
+  job.next = 0;
+
+  if (current_pool == pool || pool_forked(pool)) {
+    for (i = 0; i < ntasks; i++) {
+      fn(ctx, i);
+    }
+    return;
   }
 
-  point->x = x;
-  point->y = y;
-  strncpy(point->name, name, sizeof(point->name) - 1);
-  point->name[sizeof(point->name) - 1] = '\0';
+  pthread_mutex_lock(&pool->lock);
+  while (pool->job != NULL) {
+    pthread_cond_wait(&pool->done, &pool->lock);
+  }
 
-  capsule = PyCapsule_New(point, "Point", point_destructor);
-  if (capsule == NULL) {
-    PyMem_Free(point);
-    return NULL;
+  /* A closed pool still runs jobs, on the calling thread alone */
+  if (pool->shutdown || pool->started == 0 || ntasks < 2) {
+    pthread_mutex_unlock(&pool->lock);
+    for (i = 0; i < ntasks; i++) {
+      fn(ctx, i);
+    }
+    return;
   }
 
-  return capsule;
+  job.running = pool->started;
+  pool->job = &job;
+  pool->generation++;
+  pthread_cond_broadcast(&pool->wake);
+
+  pool_drain(pool, &job);
+  while (job.running > 0) {
+    pthread_cond_wait(&pool->done, &pool->lock);
+  }
+  pool->job = NULL;
+  pthread_cond_broadcast(&pool->done);
+  pthread_mutex_unlock(&pool->lock);
 }
 
-static PyObject* get_point_data(PyObject* self, PyObject* args) {
-  PyObject* capsule;
-  Point* point;
+static PycapiPoolAPI pool_api = {&PoolType, pool_run};
 
-  if (!PyArg_ParseTuple(args, "O", &capsule)) {
-    return NULL;
-  }
+/* Stop and join the workers once the job in progress is finished; called
+ * without the GIL */
+static void pool_shutdown(Pool* pool) {
+  int i;
 
-  if (!PyCapsule_CheckExact(capsule)) {
-    PyErr_SetString(PyExc_TypeError, "expected a capsule");
-    return NULL;
+  if (pool_forked(pool)) {
+    pool->shutdown = 1;
+    pool->started = 0;
+    return;
   }
 
-  point = (Point*)PyCapsule_GetPointer(capsule, "Point");
-  if (point == NULL) {
-    return NULL;
+  pthread_mutex_lock(&pool->lock);
+  while (pool->job != NULL) {
+    pthread_cond_wait(&pool->done, &pool->lock);
   }
+  pool->shutdown = 1;
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
 
-  return Py_BuildValue("{s:i,s:i,s:s}", "x", point->x, "y", point->y, "name",
-                       point->name);
+  for (i = 0; i < pool->started; i++) {
+    pthread_join(pool->threads[i], NULL);
+  }
+  pool->started = 0;
 }
 
-/* ============================================================================
- * IMPORTING MODULES
- * ============================================================================
- */
-
-static PyObject* import_and_call(PyObject* self, PyObject* args) {
-  const char* module_name;
-  const char* func_name;
-  PyObject* module;
-  PyObject* func;
-  PyObject* result;
+static PyObject* Pool_new(PyTypeObject* type, PyObject* args,
+                          PyObject* kwargs) {
+  Pool* self;
+  int size = 0;
+  int status = 0;
+  static char* kwlist[] = {"size", NULL};
 
-  if (!PyArg_ParseTuple(args, "ss", &module_name, &func_name)) {
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|i:Pool", kwlist, &size)) {
     return NULL;
   }
-
-  module = PyImport_ImportModule(module_name);
-  if (module == NULL) {
+  if (size == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size = cpus < 1 ? 1 : cpus > POOL_MAX_THREADS ? POOL_MAX_THREADS : cpus;
+  }
+  if (size < 1 || size > POOL_MAX_THREADS) {
+    PyErr_Format(PyExc_ValueError, "size must be between 1 and %d",
+                 POOL_MAX_THREADS);
     return NULL;
   }
 
-  func = PyObject_GetAttrString(module, func_name);
-  Py_DECREF(module);
+  /* map() takes the GIL from worker threads */
+  PyEval_InitThreads();
 
-  if (func == NULL) {
+  self = (Pool*)type->tp_alloc(type, 0);
+  if (self == NULL) {
     return NULL;
   }
+  self->size = size;
+  self->owner = getpid();
 
-  if (!PyCallable_Check(func)) {
-    Py_DECREF(func);
-    PyErr_SetString(PyExc_TypeError, "attribute is not callable");
+  self->threads = (pthread_t*)PyMem_Malloc(size * sizeof(pthread_t));
+  if (self->threads == NULL) {
+    Py_DECREF(self);
+    return PyErr_NoMemory();
+  }
+  pthread_mutex_init(&self->lock, NULL);
+  pthread_cond_init(&self->wake, NULL);
+  pthread_cond_init(&self->done, NULL);
+
+  while (self->started < size - 1 && status == 0) {
+    status = pthread_create(&self->threads[self->started], NULL, pool_worker,
+                            self);
+    if (status == 0) {
+      self->started++;
+    }
+  }
+  if (status != 0) {
+    errno = status;
+    PyErr_SetFromErrno(PyExc_OSError);
+    Py_DECREF(self);
     return NULL;
   }
+  return (PyObject*)self;
+}
 
-  result = PyObject_CallObject(func, NULL);
-  Py_DECREF(func);
+static void Pool_dealloc(Pool* self) {
+  if (self->threads != NULL) {
+    Py_BEGIN_ALLOW_THREADS;
+    pool_shutdown(self);
+    Py_END_ALLOW_THREADS;
 
-  return result;
+    pthread_cond_destroy(&self->done);
+    pthread_cond_destroy(&self->wake);
+    pthread_mutex_destroy(&self->lock);
+    PyMem_Free(self->threads);
+  }
+  Py_TYPE(self)->tp_free((PyObject*)self);
 }
 
-/* ============================================================================
- * STRING FORMATTING
- * ============================================================================
- */
+static PyObject* Pool_close(Pool* self) {
+  /* The job in progress is this thread's own; waiting for it never ends */
+  if (current_pool == self) {
+    PyErr_SetString(PyExc_RuntimeError,
+                    "cannot close a Pool from one of its own jobs");
+    return NULL;
+  }
 
-static PyObject* format_string(PyObject* self, PyObject* args) {
-  const char* template;
-  PyObject* values;
-  PyObject* result;
+  Py_BEGIN_ALLOW_THREADS;
+  pool_shutdown(self);
+  Py_END_ALLOW_THREADS;
+  Py_RETURN_NONE;
+}
+
+static PyObject* Pool_enter(Pool* self) {
+  Py_INCREF(self);
+  return (PyObject*)self;
+}
+
+static PyObject* Pool_exit(Pool* self, PyObject* args) {
+  PyObject* result = Pool_close(self);
 
-  if (!PyArg_ParseTuple(args, "sO", &template, &values)) {
+  if (result == NULL) {
     return NULL;
   }
+  Py_DECREF(result);
+  Py_RETURN_FALSE;
+}
+
+typedef struct {
+  PyObject* func;
+  PyObject* items; /* tuple snapshot, so func cannot resize it */
+  PyObject* results;
+  Py_ssize_t count;
+  Py_ssize_t chunk;
+  Py_ssize_t error_index; /* lowest failed index, or count */
+  PyObject* exc_type;
+  PyObject* exc_value;
+  PyObject* exc_traceback;
+} MapTask;
+
+static void map_task(void* ctx, Py_ssize_t index) {
+  MapTask* task = (MapTask*)ctx;
+  Py_ssize_t start = index * task->chunk;
+  Py_ssize_t stop = start + task->chunk;
+  PyGILState_STATE gil;
+  Py_ssize_t i;
+
+  if (stop > task->count) {
+    stop = task->count;
+  }
 
-  result = PyString_Format(PyString_FromString(template), values);
+  gil = PyGILState_Ensure();
+  /* Items after a failure are skipped; only the first error is raised */
+  for (i = start; i < stop && i < task->error_index; i++) {
+    PyObject* item = PyTuple_GET_ITEM(task->items, i);
+    PyObject* result = PyObject_CallFunctionObjArgs(task->func, item, NULL);
 
-  return result;
+    if (result == NULL) {
+      Py_CLEAR(task->exc_type);
+      Py_CLEAR(task->exc_value);
+      Py_CLEAR(task->exc_traceback);
+      PyErr_Fetch(&task->exc_type, &task->exc_value, &task->exc_traceback);
+      task->error_index = i;
+      break;
+    }
+    PyList_SET_ITEM(task->results, i, result);
+  }
+  PyGILState_Release(gil);
 }
 
-/* ============================================================================
- * UNICODE HANDLING
- * ============================================================================
- */
+static PyObject* Pool_map(Pool* self, PyObject* args, PyObject* kwargs) {
+  PyObject* iterable;
+  MapTask task = {NULL, NULL, NULL, 0, 0, 0, NULL, NULL, NULL};
+  Py_ssize_t ntasks;
+  static char* kwlist[] = {"func", "iterable", "chunk_size", NULL};
 
-static PyObject* string_to_unicode(PyObject* self, PyObject* args) {
-  const char* str;
-  const char* encoding = "utf-8";
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|n:map", kwlist,
+                                   &task.func, &iterable, &task.chunk)) {
+    return NULL;
+  }
+  if (task.chunk < 0) {
+    PyErr_SetString(PyExc_ValueError, "chunk_size must be non-negative");
+    return NULL;
+  }
 
-  if (!PyArg_ParseTuple(args, "s|s", &str, &encoding)) {
+  task.items = PySequence_Tuple(iterable);
+  if (task.items == NULL) {
     return NULL;
   }
+  task.count = PyTuple_GET_SIZE(task.items);
+  task.error_index = task.count;
 
-  return PyUnicode_DecodeUTF8(str, strlen(str), "strict");
-}
+  task.results = PyList_New(task.count);
+  if (task.results == NULL || task.count == 0) {
+    Py_DECREF(task.items);
+    return task.results;
+  }
+
+  /* By default, about four chunks per thread */
+  if (task.chunk == 0) {
+    task.chunk = task.count / (4 * self->size);
+    if (task.chunk < 1) {
+      task.chunk = 1;
+    }
+  }
+  ntasks = (task.count + task.chunk - 1) / task.chunk;
 
-static PyObject* unicode_to_string(PyObject* self, PyObject* args) {
-  PyObject* unicode;
+  Py_BEGIN_ALLOW_THREADS;
+  pool_run((PyObject*)self, ntasks, map_task, &task);
+  Py_END_ALLOW_THREADS;
 
-  if (!PyArg_ParseTuple(args, "O!", &PyUnicode_Type, &unicode)) {
+  Py_DECREF(task.items);
+  if (task.error_index < task.count) {
+    PyErr_Restore(task.exc_type, task.exc_value, task.exc_traceback);
+    Py_DECREF(task.results);
     return NULL;
   }
+  return task.results;
+}
 
-  return PyUnicode_AsUTF8String(unicode);
+static PyObject* Pool_repr(Pool* self) {
+  return PyString_FromFormat("<Pool size=%d%s>", self->size,
+                             self->started < self->size - 1 ? " closed" : "");
 }
 
+static PyMethodDef Pool_methods[] = {
+    {"map", (PyCFunction)Pool_map, METH_VARARGS | METH_KEYWORDS,
+     "Call func on every item, spread over the pool's threads.\n\nArgs:\n"
+     "    func: Callable taking one item\n    iterable: Items\n    "
+     "chunk_size (int, optional): Items per work unit (default: about "
+     "four units per thread)\n\nReturns:\n    list: Results in input "
+     "order\n\nRaises:\n    The exception of the lowest failing item"},
+    {"close", (PyCFunction)Pool_close, METH_NOARGS,
+     "Stop the worker threads once the current job is done; later jobs "
+     "run on the calling thread.\n\nReturns:\n    None\n\nRaises:\n    "
+     "RuntimeError: Called from inside one of the pool's own jobs"},
+    {"__enter__", (PyCFunction)Pool_enter, METH_NOARGS, "Return the pool."},
+    {"__exit__", (PyCFunction)Pool_exit, METH_VARARGS, "Close the pool."},
+    {NULL, NULL, 0, NULL}};
+
+static PyMemberDef Pool_members[] = {
+    {"size", T_INT, offsetof(Pool, size), READONLY,
+     "Threads doing the work, including the caller"},
+    {NULL}};
+
+static PyTypeObject PoolType = {
+    PyObject_HEAD_INIT(NULL) 0,              /* ob_size */
+    "advanced_module.Pool",                  /* tp_name */
+    sizeof(Pool),                            /* tp_basicsize */
+    0,                                       /* tp_itemsize */
+    (destructor)Pool_dealloc,                /* tp_dealloc */
+    0,                                       /* tp_print */
+    0,                                       /* tp_getattr */
+    0,                                       /* tp_setattr */
+    0,                                       /* tp_compare */
+    (reprfunc)Pool_repr,                     /* tp_repr */
+    0,                                       /* tp_as_number */
+    0,                                       /* tp_as_sequence */
+    0,                                       /* tp_as_mapping */
+    0,                                       /* tp_hash */
+    0,                                       /* tp_call */
+    0,                                       /* tp_str */
+    0,                                       /* tp_getattro */
+    0,                                       /* tp_setattro */
+    0,                                       /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                      /* tp_flags */
+    "Worker threads for GIL-free batch kernels", /* tp_doc */
+    0,                                       /* tp_traverse */
+    0,                                       /* tp_clear */
+    0,                                       /* tp_richcompare */
+    0,                                       /* tp_weaklistoffset */
+    0,                                       /* tp_iter */
+    0,                                       /* tp_iternext */
+    Pool_methods,                            /* tp_methods */
+    Pool_members,                            /* tp_members */
+    0,                                       /* tp_getset */
+    0,                                       /* tp_base */
+    0,                                       /* tp_dict */
+    0,                                       /* tp_descr_get */
+    0,                                       /* tp_descr_set */
+    0,                                       /* tp_dictoffset */
+    0,                                       /* tp_init */
+    0,                                       /* tp_alloc */
+    Pool_new,                                /* tp_new */
+};
+
 /* ============================================================================
  * MODULE METHOD TABLE
  * ============================================================================
@@ -356,27 +4272,53 @@ static PyMethodDef AdvancedMethods[] = {
      "args (tuple): Positional arguments\n    kwargs (dict): Keyword "
      "arguments\n\nReturns:\n    Result"},
 
+    {"call_many", (PyCFunction)call_many, METH_VARARGS | METH_KEYWORDS,
+     "Call a function once per item of an iterable.\n\nArgs:\n    func: "
+     "Callable\n    args: Iterable of argument tuples; non-tuple items are "
+     "passed as a single argument\n    kwargs (dict, optional): Keyword "
+     "arguments for every call\n    collect (bool, optional): Keep results "
+     "(default: True)\n\nReturns:\n    list: Results in order, or int: "
+     "number of calls when collect is False\n\nRaises:\n    The first "
+     "exception raised by func; remaining items are not called"},
+
     {"call_method", call_method, METH_VARARGS,
      "Call a method on an object.\n\nArgs:\n    obj: Object\n    method_name "
      "(str): Method name\n    args: Method arguments\n\nReturns:\n    Result"},
 
+    {"bound_method", bound_method, METH_VARARGS,
+     "Resolve a method once for repeated calls.\n\nArgs:\n    obj: "
+     "Object\n    method_name (str): Method name\n\nReturns:\n    "
+     "BoundMethod: Callable handle for obj.method_name"},
+
     /* Iterator protocol */
     {"range_iterator", create_range_iterator, METH_VARARGS,
      "Create a custom range iterator.\n\nArgs:\n    start (int): Start "
      "value\n    stop (int): Stop value\n    step (int, optional): Step "
      "(default: 1)\n\nReturns:\n    RangeIterator"},
 
-    {"iterate", iterate_object, METH_VARARGS,
+    {"iterate", (PyCFunction)iterate_object, METH_VARARGS | METH_KEYWORDS,
      "Iterate over an iterable.\n\nArgs:\n    iterable: Any iterable "
-     "object\n\nReturns:\n    list: List of all items"},
+     "object\n    chunk_size (int, optional): If positive, return an "
+     "iterator of lists of up to chunk_size items instead\n\nReturns:\n  "
+     "  list: List of all items, or ChunkIterator"},
 
     /* Capsules */
-    {"create_point", create_point_capsule, METH_VARARGS,
+    {"create_point", (PyCFunction)create_point_capsule,
+     METH_VARARGS | METH_KEYWORDS,
      "Create a Point capsule.\n\nArgs:\n    x (int): X coordinate\n    y "
-     "(int): Y coordinate\n    name (str): Point name\n\nReturns:\n    "
+     "(int): Y coordinate\n    name (str): Point name\n    buffer "
+     "(optional): Writable buffer to store the Point in, such as a "
+     "memory_module.SharedBuffer, instead of private memory\n    offset "
+     "(int): Byte offset of the Point in buffer\n\nReturns:\n    "
      "capsule: Point capsule"},
 
-    {"get_point", get_point_data, METH_VARARGS,
+    {"point_at", (PyCFunction)point_at, METH_VARARGS | METH_KEYWORDS,
+     "Wrap a Point already stored in a buffer.\n\nArgs:\n    buffer: "
+     "Writable buffer holding the Point\n    offset (int): Byte offset of "
+     "the Point\n\nReturns:\n    capsule: Point capsule sharing the "
+     "buffer's memory"},
+
+    {"get_point", get_point_data, METH_O,
      "Get data from Point capsule.\n\nArgs:\n    capsule: Point "
      "capsule\n\nReturns:\n    dict: Point data"},
 
@@ -386,11 +4328,23 @@ static PyMethodDef AdvancedMethods[] = {
      "name\n    func_name (str): Function name\n\nReturns:\n    Result of "
      "function call"},
 
+    {"resolve", resolve, METH_VARARGS,
+     "Resolve module.func once for repeated calls.\n\nArgs:\n    "
+     "module_name (str): Module name\n    func_name (str): Function "
+     "name\n\nReturns:\n    ResolvedCallable: Callable handle, re-resolved "
+     "when sys.modules or the module attribute changes"},
+
     /* String operations */
     {"format_string", format_string, METH_VARARGS,
      "Format string with values.\n\nArgs:\n    template (str): Format "
-     "template\n    values (tuple/dict): Values\n\nReturns:\n    str: "
-     "Formatted string"},
+     "template, compiled once and cached\n    values (tuple/dict): "
+     "Values\n\nReturns:\n    str: Formatted string"},
+
+    {"compile_format", compile_format, METH_O,
+     "Pre-parse a %-format template for repeated use.\n\nArgs:\n    "
+     "template (str): Format template\n\nReturns:\n    Formatter: "
+     "Object with render(values) and render_many(rows)\n\nRaises:\n    "
+     "ValueError: If the template is malformed"},
 
     /* Unicode */
     {"str_to_unicode", string_to_unicode, METH_VARARGS,
@@ -398,7 +4352,7 @@ static PyMethodDef AdvancedMethods[] = {
      "encoding (str, optional): Encoding (default: utf-8)\n\nReturns:\n    "
      "unicode: Unicode object"},
 
-    {"unicode_to_str", unicode_to_string, METH_VARARGS,
+    {"unicode_to_str", unicode_to_string, METH_O,
      "Convert Unicode to string.\n\nArgs:\n    u (unicode): Unicode "
      "object\n\nReturns:\n    str: UTF-8 encoded string"},
 
@@ -414,6 +4368,21 @@ PyMODINIT_FUNC initadvanced_module(void) {
 
   /* Initialize RangeIterator type */
   if (PyType_Ready(&RangeIteratorType) < 0) return;
+  if (PyType_Ready(&ChunkIteratorType) < 0) return;
+  if (PyType_Ready(&BoundMethodType) < 0) return;
+  if (PyType_Ready(&ResolvedCallableType) < 0) return;
+  if (PyType_Ready(&PointArrayType) < 0) return;
+  if (PyType_Ready(&PointColumnType) < 0) return;
+  if (PyType_Ready(&Utf8DecoderType) < 0) return;
+  if (PyType_Ready(&Utf8EncoderType) < 0) return;
+  if (PyType_Ready(&FormatterType) < 0) return;
+  if (PyType_Ready(&PoolType) < 0) return;
+  if (PyType_Ready(&MappedRecordsType) < 0) return;
+
+  format_cache = PyDict_New();
+  if (format_cache == NULL) return;
+  import_cache = PyDict_New();
+  if (import_cache == NULL) return;
 
   m = Py_InitModule3("advanced_module", AdvancedMethods,
                      "Python 2.7 C-API Tutorial: Advanced Module\n\n"
@@ -425,7 +4394,49 @@ PyMODINIT_FUNC initadvanced_module(void) {
                      "- String formatting and Unicode");
 
   if (m == NULL) return;
+  if (pycapi_instrument_module(m, AdvancedMethods) < 0) return;
 
   Py_INCREF(&RangeIteratorType);
   PyModule_AddObject(m, "RangeIterator", (PyObject*)&RangeIteratorType);
+
+  Py_INCREF(&ChunkIteratorType);
+  PyModule_AddObject(m, "ChunkIterator", (PyObject*)&ChunkIteratorType);
+
+  Py_INCREF(&BoundMethodType);
+  PyModule_AddObject(m, "BoundMethod", (PyObject*)&BoundMethodType);
+
+  Py_INCREF(&ResolvedCallableType);
+  PyModule_AddObject(m, "ResolvedCallable", (PyObject*)&ResolvedCallableType);
+
+  Py_INCREF(&PointArrayType);
+  PyModule_AddObject(m, "PointArray", (PyObject*)&PointArrayType);
+
+  Py_INCREF(&Utf8DecoderType);
+  PyModule_AddObject(m, "Utf8Decoder", (PyObject*)&Utf8DecoderType);
+
+  Py_INCREF(&Utf8EncoderType);
+  PyModule_AddObject(m, "Utf8Encoder", (PyObject*)&Utf8EncoderType);
+
+  Py_INCREF(&FormatterType);
+  PyModule_AddObject(m, "Formatter", (PyObject*)&FormatterType);
+
+  Py_INCREF(&PoolType);
+  PyModule_AddObject(m, "Pool", (PyObject*)&PoolType);
+
+  /* Kernels in other modules reach pool_run through this capsule */
+  PyModule_AddObject(m, "_pool_api",
+                     PyCapsule_New(&pool_api, PYCAPI_POOL_CAPSULE, NULL));
+
+  /* Bytes a Point takes in a buffer passed to create_point */
+  PyModule_AddIntConstant(m, "POINT_SIZE", sizeof(Point));
+
+  Py_INCREF(&MappedRecordsType);
+  PyModule_AddObject(m, "MappedRecords", (PyObject*)&MappedRecordsType);
+
+  /* Hints for MappedRecords.advise() */
+  PyModule_AddIntConstant(m, "MADV_NORMAL", MADV_NORMAL);
+  PyModule_AddIntConstant(m, "MADV_SEQUENTIAL", MADV_SEQUENTIAL);
+  PyModule_AddIntConstant(m, "MADV_RANDOM", MADV_RANDOM);
+  PyModule_AddIntConstant(m, "MADV_WILLNEED", MADV_WILLNEED);
+  PyModule_AddIntConstant(m, "MADV_DONTNEED", MADV_DONTNEED);
 }
@@ -1,7 +1,13 @@
 #include <Python.h>
 
+#include "instrument.h"
+
+/* Built once in init; every call returns a new reference to it */
+static PyObject* hello_string;
+
 static PyObject* hello_world(PyObject* self, PyObject* args) {
-  return Py_BuildValue("s", "Hello from C extension!");
+  Py_INCREF(hello_string);
+  return hello_string;
 }
 
 static PyObject* add_numbers(PyObject* self, PyObject* args) {
@@ -13,10 +19,17 @@ static PyObject* add_numbers(PyObject* self, PyObject* args) {
 }
 
 static PyMethodDef ExampleMethods[] = {
-    {"hello_world", hello_world, METH_VARARGS, "Return a hello world string"},
+    {"hello_world", hello_world, METH_NOARGS, "Return a hello world string"},
     {"add_numbers", add_numbers, METH_VARARGS, "Add two integers"},
     {NULL, NULL, 0, NULL}};
 
 PyMODINIT_FUNC initexample_module(void) {
-  Py_InitModule("example_module", ExampleMethods);
+  PyObject* m;
+
+  hello_string = PyString_InternFromString("Hello from C extension!");
+  if (hello_string == NULL) return;
+
+  m = Py_InitModule("example_module", ExampleMethods);
+  if (m == NULL) return;
+  pycapi_instrument_module(m, ExampleMethods);
 }
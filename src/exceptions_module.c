@@ -10,20 +10,42 @@
  */
 
 #include <Python.h>
+#include <structmember.h>
+
+#include "instrument.h"
 
 /* Custom exception objects */
 static PyObject* CustomError;
 static PyObject* ValidationError;
 
+/* Error codes returned instead of raising by the as_result mode and the
+ * batch validators */
+enum {
+  ERR_OK = 0,
+  ERR_ZERO_DIVISION = 1,
+  ERR_OUT_OF_RANGE = 2,
+  ERR_NOT_A_NUMBER = 3,
+  ERR_COUNT
+};
+
+/* Preallocated instances raised for the fixed-message failures. Raising one
+ * skips building the message and normalizing a new exception object. */
+static PyObject* custom_error_instance;
+static PyObject* validation_error_instance;
+static PyObject* zero_division_instance;
+
+/* Shared (False, code) tuples returned by the as_result mode */
+static PyObject* error_results[ERR_COUNT];
+
 /* ============================================================================
  * RAISING STANDARD EXCEPTIONS
  * ============================================================================
  */
 
-static PyObject* raise_value_error(PyObject* self, PyObject* args) {
+static PyObject* raise_value_error(PyObject* self, PyObject* arg) {
   const char* message;
 
-  if (!PyArg_ParseTuple(args, "s", &message)) {
+  if (!PyArg_Parse(arg, "s:raise_value_error", &message)) {
     return NULL;
   }
 
@@ -41,10 +63,10 @@ static PyObject* raise_runtime_error(PyObject* self, PyObject* args) {
   return NULL;
 }
 
-static PyObject* raise_index_error(PyObject* self, PyObject* args) {
+static PyObject* raise_index_error(PyObject* self, PyObject* arg) {
   int index;
 
-  if (!PyArg_ParseTuple(args, "i", &index)) {
+  if (!PyArg_Parse(arg, "i:raise_index_error", &index)) {
     return NULL;
   }
 
@@ -57,10 +79,15 @@ static PyObject* raise_index_error(PyObject* self, PyObject* args) {
  * ============================================================================
  */
 
-static PyObject* raise_custom_error(PyObject* self, PyObject* args) {
+static PyObject* raise_custom_error(PyObject* self, PyObject* arg) {
   const char* message;
 
-  if (!PyArg_ParseTuple(args, "s", &message)) {
+  if (arg == Py_None) {
+    PyErr_SetObject(CustomError, custom_error_instance);
+    return NULL;
+  }
+
+  if (!PyArg_Parse(arg, "s:raise_custom_error", &message)) {
     return NULL;
   }
 
@@ -86,14 +113,9 @@ static PyObject* raise_validation_error(PyObject* self, PyObject* args) {
  * ============================================================================
  */
 
-static PyObject* check_and_clear_error(PyObject* self, PyObject* args) {
-  PyObject* callable;
+static PyObject* check_and_clear_error(PyObject* self, PyObject* callable) {
   PyObject* result;
 
-  if (!PyArg_ParseTuple(args, "O", &callable)) {
-    return NULL;
-  }
-
   /* Call the object */
   result = PyObject_CallObject(callable, NULL);
 
@@ -110,15 +132,10 @@ static PyObject* check_and_clear_error(PyObject* self, PyObject* args) {
   return PyString_FromString("No exception occurred");
 }
 
-static PyObject* check_exception_type(PyObject* self, PyObject* args) {
-  PyObject* callable;
+static PyObject* check_exception_type(PyObject* self, PyObject* callable) {
   PyObject* result;
   PyObject* response;
 
-  if (!PyArg_ParseTuple(args, "O", &callable)) {
-    return NULL;
-  }
-
   result = PyObject_CallObject(callable, NULL);
 
   if (result == NULL) {
@@ -145,44 +162,312 @@ static PyObject* check_exception_type(PyObject* self, PyObject* args) {
  * ============================================================================
  */
 
-static PyObject* get_exception_info(PyObject* self, PyObject* args) {
+/* An ExceptionRecord keeps the fetched (type, value, traceback) triple as-is.
+ * Nothing is normalized or converted to str until a *_str attribute is
+ * read, and the converted strings are cached on the record. */
+typedef struct {
+  PyObject_HEAD PyObject* type;
+  PyObject* value;
+  PyObject* traceback;
+  PyObject* type_str;
+  PyObject* value_str;
+  Py_ssize_t index; /* position in capture_many, or -1 */
+} ExceptionRecord;
+
+static PyTypeObject ExceptionRecordType;
+
+/* Take over the current exception; returns NULL (exception still set) if
+ * the record cannot be allocated */
+static PyObject* ExceptionRecord_fetch(Py_ssize_t index) {
+  ExceptionRecord* record;
+
+  record = PyObject_GC_New(ExceptionRecord, &ExceptionRecordType);
+  if (record == NULL) {
+    return NULL;
+  }
+
+  PyErr_Fetch(&record->type, &record->value, &record->traceback);
+  record->type_str = NULL;
+  record->value_str = NULL;
+  record->index = index;
+  PyObject_GC_Track(record);
+  return (PyObject*)record;
+}
+
+static int ExceptionRecord_traverse(ExceptionRecord* self, visitproc visit,
+                                    void* arg) {
+  Py_VISIT(self->type);
+  Py_VISIT(self->value);
+  Py_VISIT(self->traceback);
+  return 0;
+}
+
+static int ExceptionRecord_clear(ExceptionRecord* self) {
+  Py_CLEAR(self->type);
+  Py_CLEAR(self->value);
+  Py_CLEAR(self->traceback);
+  Py_CLEAR(self->type_str);
+  Py_CLEAR(self->value_str);
+  return 0;
+}
+
+static void ExceptionRecord_dealloc(ExceptionRecord* self) {
+  PyObject_GC_UnTrack(self);
+  ExceptionRecord_clear(self);
+  PyObject_GC_Del(self);
+}
+
+/* str(obj), computed on first use and kept in *cache; None for NULL */
+static PyObject* cached_str(PyObject* obj, PyObject** cache) {
+  if (obj == NULL) {
+    Py_RETURN_NONE;
+  }
+  if (*cache == NULL) {
+    *cache = PyObject_Str(obj);
+    if (*cache == NULL) {
+      return NULL;
+    }
+  }
+  Py_INCREF(*cache);
+  return *cache;
+}
+
+static PyObject* ExceptionRecord_get_type_str(ExceptionRecord* self,
+                                              void* closure) {
+  return cached_str(self->type, &self->type_str);
+}
+
+static PyObject* ExceptionRecord_get_value_str(ExceptionRecord* self,
+                                               void* closure) {
+  return cached_str(self->value, &self->value_str);
+}
+
+static PyObject* ExceptionRecord_get_has_traceback(ExceptionRecord* self,
+                                                   void* closure) {
+  return PyBool_FromLong(self->traceback != NULL);
+}
+
+/* The dict that get_exception_info has always returned */
+static PyObject* ExceptionRecord_as_dict(ExceptionRecord* self) {
+  PyObject* info = PyDict_New();
+  PyObject* item;
+  int status;
+
+  if (info == NULL) {
+    return NULL;
+  }
+
+  if (self->type != NULL) {
+    item = ExceptionRecord_get_type_str(self, NULL);
+    if (item == NULL) {
+      goto error;
+    }
+    status = PyDict_SetItemString(info, "type", item);
+    Py_DECREF(item);
+    if (status < 0) {
+      goto error;
+    }
+  }
+
+  if (self->value != NULL) {
+    item = ExceptionRecord_get_value_str(self, NULL);
+    if (item == NULL) {
+      goto error;
+    }
+    status = PyDict_SetItemString(info, "value", item);
+    Py_DECREF(item);
+    if (status < 0) {
+      goto error;
+    }
+  }
+
+  if (PyDict_SetItemString(info, "has_traceback",
+                           self->traceback != NULL ? Py_True : Py_False) < 0) {
+    goto error;
+  }
+  return info;
+
+error:
+  Py_DECREF(info);
+  return NULL;
+}
+
+static PyObject* ExceptionRecord_repr(ExceptionRecord* self) {
+  const char* name = "?";
+
+  if (self->type != NULL) {
+    name = PyExceptionClass_Check(self->type)
+               ? PyExceptionClass_Name(self->type)
+               : Py_TYPE(self->type)->tp_name;
+  }
+  if (self->index >= 0) {
+    return PyString_FromFormat("<ExceptionRecord %s at index %zd>", name,
+                               self->index);
+  }
+  return PyString_FromFormat("<ExceptionRecord %s>", name);
+}
+
+static PyMemberDef ExceptionRecord_members[] = {
+    {"type", T_OBJECT, offsetof(ExceptionRecord, type), READONLY,
+     "Exception type as fetched"},
+    {"value", T_OBJECT, offsetof(ExceptionRecord, value), READONLY,
+     "Exception value as fetched (not normalized)"},
+    {"traceback", T_OBJECT, offsetof(ExceptionRecord, traceback), READONLY,
+     "Traceback object, or None"},
+    {"index", T_PYSSIZET, offsetof(ExceptionRecord, index), READONLY,
+     "Position of the failing callable in capture_many, or -1"},
+    {NULL, 0, 0, 0, NULL}};
+
+static PyGetSetDef ExceptionRecord_getset[] = {
+    {"type_str", (getter)ExceptionRecord_get_type_str, NULL,
+     "str(type), computed on first access", NULL},
+    {"value_str", (getter)ExceptionRecord_get_value_str, NULL,
+     "str(value), computed on first access", NULL},
+    {"has_traceback", (getter)ExceptionRecord_get_has_traceback, NULL,
+     "Whether a traceback was captured", NULL},
+    {NULL, NULL, NULL, NULL, NULL}};
+
+static PyMethodDef ExceptionRecord_methods[] = {
+    {"as_dict", (PyCFunction)ExceptionRecord_as_dict, METH_NOARGS,
+     "Convert to the dict returned by get_exception_info.\n\nReturns:\n    "
+     "dict: type, value and has_traceback"},
+    {NULL, NULL, 0, NULL}};
+
+static PyTypeObject ExceptionRecordType = {
+    PyObject_HEAD_INIT(NULL) 0,              /* ob_size */
+    "exceptions_module.ExceptionRecord",     /* tp_name */
+    sizeof(ExceptionRecord),                 /* tp_basicsize */
+    0,                                       /* tp_itemsize */
+    (destructor)ExceptionRecord_dealloc,     /* tp_dealloc */
+    0,                                       /* tp_print */
+    0,                                       /* tp_getattr */
+    0,                                       /* tp_setattr */
+    0,                                       /* tp_compare */
+    (reprfunc)ExceptionRecord_repr,          /* tp_repr */
+    0,                                       /* tp_as_number */
+    0,                                       /* tp_as_sequence */
+    0,                                       /* tp_as_mapping */
+    0,                                       /* tp_hash */
+    0,                                       /* tp_call */
+    0,                                       /* tp_str */
+    0,                                       /* tp_getattro */
+    0,                                       /* tp_setattro */
+    0,                                       /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC, /* tp_flags */
+    "Captured exception with lazily formatted fields", /* tp_doc */
+    (traverseproc)ExceptionRecord_traverse,  /* tp_traverse */
+    (inquiry)ExceptionRecord_clear,          /* tp_clear */
+    0,                                       /* tp_richcompare */
+    0,                                       /* tp_weaklistoffset */
+    0,                                       /* tp_iter */
+    0,                                       /* tp_iternext */
+    ExceptionRecord_methods,                 /* tp_methods */
+    ExceptionRecord_members,                 /* tp_members */
+    ExceptionRecord_getset,                  /* tp_getset */
+};
+
+static PyObject* get_exception_info(PyObject* self, PyObject* args,
+                                    PyObject* kwargs) {
   PyObject* callable;
+  PyObject* raw = NULL;
   PyObject* result;
-  PyObject *exc_type, *exc_value, *exc_traceback;
-  PyObject* info_dict;
+  PyObject* record;
+  PyObject* info;
+  int want_raw = 0;
+  static char* kwlist[] = {"callable", "raw", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|O:get_exception_info",
+                                   kwlist, &callable, &raw)) {
+    return NULL;
+  }
 
-  if (!PyArg_ParseTuple(args, "O", &callable)) {
+  if (raw != NULL && (want_raw = PyObject_IsTrue(raw)) < 0) {
     return NULL;
   }
 
   result = PyObject_CallObject(callable, NULL);
+  if (result != NULL) {
+    Py_DECREF(result);
+    Py_RETURN_NONE;
+  }
 
-  if (result == NULL) {
-    /* Fetch exception info */
-    PyErr_Fetch(&exc_type, &exc_value, &exc_traceback);
+  record = ExceptionRecord_fetch(-1);
+  if (record == NULL || want_raw) {
+    return record;
+  }
 
-    info_dict = PyDict_New();
+  info = ExceptionRecord_as_dict((ExceptionRecord*)record);
+  Py_DECREF(record);
+  return info;
+}
 
-    if (exc_type != NULL) {
-      PyDict_SetItemString(info_dict, "type", PyObject_Str(exc_type));
-      Py_DECREF(exc_type);
-    }
+static PyObject* capture_many(PyObject* self, PyObject* callables) {
+  PyObject* iterator;
+  PyObject* results = NULL;
+  PyObject* failures = NULL;
+  PyObject* captured;
+  PyObject* callable;
+  Py_ssize_t index = 0;
 
-    if (exc_value != NULL) {
-      PyDict_SetItemString(info_dict, "value", PyObject_Str(exc_value));
-      Py_DECREF(exc_value);
-    }
+  iterator = PyObject_GetIter(callables);
+  if (iterator == NULL) {
+    return NULL;
+  }
+
+  results = PyList_New(0);
+  failures = PyList_New(0);
+  if (results == NULL || failures == NULL) {
+    goto error;
+  }
 
-    PyDict_SetItemString(info_dict, "has_traceback",
-                         PyBool_FromLong(exc_traceback != NULL));
+  while ((callable = PyIter_Next(iterator))) {
+    PyObject* result = PyObject_CallObject(callable, NULL);
+    int status;
+
+    Py_DECREF(callable);
+    if (result == NULL) {
+      PyObject* record;
+
+      /* KeyboardInterrupt, SystemExit and friends still propagate */
+      if (!PyErr_ExceptionMatches(PyExc_Exception)) {
+        goto error;
+      }
+      record = ExceptionRecord_fetch(index);
+      if (record == NULL) {
+        goto error;
+      }
+      status = PyList_Append(failures, record);
+      Py_DECREF(record);
+      if (status < 0) {
+        goto error;
+      }
+      Py_INCREF(Py_None);
+      result = Py_None;
+    }
 
-    Py_XDECREF(exc_traceback);
+    status = PyList_Append(results, result);
+    Py_DECREF(result);
+    if (status < 0) {
+      goto error;
+    }
+    index++;
+  }
 
-    return info_dict;
+  if (PyErr_Occurred()) {
+    goto error;
   }
 
-  Py_DECREF(result);
-  Py_RETURN_NONE;
+  Py_DECREF(iterator);
+  captured = PyTuple_Pack(2, results, failures);
+  Py_DECREF(results);
+  Py_DECREF(failures);
+  return captured;
+
+error:
+  Py_DECREF(iterator);
+  Py_XDECREF(results);
+  Py_XDECREF(failures);
+  return NULL;
 }
 
 /* ============================================================================
@@ -190,18 +475,51 @@ static PyObject* get_exception_info(PyObject* self, PyObject* args) {
  * ============================================================================
  */
 
-static PyObject* safe_divide(PyObject* self, PyObject* args) {
+/* Results for the as_result mode: (True, value), stealing value, or the
+ * shared (False, code) tuple */
+static PyObject* ok_result(PyObject* value) {
+  PyObject* result;
+
+  if (value == NULL) {
+    return NULL;
+  }
+  result = PyTuple_Pack(2, Py_True, value);
+  Py_DECREF(value);
+  return result;
+}
+
+static PyObject* error_result(int code) {
+  Py_INCREF(error_results[code]);
+  return error_results[code];
+}
+
+static PyObject* safe_divide(PyObject* self, PyObject* args,
+                             PyObject* kwargs) {
   double a, b;
+  PyObject* as_result = NULL;
+  int want_result = 0;
+  static char* kwlist[] = {"a", "b", "as_result", NULL};
 
-  if (!PyArg_ParseTuple(args, "dd", &a, &b)) {
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "dd|O:safe_divide", kwlist,
+                                   &a, &b, &as_result)) {
     return NULL; /* Propagate parsing error */
   }
 
+  if (as_result != NULL && (want_result = PyObject_IsTrue(as_result)) < 0) {
+    return NULL;
+  }
+
   if (b == 0.0) {
-    PyErr_SetString(PyExc_ZeroDivisionError, "Cannot divide by zero");
+    if (want_result) {
+      return error_result(ERR_ZERO_DIVISION);
+    }
+    PyErr_SetObject(PyExc_ZeroDivisionError, zero_division_instance);
     return NULL;
   }
 
+  if (want_result) {
+    return ok_result(PyFloat_FromDouble(a / b));
+  }
   return PyFloat_FromDouble(a / b);
 }
 
@@ -213,7 +531,7 @@ static PyObject* nested_call_demo(PyObject* self, PyObject* args) {
   divide_args = Py_BuildValue("(dd)", 10.0, 0.0);
 
   /* This will raise an exception */
-  result = safe_divide(self, divide_args);
+  result = safe_divide(self, divide_args, NULL);
   Py_DECREF(divide_args);
 
   /* If safe_divide raised an exception, it will be propagated */
@@ -225,6 +543,143 @@ static PyObject* nested_call_demo(PyObject* self, PyObject* args) {
   Py_RETURN_NONE;
 }
 
+/* ============================================================================
+ * ERROR CODES
+ * ============================================================================
+ */
+
+/* Error code for one value checked against [low, high]; -1 with an
+ * exception set for failures other than a non-numeric value */
+static int range_error_code(PyObject* item, double low, double high) {
+  double value;
+
+  if (PyFloat_CheckExact(item)) {
+    value = PyFloat_AS_DOUBLE(item);
+  } else if (PyInt_CheckExact(item)) {
+    value = (double)PyInt_AS_LONG(item);
+  } else {
+    value = PyFloat_AsDouble(item);
+    if (value == -1.0 && PyErr_Occurred()) {
+      if (PyErr_ExceptionMatches(PyExc_TypeError)) {
+        PyErr_Clear();
+        return ERR_NOT_A_NUMBER;
+      }
+      if (PyErr_ExceptionMatches(PyExc_OverflowError)) {
+        PyErr_Clear();
+        return ERR_OUT_OF_RANGE;
+      }
+      return -1;
+    }
+  }
+
+  /* Written so that NaN is out of range */
+  return (low <= value && value <= high) ? ERR_OK : ERR_OUT_OF_RANGE;
+}
+
+static PyObject* validate_range(PyObject* self, PyObject* args,
+                                PyObject* kwargs) {
+  PyObject* value;
+  double low, high;
+  PyObject* as_result = NULL;
+  int want_result = 0;
+  int code;
+  static char* kwlist[] = {"value", "low", "high", "as_result", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Odd|O:validate_range",
+                                   kwlist, &value, &low, &high, &as_result)) {
+    return NULL;
+  }
+
+  if (as_result != NULL && (want_result = PyObject_IsTrue(as_result)) < 0) {
+    return NULL;
+  }
+
+  code = range_error_code(value, low, high);
+  if (code < 0) {
+    return NULL;
+  }
+
+  if (code != ERR_OK) {
+    if (want_result) {
+      return error_result(code);
+    }
+    if (code == ERR_NOT_A_NUMBER) {
+      PyErr_Format(PyExc_TypeError, "expected a number, got %.200s",
+                   Py_TYPE(value)->tp_name);
+      return NULL;
+    }
+    PyErr_SetObject(ValidationError, validation_error_instance);
+    return NULL;
+  }
+
+  Py_INCREF(value);
+  return want_result ? ok_result(value) : value;
+}
+
+static PyObject* validate_range_many(PyObject* self, PyObject* args,
+                                     PyObject* kwargs) {
+  PyObject* values;
+  double low, high;
+  PyObject* mask = Py_None;
+  PyObject* seq;
+  Py_buffer view;
+  unsigned char* codes = NULL;
+  Py_ssize_t failures = 0;
+  Py_ssize_t n, i;
+  static char* kwlist[] = {"values", "low", "high", "mask", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Odd|O:validate_range_many",
+                                   kwlist, &values, &low, &high, &mask)) {
+    return NULL;
+  }
+
+  /* A tuple copy, since a value's __float__ may resize a list argument */
+  seq = PySequence_Tuple(values);
+  if (seq == NULL) {
+    return NULL;
+  }
+  n = PyTuple_GET_SIZE(seq);
+
+  if (mask != Py_None) {
+    if (PyObject_GetBuffer(mask, &view, PyBUF_WRITABLE) < 0) {
+      Py_DECREF(seq);
+      return NULL;
+    }
+    if (view.len < n) {
+      PyErr_Format(PyExc_ValueError,
+                   "mask holds %zd bytes but there are %zd values", view.len,
+                   n);
+      PyBuffer_Release(&view);
+      Py_DECREF(seq);
+      return NULL;
+    }
+    codes = (unsigned char*)view.buf;
+  }
+
+  for (i = 0; i < n; i++) {
+    int code = range_error_code(PyTuple_GET_ITEM(seq, i), low, high);
+
+    if (code < 0) {
+      failures = -1;
+      break;
+    }
+    if (codes != NULL) {
+      codes[i] = (unsigned char)code;
+    }
+    failures += (code != ERR_OK);
+  }
+
+  if (codes != NULL) {
+    PyBuffer_Release(&view);
+  }
+  Py_DECREF(seq);
+
+  if (failures < 0) {
+    return NULL;
+  }
+  return PyInt_FromSsize_t(failures);
+}
+
 /* ============================================================================
  * ERROR INDICATORS
  * ============================================================================
@@ -260,10 +715,10 @@ static PyObject* set_and_check(PyObject* self, PyObject* args) {
  * ============================================================================
  */
 
-static PyObject* issue_warning(PyObject* self, PyObject* args) {
+static PyObject* issue_warning(PyObject* self, PyObject* arg) {
   const char* message;
 
-  if (!PyArg_ParseTuple(args, "s", &message)) {
+  if (!PyArg_Parse(arg, "s:issue_warning", &message)) {
     return NULL;
   }
 
@@ -282,63 +737,95 @@ static PyObject* issue_warning(PyObject* self, PyObject* args) {
 
 static PyMethodDef ExceptionsMethods[] = {
     /* Raising standard exceptions */
-    {"raise_value_error", raise_value_error, METH_VARARGS,
+    {"raise_value_error", raise_value_error, METH_O,
      "Raise ValueError with custom message.\n\nArgs:\n    message (str): Error "
      "message\n\nRaises:\n    ValueError"},
 
-    {"raise_type_error", raise_type_error, METH_VARARGS,
+    {"raise_type_error", raise_type_error, METH_NOARGS,
      "Always raise TypeError.\n\nRaises:\n    TypeError"},
 
-    {"raise_runtime_error", raise_runtime_error, METH_VARARGS,
+    {"raise_runtime_error", raise_runtime_error, METH_NOARGS,
      "Raise RuntimeError with formatted message.\n\nRaises:\n    "
      "RuntimeError"},
 
-    {"raise_index_error", raise_index_error, METH_VARARGS,
+    {"raise_index_error", raise_index_error, METH_O,
      "Raise IndexError.\n\nArgs:\n    index (int): Invalid "
      "index\n\nRaises:\n    IndexError"},
 
     /* Custom exceptions */
-    {"raise_custom_error", raise_custom_error, METH_VARARGS,
-     "Raise custom exception.\n\nArgs:\n    message (str): Error "
-     "message\n\nRaises:\n    CustomError"},
+    {"raise_custom_error", raise_custom_error, METH_O,
+     "Raise custom exception.\n\nArgs:\n    message (str): Error message, "
+     "or None to raise a shared preallocated instance\n\nRaises:\n    "
+     "CustomError"},
 
     {"raise_validation_error", raise_validation_error, METH_VARARGS,
      "Raise validation error.\n\nArgs:\n    field (str): Field name\n    "
      "reason (str): Validation reason\n\nRaises:\n    ValidationError"},
 
     /* Exception handling */
-    {"check_and_clear", check_and_clear_error, METH_VARARGS,
+    {"check_and_clear", check_and_clear_error, METH_O,
      "Call callable and clear any exception.\n\nArgs:\n    callable: Function "
      "to call\n\nReturns:\n    str: Result message"},
 
-    {"check_exception_type", check_exception_type, METH_VARARGS,
+    {"check_exception_type", check_exception_type, METH_O,
      "Call callable and identify exception type.\n\nArgs:\n    callable: "
      "Function to call\n\nReturns:\n    str: Exception type name"},
 
-    {"get_exception_info", get_exception_info, METH_VARARGS,
+    {"get_exception_info", (PyCFunction)get_exception_info,
+     METH_VARARGS | METH_KEYWORDS,
      "Get exception information.\n\nArgs:\n    callable: Function to "
-     "call\n\nReturns:\n    dict: Exception info or None"},
+     "call\n    raw (bool, optional): Return an ExceptionRecord holding the "
+     "unconverted objects (default: False)\n\nReturns:\n    dict or "
+     "ExceptionRecord: Exception info, or None"},
+
+    {"capture_many", capture_many, METH_O,
+     "Call each callable, recording failures instead of raising.\n\nArgs:\n"
+     "    callables: Iterable of zero-argument callables\n\nReturns:\n    "
+     "tuple: (results, failures); results has None for failed calls and "
+     "failures holds an ExceptionRecord per failure\n\nRaises:\n    "
+     "Exceptions that do not derive from Exception, such as "
+     "KeyboardInterrupt"},
 
     /* Exception propagation */
-    {"safe_divide", safe_divide, METH_VARARGS,
+    {"safe_divide", (PyCFunction)safe_divide, METH_VARARGS | METH_KEYWORDS,
      "Safely divide two numbers.\n\nArgs:\n    a (float): Numerator\n    b "
-     "(float): Denominator\n\nReturns:\n    float: Result\n\nRaises:\n    "
+     "(float): Denominator\n    as_result (bool, optional): Return (ok, "
+     "value_or_errcode) instead of raising (default: False)\n\nReturns:\n  "
+     "  float: Result, or tuple in as_result mode\n\nRaises:\n    "
      "ZeroDivisionError"},
 
-    {"nested_call_demo", nested_call_demo, METH_VARARGS,
+    /* Error codes */
+    {"validate_range", (PyCFunction)validate_range,
+     METH_VARARGS | METH_KEYWORDS,
+     "Check that low <= value <= high.\n\nArgs:\n    value (number): Value "
+     "to check\n    low (float): Lower bound\n    high (float): Upper "
+     "bound\n    as_result (bool, optional): Return (ok, value_or_errcode) "
+     "instead of raising (default: False)\n\nReturns:\n    value, or tuple "
+     "in as_result mode\n\nRaises:\n    ValidationError: Shared instance "
+     "when out of range\n    TypeError: If value is not a number"},
+
+    {"validate_range_many", (PyCFunction)validate_range_many,
+     METH_VARARGS | METH_KEYWORDS,
+     "Check many values against [low, high] without raising.\n\nArgs:\n  "
+     "  values: Sequence of numbers\n    low (float): Lower bound\n    high "
+     "(float): Upper bound\n    mask (writable buffer, optional): Receives "
+     "one ERR_* code byte per value\n\nReturns:\n    int: Number of values "
+     "that failed"},
+
+    {"nested_call_demo", nested_call_demo, METH_NOARGS,
      "Demonstrate exception propagation through nested "
      "calls.\n\nRaises:\n    ZeroDivisionError"},
 
     /* Error indicators */
-    {"check_error_occurred", check_error_occurred, METH_VARARGS,
+    {"check_error_occurred", check_error_occurred, METH_NOARGS,
      "Check if an error is currently set.\n\nReturns:\n    bool: True if error "
      "occurred"},
 
-    {"set_and_check", set_and_check, METH_VARARGS,
+    {"set_and_check", set_and_check, METH_NOARGS,
      "Set error and check.\n\nRaises:\n    RuntimeError"},
 
     /* Warnings */
-    {"issue_warning", issue_warning, METH_VARARGS,
+    {"issue_warning", issue_warning, METH_O,
      "Issue a deprecation warning.\n\nArgs:\n    message (str): Warning "
      "message\n\nReturns:\n    None"},
 
@@ -351,6 +838,7 @@ static PyMethodDef ExceptionsMethods[] = {
 
 PyMODINIT_FUNC initexceptions_module(void) {
   PyObject* m;
+  int code;
 
   m = Py_InitModule3("exceptions_module", ExceptionsMethods,
                      "Python 2.7 C-API Tutorial: Exceptions Module\n\n"
@@ -362,6 +850,11 @@ PyMODINIT_FUNC initexceptions_module(void) {
                      "- Error indicators and warnings");
 
   if (m == NULL) return;
+  if (pycapi_instrument_module(m, ExceptionsMethods) < 0) return;
+
+  if (PyType_Ready(&ExceptionRecordType) < 0) return;
+  Py_INCREF(&ExceptionRecordType);
+  PyModule_AddObject(m, "ExceptionRecord", (PyObject*)&ExceptionRecordType);
 
   /* Create custom exceptions */
   CustomError = PyErr_NewException("exceptions_module.CustomError", NULL, NULL);
@@ -372,4 +865,26 @@ PyMODINIT_FUNC initexceptions_module(void) {
       PyErr_NewException("exceptions_module.ValidationError", NULL, NULL);
   Py_INCREF(ValidationError);
   PyModule_AddObject(m, "ValidationError", ValidationError);
+
+  /* Fixed-message instances and error-code results */
+  custom_error_instance =
+      PyObject_CallFunction(CustomError, "s", "Custom error");
+  validation_error_instance =
+      PyObject_CallFunction(ValidationError, "s", "Value out of range");
+  zero_division_instance = PyObject_CallFunction(
+      PyExc_ZeroDivisionError, "s", "Cannot divide by zero");
+  if (custom_error_instance == NULL || validation_error_instance == NULL ||
+      zero_division_instance == NULL) {
+    return;
+  }
+
+  for (code = 0; code < ERR_COUNT; code++) {
+    error_results[code] = Py_BuildValue("(Oi)", Py_False, code);
+    if (error_results[code] == NULL) return;
+  }
+
+  PyModule_AddIntConstant(m, "ERR_OK", ERR_OK);
+  PyModule_AddIntConstant(m, "ERR_ZERO_DIVISION", ERR_ZERO_DIVISION);
+  PyModule_AddIntConstant(m, "ERR_OUT_OF_RANGE", ERR_OUT_OF_RANGE);
+  PyModule_AddIntConstant(m, "ERR_NOT_A_NUMBER", ERR_NOT_A_NUMBER);
 }
@@ -0,0 +1,329 @@
+/*
+ * Python 2.7 C-API Tutorial: Call Instrumentation
+ *
+ * Built with PYCAPI_INSTRUMENT defined (PYCAPI_INSTRUMENT=1 python setup.py
+ * build_ext), every module function is replaced by a PyCFunction whose self
+ * is a FunctionStats slot holding the original C function and its counters:
+ * calls, errors, total nanoseconds and a log2 latency histogram. The
+ * wrapper keeps the original ml_flags, so argument checking is unchanged.
+ *
+ * Counters are only touched with the GIL held (before a function starts and
+ * after it returns), so one slot per function needs no atomics or per-thread
+ * copies. Timestamps come from the TSC on x86 and CLOCK_MONOTONIC
+ * elsewhere.
+ *
+ * Without PYCAPI_INSTRUMENT nothing is wrapped and stats() returns an empty
+ * dict; the module functions are called exactly as before.
+ */
+
+#include "instrument.h"
+
+#ifdef PYCAPI_INSTRUMENT
+
+#include <structmember.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+/* histogram[i] counts calls that took [2**i, 2**(i+1)) ns; the last bucket
+ * also holds everything slower */
+#define STATS_BUCKETS 32
+
+typedef struct {
+  PyObject_HEAD PyCFunction meth; /* original implementation */
+  PyMethodDef def;                /* copy whose ml_meth is a wrapper */
+  unsigned long long calls;
+  unsigned long long errors;
+  unsigned long long total_ns;
+  unsigned long long histogram[STATS_BUCKETS];
+} FunctionStats;
+
+static double ns_per_tick = 1.0;
+static int ticks_calibrated = 0;
+
+static unsigned long long monotonic_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned long long read_ticks(void) {
+#ifdef HAVE_TSC
+  return __rdtsc();
+#else
+  return monotonic_ns();
+#endif
+}
+
+/* Measure the TSC rate against the monotonic clock over about 1 ms */
+static void calibrate_ticks(void) {
+#ifdef HAVE_TSC
+  unsigned long long ns_start = monotonic_ns();
+  unsigned long long ticks_start = __rdtsc();
+  unsigned long long ns_end;
+  unsigned long long ticks_end;
+
+  do {
+    ns_end = monotonic_ns();
+  } while (ns_end - ns_start < 1000000ULL);
+  ticks_end = __rdtsc();
+
+  if (ticks_end > ticks_start) {
+    ns_per_tick = (double)(ns_end - ns_start) / (ticks_end - ticks_start);
+  }
+#endif
+  ticks_calibrated = 1;
+}
+
+static int latency_bucket(unsigned long long ns) {
+  int bucket;
+
+  if (ns == 0) {
+    return 0;
+  }
+#ifdef __GNUC__
+  bucket = 63 - __builtin_clzll(ns);
+#else
+  for (bucket = 0; ns >>= 1; bucket++) {
+  }
+#endif
+  return bucket < STATS_BUCKETS ? bucket : STATS_BUCKETS - 1;
+}
+
+static void stats_record(FunctionStats* stats, unsigned long long ticks,
+                         int failed) {
+  unsigned long long ns = (unsigned long long)(ticks * ns_per_tick);
+
+  stats->calls++;
+  stats->errors += failed;
+  stats->total_ns += ns;
+  stats->histogram[latency_bucket(ns)]++;
+}
+
+/* METH_NOARGS, METH_O and METH_VARARGS functions share one signature */
+static PyObject* instrumented_call(PyObject* self, PyObject* args) {
+  FunctionStats* stats = (FunctionStats*)self;
+  unsigned long long start = read_ticks();
+  PyObject* result = stats->meth(NULL, args);
+
+  stats_record(stats, read_ticks() - start, result == NULL);
+  return result;
+}
+
+static PyObject* instrumented_call_kw(PyObject* self, PyObject* args,
+                                      PyObject* kwargs) {
+  FunctionStats* stats = (FunctionStats*)self;
+  unsigned long long start = read_ticks();
+  PyObject* result =
+      ((PyCFunctionWithKeywords)stats->meth)(NULL, args, kwargs);
+
+  stats_record(stats, read_ticks() - start, result == NULL);
+  return result;
+}
+
+static void FunctionStats_dealloc(FunctionStats* self) {
+  Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyTypeObject FunctionStatsType = {
+    PyObject_HEAD_INIT(NULL) 0,         /* ob_size */
+    "instrument.FunctionStats",         /* tp_name */
+    sizeof(FunctionStats),              /* tp_basicsize */
+    0,                                  /* tp_itemsize */
+    (destructor)FunctionStats_dealloc,  /* tp_dealloc */
+    0,                                  /* tp_print */
+    0,                                  /* tp_getattr */
+    0,                                  /* tp_setattr */
+    0,                                  /* tp_compare */
+    0,                                  /* tp_repr */
+    0,                                  /* tp_as_number */
+    0,                                  /* tp_as_sequence */
+    0,                                  /* tp_as_mapping */
+    0,                                  /* tp_hash */
+    0,                                  /* tp_call */
+    0,                                  /* tp_str */
+    0,                                  /* tp_getattro */
+    0,                                  /* tp_setattro */
+    0,                                  /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                 /* tp_flags */
+    "Call counters of one wrapped function", /* tp_doc */
+};
+
+static PyObject* FunctionStats_as_dict(FunctionStats* self) {
+  PyObject* histogram;
+  Py_ssize_t i;
+
+  histogram = PyList_New(STATS_BUCKETS);
+  if (histogram == NULL) {
+    return NULL;
+  }
+  for (i = 0; i < STATS_BUCKETS; i++) {
+    PyObject* count = PyLong_FromUnsignedLongLong(self->histogram[i]);
+
+    if (count == NULL) {
+      Py_DECREF(histogram);
+      return NULL;
+    }
+    PyList_SET_ITEM(histogram, i, count);
+  }
+
+  return Py_BuildValue("{sKsKsKsdsN}", "calls", self->calls, "errors",
+                       self->errors, "total_ns", self->total_ns, "mean_ns",
+                       self->calls ? (double)self->total_ns / self->calls : 0.0,
+                       "histogram", histogram);
+}
+
+/* self of stats() and reset_stats() is the module's list of slots, in
+ * method-table order; modules linked into one shared object each keep
+ * their own */
+static PyObject* module_stats(PyObject* self, PyObject* args) {
+  PyObject* result = PyDict_New();
+  Py_ssize_t i;
+
+  if (result == NULL) {
+    return NULL;
+  }
+
+  for (i = 0; i < PyList_GET_SIZE(self); i++) {
+    FunctionStats* stats = (FunctionStats*)PyList_GET_ITEM(self, i);
+    PyObject* entry = FunctionStats_as_dict(stats);
+    int status;
+
+    if (entry == NULL) {
+      Py_DECREF(result);
+      return NULL;
+    }
+    status = PyDict_SetItemString(result, stats->def.ml_name, entry);
+    Py_DECREF(entry);
+    if (status < 0) {
+      Py_DECREF(result);
+      return NULL;
+    }
+  }
+  return result;
+}
+
+static PyObject* module_reset_stats(PyObject* self, PyObject* args) {
+  Py_ssize_t i;
+
+  for (i = 0; i < PyList_GET_SIZE(self); i++) {
+    FunctionStats* stats = (FunctionStats*)PyList_GET_ITEM(self, i);
+
+    stats->calls = 0;
+    stats->errors = 0;
+    stats->total_ns = 0;
+    memset(stats->histogram, 0, sizeof(stats->histogram));
+  }
+  Py_RETURN_NONE;
+}
+
+/* Replace module.<name> with a wrapper around def */
+static int wrap_function(PyObject* module, PyObject* module_name,
+                         PyObject* slots, PyMethodDef* def) {
+  FunctionStats* stats;
+  PyObject* func;
+
+  stats = PyObject_New(FunctionStats, &FunctionStatsType);
+  if (stats == NULL) {
+    return -1;
+  }
+  stats->meth = def->ml_meth;
+  stats->def = *def;
+  stats->def.ml_meth = (def->ml_flags & METH_KEYWORDS)
+                           ? (PyCFunction)instrumented_call_kw
+                           : instrumented_call;
+  stats->calls = 0;
+  stats->errors = 0;
+  stats->total_ns = 0;
+  memset(stats->histogram, 0, sizeof(stats->histogram));
+
+  if (PyList_Append(slots, (PyObject*)stats) < 0) {
+    Py_DECREF(stats);
+    return -1;
+  }
+
+  /* The function keeps stats, and with it stats->def, alive */
+  func = PyCFunction_NewEx(&stats->def, (PyObject*)stats, module_name);
+  Py_DECREF(stats);
+  if (func == NULL) {
+    return -1;
+  }
+  return PyModule_AddObject(module, def->ml_name, func);
+}
+
+#else /* !PYCAPI_INSTRUMENT */
+
+static PyObject* module_stats(PyObject* self, PyObject* args) {
+  return PyDict_New();
+}
+
+static PyObject* module_reset_stats(PyObject* self, PyObject* args) {
+  Py_RETURN_NONE;
+}
+
+#endif /* PYCAPI_INSTRUMENT */
+
+static PyMethodDef StatsMethods[] = {
+    {"stats", module_stats, METH_NOARGS,
+     "Per-function call statistics.\n\nReturns:\n    dict: Function name to "
+     "{calls, errors, total_ns, mean_ns, histogram}, where histogram[i] "
+     "counts calls of [2**i, 2**(i+1)) ns; empty unless built with "
+     "PYCAPI_INSTRUMENT"},
+
+    {"reset_stats", module_reset_stats, METH_NOARGS,
+     "Zero every counter reported by stats().\n\nReturns:\n    None"},
+
+    {NULL, NULL, 0, NULL}};
+
+int pycapi_instrument_module(PyObject* module, PyMethodDef* methods) {
+  PyObject* module_name;
+  PyObject* slots;
+  PyMethodDef* def;
+  int status = 0;
+
+  module_name = PyString_FromString(PyModule_GetName(module));
+  if (module_name == NULL) {
+    return -1;
+  }
+  slots = PyList_New(0);
+  if (slots == NULL) {
+    Py_DECREF(module_name);
+    return -1;
+  }
+
+#ifdef PYCAPI_INSTRUMENT
+  if (PyType_Ready(&FunctionStatsType) < 0) {
+    Py_DECREF(slots);
+    Py_DECREF(module_name);
+    return -1;
+  }
+  if (!ticks_calibrated) {
+    calibrate_ticks();
+  }
+
+  for (def = methods; def->ml_name != NULL && status == 0; def++) {
+    status = wrap_function(module, module_name, slots, def);
+  }
+#endif
+
+  for (def = StatsMethods; def->ml_name != NULL && status == 0; def++) {
+    PyObject* func = PyCFunction_NewEx(def, slots, module_name);
+
+    status = func == NULL ? -1 : PyModule_AddObject(module, def->ml_name, func);
+  }
+
+  if (status == 0) {
+#ifdef PYCAPI_INSTRUMENT
+    status = PyModule_AddObject(module, "INSTRUMENTED", PyBool_FromLong(1));
+#else
+    status = PyModule_AddObject(module, "INSTRUMENTED", PyBool_FromLong(0));
+#endif
+  }
+
+  Py_DECREF(slots);
+  Py_DECREF(module_name);
+  return status;
+}
@@ -0,0 +1,18 @@
+/*
+ * Python 2.7 C-API Tutorial: Call Instrumentation
+ *
+ * Shared by every tutorial module; see instrument.c.
+ */
+
+#ifndef PYCAPI_INSTRUMENT_H
+#define PYCAPI_INSTRUMENT_H
+
+#include <Python.h>
+
+/* Add stats() and reset_stats() to module. When built with
+ * PYCAPI_INSTRUMENT defined, first replace each function of methods (the
+ * table the module was initialized from) with a counting wrapper.
+ * Returns 0, or -1 with an exception set. */
+int pycapi_instrument_module(PyObject* module, PyMethodDef* methods);
+
+#endif /* PYCAPI_INSTRUMENT_H */
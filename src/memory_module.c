@@ -10,45 +10,417 @@
  */
 
 #include <Python.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <string.h>
+#include <structmember.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "instrument.h"
 
 /* ============================================================================
- * REFERENCE COUNTING DEMONSTRATIONS
+ * ALLOCATION TRACKING
  * ============================================================================
  */
 
-static PyObject* get_refcount(PyObject* self, PyObject* args) {
-  PyObject* obj;
+/* Python 2.7 has no allocator hooks (PyMem_SetAllocator arrived in 3.4), so
+ * the module's own raw allocations go through tracked_malloc/tracked_free.
+ * Every block carries a small header with its size, call site and the epoch
+ * of the tracker that was active when it was allocated. The innermost
+ * active AllocationTracker counts allocations and frees per site; a free
+ * only counts when that tracker also saw the allocation.
+ *
+ * Object leaks are found through refcounts instead. A watched object's
+ * refcount is recorded as its baseline, and report() lists the objects
+ * whose refcount is still above it. incref_demo and borrowed_ref_demo watch
+ * the objects they touch while a tracker is active. */
+
+typedef enum {
+  SITE_ALLOCATE_BUFFER,
+  SITE_COPY_STRING,
+  SITE_PROPER_CLEANUP,
+  SITE_ARENA,
+  SITE_COUNT
+} AllocSite;
+
+static const char* const site_names[SITE_COUNT] = {
+    "allocate_buffer", "copy_string", "proper_cleanup", "Arena"};
+
+typedef struct {
+  Py_ssize_t allocations;
+  Py_ssize_t frees;
+  size_t bytes_allocated;
+  size_t bytes_freed;
+} SiteCounters;
+
+/* Prefix of every tracked block; the union keeps the payload aligned */
+typedef union {
+  struct {
+    size_t size;
+    unsigned int epoch; /* 0 when no tracker was active */
+    int site;
+  } info;
+  double align[2];
+} BlockHeader;
+
+typedef struct AllocationTracker {
+  PyObject_HEAD struct AllocationTracker* previous; /* enclosing tracker */
+  PyObject* watched; /* id(obj) -> (obj, baseline, site) */
+  SiteCounters sites[SITE_COUNT];
+  unsigned int epoch;
+  int active;
+} AllocationTracker;
+
+static PyTypeObject AllocationTrackerType;
+
+/* Innermost active tracker; holds a reference while set */
+static AllocationTracker* active_tracker = NULL;
+static unsigned int last_epoch = 0;
+
+static void* tracked_malloc(AllocSite site, size_t size) {
+  BlockHeader* header;
+
+  if (size > PY_SSIZE_T_MAX - sizeof(BlockHeader)) {
+    return NULL;
+  }
 
-  if (!PyArg_ParseTuple(args, "O", &obj)) {
+  header = (BlockHeader*)PyMem_Malloc(sizeof(BlockHeader) + size);
+  if (header == NULL) {
     return NULL;
   }
 
-  return PyInt_FromSsize_t(obj->ob_refcnt);
+  header->info.size = size;
+  header->info.site = site;
+  header->info.epoch = 0;
+  if (active_tracker != NULL) {
+    SiteCounters* counters = &active_tracker->sites[site];
+
+    header->info.epoch = active_tracker->epoch;
+    counters->allocations++;
+    counters->bytes_allocated += size;
+  }
+  return header + 1;
+}
+
+static void tracked_free(void* ptr) {
+  BlockHeader* header;
+
+  if (ptr == NULL) {
+    return;
+  }
+
+  header = (BlockHeader*)ptr - 1;
+  if (active_tracker != NULL && header->info.epoch != 0 &&
+      header->info.epoch == active_tracker->epoch) {
+    SiteCounters* counters = &active_tracker->sites[header->info.site];
+
+    counters->frees++;
+    counters->bytes_freed += header->info.size;
+  }
+  PyMem_Free(header);
+}
+
+/* Watch obj under the active tracker, if any. held_refs is the number of
+ * references the caller holds only for the duration of the current call
+ * (1 for a function argument), which are left out of the baseline. */
+static int track_object(PyObject* obj, const char* site, Py_ssize_t held_refs) {
+  PyObject* key;
+  PyObject* entry;
+  int status = 0;
+
+  if (active_tracker == NULL) {
+    return 0;
+  }
+
+  key = PyLong_FromVoidPtr(obj);
+  if (key == NULL) {
+    return -1;
+  }
+
+  if (PyDict_GetItem(active_tracker->watched, key) == NULL) {
+    entry = Py_BuildValue("(Ons)", obj, Py_REFCNT(obj) - held_refs, site);
+    status = entry == NULL
+                 ? -1
+                 : PyDict_SetItem(active_tracker->watched, key, entry);
+    Py_XDECREF(entry);
+  }
+  Py_DECREF(key);
+  return status;
+}
+
+/* References to obj held by the active tracker's watch list (0 or 1) */
+static Py_ssize_t tracker_refs(PyObject* obj) {
+  PyObject* key;
+  Py_ssize_t refs = 0;
+
+  if (active_tracker == NULL) {
+    return 0;
+  }
+
+  key = PyLong_FromVoidPtr(obj);
+  if (key == NULL) {
+    PyErr_Clear();
+    return 0;
+  }
+  refs = PyDict_GetItem(active_tracker->watched, key) != NULL;
+  Py_DECREF(key);
+  return refs;
+}
+
+static PyObject* AllocationTracker_new(PyTypeObject* type, PyObject* args,
+                                       PyObject* kwargs) {
+  AllocationTracker* self;
+  static char* kwlist[] = {NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, ":AllocationTracker",
+                                   kwlist)) {
+    return NULL;
+  }
+
+  self = (AllocationTracker*)type->tp_alloc(type, 0);
+  if (self == NULL) {
+    return NULL;
+  }
+
+  self->watched = PyDict_New();
+  if (self->watched == NULL) {
+    Py_DECREF(self);
+    return NULL;
+  }
+  return (PyObject*)self;
+}
+
+static int AllocationTracker_traverse(AllocationTracker* self,
+                                      visitproc visit, void* arg) {
+  Py_VISIT(self->watched);
+  return 0;
+}
+
+static int AllocationTracker_clear(AllocationTracker* self) {
+  Py_CLEAR(self->watched);
+  return 0;
+}
+
+static void AllocationTracker_dealloc(AllocationTracker* self) {
+  PyObject_GC_UnTrack(self);
+  AllocationTracker_clear(self);
+  Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyObject* AllocationTracker_enter(AllocationTracker* self) {
+  if (self->active) {
+    PyErr_SetString(PyExc_RuntimeError, "tracker is already active");
+    return NULL;
+  }
+
+  /* Each activation gets a fresh epoch, so counts start from zero */
+  memset(self->sites, 0, sizeof(self->sites));
+  if (++last_epoch == 0) {
+    last_epoch = 1;
+  }
+  self->epoch = last_epoch;
+  self->active = 1;
+
+  Py_INCREF(self);
+  self->previous = active_tracker;
+  active_tracker = self;
+
+  Py_INCREF(self);
+  return (PyObject*)self;
+}
+
+static PyObject* AllocationTracker_exit(AllocationTracker* self,
+                                        PyObject* args) {
+  if (active_tracker != self) {
+    PyErr_SetString(PyExc_RuntimeError,
+                    "trackers must exit in reverse order of entry");
+    return NULL;
+  }
+
+  active_tracker = self->previous;
+  self->previous = NULL;
+  self->active = 0;
+  Py_DECREF(self); /* reference held while active */
+  Py_RETURN_FALSE;
+}
+
+static PyObject* AllocationTracker_watch(AllocationTracker* self,
+                                         PyObject* obj) {
+  AllocationTracker* saved = active_tracker;
+  int status;
+
+  /* Watch under this tracker even when it is not the active one */
+  active_tracker = self;
+  status = track_object(obj, "watch", 1);
+  active_tracker = saved;
+
+  if (status < 0) {
+    return NULL;
+  }
+  Py_INCREF(obj);
+  return obj;
+}
+
+static PyObject* AllocationTracker_report(AllocationTracker* self) {
+  PyObject* sites = NULL;
+  PyObject* leaks = NULL;
+  PyObject* entry;
+  PyObject* key;
+  Py_ssize_t pos = 0;
+  int i;
+
+  sites = PyDict_New();
+  leaks = PyList_New(0);
+  if (sites == NULL || leaks == NULL) {
+    goto error;
+  }
+
+  for (i = 0; i < SITE_COUNT; i++) {
+    SiteCounters* c = &self->sites[i];
+    int status;
+
+    if (c->allocations == 0 && c->frees == 0) {
+      continue;
+    }
+    entry = Py_BuildValue(
+        "{s:n,s:n,s:n,s:n,s:n}", "allocations", c->allocations, "frees",
+        c->frees, "bytes_allocated", (Py_ssize_t)c->bytes_allocated,
+        "bytes_freed", (Py_ssize_t)c->bytes_freed, "outstanding_bytes",
+        (Py_ssize_t)(c->bytes_allocated - c->bytes_freed));
+    if (entry == NULL) {
+      goto error;
+    }
+    status = PyDict_SetItemString(sites, site_names[i], entry);
+    Py_DECREF(entry);
+    if (status < 0) {
+      goto error;
+    }
+  }
+
+  while (PyDict_Next(self->watched, &pos, &key, &entry)) {
+    PyObject* obj = PyTuple_GET_ITEM(entry, 0);
+    Py_ssize_t baseline = PyInt_AsSsize_t(PyTuple_GET_ITEM(entry, 1));
+    Py_ssize_t refcount = Py_REFCNT(obj) - 1; /* minus the watch entry */
+    PyObject* leak;
+    int status;
+
+    if (refcount <= baseline) {
+      continue;
+    }
+    leak = Py_BuildValue("{s:O,s:O,s:n,s:n}", "object", obj, "site",
+                         PyTuple_GET_ITEM(entry, 2), "baseline", baseline,
+                         "refcount", refcount);
+    if (leak == NULL) {
+      goto error;
+    }
+    status = PyList_Append(leaks, leak);
+    Py_DECREF(leak);
+    if (status < 0) {
+      goto error;
+    }
+  }
+
+  return Py_BuildValue("{s:N,s:N}", "sites", sites, "leaks", leaks);
+
+error:
+  Py_XDECREF(sites);
+  Py_XDECREF(leaks);
+  return NULL;
 }
 
-static PyObject* incref_demo(PyObject* self, PyObject* args) {
-  PyObject* obj;
+static PyMethodDef AllocationTracker_methods[] = {
+    {"watch", (PyCFunction)AllocationTracker_watch, METH_O,
+     "Record obj's current refcount as its baseline.\n\nArgs:\n    obj: "
+     "Object to watch\n\nReturns:\n    obj"},
+    {"report", (PyCFunction)AllocationTracker_report, METH_NOARGS,
+     "Summarize what the tracker saw.\n\nReturns:\n    dict: 'sites' maps "
+     "each call site to allocation and free counts and bytes; 'leaks' "
+     "lists watched objects whose refcount is above its baseline"},
+    {"__enter__", (PyCFunction)AllocationTracker_enter, METH_NOARGS,
+     "Start tracking; counters restart from zero."},
+    {"__exit__", (PyCFunction)AllocationTracker_exit, METH_VARARGS,
+     "Stop tracking; report() stays available."},
+    {NULL, NULL, 0, NULL}};
+
+static PyMemberDef AllocationTracker_members[] = {
+    {"active", T_INT, offsetof(AllocationTracker, active), READONLY,
+     "Whether the tracker is inside its with-block"},
+    {NULL}};
+
+static PyTypeObject AllocationTrackerType = {
+    PyObject_HEAD_INIT(NULL) 0,                          /* ob_size */
+    "memory_module.AllocationTracker",                   /* tp_name */
+    sizeof(AllocationTracker),                           /* tp_basicsize */
+    0,                                                   /* tp_itemsize */
+    (destructor)AllocationTracker_dealloc,               /* tp_dealloc */
+    0,                                                   /* tp_print */
+    0,                                                   /* tp_getattr */
+    0,                                                   /* tp_setattr */
+    0,                                                   /* tp_compare */
+    0,                                                   /* tp_repr */
+    0,                                                   /* tp_as_number */
+    0,                                                   /* tp_as_sequence */
+    0,                                                   /* tp_as_mapping */
+    0,                                                   /* tp_hash */
+    0,                                                   /* tp_call */
+    0,                                                   /* tp_str */
+    0,                                                   /* tp_getattro */
+    0,                                                   /* tp_setattro */
+    0,                                                   /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,             /* tp_flags */
+    "Context manager counting allocations per call site", /* tp_doc */
+    (traverseproc)AllocationTracker_traverse,            /* tp_traverse */
+    (inquiry)AllocationTracker_clear,                    /* tp_clear */
+    0,                                                   /* tp_richcompare */
+    0,                                                   /* tp_weaklistoffset */
+    0,                                                   /* tp_iter */
+    0,                                                   /* tp_iternext */
+    AllocationTracker_methods,                           /* tp_methods */
+    AllocationTracker_members,                           /* tp_members */
+    0,                                                   /* tp_getset */
+    0,                                                   /* tp_base */
+    0,                                                   /* tp_dict */
+    0,                                                   /* tp_descr_get */
+    0,                                                   /* tp_descr_set */
+    0,                                                   /* tp_dictoffset */
+    0,                                                   /* tp_init */
+    0,                                                   /* tp_alloc */
+    AllocationTracker_new,                               /* tp_new */
+};
+
+/* ============================================================================
+ * REFERENCE COUNTING DEMONSTRATIONS
+ * ============================================================================
+ */
+
+static PyObject* get_refcount(PyObject* self, PyObject* obj) {
+  /* An active tracker's watch list does not count */
+  return PyInt_FromSsize_t(obj->ob_refcnt - tracker_refs(obj));
+}
+
+static PyObject* incref_demo(PyObject* self, PyObject* obj) {
   Py_ssize_t before, after;
 
-  if (!PyArg_ParseTuple(args, "O", &obj)) {
+  if (track_object(obj, "incref_demo", 1) < 0) {
     return NULL;
   }
 
-  before = obj->ob_refcnt;
+  before = obj->ob_refcnt - tracker_refs(obj);
   Py_INCREF(obj);
-  after = obj->ob_refcnt;
+  after = obj->ob_refcnt - tracker_refs(obj);
   Py_DECREF(obj); /* Restore original count */
 
   return Py_BuildValue("(nn)", before, after);
 }
 
-static PyObject* create_temp_list(PyObject* self, PyObject* args) {
+static PyObject* create_temp_list(PyObject* self, PyObject* arg) {
   int size, i;
   PyObject* list;
   PyObject* result;
 
-  if (!PyArg_ParseTuple(args, "i", &size)) {
+  if (!PyArg_Parse(arg, "i:create_temp_list", &size)) {
     return NULL;
   }
 
@@ -72,47 +444,807 @@ static PyObject* create_temp_list(PyObject* self, PyObject* args) {
   return result;
 }
 
+/* ============================================================================
+ * ARENA ALLOCATION
+ * ============================================================================
+ */
+
+/* An Arena hands out scratch memory by bumping a pointer through large
+ * slabs and releases everything at once on reset(), so short-lived buffers
+ * never reach PyMem_Free individually. Memory from an arena must not
+ * outlive the next reset(); the demos below only use it as scratch space
+ * that is copied into a Python object before returning. */
+
+#define ARENA_DEFAULT_SLAB_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT 16
+
+typedef struct ArenaSlab {
+  struct ArenaSlab* next;
+  size_t size;
+  size_t used;
+  /* Keeps data[] aligned for any type the buffers are used for */
+  union {
+    double d;
+    void* p;
+    PY_LONG_LONG ll;
+  } align;
+  char data[1];
+} ArenaSlab;
+
+typedef struct {
+  PyObject_HEAD ArenaSlab* slabs; /* head is the slab being filled */
+  size_t slab_size;
+  size_t reserved;   /* bytes obtained from PyMem_Malloc */
+  size_t in_use;     /* bytes handed out since the last reset */
+  size_t high_water; /* largest in_use ever observed */
+  Py_ssize_t allocations;
+} Arena;
+
+static PyTypeObject ArenaType;
+
+static ArenaSlab* arena_new_slab(Arena* arena, size_t min_size) {
+  size_t size = min_size > arena->slab_size ? min_size : arena->slab_size;
+  ArenaSlab* slab;
+
+  if (size > PY_SSIZE_T_MAX - sizeof(ArenaSlab)) {
+    return NULL;
+  }
+
+  slab = (ArenaSlab*)tracked_malloc(SITE_ARENA, sizeof(ArenaSlab) + size);
+  if (slab == NULL) {
+    return NULL;
+  }
+
+  slab->size = size;
+  slab->used = 0;
+  arena->reserved += size;
+  return slab;
+}
+
+/* Return `size` bytes from the arena, or NULL with MemoryError set */
+static char* arena_alloc(Arena* arena, size_t size) {
+  ArenaSlab* slab = arena->slabs;
+  size_t rounded;
+  char* ptr;
+
+  if (size > PY_SSIZE_T_MAX - ARENA_ALIGNMENT) {
+    PyErr_NoMemory();
+    return NULL;
+  }
+  rounded = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+  if (slab == NULL || slab->size - slab->used < rounded) {
+    ArenaSlab* fresh = arena_new_slab(arena, rounded);
+    if (fresh == NULL) {
+      PyErr_NoMemory();
+      return NULL;
+    }
+
+    if (slab != NULL && rounded > arena->slab_size) {
+      /* Oversized request: keep filling the current slab afterwards */
+      fresh->next = slab->next;
+      slab->next = fresh;
+    } else {
+      fresh->next = slab;
+      arena->slabs = fresh;
+    }
+    slab = fresh;
+  }
+
+  ptr = slab->data + slab->used;
+  slab->used += rounded;
+
+  arena->in_use += rounded;
+  if (arena->in_use > arena->high_water) {
+    arena->high_water = arena->in_use;
+  }
+  arena->allocations++;
+  return ptr;
+}
+
+/* Free every slab except the newest, which is kept for the next cycle */
+static void arena_reset(Arena* arena) {
+  ArenaSlab* keep = arena->slabs;
+  ArenaSlab* slab;
+
+  if (keep == NULL) {
+    arena->in_use = 0;
+    return;
+  }
+
+  slab = keep->next;
+  while (slab != NULL) {
+    ArenaSlab* next = slab->next;
+    arena->reserved -= slab->size;
+    tracked_free(slab);
+    slab = next;
+  }
+
+  keep->next = NULL;
+  keep->used = 0;
+  arena->in_use = 0;
+}
+
+static PyObject* Arena_new(PyTypeObject* type, PyObject* args,
+                           PyObject* kwargs) {
+  Py_ssize_t slab_size = ARENA_DEFAULT_SLAB_SIZE;
+  static char* kwlist[] = {"slab_size", NULL};
+  Arena* self;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|n", kwlist, &slab_size)) {
+    return NULL;
+  }
+
+  if (slab_size <= 0) {
+    PyErr_SetString(PyExc_ValueError, "slab_size must be positive");
+    return NULL;
+  }
+
+  self = (Arena*)type->tp_alloc(type, 0);
+  if (self == NULL) {
+    return NULL;
+  }
+
+  self->slab_size = (size_t)slab_size;
+  return (PyObject*)self;
+}
+
+static void Arena_dealloc(Arena* self) {
+  ArenaSlab* slab = self->slabs;
+
+  while (slab != NULL) {
+    ArenaSlab* next = slab->next;
+    tracked_free(slab);
+    slab = next;
+  }
+
+  Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyObject* Arena_reset(Arena* self) {
+  arena_reset(self);
+  Py_RETURN_NONE;
+}
+
+static PyObject* Arena_stats(Arena* self) {
+  Py_ssize_t slabs = 0;
+  ArenaSlab* slab;
+
+  for (slab = self->slabs; slab != NULL; slab = slab->next) {
+    slabs++;
+  }
+
+  return Py_BuildValue("{s:n,s:n,s:n,s:n,s:n}", "reserved",
+                       (Py_ssize_t)self->reserved, "in_use",
+                       (Py_ssize_t)self->in_use, "high_water",
+                       (Py_ssize_t)self->high_water, "slabs", slabs,
+                       "allocations", self->allocations);
+}
+
+static PyObject* Arena_enter(PyObject* self) {
+  Py_INCREF(self);
+  return self;
+}
+
+static PyObject* Arena_exit(Arena* self, PyObject* args) {
+  arena_reset(self);
+  Py_RETURN_FALSE;
+}
+
+static PyMethodDef Arena_methods[] = {
+    {"reset", (PyCFunction)Arena_reset, METH_NOARGS,
+     "Release every allocation at once, keeping one slab for reuse."},
+    {"stats", (PyCFunction)Arena_stats, METH_NOARGS,
+     "Get allocator statistics.\n\nReturns:\n    dict: reserved, in_use and "
+     "high_water bytes, slab count and allocation count"},
+    {"__enter__", (PyCFunction)Arena_enter, METH_NOARGS,
+     "Use the arena as a context manager."},
+    {"__exit__", (PyCFunction)Arena_exit, METH_VARARGS,
+     "Reset the arena when the with-block ends."},
+    {NULL, NULL, 0, NULL}};
+
+static PyTypeObject ArenaType = {
+    PyObject_HEAD_INIT(NULL) 0,           /* ob_size */
+    "memory_module.Arena",                /* tp_name */
+    sizeof(Arena),                        /* tp_basicsize */
+    0,                                    /* tp_itemsize */
+    (destructor)Arena_dealloc,            /* tp_dealloc */
+    0,                                    /* tp_print */
+    0,                                    /* tp_getattr */
+    0,                                    /* tp_setattr */
+    0,                                    /* tp_compare */
+    0,                                    /* tp_repr */
+    0,                                    /* tp_as_number */
+    0,                                    /* tp_as_sequence */
+    0,                                    /* tp_as_mapping */
+    0,                                    /* tp_hash */
+    0,                                    /* tp_call */
+    0,                                    /* tp_str */
+    0,                                    /* tp_getattro */
+    0,                                    /* tp_setattro */
+    0,                                    /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                   /* tp_flags */
+    "Bump allocator for scratch buffers", /* tp_doc */
+    0,                                    /* tp_traverse */
+    0,                                    /* tp_clear */
+    0,                                    /* tp_richcompare */
+    0,                                    /* tp_weaklistoffset */
+    0,                                    /* tp_iter */
+    0,                                    /* tp_iternext */
+    Arena_methods,                        /* tp_methods */
+    0,                                    /* tp_members */
+    0,                                    /* tp_getset */
+    0,                                    /* tp_base */
+    0,                                    /* tp_dict */
+    0,                                    /* tp_descr_get */
+    0,                                    /* tp_descr_set */
+    0,                                    /* tp_dictoffset */
+    0,                                    /* tp_init */
+    0,                                    /* tp_alloc */
+    Arena_new,                            /* tp_new */
+};
+
+/* Parse the optional arena= argument: None means "use PyMem_Malloc" */
+static int parse_arena(PyObject* obj, Arena** arena) {
+  if (obj == NULL || obj == Py_None) {
+    *arena = NULL;
+    return 1;
+  }
+
+  if (!PyObject_TypeCheck(obj, &ArenaType)) {
+    PyErr_Format(PyExc_TypeError, "arena must be an Arena or None, not %.200s",
+                 Py_TYPE(obj)->tp_name);
+    return 0;
+  }
+
+  *arena = (Arena*)obj;
+  return 1;
+}
+
+/* ============================================================================
+ * SHARED MEMORY
+ * ============================================================================
+ */
+
+/* A SharedBuffer is a POSIX shared memory object mapped into this process.
+ * The mapping starts with a SharedHeader holding the data size and the
+ * number of handles, in any process, that still map it; the data follows at
+ * SHARED_DATA_OFFSET. Pickling a handle only records the name: unpickling
+ * maps the same region in the receiving process and bumps the count, and
+ * the last handle to close unlinks the name. The sender has to keep its
+ * handle open until the receiver has attached, or the region is already
+ * gone. A fork()ed child's copy of a handle was never counted, so closing
+ * it only unmaps the child's view. */
+
+#define SHARED_MAGIC 0x5079434150495348LL /* "PyCAPISH" */
+#define SHARED_DATA_OFFSET 64             /* one cache line for the header */
+#define SHARED_NAME_ATTEMPTS 100
+
+typedef struct {
+  PY_LONG_LONG magic;
+  Py_ssize_t size;
+  long refs; /* updated with atomic builtins, shared across processes */
+} SharedHeader;
+
+typedef struct {
+  PyObject_HEAD char* base; /* start of the mapping, NULL once closed */
+  Py_ssize_t size;          /* data bytes after the header */
+  Py_ssize_t exports;       /* new-style buffer views still open */
+  PyObject* name;
+  pid_t owner; /* the process this handle was counted for */
+} SharedBuffer;
+
+static PyTypeObject SharedBufferType;
+
+/* Counts names generated by this process, so pid + counter is unique */
+static unsigned long shared_name_counter = 0;
+
+#define SHARED_HEADER(self) ((SharedHeader*)(self)->base)
+#define SHARED_DATA(self) ((self)->base + SHARED_DATA_OFFSET)
+
+static SharedBuffer* shared_wrap(PyTypeObject* type, char* base,
+                                 Py_ssize_t size, PyObject* name) {
+  SharedBuffer* self = (SharedBuffer*)type->tp_alloc(type, 0);
+  if (self == NULL) {
+    return NULL;
+  }
+
+  self->base = base;
+  self->size = size;
+  Py_INCREF(name);
+  self->name = name;
+  self->owner = getpid();
+  return self;
+}
+
+/* Drop this handle's mapping; the last handle anywhere unlinks the name */
+static void shared_release(SharedBuffer* self) {
+  if (self->base == NULL) {
+    return;
+  }
+
+  if (self->owner == getpid() &&
+      __sync_sub_and_fetch(&SHARED_HEADER(self)->refs, 1) == 0) {
+    shm_unlink(PyString_AS_STRING(self->name));
+  }
+  munmap(self->base, SHARED_DATA_OFFSET + self->size);
+  self->base = NULL;
+}
+
+static int shared_check_open(SharedBuffer* self) {
+  if (self->base == NULL) {
+    PyErr_SetString(PyExc_ValueError, "shared buffer is closed");
+    return -1;
+  }
+  return 0;
+}
+
+/* Create and size a new shared memory object; returns its descriptor, or
+ * -1 with OSError set. Without a name one is generated from the pid. */
+static int shared_create(PyObject* name_obj, Py_ssize_t total,
+                         PyObject** name) {
+  int attempt;
+  int fd = -1;
+
+  for (attempt = 0; attempt < SHARED_NAME_ATTEMPTS; attempt++) {
+    if (name_obj != NULL) {
+      Py_INCREF(name_obj);
+      *name = name_obj;
+    } else {
+      *name = PyString_FromFormat("/pycapi-%ld-%lu", (long)getpid(),
+                                  shared_name_counter++);
+      if (*name == NULL) {
+        return -1;
+      }
+    }
+
+    fd = shm_open(PyString_AS_STRING(*name), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0 || errno != EEXIST || name_obj != NULL) {
+      break;
+    }
+    Py_CLEAR(*name); /* a stale region from a reused pid: try the next */
+  }
+
+  if (fd < 0) {
+    if (*name != NULL) {
+      PyErr_SetFromErrnoWithFilename(PyExc_OSError, PyString_AS_STRING(*name));
+      Py_CLEAR(*name);
+    } else if (!PyErr_Occurred()) {
+      errno = EEXIST;
+      PyErr_SetFromErrno(PyExc_OSError);
+    }
+    return -1;
+  }
+
+  if (ftruncate(fd, (off_t)total) < 0) {
+    PyErr_SetFromErrnoWithFilename(PyExc_OSError, PyString_AS_STRING(*name));
+    close(fd);
+    shm_unlink(PyString_AS_STRING(*name));
+    Py_CLEAR(*name);
+    return -1;
+  }
+  return fd;
+}
+
+static PyObject* SharedBuffer_new(PyTypeObject* type, PyObject* args,
+                                  PyObject* kwargs) {
+  Py_ssize_t size;
+  PyObject* name_obj = NULL;
+  static char* kwlist[] = {"size", "name", NULL};
+  PyObject* name;
+  SharedHeader* header;
+  SharedBuffer* self;
+  void* base;
+  int fd;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "n|S", kwlist, &size,
+                                   &name_obj)) {
+    return NULL;
+  }
+
+  if (size < 0 || size > PY_SSIZE_T_MAX - SHARED_DATA_OFFSET) {
+    PyErr_SetString(PyExc_ValueError, "size must be non-negative");
+    return NULL;
+  }
+
+  fd = shared_create(name_obj, SHARED_DATA_OFFSET + size, &name);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  base = mmap(NULL, SHARED_DATA_OFFSET + size, PROT_READ | PROT_WRITE,
+              MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    PyErr_SetFromErrnoWithFilename(PyExc_OSError, PyString_AS_STRING(name));
+    shm_unlink(PyString_AS_STRING(name));
+    Py_DECREF(name);
+    return NULL;
+  }
+
+  header = (SharedHeader*)base;
+  header->magic = SHARED_MAGIC;
+  header->size = size;
+  header->refs = 1;
+
+  self = shared_wrap(type, (char*)base, size, name);
+  if (self == NULL) {
+    munmap(base, SHARED_DATA_OFFSET + size);
+    shm_unlink(PyString_AS_STRING(name));
+  }
+  Py_DECREF(name);
+  return (PyObject*)self;
+}
+
+static PyObject* attach_shared(PyObject* module, PyObject* name) {
+  const char* path;
+  struct stat info;
+  SharedHeader* header;
+  SharedBuffer* self;
+  Py_ssize_t size;
+  void* base;
+  int fd;
+
+  if (!PyString_Check(name)) {
+    PyErr_Format(PyExc_TypeError, "name must be a str, not %.200s",
+                 Py_TYPE(name)->tp_name);
+    return NULL;
+  }
+  path = PyString_AS_STRING(name);
+
+  fd = shm_open(path, O_RDWR, 0);
+  if (fd < 0) {
+    return PyErr_SetFromErrnoWithFilename(PyExc_OSError, (char*)path);
+  }
+
+  if (fstat(fd, &info) < 0) {
+    PyErr_SetFromErrnoWithFilename(PyExc_OSError, (char*)path);
+    close(fd);
+    return NULL;
+  }
+  if (info.st_size < SHARED_DATA_OFFSET) {
+    close(fd);
+    PyErr_Format(PyExc_ValueError, "%s is not a shared buffer", path);
+    return NULL;
+  }
+
+  base = mmap(NULL, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+              fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    return PyErr_SetFromErrnoWithFilename(PyExc_OSError, (char*)path);
+  }
+
+  header = (SharedHeader*)base;
+  size = header->size;
+  if (header->magic != SHARED_MAGIC || size < 0 ||
+      size != (Py_ssize_t)info.st_size - SHARED_DATA_OFFSET) {
+    munmap(base, (size_t)info.st_size);
+    PyErr_Format(PyExc_ValueError, "%s is not a shared buffer", path);
+    return NULL;
+  }
+
+  /* A count that already reached zero means the last handle is unlinking
+   * the region: it must not be revived */
+  if (__sync_fetch_and_add(&header->refs, 1) <= 0) {
+    __sync_sub_and_fetch(&header->refs, 1);
+    munmap(base, (size_t)info.st_size);
+    errno = ENOENT;
+    return PyErr_SetFromErrnoWithFilename(PyExc_OSError, (char*)path);
+  }
+
+  self = shared_wrap(&SharedBufferType, (char*)base, size, name);
+  if (self == NULL) {
+    __sync_sub_and_fetch(&header->refs, 1);
+    munmap(base, (size_t)info.st_size);
+  }
+  return (PyObject*)self;
+}
+
+static void SharedBuffer_dealloc(SharedBuffer* self) {
+  shared_release(self);
+  Py_XDECREF(self->name);
+  Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyObject* SharedBuffer_close(SharedBuffer* self) {
+  if (self->exports > 0) {
+    PyErr_SetString(PyExc_BufferError,
+                    "cannot close a shared buffer with exported views");
+    return NULL;
+  }
+  shared_release(self);
+  Py_RETURN_NONE;
+}
+
+static PyObject* SharedBuffer_reduce(SharedBuffer* self) {
+  PyObject* module;
+  PyObject* attach;
+
+  if (shared_check_open(self) < 0) {
+    return NULL;
+  }
+
+  module = PyImport_ImportModule("memory_module");
+  if (module == NULL) {
+    return NULL;
+  }
+  attach = PyObject_GetAttrString(module, "attach_shared");
+  Py_DECREF(module);
+  if (attach == NULL) {
+    return NULL;
+  }
+
+  return Py_BuildValue("(N(O))", attach, self->name);
+}
+
+static PyObject* SharedBuffer_enter(PyObject* self) {
+  Py_INCREF(self);
+  return self;
+}
+
+static PyObject* SharedBuffer_exit(SharedBuffer* self, PyObject* args) {
+  PyObject* result = SharedBuffer_close(self);
+  if (result == NULL) {
+    return NULL;
+  }
+  Py_DECREF(result);
+  Py_RETURN_FALSE;
+}
+
+static PyObject* SharedBuffer_get_refs(SharedBuffer* self, void* closure) {
+  if (shared_check_open(self) < 0) {
+    return NULL;
+  }
+  return PyInt_FromLong(__sync_fetch_and_add(&SHARED_HEADER(self)->refs, 0));
+}
+
+static PyObject* SharedBuffer_get_closed(SharedBuffer* self, void* closure) {
+  return PyBool_FromLong(self->base == NULL);
+}
+
+static PyObject* SharedBuffer_repr(SharedBuffer* self) {
+  return PyString_FromFormat("<SharedBuffer %s size=%zd%s>",
+                             PyString_AS_STRING(self->name), self->size,
+                             self->base == NULL ? " closed" : "");
+}
+
+static Py_ssize_t SharedBuffer_length(SharedBuffer* self) {
+  return self->size;
+}
+
+static int SharedBuffer_getbuffer(SharedBuffer* self, Py_buffer* view,
+                                  int flags) {
+  if (shared_check_open(self) < 0) {
+    return -1;
+  }
+  if (PyBuffer_FillInfo(view, (PyObject*)self, SHARED_DATA(self), self->size,
+                        0, flags) < 0) {
+    return -1;
+  }
+  self->exports++;
+  return 0;
+}
+
+static void SharedBuffer_releasebuffer(SharedBuffer* self, Py_buffer* view) {
+  self->exports--;
+}
+
+static PyMethodDef SharedBuffer_methods[] = {
+    {"close", (PyCFunction)SharedBuffer_close, METH_NOARGS,
+     "Unmap this handle; the last handle in any process unlinks the "
+     "name.\n\nRaises:\n    BufferError: If memoryviews of the buffer are "
+     "still open"},
+    {"__reduce__", (PyCFunction)SharedBuffer_reduce, METH_NOARGS,
+     "Pickle as attach_shared(name)."},
+    {"__enter__", (PyCFunction)SharedBuffer_enter, METH_NOARGS,
+     "Use the buffer as a context manager."},
+    {"__exit__", (PyCFunction)SharedBuffer_exit, METH_VARARGS,
+     "Close the handle when the with-block ends."},
+    {NULL, NULL, 0, NULL}};
+
+static PyMemberDef SharedBuffer_members[] = {
+    {"name", T_OBJECT, offsetof(SharedBuffer, name), READONLY,
+     "Shared memory object name, as passed to shm_open"},
+    {"size", T_PYSSIZET, offsetof(SharedBuffer, size), READONLY,
+     "Data size in bytes"},
+    {NULL}};
+
+static PyGetSetDef SharedBuffer_getset[] = {
+    {"refs", (getter)SharedBuffer_get_refs, NULL,
+     "Handles mapping the region across all processes", NULL},
+    {"closed", (getter)SharedBuffer_get_closed, NULL,
+     "Whether this handle has been closed", NULL},
+    {NULL}};
+
+static PySequenceMethods SharedBuffer_as_sequence = {
+    (lenfunc)SharedBuffer_length, /* sq_length */
+};
+
+static PyBufferProcs SharedBuffer_as_buffer = {
+    0,                                             /* bf_getreadbuffer */
+    0,                                             /* bf_getwritebuffer */
+    0,                                             /* bf_getsegcount */
+    0,                                             /* bf_getcharbuffer */
+    (getbufferproc)SharedBuffer_getbuffer,         /* bf_getbuffer */
+    (releasebufferproc)SharedBuffer_releasebuffer, /* bf_releasebuffer */
+};
+
+static PyTypeObject SharedBufferType = {
+    PyObject_HEAD_INIT(NULL) 0,                     /* ob_size */
+    "memory_module.SharedBuffer",                   /* tp_name */
+    sizeof(SharedBuffer),                           /* tp_basicsize */
+    0,                                              /* tp_itemsize */
+    (destructor)SharedBuffer_dealloc,               /* tp_dealloc */
+    0,                                              /* tp_print */
+    0,                                              /* tp_getattr */
+    0,                                              /* tp_setattr */
+    0,                                              /* tp_compare */
+    (reprfunc)SharedBuffer_repr,                    /* tp_repr */
+    0,                                              /* tp_as_number */
+    &SharedBuffer_as_sequence,                      /* tp_as_sequence */
+    0,                                              /* tp_as_mapping */
+    0,                                              /* tp_hash */
+    0,                                              /* tp_call */
+    0,                                              /* tp_str */
+    0,                                              /* tp_getattro */
+    0,                                              /* tp_setattro */
+    &SharedBuffer_as_buffer,                        /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_NEWBUFFER, /* tp_flags */
+    "Writable buffer in named POSIX shared memory", /* tp_doc */
+    0,                                              /* tp_traverse */
+    0,                                              /* tp_clear */
+    0,                                              /* tp_richcompare */
+    0,                                              /* tp_weaklistoffset */
+    0,                                              /* tp_iter */
+    0,                                              /* tp_iternext */
+    SharedBuffer_methods,                           /* tp_methods */
+    SharedBuffer_members,                           /* tp_members */
+    SharedBuffer_getset,                            /* tp_getset */
+    0,                                              /* tp_base */
+    0,                                              /* tp_dict */
+    0,                                              /* tp_descr_get */
+    0,                                              /* tp_descr_set */
+    0,                                              /* tp_dictoffset */
+    0,                                              /* tp_init */
+    0,                                              /* tp_alloc */
+    SharedBuffer_new,                               /* tp_new */
+};
+
 /* ============================================================================
  * MEMORY ALLOCATION
  * ============================================================================
  */
 
-static PyObject* allocate_buffer(PyObject* self, PyObject* args) {
-  int size;
+#define ALPHABET_LENGTH 26
+/* Largest block copied at once: a whole number of alphabet periods that
+ * stays resident in L1/L2 while it is replicated */
+#define ALPHABET_BLOCK (ALPHABET_LENGTH * 1024)
+
+/* Write the repeating A-Z pattern into buffer[0:size].
+ *
+ * Only the first period is written byte by byte. The filled prefix is then
+ * copied onto the rest of the buffer with memcpy, doubling until it reaches
+ * ALPHABET_BLOCK, so the bulk of the work is done with the wide stores of
+ * the platform's memcpy. Every copied block is a whole number of periods,
+ * which keeps the pattern aligned with its absolute offset. */
+static void fill_alphabet(char* buffer, Py_ssize_t size) {
+  Py_ssize_t filled;
+  Py_ssize_t i;
+
+  filled = size < ALPHABET_LENGTH ? size : ALPHABET_LENGTH;
+  for (i = 0; i < filled; i++) {
+    buffer[i] = 'A' + i;
+  }
+
+  while (filled < size) {
+    Py_ssize_t block = filled < ALPHABET_BLOCK ? filled : ALPHABET_BLOCK;
+    if (block > size - filled) {
+      block = size - filled;
+    }
+    memcpy(buffer + filled, buffer, block);
+    filled += block;
+  }
+}
+
+static PyObject* allocate_buffer(PyObject* self, PyObject* args,
+                                 PyObject* kwargs) {
+  Py_ssize_t size;
+  PyObject* arena_obj = NULL;
+  int copy = 1;
+  int writable = 0;
+  int shared = 0;
+  static char* kwlist[] = {"size", "arena", "copy", "writable", "shared",
+                           NULL};
+  Arena* arena;
   char* buffer;
   PyObject* result;
-  int i;
 
-  if (!PyArg_ParseTuple(args, "i", &size)) {
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "n|Oiii", kwlist, &size,
+                                   &arena_obj, &copy, &writable, &shared) ||
+      !parse_arena(arena_obj, &arena)) {
     return NULL;
   }
 
-  /* Allocate memory using Python's allocator */
-  buffer = (char*)PyMem_Malloc(size * sizeof(char));
-  if (buffer == NULL) {
-    return PyErr_NoMemory();
+  if (size < 0) {
+    PyErr_SetString(PyExc_ValueError, "size must be non-negative");
+    return NULL;
   }
 
-  /* Fill buffer */
-  for (i = 0; i < size; i++) {
-    buffer[i] = 'A' + (i % 26);
+  /* Only the copying path has a scratch buffer to take from the arena */
+  if (arena != NULL && (!copy || writable || shared)) {
+    PyErr_SetString(PyExc_TypeError,
+                    "arena cannot be combined with copy=False, writable or "
+                    "shared");
+    return NULL;
+  }
+
+  /* Zero-copy: create the result first and fill its storage directly, so
+   * no scratch buffer exists and peak memory is the result alone */
+  if (shared) {
+    result = PyObject_CallFunction((PyObject*)&SharedBufferType, "n", size);
+    if (result != NULL) {
+      fill_alphabet(SHARED_DATA((SharedBuffer*)result), size);
+    }
+    return result;
+  }
+
+  if (writable) {
+    result = PyByteArray_FromStringAndSize(NULL, size);
+    if (result != NULL) {
+      fill_alphabet(PyByteArray_AS_STRING(result), size);
+    }
+    return result;
+  }
+
+  if (!copy) {
+    result = PyString_FromStringAndSize(NULL, size);
+    if (result != NULL) {
+      fill_alphabet(PyString_AS_STRING(result), size);
+    }
+    return result;
+  }
+
+  /* Allocate memory using Python's allocator, or bump it from the arena */
+  if (arena != NULL) {
+    buffer = arena_alloc(arena, (size_t)size);
+    if (buffer == NULL) {
+      return NULL;
+    }
+  } else {
+    buffer = (char*)tracked_malloc(SITE_ALLOCATE_BUFFER, size * sizeof(char));
+    if (buffer == NULL) {
+      return PyErr_NoMemory();
+    }
   }
 
+  /* Fill buffer */
+  fill_alphabet(buffer, size);
+
   /* Create Python string from buffer */
   result = PyString_FromStringAndSize(buffer, size);
 
-  /* Free the allocated memory */
-  PyMem_Free(buffer);
+  /* Free the allocated memory; arena memory is released by reset() */
+  if (arena == NULL) {
+    tracked_free(buffer);
+  }
 
   return result;
 }
 
-static PyObject* copy_string_safe(PyObject* self, PyObject* args) {
+static PyObject* copy_string_safe(PyObject* self, PyObject* args,
+                                  PyObject* kwargs) {
   const char* input;
   int input_len;
+  PyObject* arena_obj = NULL;
+  static char* kwlist[] = {"s", "arena", NULL};
+  Arena* arena;
+  char* buffer;
 
   /* Parse string argument - let Python handle the length */
-  if (!PyArg_ParseTuple(args, "s", &input)) {
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|O", kwlist, &input,
+                                   &arena_obj) ||
+      !parse_arena(arena_obj, &arena)) {
     return NULL;
   }
 
@@ -120,9 +1252,17 @@ static PyObject* copy_string_safe(PyObject* self, PyObject* args) {
   input_len = strlen(input);
 
   /* Allocate buffer for copy */
-  char* buffer = (char*)PyMem_Malloc((input_len + 1) * sizeof(char));
-  if (buffer == NULL) {
-    return PyErr_NoMemory();
+  if (arena != NULL) {
+    buffer = arena_alloc(arena, (input_len + 1) * sizeof(char));
+    if (buffer == NULL) {
+      return NULL;
+    }
+  } else {
+    buffer = (char*)tracked_malloc(SITE_COPY_STRING,
+                                   (input_len + 1) * sizeof(char));
+    if (buffer == NULL) {
+      return PyErr_NoMemory();
+    }
   }
 
   /* Copy the string */
@@ -131,8 +1271,10 @@ static PyObject* copy_string_safe(PyObject* self, PyObject* args) {
   /* Create Python string from copied buffer */
   PyObject* result = PyString_FromString(buffer);
 
-  /* Free the buffer */
-  PyMem_Free(buffer);
+  /* Free the buffer unless the arena owns it */
+  if (arena == NULL) {
+    tracked_free(buffer);
+  }
 
   return result;
 }
@@ -142,12 +1284,14 @@ static PyObject* copy_string_safe(PyObject* self, PyObject* args) {
  * ============================================================================
  */
 
-static PyObject* borrowed_reference_demo(PyObject* self, PyObject* args) {
-  PyObject* list;
+static PyObject* borrowed_reference_demo(PyObject* self, PyObject* list) {
   PyObject* item;
   PyObject* result;
 
-  if (!PyArg_ParseTuple(args, "O!", &PyList_Type, &list)) {
+  if (!PyList_Check(list)) {
+    PyErr_Format(PyExc_TypeError,
+                 "borrowed_ref_demo() argument must be list, not %.200s",
+                 Py_TYPE(list)->tp_name);
     return NULL;
   }
 
@@ -162,13 +1306,17 @@ static PyObject* borrowed_reference_demo(PyObject* self, PyObject* args) {
     return NULL;
   }
 
+  if (track_object(item, "borrowed_ref_demo", 0) < 0) {
+    return NULL;
+  }
+
   /* Must INCREF if we want to keep it */
   Py_INCREF(item);
 
-  /* Create result dict */
-  result = PyDict_New();
-  PyDict_SetItemString(result, "item", item);
-  PyDict_SetItemString(result, "refcount", PyInt_FromSsize_t(item->ob_refcnt));
+  /* Create result dict; Py_BuildValue's "N" steals the new refcount int */
+  result = Py_BuildValue(
+      "{s:O,s:N}", "item", item, "refcount",
+      PyInt_FromSsize_t(item->ob_refcnt - tracker_refs(item)));
 
   /* DECREF our reference */
   Py_DECREF(item);
@@ -176,12 +1324,12 @@ static PyObject* borrowed_reference_demo(PyObject* self, PyObject* args) {
   return result;
 }
 
-static PyObject* owned_reference_demo(PyObject* self, PyObject* args) {
+static PyObject* owned_reference_demo(PyObject* self, PyObject* arg) {
   int value;
   PyObject* new_int;
   PyObject* result;
 
-  if (!PyArg_ParseTuple(args, "i", &value)) {
+  if (!PyArg_Parse(arg, "i:owned_ref_demo", &value)) {
     return NULL;
   }
 
@@ -191,11 +1339,9 @@ static PyObject* owned_reference_demo(PyObject* self, PyObject* args) {
     return NULL;
   }
 
-  /* Create result */
-  result = PyDict_New();
-  PyDict_SetItemString(result, "value", new_int);
-  PyDict_SetItemString(result, "refcount",
-                       PyInt_FromSsize_t(new_int->ob_refcnt));
+  /* Create result; "N" steals the refcount int instead of leaking it */
+  result = Py_BuildValue("{s:O,s:N}", "value", new_int, "refcount",
+                         PyInt_FromSsize_t(new_int->ob_refcnt));
 
   /* We own the reference, so we must DECREF it */
   Py_DECREF(new_int);
@@ -224,7 +1370,7 @@ static PyObject* proper_cleanup_demo(PyObject* self, PyObject* args) {
   total_len = len1 + len2 + 2; /* +2 for space and null terminator */
 
   /* Allocate buffer */
-  buffer = (char*)PyMem_Malloc(total_len);
+  buffer = (char*)tracked_malloc(SITE_PROPER_CLEANUP, total_len);
   if (buffer == NULL) {
     return PyErr_NoMemory();
   }
@@ -238,7 +1384,7 @@ static PyObject* proper_cleanup_demo(PyObject* self, PyObject* args) {
   result = PyString_FromString(buffer);
 
   /* Always cleanup, even if PyString_FromString failed */
-  PyMem_Free(buffer);
+  tracked_free(buffer);
 
   /* result might be NULL if PyString_FromString failed */
   return result;
@@ -284,14 +1430,14 @@ error:
  * ============================================================================
  */
 
-static PyObject* create_and_populate_dict(PyObject* self, PyObject* args) {
+static PyObject* create_and_populate_dict(PyObject* self, PyObject* arg) {
   int count;
   PyObject* dict = NULL;
   PyObject* key = NULL;
   PyObject* value = NULL;
   int i;
 
-  if (!PyArg_ParseTuple(args, "i", &count)) {
+  if (!PyArg_Parse(arg, "i:create_populated_dict", &count)) {
     return NULL;
   }
 
@@ -337,33 +1483,49 @@ static PyObject* create_and_populate_dict(PyObject* self, PyObject* args) {
 
 static PyMethodDef MemoryMethods[] = {
     /* Reference counting */
-    {"get_refcount", get_refcount, METH_VARARGS,
+    {"get_refcount", get_refcount, METH_O,
      "Get reference count of an object.\n\nArgs:\n    obj: Any Python "
      "object\n\nReturns:\n    int: Current reference count"},
 
-    {"incref_demo", incref_demo, METH_VARARGS,
+    {"incref_demo", incref_demo, METH_O,
      "Demonstrate INCREF/DECREF.\n\nArgs:\n    obj: Any Python "
      "object\n\nReturns:\n    tuple: (before_count, after_count)"},
 
-    {"create_temp_list", create_temp_list, METH_VARARGS,
+    {"create_temp_list", create_temp_list, METH_O,
      "Create temporary list and clean up.\n\nArgs:\n    size (int): List "
      "size\n\nReturns:\n    int: Size of temporary list"},
 
     /* Memory allocation */
-    {"allocate_buffer", allocate_buffer, METH_VARARGS,
+    {"allocate_buffer", (PyCFunction)allocate_buffer,
+     METH_VARARGS | METH_KEYWORDS,
      "Allocate and fill a buffer.\n\nArgs:\n    size (int): Buffer "
-     "size\n\nReturns:\n    str: String filled with pattern"},
-
-    {"copy_string", copy_string_safe, METH_VARARGS,
+     "size\n    arena (Arena, optional): Take the scratch buffer from this "
+     "arena; only with the default copy=True\n    copy (bool): Fill a "
+     "scratch buffer and copy it (default); False fills the result in "
+     "place\n    writable (bool): Return a bytearray filled in place\n    "
+     "shared (bool): Return a SharedBuffer filled in place\n\nReturns:\n"
+     "    str, bytearray or SharedBuffer: Buffer filled with pattern\n\n"
+     "Raises:\n    TypeError: arena given with copy=False, writable or "
+     "shared"},
+
+    {"copy_string", (PyCFunction)copy_string_safe,
+     METH_VARARGS | METH_KEYWORDS,
      "Safely copy a string using PyMem_Malloc.\n\nArgs:\n    s (str): Input "
-     "string\n\nReturns:\n    str: Copied string"},
+     "string\n    arena (Arena, optional): Take the scratch buffer from this "
+     "arena\n\nReturns:\n    str: Copied string"},
+
+    /* Shared memory */
+    {"attach_shared", attach_shared, METH_O,
+     "Map an existing SharedBuffer by name.\n\nArgs:\n    name (str): "
+     "SharedBuffer.name from another handle or process\n\nReturns:\n    "
+     "SharedBuffer: New handle on the same memory"},
 
     /* Borrowed vs owned */
-    {"borrowed_ref_demo", borrowed_reference_demo, METH_VARARGS,
+    {"borrowed_ref_demo", borrowed_reference_demo, METH_O,
      "Demonstrate borrowed references.\n\nArgs:\n    lst (list): Non-empty "
      "list\n\nReturns:\n    dict: Info about first element"},
 
-    {"owned_ref_demo", owned_reference_demo, METH_VARARGS,
+    {"owned_ref_demo", owned_reference_demo, METH_O,
      "Demonstrate owned references.\n\nArgs:\n    value (int): Integer "
      "value\n\nReturns:\n    dict: Info about new object"},
 
@@ -372,11 +1534,11 @@ static PyMethodDef MemoryMethods[] = {
      "Demonstrate proper cleanup.\n\nArgs:\n    str1 (str): First string\n    "
      "str2 (str): Second string\n\nReturns:\n    str: Concatenated string"},
 
-    {"exception_safe", exception_safe_demo, METH_VARARGS,
+    {"exception_safe", exception_safe_demo, METH_NOARGS,
      "Create list with exception safety.\n\nReturns:\n    list: List of "
      "squares"},
 
-    {"create_populated_dict", create_and_populate_dict, METH_VARARGS,
+    {"create_populated_dict", create_and_populate_dict, METH_O,
      "Create and populate dictionary safely.\n\nArgs:\n    count (int): Number "
      "of entries\n\nReturns:\n    dict: Populated dictionary"},
 
@@ -390,6 +1552,10 @@ static PyMethodDef MemoryMethods[] = {
 PyMODINIT_FUNC initmemory_module(void) {
   PyObject* m;
 
+  if (PyType_Ready(&ArenaType) < 0) return;
+  if (PyType_Ready(&AllocationTrackerType) < 0) return;
+  if (PyType_Ready(&SharedBufferType) < 0) return;
+
   m = Py_InitModule3("memory_module", MemoryMethods,
                      "Python 2.7 C-API Tutorial: Memory Management Module\n\n"
                      "This module demonstrates:\n"
@@ -397,7 +1563,20 @@ PyMODINIT_FUNC initmemory_module(void) {
                      "- Memory allocation (PyMem_Malloc/Free)\n"
                      "- Borrowed vs owned references\n"
                      "- Memory leak prevention\n"
-                     "- Exception-safe code");
+                     "- Exception-safe code\n"
+                     "- Arena (bump) allocation\n"
+                     "- Shared memory buffers");
 
   if (m == NULL) return;
+  if (pycapi_instrument_module(m, MemoryMethods) < 0) return;
+
+  Py_INCREF(&ArenaType);
+  PyModule_AddObject(m, "Arena", (PyObject*)&ArenaType);
+
+  Py_INCREF(&AllocationTrackerType);
+  PyModule_AddObject(m, "AllocationTracker",
+                     (PyObject*)&AllocationTrackerType);
+
+  Py_INCREF(&SharedBufferType);
+  PyModule_AddObject(m, "SharedBuffer", (PyObject*)&SharedBufferType);
 }
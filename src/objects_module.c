@@ -8,330 +8,2901 @@
  * - Set operations
  * - Object attribute access
  * - Type checking
+ * - Sorting
+ * - Binary serialization
  */
 
 #include <Python.h>
+#include <string.h>
+#include <structmember.h>
+
+#include "instrument.h"
+#include "shared.h"
 
 /* ============================================================================
  * LIST OPERATIONS
  * ============================================================================
  */
 
-static PyObject* create_list(PyObject* self, PyObject* args) {
-  int size;
-  PyObject* list;
-  int i;
+/* Value generators understood by create_list */
+typedef enum {
+  LIST_KIND_SQUARES,
+  LIST_KIND_RANGE,
+  LIST_KIND_CONST
+} ListKind;
+
+/* array.array, imported on first use by create_list(as_array=True) */
+static PyObject* array_type = NULL;
+
+static int parse_list_kind(const char* name, ListKind* kind) {
+  if (strcmp(name, "squares") == 0) {
+    *kind = LIST_KIND_SQUARES;
+  } else if (strcmp(name, "range") == 0) {
+    *kind = LIST_KIND_RANGE;
+  } else if (strcmp(name, "const") == 0) {
+    *kind = LIST_KIND_CONST;
+  } else {
+    PyErr_Format(PyExc_ValueError,
+                 "kind must be 'squares', 'range' or 'const', not '%.50s'",
+                 name);
+    return 0;
+  }
+  return 1;
+}
+
+static long list_kind_value(ListKind kind, Py_ssize_t i, long value) {
+  switch (kind) {
+    case LIST_KIND_SQUARES:
+      return (long)i * (long)i;
+    case LIST_KIND_RANGE:
+      return (long)i;
+    default:
+      return value;
+  }
+}
+
+/* Build a typed array.array('l') of `size` items. The array is allocated
+ * zero-filled in one block by repeating a one-element array, then written in
+ * place through its buffer, so no Python int is ever created. */
+static PyObject* create_long_array(Py_ssize_t size, ListKind kind,
+                                   long value) {
+  PyObject* one;
+  PyObject* result;
+  void* data;
+  Py_ssize_t len, i;
+  long* items;
+
+  if (array_type == NULL) {
+    PyObject* array_module = PyImport_ImportModule("array");
+    if (array_module == NULL) {
+      return NULL;
+    }
+    array_type = PyObject_GetAttrString(array_module, "array");
+    Py_DECREF(array_module);
+    if (array_type == NULL) {
+      return NULL;
+    }
+  }
+
+  one = PyObject_CallFunction(array_type, "s[i]", "l", 0);
+  if (one == NULL) {
+    return NULL;
+  }
+
+  result = PySequence_Repeat(one, size);
+  Py_DECREF(one);
+  if (result == NULL) {
+    return NULL;
+  }
+
+  if (PyObject_AsWriteBuffer(result, &data, &len) < 0) {
+    Py_DECREF(result);
+    return NULL;
+  }
+
+  items = (long*)data;
+  for (i = 0; i < size; i++) {
+    items[i] = list_kind_value(kind, i, value);
+  }
+
+  return result;
+}
+
+static PyObject* create_list(PyObject* self, PyObject* args,
+                             PyObject* kwargs) {
+  Py_ssize_t size;
+  const char* kind_name = "squares";
+  long value = 0;
+  PyObject* as_array_obj = NULL;
+  int as_array;
+  static char* kwlist[] = {"size", "kind", "value", "as_array", NULL};
+  ListKind kind;
+  PyObject* list;
+  Py_ssize_t i;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "n|slO", kwlist, &size,
+                                   &kind_name, &value, &as_array_obj)) {
+    return NULL;
+  }
+
+  if (!parse_list_kind(kind_name, &kind)) {
+    return NULL;
+  }
+
+  if (size < 0) {
+    PyErr_SetString(PyExc_ValueError, "size must be non-negative");
+    return NULL;
+  }
+
+  if (kind == LIST_KIND_SQUARES && size > 1 &&
+      size - 1 > LONG_MAX / (size - 1)) {
+    PyErr_SetString(PyExc_OverflowError, "squares do not fit in a C long");
+    return NULL;
+  }
+
+  as_array = as_array_obj == NULL ? 0 : PyObject_IsTrue(as_array_obj);
+  if (as_array < 0) {
+    return NULL;
+  }
+  if (as_array) {
+    return create_long_array(size, kind, value);
+  }
+
+  list = PyList_New(size);
+  if (list == NULL) {
+    return NULL;
+  }
+
+  if (kind == LIST_KIND_CONST) {
+    /* Every slot shares one object: one allocation for the whole list */
+    PyObject* item = PyInt_FromLong(value);
+    if (item == NULL) {
+      Py_DECREF(list);
+      return NULL;
+    }
+    for (i = 0; i < size; i++) {
+      Py_INCREF(item);
+      PyList_SET_ITEM(list, i, item);
+    }
+    Py_DECREF(item);
+    return list;
+  }
+
+  /* PyInt_FromLong already hands out the interpreter's cached small ints and
+   * carves new ones from its block allocator, so only the list is sized. */
+  for (i = 0; i < size; i++) {
+    PyObject* item = PyInt_FromLong(list_kind_value(kind, i, value));
+    if (item == NULL) {
+      Py_DECREF(list);
+      return NULL;
+    }
+    PyList_SET_ITEM(list, i, item);
+  }
+
+  return list;
+}
+
+static PyObject* sum_list(PyObject* self, PyObject* list) {
+  Py_ssize_t i, size;
+  long total = 0;
+
+  if (!PyList_Check(list)) {
+    PyErr_Format(PyExc_TypeError,
+                 "sum_list() argument must be list, not %.200s",
+                 Py_TYPE(list)->tp_name);
+    return NULL;
+  }
+
+  size = PyList_Size(list);
+
+  for (i = 0; i < size; i++) {
+    PyObject* item = PyList_GetItem(list, i);
+    if (!PyInt_Check(item) && !PyLong_Check(item)) {
+      PyErr_SetString(PyExc_TypeError, "list must contain only integers");
+      return NULL;
+    }
+    total += PyInt_AsLong(item);
+  }
+
+  return PyInt_FromLong(total);
+}
+
+static PyObject* reverse_list(PyObject* self, PyObject* list) {
+  if (!PyList_Check(list)) {
+    PyErr_Format(PyExc_TypeError,
+                 "reverse_list() argument must be list, not %.200s",
+                 Py_TYPE(list)->tp_name);
+    return NULL;
+  }
+
+  if (PyList_Reverse(list) < 0) {
+    return NULL;
+  }
+
+  Py_INCREF(list);
+  return list;
+}
+
+/* ============================================================================
+ * BUFFER PROTOCOL REDUCTION
+ * ============================================================================
+ */
+
+/* Buffers smaller than this are summed without releasing the GIL; the
+ * thread switch would cost more than the reduction itself. */
+#define SUM_GIL_RELEASE_BYTES (64 * 1024)
+
+/* Narrow integers are summed in int64 blocks of this many elements. Four
+ * accumulators of at most 2^28 values below 2^32 cannot overflow. */
+#define SUM_NARROW_BLOCK ((Py_ssize_t)1 << 30)
+
+/* 128-bit two's complement accumulator: exact for any buffer length that
+ * fits in memory, so integer sums never overflow silently. */
+typedef struct {
+  unsigned PY_LONG_LONG lo;
+  PY_LONG_LONG hi;
+} WideSum;
+
+static void wide_add_signed(WideSum* acc, PY_LONG_LONG value) {
+  unsigned PY_LONG_LONG u = (unsigned PY_LONG_LONG)value;
+  acc->lo += u;
+  acc->hi += (acc->lo < u) - (value < 0);
+}
+
+static void wide_add_unsigned(WideSum* acc, unsigned PY_LONG_LONG value) {
+  acc->lo += value;
+  acc->hi += (acc->lo < value);
+}
+
+/* Four independent accumulators per loop so the compiler can keep several
+ * lanes busy (and vectorize at -O3) instead of serializing on one sum. */
+#define DEFINE_NARROW_SUM(fname, ctype)                                  \
+  static void fname(const char* data, Py_ssize_t n, WideSum* acc) {      \
+    const ctype* p = (const ctype*)data;                                 \
+    while (n > 0) {                                                      \
+      Py_ssize_t block = n < SUM_NARROW_BLOCK ? n : SUM_NARROW_BLOCK;    \
+      PY_LONG_LONG s0 = 0, s1 = 0, s2 = 0, s3 = 0;                       \
+      Py_ssize_t i = 0;                                                  \
+      for (; i + 4 <= block; i += 4) {                                   \
+        s0 += p[i];                                                      \
+        s1 += p[i + 1];                                                  \
+        s2 += p[i + 2];                                                  \
+        s3 += p[i + 3];                                                  \
+      }                                                                  \
+      for (; i < block; i++) {                                           \
+        s0 += p[i];                                                      \
+      }                                                                  \
+      wide_add_signed(acc, s0 + s1 + s2 + s3);                           \
+      p += block;                                                        \
+      n -= block;                                                        \
+    }                                                                    \
+  }
+
+DEFINE_NARROW_SUM(sum_int8, signed char)
+DEFINE_NARROW_SUM(sum_uint8, unsigned char)
+DEFINE_NARROW_SUM(sum_int16, short)
+DEFINE_NARROW_SUM(sum_uint16, unsigned short)
+DEFINE_NARROW_SUM(sum_int32, int)
+DEFINE_NARROW_SUM(sum_uint32, unsigned int)
+
+static void sum_int64(const char* data, Py_ssize_t n, WideSum* acc) {
+  const PY_LONG_LONG* p = (const PY_LONG_LONG*)data;
+  Py_ssize_t i;
+
+  for (i = 0; i < n; i++) {
+    wide_add_signed(acc, p[i]);
+  }
+}
+
+static void sum_uint64(const char* data, Py_ssize_t n, WideSum* acc) {
+  const unsigned PY_LONG_LONG* p = (const unsigned PY_LONG_LONG*)data;
+  Py_ssize_t i;
+
+  for (i = 0; i < n; i++) {
+    wide_add_unsigned(acc, p[i]);
+  }
+}
+
+#define DEFINE_FLOAT_SUM(fname, ctype)                          \
+  static double fname(const char* data, Py_ssize_t n) {         \
+    const ctype* p = (const ctype*)data;                        \
+    double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;              \
+    Py_ssize_t i = 0;                                           \
+    for (; i + 4 <= n; i += 4) {                                \
+      s0 += p[i];                                               \
+      s1 += p[i + 1];                                           \
+      s2 += p[i + 2];                                           \
+      s3 += p[i + 3];                                           \
+    }                                                           \
+    for (; i < n; i++) {                                        \
+      s0 += p[i];                                               \
+    }                                                           \
+    return (s0 + s1) + (s2 + s3);                               \
+  }
+
+DEFINE_FLOAT_SUM(sum_float32, float)
+DEFINE_FLOAT_SUM(sum_float64, double)
+
+typedef void (*int_sum_kernel)(const char*, Py_ssize_t, WideSum*);
+typedef double (*float_sum_kernel)(const char*, Py_ssize_t);
+
+/* Map a struct-module format character and item size to a kernel. Returns 0
+ * and sets TypeError for formats that are not plain numbers. */
+static int select_sum_kernel(char code, Py_ssize_t itemsize,
+                             int_sum_kernel* int_kernel,
+                             float_sum_kernel* float_kernel) {
+  *int_kernel = NULL;
+  *float_kernel = NULL;
+
+  switch (code) {
+    case 'b':
+    case 'h':
+    case 'i':
+    case 'l':
+    case 'q':
+    case 'n':
+      if (itemsize == 1) *int_kernel = sum_int8;
+      if (itemsize == 2) *int_kernel = sum_int16;
+      if (itemsize == 4) *int_kernel = sum_int32;
+      if (itemsize == 8) *int_kernel = sum_int64;
+      break;
+    case 'B':
+    case 'H':
+    case 'I':
+    case 'L':
+    case 'Q':
+    case 'N':
+      if (itemsize == 1) *int_kernel = sum_uint8;
+      if (itemsize == 2) *int_kernel = sum_uint16;
+      if (itemsize == 4) *int_kernel = sum_uint32;
+      if (itemsize == 8) *int_kernel = sum_uint64;
+      break;
+    case 'f':
+      if (itemsize == sizeof(float)) *float_kernel = sum_float32;
+      break;
+    case 'd':
+      if (itemsize == sizeof(double)) *float_kernel = sum_float64;
+      break;
+  }
+
+  if (*int_kernel == NULL && *float_kernel == NULL) {
+    PyErr_Format(PyExc_TypeError,
+                 "unsupported buffer format '%c' with item size %zd", code,
+                 itemsize);
+    return 0;
+  }
+
+  return 1;
+}
+
+static PyObject* wide_sum_to_python(const WideSum* acc) {
+  PyObject *high, *shift, *shifted, *low, *result;
+
+  /* Fast path: the 128-bit value fits in a signed 64-bit integer */
+  if ((acc->hi == 0 && acc->lo <= (unsigned PY_LONG_LONG)PY_LLONG_MAX) ||
+      (acc->hi == -1 && acc->lo > (unsigned PY_LONG_LONG)PY_LLONG_MAX)) {
+    PY_LONG_LONG value = (PY_LONG_LONG)acc->lo;
+    if (value >= LONG_MIN && value <= LONG_MAX) {
+      return PyInt_FromLong((long)value);
+    }
+    return PyLong_FromLongLong(value);
+  }
+
+  /* Slow path: (hi << 64) + lo as a Python long */
+  high = PyLong_FromLongLong(acc->hi);
+  shift = PyInt_FromLong(64);
+  low = PyLong_FromUnsignedLongLong(acc->lo);
+  if (high == NULL || shift == NULL || low == NULL) {
+    Py_XDECREF(high);
+    Py_XDECREF(shift);
+    Py_XDECREF(low);
+    return NULL;
+  }
+
+  shifted = PyNumber_Lshift(high, shift);
+  Py_DECREF(high);
+  Py_DECREF(shift);
+  if (shifted == NULL) {
+    Py_DECREF(low);
+    return NULL;
+  }
+
+  result = PyNumber_Add(shifted, low);
+  Py_DECREF(shifted);
+  Py_DECREF(low);
+  return result;
+}
+
+/* The format character of an old-style buffer (array.array on Python 2.7)
+ * comes from its typecode attribute; anything else is treated as bytes. */
+static int legacy_buffer_format(PyObject* obj, char* code) {
+  PyObject* typecode = PyObject_GetAttrString(obj, "typecode");
+
+  *code = 'B';
+  if (typecode == NULL) {
+    PyErr_Clear();
+    return 1;
+  }
+
+  if (PyString_Check(typecode) && PyString_GET_SIZE(typecode) == 1) {
+    *code = PyString_AS_STRING(typecode)[0];
+  }
+  Py_DECREF(typecode);
+  return 1;
+}
+
+/* Acquire a read view of a numeric buffer and its struct format code.
+ *
+ * New-style exporters are locked against resizing until PyBuffer_Release,
+ * so *locked is set and the caller may drop the GIL while reading. For
+ * old-style buffers (array.array in 2.7) nothing stops another thread from
+ * resizing the object, so the GIL must stay held. Returns 0 with an
+ * exception set when obj has no buffer. */
+static int get_numeric_view(PyObject* obj, Py_buffer* view, char* code,
+                            int* locked) {
+  if (PyObject_CheckBuffer(obj)) {
+    const char* format;
+
+    if (PyObject_GetBuffer(obj, view, PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) < 0) {
+      return 0;
+    }
+    format = view->format != NULL ? view->format : "B";
+    if (format[0] == '@' || format[0] == '=' || format[0] == '<') {
+      format++;
+    }
+    /* One value per item: "ii" would otherwise be read as one int */
+    if (format[0] != '\0' && format[1] != '\0') {
+      PyErr_Format(PyExc_TypeError, "unsupported buffer format '%.50s'",
+                   view->format);
+      PyBuffer_Release(view);
+      return 0;
+    }
+    *code = format[0];
+    *locked = 1;
+  } else if (PyObject_CheckReadBuffer(obj)) {
+    const void* data;
+    Py_ssize_t len;
+    PyObject* itemsize_obj;
+    Py_ssize_t itemsize = 1;
+
+    /* The attribute lookups can run Python code that resizes the object,
+     * so the data pointer is taken after them */
+    legacy_buffer_format(obj, code);
+    itemsize_obj = PyObject_GetAttrString(obj, "itemsize");
+    if (itemsize_obj == NULL) {
+      PyErr_Clear();
+    } else {
+      itemsize = PyInt_AsSsize_t(itemsize_obj);
+      Py_DECREF(itemsize_obj);
+      if (itemsize <= 0) {
+        PyErr_Clear();
+        itemsize = 1;
+      }
+    }
+
+    if (PyObject_AsReadBuffer(obj, &data, &len) < 0) {
+      return 0;
+    }
+    if (PyBuffer_FillInfo(view, NULL, (void*)data, len, 1, PyBUF_SIMPLE) < 0) {
+      return 0;
+    }
+    view->itemsize = itemsize;
+    *locked = 0;
+  } else {
+    PyErr_Format(PyExc_TypeError, "object of type '%.200s' has no buffer",
+                 Py_TYPE(obj)->tp_name);
+    return 0;
+  }
+
+  return 1;
+}
+
+/* With pool=, a buffer that may drop the GIL is summed in chunks of this
+ * many elements on the pool's threads. Partial sums are combined in chunk
+ * order, so the result does not depend on the number of threads. */
+#define SUM_POOL_CHUNK ((Py_ssize_t)64 * 1024)
+
+typedef struct {
+  const char* data;
+  Py_ssize_t itemsize;
+  Py_ssize_t count;
+  int_sum_kernel int_kernel;
+  float_sum_kernel float_kernel;
+  WideSum* int_partials;
+  double* float_partials;
+} SumTask;
+
+static void sum_task(void* ctx, Py_ssize_t index) {
+  SumTask* task = (SumTask*)ctx;
+  Py_ssize_t start = index * SUM_POOL_CHUNK;
+  Py_ssize_t n = task->count - start;
+  const char* data = task->data + start * task->itemsize;
+
+  if (n > SUM_POOL_CHUNK) {
+    n = SUM_POOL_CHUNK;
+  }
+  if (task->int_kernel != NULL) {
+    WideSum acc = {0, 0};
+    task->int_kernel(data, n, &acc);
+    task->int_partials[index] = acc;
+  } else {
+    task->float_partials[index] = task->float_kernel(data, n);
+  }
+}
+
+/* Sum view on the pool; returns 0 without an exception when the caller
+ * should sum serially, -1 with one set */
+static int sum_buffer_pool(const PycapiPoolAPI* api, PyObject* pool,
+                           const Py_buffer* view, int_sum_kernel int_kernel,
+                           float_sum_kernel float_kernel, WideSum* acc,
+                           double* float_total) {
+  SumTask task;
+  Py_ssize_t ntasks;
+  Py_ssize_t i;
+
+  task.data = (const char*)view->buf;
+  task.itemsize = view->itemsize;
+  task.count = view->len / view->itemsize;
+  task.int_kernel = int_kernel;
+  task.float_kernel = float_kernel;
+  task.int_partials = NULL;
+  task.float_partials = NULL;
+
+  ntasks = (task.count + SUM_POOL_CHUNK - 1) / SUM_POOL_CHUNK;
+  if (ntasks < 2) {
+    return 0;
+  }
+
+  if (int_kernel != NULL) {
+    task.int_partials = PyMem_New(WideSum, ntasks);
+  } else {
+    task.float_partials = PyMem_New(double, ntasks);
+  }
+  if (task.int_partials == NULL && task.float_partials == NULL) {
+    PyErr_NoMemory();
+    return -1;
+  }
+
+  Py_BEGIN_ALLOW_THREADS;
+  api->run(pool, ntasks, sum_task, &task);
+  Py_END_ALLOW_THREADS;
+
+  for (i = 0; i < ntasks; i++) {
+    if (int_kernel != NULL) {
+      acc->lo += task.int_partials[i].lo;
+      acc->hi += task.int_partials[i].hi + (acc->lo < task.int_partials[i].lo);
+    } else {
+      *float_total += task.float_partials[i];
+    }
+  }
+
+  PyMem_Free(task.int_partials);
+  PyMem_Free(task.float_partials);
+  return 1;
+}
+
+static PyObject* sum_buffer(PyObject* self, PyObject* args,
+                            PyObject* kwargs) {
+  PyObject* obj;
+  PyObject* pool = NULL;
+  static char* kwlist[] = {"obj", "pool", NULL};
+  const PycapiPoolAPI* api;
+  Py_buffer view;
+  char code;
+  int release_gil;
+  int_sum_kernel int_kernel;
+  float_sum_kernel float_kernel;
+  WideSum acc = {0, 0};
+  double float_total = 0.0;
+  PyObject* result;
+  int pooled = 0;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|O:sum_buffer", kwlist,
+                                   &obj, &pool) ||
+      pycapi_get_pool(pool, &api) < 0) {
+    return NULL;
+  }
+
+  if (!get_numeric_view(obj, &view, &code, &release_gil)) {
+    return NULL;
+  }
+  /* Only worth a thread switch for large, locked buffers */
+  release_gil = release_gil && view.len >= SUM_GIL_RELEASE_BYTES;
+
+  if (!select_sum_kernel(code, view.itemsize, &int_kernel, &float_kernel)) {
+    PyBuffer_Release(&view);
+    return NULL;
+  }
+
+  if (api != NULL && release_gil) {
+    pooled = sum_buffer_pool(api, pool, &view, int_kernel, float_kernel, &acc,
+                             &float_total);
+    if (pooled < 0) {
+      PyBuffer_Release(&view);
+      return NULL;
+    }
+  }
+
+  /* Otherwise acc or float_total already holds the pool's partial sums */
+  if (!pooled && release_gil) {
+    Py_BEGIN_ALLOW_THREADS;
+    if (int_kernel != NULL) {
+      int_kernel((const char*)view.buf, view.len / view.itemsize, &acc);
+    } else {
+      float_total = float_kernel((const char*)view.buf,
+                                 view.len / view.itemsize);
+    }
+    Py_END_ALLOW_THREADS;
+  } else if (!pooled && int_kernel != NULL) {
+    int_kernel((const char*)view.buf, view.len / view.itemsize, &acc);
+  } else if (!pooled) {
+    float_total = float_kernel((const char*)view.buf, view.len / view.itemsize);
+  }
+
+  PyBuffer_Release(&view);
+
+  if (int_kernel != NULL) {
+    result = wide_sum_to_python(&acc);
+  } else {
+    result = PyFloat_FromDouble(float_total);
+  }
+
+  return result;
+}
+
+/* ============================================================================
+ * DICTIONARY OPERATIONS
+ * ============================================================================
+ */
+
+static PyObject* create_dict(PyObject* self, PyObject* args) {
+  PyObject* dict;
+  int i;
+
+  dict = PyDict_New();
+  if (dict == NULL) {
+    return NULL;
+  }
+
+  for (i = 0; i < 5; i++) {
+    PyObject* key = PyString_FromFormat("key%d", i);
+    PyObject* value = PyInt_FromLong(i * 10);
+    PyDict_SetItem(dict, key, value);
+    Py_DECREF(key);
+    Py_DECREF(value);
+  }
+
+  return dict;
+}
+
+static PyObject* dict_has_key(PyObject* self, PyObject* args) {
+  PyObject* dict;
+  const char* key;
+
+  if (!PyArg_ParseTuple(args, "O!s", &PyDict_Type, &dict, &key)) {
+    return NULL;
+  }
+
+  if (PyDict_GetItemString(dict, key) != NULL) {
+    Py_RETURN_TRUE;
+  } else {
+    Py_RETURN_FALSE;
+  }
+}
+
+/* How merge_dicts/merge_many resolve a key present in several dicts */
+typedef enum {
+  MERGE_LAST,  /* the later dict wins (dict.update) */
+  MERGE_FIRST, /* the earlier dict wins */
+  MERGE_SUM,   /* existing + new */
+  MERGE_CALL   /* resolver(key, existing, new) */
+} MergePolicy;
+
+static int parse_merge_policy(PyObject* obj, MergePolicy* policy,
+                              PyObject** resolver) {
+  *resolver = NULL;
+
+  if (obj == NULL) {
+    *policy = MERGE_LAST;
+    return 1;
+  }
+
+  if (PyString_Check(obj)) {
+    const char* name = PyString_AS_STRING(obj);
+    if (strcmp(name, "last") == 0) {
+      *policy = MERGE_LAST;
+    } else if (strcmp(name, "first") == 0) {
+      *policy = MERGE_FIRST;
+    } else if (strcmp(name, "sum") == 0) {
+      *policy = MERGE_SUM;
+    } else {
+      PyErr_Format(PyExc_ValueError,
+                   "on_conflict must be 'first', 'last', 'sum' or a "
+                   "callable, not '%.100s'",
+                   name);
+      return 0;
+    }
+    return 1;
+  }
+
+  if (PyCallable_Check(obj)) {
+    *policy = MERGE_CALL;
+    *resolver = obj;
+    return 1;
+  }
+
+  PyErr_Format(PyExc_TypeError,
+               "on_conflict must be a string or callable, not %.200s",
+               Py_TYPE(obj)->tp_name);
+  return 0;
+}
+
+/* Merge source into target in one pass using the given policy */
+static int merge_into(PyObject* target, PyObject* source, MergePolicy policy,
+                      PyObject* resolver) {
+  Py_ssize_t pos = 0;
+  Py_ssize_t size;
+  PyObject* key;
+  PyObject* value;
+
+  /* The first two policies are exactly dict.update with/without override */
+  if (policy == MERGE_LAST) {
+    return PyDict_Merge(target, source, 1);
+  }
+  if (policy == MERGE_FIRST) {
+    return PyDict_Merge(target, source, 0);
+  }
+
+  size = PyDict_Size(source);
+  while (PyDict_Next(source, &pos, &key, &value)) {
+    PyObject* existing = PyDict_GetItem(target, key);
+    PyObject* merged;
+    int status;
+
+    if (existing == NULL) {
+      status = PyDict_SetItem(target, key, value);
+    } else {
+      /* The resolver may run arbitrary code, so own everything it sees */
+      Py_INCREF(key);
+      Py_INCREF(value);
+      Py_INCREF(existing);
+      if (policy == MERGE_SUM) {
+        merged = PyNumber_Add(existing, value);
+      } else {
+        merged = PyObject_CallFunctionObjArgs(resolver, key, existing, value,
+                                              NULL);
+      }
+      Py_DECREF(existing);
+      Py_DECREF(value);
+      status = merged == NULL ? -1 : PyDict_SetItem(target, key, merged);
+      Py_XDECREF(merged);
+      Py_DECREF(key);
+    }
+
+    if (status < 0) {
+      return -1;
+    }
+    if (PyDict_Size(source) != size) {
+      PyErr_SetString(PyExc_RuntimeError,
+                      "dictionary changed size during merge");
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+static PyObject* merge_dicts(PyObject* self, PyObject* args,
+                             PyObject* kwargs) {
+  PyObject *dict1, *dict2, *result;
+  PyObject* inplace_obj = NULL;
+  PyObject* on_conflict = NULL;
+  static char* kwlist[] = {"dict1", "dict2", "inplace", "on_conflict", NULL};
+  MergePolicy policy;
+  PyObject* resolver;
+  int inplace;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!O!|OO", kwlist,
+                                   &PyDict_Type, &dict1, &PyDict_Type, &dict2,
+                                   &inplace_obj, &on_conflict) ||
+      !parse_merge_policy(on_conflict, &policy, &resolver)) {
+    return NULL;
+  }
+
+  inplace = inplace_obj == NULL ? 0 : PyObject_IsTrue(inplace_obj);
+  if (inplace < 0) {
+    return NULL;
+  }
+
+  /* In place, merging an overlay costs O(len(dict2)) instead of copying
+   * the whole of dict1 first */
+  if (inplace) {
+    result = dict1;
+    Py_INCREF(result);
+  } else {
+    result = PyDict_Copy(dict1);
+    if (result == NULL) {
+      return NULL;
+    }
+  }
+
+  if (merge_into(result, dict2, policy, resolver) < 0) {
+    Py_DECREF(result);
+    return NULL;
+  }
+
+  return result;
+}
+
+static PyObject* merge_many(PyObject* self, PyObject* args, PyObject* kwargs) {
+  PyObject* on_conflict = NULL;
+  MergePolicy policy;
+  PyObject* resolver;
+  PyObject* result;
+  Py_ssize_t count = PyTuple_GET_SIZE(args);
+  Py_ssize_t total = 0;
+  Py_ssize_t i;
+
+  /* *dicts leaves on_conflict as the only keyword */
+  if (kwargs != NULL && PyDict_Size(kwargs) > 0) {
+    on_conflict = PyDict_GetItemString(kwargs, "on_conflict");
+    if (on_conflict == NULL || PyDict_Size(kwargs) > 1) {
+      PyErr_SetString(PyExc_TypeError,
+                      "merge_many() only accepts the on_conflict keyword");
+      return NULL;
+    }
+  }
+  if (!parse_merge_policy(on_conflict, &policy, &resolver)) {
+    return NULL;
+  }
+
+  for (i = 0; i < count; i++) {
+    PyObject* item = PyTuple_GET_ITEM(args, i);
+    if (!PyDict_Check(item)) {
+      PyErr_Format(PyExc_TypeError,
+                   "merge_many() argument %zd must be dict, not %.200s",
+                   i + 1, Py_TYPE(item)->tp_name);
+      return NULL;
+    }
+    total += PyDict_Size(item);
+  }
+
+  /* The summed sizes bound the result, so the table never resizes */
+  result = _PyDict_NewPresized(total);
+  if (result == NULL) {
+    return NULL;
+  }
+
+  for (i = 0; i < count; i++) {
+    if (merge_into(result, PyTuple_GET_ITEM(args, i), policy, resolver) < 0) {
+      Py_DECREF(result);
+      return NULL;
+    }
+  }
+
+  return result;
+}
+
+/* Room for the decimal digits of any non-negative Py_ssize_t */
+#define KEY_DIGITS_MAX 24
+
+/* Write the decimal digits of value so they end at `end`; returns the
+ * first digit. Replaces a PyString_FromFormat round trip per key. */
+static char* format_index(char* end, Py_ssize_t value) {
+  size_t v = (size_t)value;
+
+  do {
+    *--end = (char)('0' + v % 10);
+    v /= 10;
+  } while (v != 0);
+
+  return end;
+}
+
+/* Convert one element of a numeric buffer to a Python int or float */
+static PyObject* buffer_item_to_python(const char* item, char code) {
+  switch (code) {
+    case 'b': {
+      signed char v;
+      memcpy(&v, item, sizeof(v));
+      return PyInt_FromLong(v);
+    }
+    case 'B': {
+      unsigned char v;
+      memcpy(&v, item, sizeof(v));
+      return PyInt_FromLong(v);
+    }
+    case 'h': {
+      short v;
+      memcpy(&v, item, sizeof(v));
+      return PyInt_FromLong(v);
+    }
+    case 'H': {
+      unsigned short v;
+      memcpy(&v, item, sizeof(v));
+      return PyInt_FromLong(v);
+    }
+    case 'i': {
+      int v;
+      memcpy(&v, item, sizeof(v));
+      return PyInt_FromLong(v);
+    }
+    case 'I': {
+      unsigned int v;
+      memcpy(&v, item, sizeof(v));
+      return PyLong_FromUnsignedLong(v);
+    }
+    case 'l': {
+      long v;
+      memcpy(&v, item, sizeof(v));
+      return PyInt_FromLong(v);
+    }
+    case 'L': {
+      unsigned long v;
+      memcpy(&v, item, sizeof(v));
+      return PyLong_FromUnsignedLong(v);
+    }
+    case 'q': {
+      PY_LONG_LONG v;
+      memcpy(&v, item, sizeof(v));
+      return PyLong_FromLongLong(v);
+    }
+    case 'Q': {
+      unsigned PY_LONG_LONG v;
+      memcpy(&v, item, sizeof(v));
+      return PyLong_FromUnsignedLongLong(v);
+    }
+    case 'f': {
+      float v;
+      memcpy(&v, item, sizeof(v));
+      return PyFloat_FromDouble(v);
+    }
+    case 'd': {
+      double v;
+      memcpy(&v, item, sizeof(v));
+      return PyFloat_FromDouble(v);
+    }
+    default:
+      PyErr_Format(PyExc_TypeError, "unsupported buffer format '%c'", code);
+      return NULL;
+  }
+}
+
+static Py_ssize_t buffer_code_size(char code) {
+  switch (code) {
+    case 'b':
+    case 'B':
+      return 1;
+    case 'h':
+    case 'H':
+      return sizeof(short);
+    case 'i':
+    case 'I':
+      return sizeof(int);
+    case 'l':
+    case 'L':
+      return sizeof(long);
+    case 'q':
+    case 'Q':
+      return sizeof(PY_LONG_LONG);
+    case 'f':
+      return sizeof(float);
+    case 'd':
+      return sizeof(double);
+    default:
+      return 0;
+  }
+}
+
+static PyObject* dict_from_columns(PyObject* self, PyObject* args,
+                                   PyObject* kwargs) {
+  PyObject* keys;
+  PyObject* values;
+  const char* prefix = "key_";
+  int prefix_len = 4; /* s# stores an int without PY_SSIZE_T_CLEAN */
+  static char* kwlist[] = {"keys", "values", "prefix", NULL};
+  PyObject* key_seq = NULL;
+  PyObject* value_seq = NULL;
+  PyObject* dict = NULL;
+  Py_buffer view;
+  int have_view = 0;
+  int locked = 0;
+  char code = 'B';
+  char* scratch = NULL;
+  Py_ssize_t count;
+  Py_ssize_t value_count;
+  Py_ssize_t i;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|s#", kwlist, &keys,
+                                   &values, &prefix, &prefix_len)) {
+    return NULL;
+  }
+
+  /* keys: an explicit iterable, or a count of generated prefix+N keys */
+  if (PyInt_Check(keys) || PyLong_Check(keys)) {
+    count = PyNumber_AsSsize_t(keys, PyExc_OverflowError);
+    if (count == -1 && PyErr_Occurred()) {
+      return NULL;
+    }
+    if (count < 0) {
+      PyErr_SetString(PyExc_ValueError, "key count must be non-negative");
+      return NULL;
+    }
+    scratch = (char*)PyMem_Malloc(prefix_len + KEY_DIGITS_MAX);
+    if (scratch == NULL) {
+      return PyErr_NoMemory();
+    }
+    memcpy(scratch, prefix, prefix_len);
+  } else {
+    key_seq = PySequence_Fast(keys, "keys must be an int or an iterable");
+    if (key_seq == NULL) {
+      return NULL;
+    }
+    count = PySequence_Fast_GET_SIZE(key_seq);
+  }
+
+  /* values: numeric buffers are read in place, anything else iterated */
+  if (!PyString_Check(values) && !PyUnicode_Check(values) &&
+      (PyObject_CheckBuffer(values) || PyObject_CheckReadBuffer(values))) {
+    if (!get_numeric_view(values, &view, &code, &locked)) {
+      goto error;
+    }
+    have_view = 1;
+    if (buffer_code_size(code) != view.itemsize) {
+      PyErr_Format(PyExc_TypeError, "unsupported buffer format '%c'", code);
+      goto error;
+    }
+    value_count = view.len / view.itemsize;
+  } else {
+    value_seq = PySequence_Fast(values, "values must be a buffer or iterable");
+    if (value_seq == NULL) {
+      goto error;
+    }
+    value_count = PySequence_Fast_GET_SIZE(value_seq);
+  }
+
+  if (value_count != count) {
+    PyErr_Format(PyExc_ValueError,
+                 "keys and values have different lengths (%zd and %zd)",
+                 count, value_count);
+    goto error;
+  }
+
+  /* Size the table once instead of resizing it while it grows */
+  dict = _PyDict_NewPresized(count);
+  if (dict == NULL) {
+    goto error;
+  }
+
+  for (i = 0; i < count; i++) {
+    PyObject* key;
+    PyObject* value;
+    int status;
+
+    if (scratch != NULL) {
+      char* end = scratch + prefix_len + KEY_DIGITS_MAX;
+      char* digits = format_index(end, i);
+      memmove(scratch + prefix_len, digits, end - digits);
+      key = PyString_FromStringAndSize(
+          scratch, prefix_len + (Py_ssize_t)(end - digits));
+    } else if (i < PySequence_Fast_GET_SIZE(key_seq)) {
+      key = PySequence_Fast_GET_ITEM(key_seq, i);
+      Py_INCREF(key);
+    } else {
+      PyErr_SetString(PyExc_RuntimeError, "keys changed size during build");
+      goto error;
+    }
+    if (key == NULL) {
+      goto error;
+    }
+
+    if (have_view) {
+      if (!locked && key_seq != NULL) {
+        /* Hashing a user key can run Python code that resizes an
+         * unlocked exporter, so refresh the pointer every time */
+        const void* data;
+        Py_ssize_t len;
+        if (PyObject_AsReadBuffer(values, &data, &len) < 0) {
+          Py_DECREF(key);
+          goto error;
+        }
+        if ((i + 1) * view.itemsize > len) {
+          Py_DECREF(key);
+          PyErr_SetString(PyExc_RuntimeError,
+                          "values changed size during build");
+          goto error;
+        }
+        view.buf = (void*)data;
+      }
+      value = buffer_item_to_python((const char*)view.buf + i * view.itemsize,
+                                    code);
+    } else if (i < PySequence_Fast_GET_SIZE(value_seq)) {
+      value = PySequence_Fast_GET_ITEM(value_seq, i);
+      Py_INCREF(value);
+    } else {
+      PyErr_SetString(PyExc_RuntimeError, "values changed size during build");
+      value = NULL;
+    }
+    if (value == NULL) {
+      Py_DECREF(key);
+      goto error;
+    }
+
+    status = PyDict_SetItem(dict, key, value);
+    Py_DECREF(key);
+    Py_DECREF(value);
+    if (status < 0) {
+      goto error;
+    }
+  }
+
+  goto done;
+
+error:
+  Py_CLEAR(dict);
+done:
+  if (have_view) {
+    PyBuffer_Release(&view);
+  }
+  Py_XDECREF(key_seq);
+  Py_XDECREF(value_seq);
+  PyMem_Free(scratch);
+  return dict;
+}
+
+static PyObject* dict_from_pairs(PyObject* self, PyObject* iterable) {
+  PyObject* iterator;
+  PyObject* dict = NULL;
+  PyObject* item;
+  Py_ssize_t hint;
+  Py_ssize_t index = 0;
+
+  iterator = PyObject_GetIter(iterable);
+  if (iterator == NULL) {
+    return NULL;
+  }
+
+  hint = _PyObject_LengthHint(iterable, 0);
+  if (hint < 0 || (dict = _PyDict_NewPresized(hint)) == NULL) {
+    Py_DECREF(iterator);
+    return NULL;
+  }
+
+  while ((item = PyIter_Next(iterator))) {
+    PyObject* pair;
+    PyObject* key;
+    PyObject* value;
+    int status;
+
+    if (PyTuple_CheckExact(item) || PyList_CheckExact(item)) {
+      pair = item;
+      Py_INCREF(pair);
+    } else {
+      pair = PySequence_Fast(item, "");
+      if (pair == NULL) {
+        PyErr_Format(PyExc_TypeError,
+                     "cannot convert pair #%zd to a sequence", index);
+      }
+    }
+    Py_DECREF(item);
+    if (pair == NULL) {
+      goto error;
+    }
+
+    if (PySequence_Fast_GET_SIZE(pair) != 2) {
+      PyErr_Format(PyExc_ValueError,
+                   "pair #%zd has length %zd; 2 is required", index,
+                   PySequence_Fast_GET_SIZE(pair));
+      Py_DECREF(pair);
+      goto error;
+    }
+
+    /* Own the key and value: hashing may run code that mutates a list */
+    key = PySequence_Fast_GET_ITEM(pair, 0);
+    value = PySequence_Fast_GET_ITEM(pair, 1);
+    Py_INCREF(key);
+    Py_INCREF(value);
+    Py_DECREF(pair);
+    status = PyDict_SetItem(dict, key, value);
+    Py_DECREF(key);
+    Py_DECREF(value);
+    if (status < 0) {
+      goto error;
+    }
+    index++;
+  }
+
+  if (PyErr_Occurred()) {
+    goto error;
+  }
+
+  Py_DECREF(iterator);
+  return dict;
+
+error:
+  Py_DECREF(iterator);
+  Py_DECREF(dict);
+  return NULL;
+}
+
+/* ============================================================================
+ * TUPLE OPERATIONS
+ * ============================================================================
+ */
+
+static PyObject* create_tuple(PyObject* self, PyObject* arg) {
+  int size;
+  PyObject* tuple;
+  int i;
+
+  if (!PyArg_Parse(arg, "i:create_tuple", &size)) {
+    return NULL;
+  }
+
+  tuple = PyTuple_New(size);
+  if (tuple == NULL) {
+    return NULL;
+  }
+
+  for (i = 0; i < size; i++) {
+    PyObject* item = PyInt_FromLong(i + 1);
+    PyTuple_SET_ITEM(tuple, i, item);
+  }
+
+  return tuple;
+}
+
+static PyObject* tuple_element(PyObject* self, PyObject* args) {
+  PyObject* tuple;
+  int index;
+  PyObject* item;
+
+  if (!PyArg_ParseTuple(args, "O!i", &PyTuple_Type, &tuple, &index)) {
+    return NULL;
+  }
+
+  if (index < 0 || index >= PyTuple_Size(tuple)) {
+    PyErr_SetString(PyExc_IndexError, "tuple index out of range");
+    return NULL;
+  }
+
+  item = PyTuple_GetItem(tuple, index);
+  Py_INCREF(item);
+  return item;
+}
+
+/* ============================================================================
+ * SET OPERATIONS
+ * ============================================================================
+ */
+
+static PyObject* create_set(PyObject* self, PyObject* iterable) {
+  PyObject* set;
+
+  set = PySet_New(iterable);
+  return set;
+}
+
+/* Collect the positional operands of an n-ary set operation as a tuple of
+ * sets (frozensets are used as they are, other iterables are converted)
+ * and parse the count_only keyword. */
+static PyObject* parse_set_operands(PyObject* args, PyObject* kwargs,
+                                    const char* fname, Py_ssize_t min_count,
+                                    int* count_only) {
+  Py_ssize_t count = PyTuple_GET_SIZE(args);
+  PyObject* operands;
+  Py_ssize_t i;
+
+  *count_only = 0;
+  if (kwargs != NULL && PyDict_Size(kwargs) > 0) {
+    PyObject* flag = PyDict_GetItemString(kwargs, "count_only");
+    if (flag == NULL || PyDict_Size(kwargs) > 1) {
+      PyErr_Format(PyExc_TypeError,
+                   "%s() only accepts the count_only keyword", fname);
+      return NULL;
+    }
+    *count_only = PyObject_IsTrue(flag);
+    if (*count_only < 0) {
+      return NULL;
+    }
+  }
+
+  if (count < min_count) {
+    PyErr_Format(PyExc_TypeError, "%s() needs at least %zd operand%s", fname,
+                 min_count, min_count == 1 ? "" : "s");
+    return NULL;
+  }
+
+  operands = PyTuple_New(count);
+  if (operands == NULL) {
+    return NULL;
+  }
+
+  for (i = 0; i < count; i++) {
+    PyObject* item = PyTuple_GET_ITEM(args, i);
+    PyObject* set;
+
+    if (PyAnySet_Check(item)) {
+      set = item;
+      Py_INCREF(set);
+    } else {
+      set = PySet_New(item);
+      if (set == NULL) {
+        Py_DECREF(operands);
+        return NULL;
+      }
+    }
+    PyTuple_SET_ITEM(operands, i, set);
+  }
+
+  return operands;
+}
+
+/* Index of the smallest (or largest) operand */
+static Py_ssize_t pick_operand(PyObject* operands, int largest) {
+  Py_ssize_t best = 0;
+  Py_ssize_t i;
+
+  for (i = 1; i < PyTuple_GET_SIZE(operands); i++) {
+    Py_ssize_t size = PySet_GET_SIZE(PyTuple_GET_ITEM(operands, i));
+    Py_ssize_t best_size = PySet_GET_SIZE(PyTuple_GET_ITEM(operands, best));
+    if (largest ? size > best_size : size < best_size) {
+      best = i;
+    }
+  }
+
+  return best;
+}
+
+/* 1 if key is in every operand in [start, stop) other than `skip`, 0 if
+ * not, -1 on error. The key is owned across the calls: comparing it may
+ * run Python code. */
+static int contained_in_all(PyObject* operands, PyObject* key,
+                            Py_ssize_t start, Py_ssize_t stop,
+                            Py_ssize_t skip) {
+  int found = 1;
+  Py_ssize_t i;
+
+  Py_INCREF(key);
+  for (i = start; i < stop && found == 1; i++) {
+    if (i != skip) {
+      found = PySet_Contains(PyTuple_GET_ITEM(operands, i), key);
+    }
+  }
+  Py_DECREF(key);
+
+  return found;
+}
+
+/* 1 if key is in any operand in [start, stop) other than `skip` */
+static int contained_in_any(PyObject* operands, PyObject* key,
+                            Py_ssize_t start, Py_ssize_t stop,
+                            Py_ssize_t skip) {
+  int found = 0;
+  Py_ssize_t i;
+
+  Py_INCREF(key);
+  for (i = start; i < stop && found == 0; i++) {
+    if (i != skip) {
+      found = PySet_Contains(PyTuple_GET_ITEM(operands, i), key);
+    }
+  }
+  Py_DECREF(key);
+
+  return found;
+}
+
+/* PySet_Add and PySet_Discard for a key borrowed from _PySet_Next. As in
+ * contained_in_all, the key is owned across the call: hashing or comparing
+ * it may run Python code that removes it from the set it came from. */
+static int set_add_key(PyObject* set, PyObject* key) {
+  int status;
+
+  Py_INCREF(key);
+  status = PySet_Add(set, key);
+  Py_DECREF(key);
+
+  return status;
+}
+
+static int set_discard_key(PyObject* set, PyObject* key) {
+  int status;
+
+  Py_INCREF(key);
+  status = PySet_Discard(set, key);
+  Py_DECREF(key);
+
+  return status;
+}
+
+/* Wrap a result set, or just its cardinality for count_only */
+static PyObject* set_result(PyObject* result, int count_only) {
+  PyObject* count;
+
+  if (result == NULL || !count_only) {
+    return result;
+  }
+
+  count = PyInt_FromSsize_t(PySet_GET_SIZE(result));
+  Py_DECREF(result);
+  return count;
+}
+
+static PyObject* set_operations(PyObject* self, PyObject* args,
+                                PyObject* kwargs) {
+  PyObject* operands;
+  PyObject* result;
+  Py_ssize_t count;
+  Py_ssize_t largest;
+  Py_ssize_t i;
+  int count_only;
+
+  operands = parse_set_operands(args, kwargs, "set_union", 0, &count_only);
+  if (operands == NULL) {
+    return NULL;
+  }
+  count = PyTuple_GET_SIZE(operands);
+
+  if (count_only) {
+    /* An element is new in operand i if no earlier operand has it */
+    Py_ssize_t total = 0;
+
+    for (i = 0; i < count; i++) {
+      PyObject* set = PyTuple_GET_ITEM(operands, i);
+      Py_ssize_t pos = 0;
+      PyObject* key;
+
+      while (_PySet_Next(set, &pos, &key)) {
+        int found = contained_in_any(operands, key, 0, i, -1);
+        if (found < 0) {
+          Py_DECREF(operands);
+          return NULL;
+        }
+        total += !found;
+      }
+    }
+
+    Py_DECREF(operands);
+    return PyInt_FromSsize_t(total);
+  }
+
+  if (count == 0) {
+    Py_DECREF(operands);
+    return PySet_New(NULL);
+  }
+
+  /* Copying the largest operand sizes the table once, up front */
+  largest = pick_operand(operands, 1);
+  result = PySet_New(PyTuple_GET_ITEM(operands, largest));
+
+  for (i = 0; i < count && result != NULL; i++) {
+    PyObject* set = PyTuple_GET_ITEM(operands, i);
+    Py_ssize_t pos = 0;
+    PyObject* key;
+
+    if (i == largest) {
+      continue;
+    }
+    while (_PySet_Next(set, &pos, &key)) {
+      if (set_add_key(result, key) < 0) {
+        Py_CLEAR(result);
+        break;
+      }
+    }
+  }
+
+  Py_DECREF(operands);
+  return result;
+}
+
+static PyObject* set_intersection(PyObject* self, PyObject* args,
+                                  PyObject* kwargs) {
+  PyObject* operands;
+  PyObject* smallest_set;
+  PyObject* result = NULL;
+  PyObject* key;
+  Py_ssize_t count;
+  Py_ssize_t smallest;
+  Py_ssize_t pos = 0;
+  Py_ssize_t total = 0;
+  int count_only;
+
+  operands =
+      parse_set_operands(args, kwargs, "set_intersection", 1, &count_only);
+  if (operands == NULL) {
+    return NULL;
+  }
+  count = PyTuple_GET_SIZE(operands);
+
+  /* Only the smallest operand is iterated; the others are probed */
+  smallest = pick_operand(operands, 0);
+  smallest_set = PyTuple_GET_ITEM(operands, smallest);
+
+  /* The result is a copy of the smallest operand with the misses
+   * discarded, so it never grows (or resizes) while being built */
+  if (!count_only) {
+    result = PySet_New(smallest_set);
+    if (result == NULL) {
+      Py_DECREF(operands);
+      return NULL;
+    }
+  }
+
+  while (_PySet_Next(smallest_set, &pos, &key)) {
+    int found = contained_in_all(operands, key, 0, count, smallest);
+
+    if (found < 0 ||
+        (!found && !count_only && set_discard_key(result, key) < 0)) {
+      Py_XDECREF(result);
+      Py_DECREF(operands);
+      return NULL;
+    }
+    total += found;
+  }
+
+  Py_DECREF(operands);
+  return count_only ? PyInt_FromSsize_t(total) : result;
+}
+
+static PyObject* set_difference(PyObject* self, PyObject* args,
+                                PyObject* kwargs) {
+  PyObject* operands;
+  PyObject* first;
+  PyObject* result;
+  PyObject* key;
+  Py_ssize_t count;
+  Py_ssize_t pos = 0;
+  Py_ssize_t total = 0;
+  Py_ssize_t i;
+  int count_only;
+
+  operands = parse_set_operands(args, kwargs, "set_difference", 1, &count_only);
+  if (operands == NULL) {
+    return NULL;
+  }
+  count = PyTuple_GET_SIZE(operands);
+  first = PyTuple_GET_ITEM(operands, 0);
+
+  if (count_only) {
+    while (_PySet_Next(first, &pos, &key)) {
+      int found = contained_in_any(operands, key, 1, count, -1);
+      if (found < 0) {
+        Py_DECREF(operands);
+        return NULL;
+      }
+      total += !found;
+    }
+
+    Py_DECREF(operands);
+    return PyInt_FromSsize_t(total);
+  }
+
+  /* Start from a copy of the first operand and discard from it, walking
+   * whichever side of each subtraction is smaller */
+  result = PySet_New(first);
+
+  for (i = 1; i < count && result != NULL; i++) {
+    PyObject* other = PyTuple_GET_ITEM(operands, i);
+    int walk_other = PySet_GET_SIZE(other) <= PySet_GET_SIZE(result);
+
+    pos = 0;
+    while (_PySet_Next(walk_other ? other : first, &pos, &key)) {
+      int found =
+          walk_other ? 1 : contained_in_all(operands, key, i, i + 1, -1);
+
+      if (found < 0 || (found && set_discard_key(result, key) < 0)) {
+        Py_CLEAR(result);
+        break;
+      }
+    }
+  }
+
+  Py_DECREF(operands);
+  return result;
+}
+
+static PyObject* set_symmetric_difference(PyObject* self, PyObject* args,
+                                          PyObject* kwargs) {
+  PyObject* operands;
+  PyObject* result;
+  PyObject* key;
+  Py_ssize_t count;
+  Py_ssize_t largest;
+  Py_ssize_t pos = 0;
+  Py_ssize_t i;
+  int count_only;
+
+  operands = parse_set_operands(args, kwargs, "set_symmetric_difference", 0,
+                                &count_only);
+  if (operands == NULL) {
+    return NULL;
+  }
+  count = PyTuple_GET_SIZE(operands);
+
+  if (count == 2 && count_only) {
+    /* |a ^ b| = |a| + |b| - 2|a & b|, probing the smaller set */
+    PyObject* a = PyTuple_GET_ITEM(operands, 0);
+    PyObject* b = PyTuple_GET_ITEM(operands, 1);
+    Py_ssize_t small = PySet_GET_SIZE(a) <= PySet_GET_SIZE(b) ? 0 : 1;
+    Py_ssize_t common = 0;
+
+    while (_PySet_Next(PyTuple_GET_ITEM(operands, small), &pos, &key)) {
+      int found = contained_in_all(operands, key, 1 - small, 2 - small, -1);
+      if (found < 0) {
+        Py_DECREF(operands);
+        return NULL;
+      }
+      common += found;
+    }
+
+    Py_DECREF(operands);
+    return PyInt_FromSsize_t(PySet_GET_SIZE(a) + PySet_GET_SIZE(b) -
+                             2 * common);
+  }
+
+  if (count == 0) {
+    Py_DECREF(operands);
+    return set_result(PySet_New(NULL), count_only);
+  }
+
+  /* Elements present in an odd number of operands; toggling membership
+   * into a copy of the largest operand keeps resizes to a minimum */
+  largest = pick_operand(operands, 1);
+  result = PySet_New(PyTuple_GET_ITEM(operands, largest));
+
+  for (i = 0; i < count && result != NULL; i++) {
+    PyObject* set = PyTuple_GET_ITEM(operands, i);
+
+    if (i == largest) {
+      continue;
+    }
+    pos = 0;
+    while (_PySet_Next(set, &pos, &key)) {
+      int removed;
+
+      Py_INCREF(key);
+      removed = PySet_Discard(result, key);
+      if (removed == 0) {
+        removed = PySet_Add(result, key) < 0 ? -1 : 0;
+      }
+      Py_DECREF(key);
+      if (removed < 0) {
+        Py_CLEAR(result);
+        break;
+      }
+    }
+  }
+
+  Py_DECREF(operands);
+  return set_result(result, count_only);
+}
+
+/* ============================================================================
+ * OBJECT ATTRIBUTE ACCESS
+ * ============================================================================
+ */
+
+static PyObject* get_object_attr(PyObject* self, PyObject* args) {
+  PyObject* obj;
+  PyObject* attr_name;
+  PyObject* name;
+  PyObject* attr;
+
+  if (!PyArg_ParseTuple(args, "OO", &obj, &attr_name)) {
+    return NULL;
+  }
+
+  name = pycapi_intern_name(attr_name);
+  if (name == NULL) {
+    return NULL;
+  }
+
+  attr = PyObject_GetAttr(obj, name);
+  Py_DECREF(name);
+  if (attr == NULL) {
+    PyErr_Clear();
+    Py_RETURN_NONE;
+  }
+
+  return attr;
+}
+
+static PyObject* set_object_attr(PyObject* self, PyObject* args) {
+  PyObject* obj;
+  PyObject* attr_name;
+  PyObject* value;
+  PyObject* name;
+  int status;
+
+  if (!PyArg_ParseTuple(args, "OOO", &obj, &attr_name, &value)) {
+    return NULL;
+  }
+
+  name = pycapi_intern_name(attr_name);
+  if (name == NULL) {
+    return NULL;
+  }
+
+  status = PyObject_SetAttr(obj, name, value);
+  Py_DECREF(name);
+  if (status < 0) {
+    return NULL;
+  }
+
+  Py_RETURN_NONE;
+}
+
+static PyObject* has_attribute(PyObject* self, PyObject* args) {
+  PyObject* obj;
+  PyObject* attr_name;
+  PyObject* name;
+  int found;
+
+  if (!PyArg_ParseTuple(args, "OO", &obj, &attr_name)) {
+    return NULL;
+  }
+
+  name = pycapi_intern_name(attr_name);
+  if (name == NULL) {
+    return NULL;
+  }
+
+  found = PyObject_HasAttr(obj, name);
+  Py_DECREF(name);
+
+  if (found) {
+    Py_RETURN_TRUE;
+  } else {
+    Py_RETURN_FALSE;
+  }
+}
+
+/* ============================================================================
+ * TYPE CHECKING
+ * ============================================================================
+ */
+
+static PyObject* get_object_type(PyObject* self, PyObject* obj) {
+  const char* type_name;
+
+  type_name = obj->ob_type->tp_name;
+  return PyString_FromString(type_name);
+}
+
+/* Bits of the check_type() result, exported as the TYPE_* constants */
+typedef enum {
+  TYPE_INT = 1 << 0,
+  TYPE_LONG = 1 << 1,
+  TYPE_FLOAT = 1 << 2,
+  TYPE_STRING = 1 << 3,
+  TYPE_UNICODE = 1 << 4,
+  TYPE_LIST = 1 << 5,
+  TYPE_TUPLE = 1 << 6,
+  TYPE_DICT = 1 << 7,
+  TYPE_SET = 1 << 8
+} TypeBit;
+
+/* Classify obj as a bitmask: one int instead of a dict of nine bools */
+static PyObject* check_type(PyObject* self, PyObject* obj) {
+  long mask = 0;
+
+  if (PyInt_Check(obj)) mask |= TYPE_INT;
+  if (PyLong_Check(obj)) mask |= TYPE_LONG;
+  if (PyFloat_Check(obj)) mask |= TYPE_FLOAT;
+  if (PyString_Check(obj)) mask |= TYPE_STRING;
+  if (PyUnicode_Check(obj)) mask |= TYPE_UNICODE;
+  if (PyList_Check(obj)) mask |= TYPE_LIST;
+  if (PyTuple_Check(obj)) mask |= TYPE_TUPLE;
+  if (PyDict_Check(obj)) mask |= TYPE_DICT;
+  if (PySet_Check(obj)) mask |= TYPE_SET;
+
+  return PyInt_FromLong(mask);
+}
+
+/* ============================================================================
+ * OBJECT COMPARISON
+ * ============================================================================
+ */
+
+static PyObject* compare_objects(PyObject* self, PyObject* args) {
+  PyObject *obj1, *obj2;
+  int result;
+
+  if (!PyArg_ParseTuple(args, "OO", &obj1, &obj2)) {
+    return NULL;
+  }
+
+  result = PyObject_Compare(obj1, obj2);
+
+  if (PyErr_Occurred()) {
+    return NULL;
+  }
+
+  return PyInt_FromLong(result);
+}
+
+/* ============================================================================
+ * SORTING
+ * ============================================================================
+ */
+
+/* sort_homogeneous() sorts a list in place like list.sort(), but first
+ * checks in one scan whether every key is an exact int (or long that fits
+ * in 64 bits), every key an exact float, or every key an exact str. Such
+ * lists are sorted on unboxed keys without a single rich comparison:
+ * numbers with an LSD radix sort on an order-preserving 64-bit image of
+ * the value, strings with a merge sort comparing bytes directly. Both are
+ * stable, so the result is exactly what list.sort() would produce. Any
+ * other list is handed to list.sort(). */
+
+#define SORT_RADIX_BITS 8
+#define SORT_RADIX_BUCKETS (1 << SORT_RADIX_BITS)
+#define SORT_RADIX_PASSES (64 / SORT_RADIX_BITS)
+#define SORT_INSERTION_RUN 32 /* merge sort starts from sorted runs */
+
+typedef enum { SORT_INT, SORT_FLOAT, SORT_STR, SORT_GENERIC } SortKind;
+
+static const char* const sort_kind_names[] = {"int", "float", "str",
+                                              "generic"};
+
+typedef struct {
+  union {
+    unsigned PY_LONG_LONG bits; /* numbers: unsigned order == value order */
+    PyObject* str;              /* strings: the key itself (borrowed) */
+  } key;
+  PyObject* item;
+} SortEntry;
+
+/* Map a key to unsigned bits with the same order, or return 0 if it does
+ * not fit the list's kind. Flipping the sign bit orders signed integers;
+ * for doubles negative values also get their other bits inverted. -0.0
+ * is folded into 0.0 because the two compare equal, and NaN (which does
+ * not order at all) leaves the list to the generic sort. */
+static int sort_key_bits(SortKind kind, PyObject* key,
+                         unsigned PY_LONG_LONG* bits) {
+  if (kind == SORT_INT) {
+    PY_LONG_LONG v;
+
+    if (PyInt_CheckExact(key)) {
+      v = PyInt_AS_LONG(key);
+    } else if (PyLong_CheckExact(key)) {
+      int overflow;
+      v = PyLong_AsLongLongAndOverflow(key, &overflow);
+      if (overflow) {
+        return 0;
+      }
+    } else {
+      return 0;
+    }
+    *bits = (unsigned PY_LONG_LONG)v ^ (1ULL << 63);
+    return 1;
+  }
+
+  if (PyFloat_CheckExact(key)) {
+    double x = PyFloat_AS_DOUBLE(key);
+    unsigned PY_LONG_LONG u;
+
+    if (Py_IS_NAN(x)) {
+      return 0;
+    }
+    if (x == 0.0) {
+      x = 0.0;
+    }
+    memcpy(&u, &x, sizeof(u));
+    *bits = (u >> 63) ? ~u : u | (1ULL << 63);
+    return 1;
+  }
+  return 0;
+}
+
+/* Stable LSD radix sort of n entries on key.bits; tmp holds n entries.
+ * Returns whichever of the two arrays ends up holding the result. Byte
+ * positions where every key agrees (the high bytes of small ints,
+ * typically) are skipped. */
+static SortEntry* sort_radix(SortEntry* entries, SortEntry* tmp,
+                             Py_ssize_t n) {
+  Py_ssize_t counts[SORT_RADIX_PASSES][SORT_RADIX_BUCKETS];
+  Py_ssize_t i;
+  int pass;
+
+  memset(counts, 0, sizeof(counts));
+  for (i = 0; i < n; i++) {
+    unsigned PY_LONG_LONG bits = entries[i].key.bits;
+    for (pass = 0; pass < SORT_RADIX_PASSES; pass++) {
+      counts[pass][(bits >> (pass * SORT_RADIX_BITS)) & 0xff]++;
+    }
+  }
+
+  for (pass = 0; pass < SORT_RADIX_PASSES; pass++) {
+    Py_ssize_t* count = counts[pass];
+    int shift = pass * SORT_RADIX_BITS;
+    Py_ssize_t offset = 0;
+    SortEntry* swap;
+    int bucket;
+
+    if (count[(entries[0].key.bits >> shift) & 0xff] == n) {
+      continue;
+    }
+
+    for (bucket = 0; bucket < SORT_RADIX_BUCKETS; bucket++) {
+      Py_ssize_t size = count[bucket];
+      count[bucket] = offset;
+      offset += size;
+    }
+    for (i = 0; i < n; i++) {
+      tmp[count[(entries[i].key.bits >> shift) & 0xff]++] = entries[i];
+    }
+
+    swap = entries;
+    entries = tmp;
+    tmp = swap;
+  }
+  return entries;
+}
+
+/* Python 2 str ordering: bytes first, then length */
+static int sort_str_less(const SortEntry* a, const SortEntry* b) {
+  Py_ssize_t len_a = PyString_GET_SIZE(a->key.str);
+  Py_ssize_t len_b = PyString_GET_SIZE(b->key.str);
+  int c = memcmp(PyString_AS_STRING(a->key.str),
+                 PyString_AS_STRING(b->key.str), len_a < len_b ? len_a : len_b);
+  return c < 0 || (c == 0 && len_a < len_b);
+}
+
+/* Stable bottom-up merge sort of string keys; same contract as
+ * sort_radix */
+static SortEntry* sort_strings(SortEntry* entries, SortEntry* tmp,
+                               Py_ssize_t n) {
+  Py_ssize_t start, width, i, j;
+
+  /* Insertion sort each run; it only moves an entry past strictly greater
+   * ones, which keeps equal keys in order */
+  for (start = 0; start < n; start += SORT_INSERTION_RUN) {
+    Py_ssize_t end = start + SORT_INSERTION_RUN < n ? start + SORT_INSERTION_RUN
+                                                   : n;
+    for (i = start + 1; i < end; i++) {
+      SortEntry current = entries[i];
+      for (j = i; j > start && sort_str_less(&current, &entries[j - 1]); j--) {
+        entries[j] = entries[j - 1];
+      }
+      entries[j] = current;
+    }
+  }
+
+  for (width = SORT_INSERTION_RUN; width < n; width *= 2) {
+    SortEntry* swap;
+
+    for (start = 0; start < n; start += 2 * width) {
+      Py_ssize_t mid = start + width < n ? start + width : n;
+      Py_ssize_t end = start + 2 * width < n ? start + 2 * width : n;
+      Py_ssize_t left = start, right = mid, out = start;
+
+      /* Take from the right run only when strictly smaller: stable */
+      while (left < mid && right < end) {
+        if (sort_str_less(&entries[right], &entries[left])) {
+          tmp[out++] = entries[right++];
+        } else {
+          tmp[out++] = entries[left++];
+        }
+      }
+      while (left < mid) {
+        tmp[out++] = entries[left++];
+      }
+      while (right < end) {
+        tmp[out++] = entries[right++];
+      }
+    }
+
+    swap = entries;
+    entries = tmp;
+    tmp = swap;
+  }
+  return entries;
+}
 
-  if (!PyArg_ParseTuple(args, "i", &size)) {
-    return NULL;
+/* Key function for list.sort() that ignores the item and returns the next
+ * precomputed key; self is an iterator over the keys. list.sort() calls
+ * its key once per item in list order, so each item gets its own key. */
+static PyObject* sort_next_key(PyObject* self, PyObject* item) {
+  PyObject* key = PyIter_Next(self);
+  if (key == NULL && !PyErr_Occurred()) {
+    PyErr_SetString(PyExc_ValueError, "list modified during sort");
   }
+  return key;
+}
 
-  list = PyList_New(size);
-  if (list == NULL) {
-    return NULL;
+static PyMethodDef sort_next_key_def = {"next_key", sort_next_key, METH_O,
+                                        NULL};
+
+/* Sort with list.sort(), reusing keys when they were already computed */
+static int sort_generic(PyObject* list, PyObject* keys, int reverse) {
+  PyObject* sort = NULL;
+  PyObject* empty = NULL;
+  PyObject* kwargs = NULL;
+  PyObject* result = NULL;
+
+  sort = PyObject_GetAttrString(list, "sort");
+  empty = PyTuple_New(0);
+  kwargs = Py_BuildValue("{s:O}", "reverse", reverse ? Py_True : Py_False);
+  if (sort == NULL || empty == NULL || kwargs == NULL) {
+    goto done;
   }
 
-  for (i = 0; i < size; i++) {
-    PyObject* item = PyInt_FromLong(i * i);
-    PyList_SET_ITEM(list, i, item);
+  if (keys != NULL) {
+    PyObject* iter = PyObject_GetIter(keys);
+    PyObject* next =
+        iter != NULL ? PyCFunction_New(&sort_next_key_def, iter) : NULL;
+    int status = next != NULL ? PyDict_SetItemString(kwargs, "key", next) : -1;
+    Py_XDECREF(iter);
+    Py_XDECREF(next);
+    if (status < 0) {
+      goto done;
+    }
   }
 
-  return list;
+  result = PyObject_Call(sort, empty, kwargs);
+
+done:
+  Py_XDECREF(sort);
+  Py_XDECREF(empty);
+  Py_XDECREF(kwargs);
+  Py_XDECREF(result);
+  return result != NULL ? 0 : -1;
 }
 
-static PyObject* sum_list(PyObject* self, PyObject* args) {
+static void sort_reverse(SortEntry* entries, Py_ssize_t n) {
+  Py_ssize_t i;
+
+  for (i = 0; i < n / 2; i++) {
+    SortEntry swap = entries[i];
+    entries[i] = entries[n - 1 - i];
+    entries[n - 1 - i] = swap;
+  }
+}
+
+static PyObject* sort_homogeneous(PyObject* self, PyObject* args,
+                                  PyObject* kwargs) {
   PyObject* list;
-  Py_ssize_t i, size;
-  long total = 0;
+  PyObject* key = Py_None;
+  int reverse = 0;
+  static char* kwlist[] = {"list", "key", "reverse", NULL};
+  PyObject* items;
+  PyObject* keys = NULL;
+  PyObject** sources;
+  SortEntry* entries = NULL;
+  SortEntry* sorted;
+  SortKind kind = SORT_GENERIC;
+  Py_ssize_t n, i;
+  int status = -1;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!|Oi", kwlist,
+                                   &PyList_Type, &list, &key, &reverse)) {
+    return NULL;
+  }
 
-  if (!PyArg_ParseTuple(args, "O!", &PyList_Type, &list)) {
+  /* Work on a snapshot that owns the items: key functions may run
+   * arbitrary code */
+  n = PyList_GET_SIZE(list);
+  items = PyList_GetSlice(list, 0, n);
+  if (items == NULL) {
     return NULL;
   }
 
-  size = PyList_Size(list);
+  if (key != Py_None) {
+    keys = PyList_New(n);
+    if (keys == NULL) {
+      goto done;
+    }
+    for (i = 0; i < n; i++) {
+      PyObject* k =
+          PyObject_CallFunctionObjArgs(key, PyList_GET_ITEM(items, i), NULL);
+      if (k == NULL) {
+        goto done;
+      }
+      PyList_SET_ITEM(keys, i, k);
+    }
+    if (PyList_GET_SIZE(list) != n) {
+      PyErr_SetString(PyExc_ValueError, "list modified during sort");
+      goto done;
+    }
+  }
+  sources = PySequence_Fast_ITEMS(keys != NULL ? keys : items);
+
+  /* The single classifying scan also fills in the unboxed keys */
+  if (n > 1) {
+    entries = PyMem_New(SortEntry, 2 * n);
+    if (entries == NULL) {
+      PyErr_NoMemory();
+      goto done;
+    }
 
-  for (i = 0; i < size; i++) {
-    PyObject* item = PyList_GetItem(list, i);
-    if (!PyInt_Check(item) && !PyLong_Check(item)) {
-      PyErr_SetString(PyExc_TypeError, "list must contain only integers");
-      return NULL;
+    kind = PyFloat_CheckExact(sources[0])    ? SORT_FLOAT
+           : PyString_CheckExact(sources[0]) ? SORT_STR
+                                             : SORT_INT;
+    for (i = 0; i < n; i++) {
+      entries[i].item = PyList_GET_ITEM(items, i);
+      if (kind == SORT_STR) {
+        if (!PyString_CheckExact(sources[i])) {
+          break;
+        }
+        entries[i].key.str = sources[i];
+      } else if (!sort_key_bits(kind, sources[i], &entries[i].key.bits)) {
+        break;
+      }
+    }
+    if (i < n) {
+      kind = SORT_GENERIC;
     }
-    total += PyInt_AsLong(item);
   }
 
-  return PyInt_FromLong(total);
-}
+  if (kind == SORT_GENERIC) {
+    status = sort_generic(list, keys, reverse);
+    goto done;
+  }
 
-static PyObject* reverse_list(PyObject* self, PyObject* args) {
-  PyObject* list;
+  /* Like list.sort(): reversing before and after a stable ascending sort
+   * keeps equal keys in their original order */
+  if (reverse) {
+    sort_reverse(entries, n);
+  }
+  sorted = kind == SORT_STR ? sort_strings(entries, entries + n, n)
+                            : sort_radix(entries, entries + n, n);
+  if (reverse) {
+    sort_reverse(sorted, n);
+  }
 
-  if (!PyArg_ParseTuple(args, "O!", &PyList_Type, &list)) {
-    return NULL;
+  /* Permuting the snapshot keeps every reference count as it was */
+  for (i = 0; i < n; i++) {
+    PyList_SET_ITEM(items, i, sorted[i].item);
   }
+  status = PyList_SetSlice(list, 0, n, items);
 
-  if (PyList_Reverse(list) < 0) {
+done:
+  PyMem_Free(entries);
+  Py_DECREF(items);
+  Py_XDECREF(keys);
+  if (status < 0) {
     return NULL;
   }
-
-  Py_INCREF(list);
-  return list;
+  return PyString_FromString(sort_kind_names[kind]);
 }
 
 /* ============================================================================
- * DICTIONARY OPERATIONS
+ * SERIALIZATION
  * ============================================================================
  */
 
-static PyObject* create_dict(PyObject* self, PyObject* args) {
-  PyObject* dict;
-  int i;
-
-  dict = PyDict_New();
-  if (dict == NULL) {
-    return NULL;
+/* dumps() writes a compact tagged format: one tag byte per value, then
+ *
+ *   SERIAL_INT, SERIAL_LONG   zigzag varint (SERIAL_BIGLONG for longs past
+ *                             64 bits: varint byte count, little-endian
+ *                             two's complement)
+ *   SERIAL_FLOAT              8-byte little-endian IEEE double
+ *   SERIAL_STR, SERIAL_UNICODE  varint byte count, raw / UTF-8 bytes
+ *   SERIAL_MEMO               varint index of an earlier str or unicode
+ *   SERIAL_LIST ... SET       varint item count, then the items (dicts:
+ *                             key, value pairs)
+ *
+ * Within a record every distinct string is written once; repeats, such as
+ * the keys of a list of dicts, become a memo reference. A record is
+ * self-delimiting, so records concatenated into one buffer can be read
+ * back with load_iter(). Only the exact built-in types are supported;
+ * anything else, subclasses included, raises TypeError. */
+
+#define SERIAL_NONE 'N'
+#define SERIAL_TRUE 'T'
+#define SERIAL_FALSE 'F'
+#define SERIAL_INT 'i'
+#define SERIAL_LONG 'l'
+#define SERIAL_BIGLONG 'g'
+#define SERIAL_FLOAT 'f'
+#define SERIAL_STR 's'
+#define SERIAL_UNICODE 'u'
+#define SERIAL_MEMO 'm'
+#define SERIAL_LIST '['
+#define SERIAL_TUPLE '('
+#define SERIAL_DICT '{'
+#define SERIAL_SET '<'
+#define SERIAL_FROZENSET '>'
+
+#define SERIAL_INITIAL_SIZE 256
+#define SERIAL_VARINT_MAX 10 /* bytes for a 64-bit varint */
+
+typedef struct {
+  PyObject* out; /* str being filled; trimmed to size at the end */
+  char* p;       /* next byte to write */
+  char* end;
+  PyObject* strings;  /* str -> memo index */
+  PyObject* unicodes; /* unicode -> memo index: u'a' == 'a' in a dict */
+  Py_ssize_t memo_size;
+} SerialWriter;
+
+/* Make room for n more bytes, doubling the buffer so a whole dump costs
+ * O(log size) reallocations */
+static int writer_reserve(SerialWriter* w, Py_ssize_t n) {
+  Py_ssize_t used, size;
+
+  if (w->end - w->p >= n) {
+    return 0;
   }
 
-  for (i = 0; i < 5; i++) {
-    PyObject* key = PyString_FromFormat("key%d", i);
-    PyObject* value = PyInt_FromLong(i * 10);
-    PyDict_SetItem(dict, key, value);
-    Py_DECREF(key);
-    Py_DECREF(value);
+  used = w->p - PyString_AS_STRING(w->out);
+  size = PyString_GET_SIZE(w->out);
+  if (n > PY_SSIZE_T_MAX - used) {
+    PyErr_NoMemory();
+    return -1;
+  }
+  while (size - used < n) {
+    size = size > PY_SSIZE_T_MAX / 2 ? PY_SSIZE_T_MAX : size * 2;
   }
 
-  return dict;
+  if (_PyString_Resize(&w->out, size) < 0) {
+    return -1;
+  }
+  w->p = PyString_AS_STRING(w->out) + used;
+  w->end = PyString_AS_STRING(w->out) + size;
+  return 0;
 }
 
-static PyObject* dict_has_key(PyObject* self, PyObject* args) {
-  PyObject* dict;
-  const char* key;
-
-  if (!PyArg_ParseTuple(args, "O!s", &PyDict_Type, &dict, &key)) {
-    return NULL;
+static int writer_tag(SerialWriter* w, char tag) {
+  if (writer_reserve(w, 1) < 0) {
+    return -1;
   }
+  *w->p++ = tag;
+  return 0;
+}
 
-  if (PyDict_GetItemString(dict, key) != NULL) {
-    Py_RETURN_TRUE;
-  } else {
-    Py_RETURN_FALSE;
+/* Callers reserve SERIAL_VARINT_MAX bytes first */
+static void writer_varint(SerialWriter* w, unsigned PY_LONG_LONG v) {
+  while (v >= 0x80) {
+    *w->p++ = (char)(v | 0x80);
+    v >>= 7;
   }
+  *w->p++ = (char)v;
 }
 
-static PyObject* merge_dicts(PyObject* self, PyObject* args) {
-  PyObject *dict1, *dict2, *result;
+static unsigned PY_LONG_LONG zigzag(PY_LONG_LONG v) {
+  return v < 0 ? ~((unsigned PY_LONG_LONG)v << 1)
+               : (unsigned PY_LONG_LONG)v << 1;
+}
 
-  if (!PyArg_ParseTuple(args, "O!O!", &PyDict_Type, &dict1, &PyDict_Type,
-                        &dict2)) {
-    return NULL;
+static int writer_tag_varint(SerialWriter* w, char tag,
+                             unsigned PY_LONG_LONG v) {
+  if (writer_reserve(w, 1 + SERIAL_VARINT_MAX) < 0) {
+    return -1;
   }
+  *w->p++ = tag;
+  writer_varint(w, v);
+  return 0;
+}
 
-  result = PyDict_Copy(dict1);
-  if (result == NULL) {
-    return NULL;
+static int writer_bytes(SerialWriter* w, char tag, const char* data,
+                        Py_ssize_t size) {
+  if (writer_reserve(w, 1 + SERIAL_VARINT_MAX + size) < 0) {
+    return -1;
   }
+  *w->p++ = tag;
+  writer_varint(w, (unsigned PY_LONG_LONG)size);
+  memcpy(w->p, data, size);
+  w->p += size;
+  return 0;
+}
 
-  if (PyDict_Update(result, dict2) < 0) {
-    Py_DECREF(result);
-    return NULL;
+/* Write a memo reference if obj was seen before, otherwise remember it.
+ * Returns 1 when a reference was written, 0 when obj is new, -1 on error. */
+static int writer_memo(SerialWriter* w, PyObject* memo, PyObject* obj) {
+  PyObject* index = PyDict_GetItem(memo, obj);
+  int status;
+
+  if (index != NULL) {
+    return writer_tag_varint(w, SERIAL_MEMO,
+                             (unsigned PY_LONG_LONG)PyInt_AS_LONG(index)) < 0
+               ? -1
+               : 1;
   }
 
-  return result;
+  index = PyInt_FromSsize_t(w->memo_size);
+  if (index == NULL) {
+    return -1;
+  }
+  status = PyDict_SetItem(memo, obj, index);
+  Py_DECREF(index);
+  if (status < 0) {
+    return -1;
+  }
+  w->memo_size++;
+  return 0;
 }
 
-/* ============================================================================
- * TUPLE OPERATIONS
- * ============================================================================
- */
+static int serial_dump(SerialWriter* w, PyObject* obj);
 
-static PyObject* create_tuple(PyObject* self, PyObject* args) {
-  int size;
-  PyObject* tuple;
-  int i;
+static int serial_dump_long(SerialWriter* w, PyObject* obj) {
+  int overflow;
+  PY_LONG_LONG v = PyLong_AsLongLongAndOverflow(obj, &overflow);
+  size_t bits;
+  Py_ssize_t size;
 
-  if (!PyArg_ParseTuple(args, "i", &size)) {
-    return NULL;
+  if (v == -1 && PyErr_Occurred()) {
+    return -1;
+  }
+  if (!overflow) {
+    return writer_tag_varint(w, SERIAL_LONG, zigzag(v));
   }
 
-  tuple = PyTuple_New(size);
-  if (tuple == NULL) {
-    return NULL;
+  bits = _PyLong_NumBits(obj);
+  if (bits == (size_t)-1 && PyErr_Occurred()) {
+    return -1;
+  }
+  size = (Py_ssize_t)(bits / 8 + 1); /* + 1 leaves room for the sign bit */
+  if (writer_reserve(w, 1 + SERIAL_VARINT_MAX + size) < 0) {
+    return -1;
+  }
+  *w->p++ = SERIAL_BIGLONG;
+  writer_varint(w, (unsigned PY_LONG_LONG)size);
+  if (_PyLong_AsByteArray((PyLongObject*)obj, (unsigned char*)w->p, size, 1,
+                          1) < 0) {
+    return -1;
   }
+  w->p += size;
+  return 0;
+}
+
+static int serial_dump_items(SerialWriter* w, char tag, PyObject* seq) {
+  Py_ssize_t size = PySequence_Fast_GET_SIZE(seq);
+  PyObject** items = PySequence_Fast_ITEMS(seq);
+  Py_ssize_t i;
 
+  if (writer_tag_varint(w, tag, (unsigned PY_LONG_LONG)size) < 0) {
+    return -1;
+  }
   for (i = 0; i < size; i++) {
-    PyObject* item = PyInt_FromLong(i + 1);
-    PyTuple_SET_ITEM(tuple, i, item);
+    if (serial_dump(w, items[i]) < 0) {
+      return -1;
+    }
   }
-
-  return tuple;
+  return 0;
 }
 
-static PyObject* tuple_element(PyObject* self, PyObject* args) {
-  PyObject* tuple;
-  int index;
-  PyObject* item;
+static int serial_dump_container(SerialWriter* w, PyObject* obj) {
+  Py_ssize_t pos = 0;
+  PyObject *key, *value;
+  long hash;
 
-  if (!PyArg_ParseTuple(args, "O!i", &PyTuple_Type, &tuple, &index)) {
-    return NULL;
+  if (PyList_CheckExact(obj)) {
+    return serial_dump_items(w, SERIAL_LIST, obj);
   }
 
-  if (index < 0 || index >= PyTuple_Size(tuple)) {
-    PyErr_SetString(PyExc_IndexError, "tuple index out of range");
-    return NULL;
+  if (PyTuple_CheckExact(obj)) {
+    return serial_dump_items(w, SERIAL_TUPLE, obj);
   }
 
-  item = PyTuple_GetItem(tuple, index);
-  Py_INCREF(item);
-  return item;
+  if (PyDict_CheckExact(obj)) {
+    Py_ssize_t size = PyDict_Size(obj);
+    if (writer_tag_varint(w, SERIAL_DICT, (unsigned PY_LONG_LONG)size) < 0) {
+      return -1;
+    }
+    while (PyDict_Next(obj, &pos, &key, &value)) {
+      if (serial_dump(w, key) < 0 || serial_dump(w, value) < 0) {
+        return -1;
+      }
+    }
+    return 0;
+  }
+
+  if (PyAnySet_CheckExact(obj)) {
+    Py_ssize_t size = PySet_GET_SIZE(obj);
+    char tag = PyFrozenSet_CheckExact(obj) ? SERIAL_FROZENSET : SERIAL_SET;
+    if (writer_tag_varint(w, tag, (unsigned PY_LONG_LONG)size) < 0) {
+      return -1;
+    }
+    while (_PySet_NextEntry(obj, &pos, &key, &hash)) {
+      if (serial_dump(w, key) < 0) {
+        return -1;
+      }
+    }
+    return 0;
+  }
+
+  PyErr_Format(PyExc_TypeError, "cannot serialize %.200s objects",
+               Py_TYPE(obj)->tp_name);
+  return -1;
 }
 
-/* ============================================================================
- * SET OPERATIONS
- * ============================================================================
- */
+static int serial_dump(SerialWriter* w, PyObject* obj) {
+  int status;
 
-static PyObject* create_set(PyObject* self, PyObject* args) {
-  PyObject* list;
-  PyObject* set;
+  if (obj == Py_None) {
+    return writer_tag(w, SERIAL_NONE);
+  }
+  if (PyBool_Check(obj)) {
+    return writer_tag(w, obj == Py_True ? SERIAL_TRUE : SERIAL_FALSE);
+  }
+  if (PyInt_CheckExact(obj)) {
+    return writer_tag_varint(w, SERIAL_INT, zigzag(PyInt_AS_LONG(obj)));
+  }
+  if (PyLong_CheckExact(obj)) {
+    return serial_dump_long(w, obj);
+  }
+  if (PyFloat_CheckExact(obj)) {
+    if (writer_reserve(w, 9) < 0) {
+      return -1;
+    }
+    *w->p++ = SERIAL_FLOAT;
+    if (_PyFloat_Pack8(PyFloat_AS_DOUBLE(obj), (unsigned char*)w->p, 1) < 0) {
+      return -1;
+    }
+    w->p += 8;
+    return 0;
+  }
 
-  if (!PyArg_ParseTuple(args, "O!", &PyList_Type, &list)) {
-    return NULL;
+  if (PyString_CheckExact(obj)) {
+    status = writer_memo(w, w->strings, obj);
+    if (status != 0) {
+      return status < 0 ? -1 : 0;
+    }
+    return writer_bytes(w, SERIAL_STR, PyString_AS_STRING(obj),
+                        PyString_GET_SIZE(obj));
+  }
+  if (PyUnicode_CheckExact(obj)) {
+    PyObject* utf8;
+    status = writer_memo(w, w->unicodes, obj);
+    if (status != 0) {
+      return status < 0 ? -1 : 0;
+    }
+    utf8 = PyUnicode_AsUTF8String(obj);
+    if (utf8 == NULL) {
+      return -1;
+    }
+    status = writer_bytes(w, SERIAL_UNICODE, PyString_AS_STRING(utf8),
+                          PyString_GET_SIZE(utf8));
+    Py_DECREF(utf8);
+    return status;
   }
 
-  set = PySet_New(list);
-  return set;
+  if (Py_EnterRecursiveCall(" while serializing")) {
+    return -1;
+  }
+  status = serial_dump_container(w, obj);
+  Py_LeaveRecursiveCall();
+  return status;
 }
 
-static PyObject* set_operations(PyObject* self, PyObject* args) {
-  PyObject *set1, *set2;
-  PyObject* result;
+static PyObject* serial_dumps(PyObject* self, PyObject* args,
+                              PyObject* kwargs) {
+  PyObject* obj;
+  Py_ssize_t size_hint = 0;
+  static char* kwlist[] = {"obj", "size_hint", NULL};
+  SerialWriter w;
+  PyObject* result = NULL;
 
-  if (!PyArg_ParseTuple(args, "O!O!", &PySet_Type, &set1, &PySet_Type, &set2)) {
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|n", kwlist, &obj,
+                                   &size_hint)) {
     return NULL;
   }
 
-  /* Create union */
-  result = PyNumber_Or(set1, set2);
+  /* Start from the caller's estimate, or a guess from the top-level size,
+   * so a typical record is written without any reallocation */
+  if (size_hint <= 0) {
+    Py_ssize_t items = PyObject_Size(obj);
+    if (items < 0) {
+      PyErr_Clear();
+      items = 0;
+    }
+    size_hint = SERIAL_INITIAL_SIZE +
+                (items < PY_SSIZE_T_MAX / 16 ? items * 16 : 0);
+  }
+
+  memset(&w, 0, sizeof(w));
+  w.out = PyString_FromStringAndSize(NULL, size_hint);
+  w.strings = PyDict_New();
+  w.unicodes = PyDict_New();
+  if (w.out == NULL || w.strings == NULL || w.unicodes == NULL) {
+    goto done;
+  }
+  w.p = PyString_AS_STRING(w.out);
+  w.end = w.p + size_hint;
+
+  if (serial_dump(&w, obj) < 0 ||
+      _PyString_Resize(&w.out, w.p - PyString_AS_STRING(w.out)) < 0) {
+    goto done;
+  }
+  result = w.out;
+  w.out = NULL;
 
+done:
+  Py_XDECREF(w.out);
+  Py_XDECREF(w.strings);
+  Py_XDECREF(w.unicodes);
   return result;
 }
 
-/* ============================================================================
- * OBJECT ATTRIBUTE ACCESS
- * ============================================================================
- */
+typedef struct {
+  const unsigned char* p;
+  const unsigned char* end;
+  PyObject* memo; /* strings in the order they were first written */
+} SerialReader;
 
-static PyObject* get_object_attr(PyObject* self, PyObject* args) {
-  PyObject* obj;
-  const char* attr_name;
-  PyObject* attr;
+static int reader_truncated(void) {
+  PyErr_SetString(PyExc_ValueError, "serialized data is truncated");
+  return -1;
+}
 
-  if (!PyArg_ParseTuple(args, "Os", &obj, &attr_name)) {
-    return NULL;
+static int reader_varint(SerialReader* r, unsigned PY_LONG_LONG* v) {
+  unsigned PY_LONG_LONG result = 0;
+  int shift;
+
+  for (shift = 0; shift < 64; shift += 7) {
+    unsigned char byte;
+    if (r->p >= r->end) {
+      return reader_truncated();
+    }
+    byte = *r->p++;
+    result |= (unsigned PY_LONG_LONG)(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      *v = result;
+      return 0;
+    }
   }
 
-  attr = PyObject_GetAttrString(obj, attr_name);
-  if (attr == NULL) {
-    PyErr_Clear();
-    Py_RETURN_NONE;
+  PyErr_SetString(PyExc_ValueError, "serialized varint is too long");
+  return -1;
+}
+
+/* A length or count: it can never exceed the bytes left, since every byte
+ * of a string and every item of a container takes at least one byte */
+static int reader_length(SerialReader* r, Py_ssize_t* length) {
+  unsigned PY_LONG_LONG v;
+
+  if (reader_varint(r, &v) < 0) {
+    return -1;
   }
+  if (v > (unsigned PY_LONG_LONG)(r->end - r->p)) {
+    return reader_truncated();
+  }
+  *length = (Py_ssize_t)v;
+  return 0;
+}
 
-  return attr;
+static PY_LONG_LONG unzigzag(unsigned PY_LONG_LONG v) {
+  return (PY_LONG_LONG)(v >> 1) ^ -(PY_LONG_LONG)(v & 1);
 }
 
-static PyObject* set_object_attr(PyObject* self, PyObject* args) {
-  PyObject* obj;
-  const char* attr_name;
-  PyObject* value;
+static PyObject* serial_load(SerialReader* r);
 
-  if (!PyArg_ParseTuple(args, "OsO", &obj, &attr_name, &value)) {
-    return NULL;
+static PyObject* reader_memoize(SerialReader* r, PyObject* obj) {
+  if (obj != NULL && PyList_Append(r->memo, obj) < 0) {
+    Py_CLEAR(obj);
   }
+  return obj;
+}
+
+static PyObject* serial_load_container(SerialReader* r, unsigned char tag) {
+  Py_ssize_t size, i;
+  PyObject* result;
 
-  if (PyObject_SetAttrString(obj, attr_name, value) < 0) {
+  if (reader_length(r, &size) < 0) {
     return NULL;
   }
 
-  Py_RETURN_NONE;
+  switch (tag) {
+    case SERIAL_LIST:
+    case SERIAL_TUPLE:
+      result = tag == SERIAL_LIST ? PyList_New(size) : PyTuple_New(size);
+      if (result == NULL) {
+        return NULL;
+      }
+      for (i = 0; i < size; i++) {
+        PyObject* item = serial_load(r);
+        if (item == NULL) {
+          Py_DECREF(result);
+          return NULL;
+        }
+        if (tag == SERIAL_LIST) {
+          PyList_SET_ITEM(result, i, item);
+        } else {
+          PyTuple_SET_ITEM(result, i, item);
+        }
+      }
+      return result;
+
+    case SERIAL_DICT:
+      result = PyDict_New();
+      if (result == NULL) {
+        return NULL;
+      }
+      for (i = 0; i < size; i++) {
+        PyObject* key = serial_load(r);
+        PyObject* value = key != NULL ? serial_load(r) : NULL;
+        int status = value != NULL ? PyDict_SetItem(result, key, value) : -1;
+        Py_XDECREF(key);
+        Py_XDECREF(value);
+        if (status < 0) {
+          Py_DECREF(result);
+          return NULL;
+        }
+      }
+      return result;
+
+    default: /* SERIAL_SET, SERIAL_FROZENSET */
+      result = tag == SERIAL_SET ? PySet_New(NULL) : PyFrozenSet_New(NULL);
+      if (result == NULL) {
+        return NULL;
+      }
+      for (i = 0; i < size; i++) {
+        PyObject* item = serial_load(r);
+        int status = item != NULL ? PySet_Add(result, item) : -1;
+        Py_XDECREF(item);
+        if (status < 0) {
+          Py_DECREF(result);
+          return NULL;
+        }
+      }
+      return result;
+  }
 }
 
-static PyObject* has_attribute(PyObject* self, PyObject* args) {
-  PyObject* obj;
-  const char* attr_name;
+static PyObject* serial_load(SerialReader* r) {
+  unsigned PY_LONG_LONG v;
+  Py_ssize_t size;
+  unsigned char tag;
+  PyObject* result;
 
-  if (!PyArg_ParseTuple(args, "Os", &obj, &attr_name)) {
+  if (r->p >= r->end) {
+    reader_truncated();
     return NULL;
   }
+  tag = *r->p++;
+
+  switch (tag) {
+    case SERIAL_NONE:
+      Py_RETURN_NONE;
+    case SERIAL_TRUE:
+      Py_RETURN_TRUE;
+    case SERIAL_FALSE:
+      Py_RETURN_FALSE;
+
+    case SERIAL_INT:
+    case SERIAL_LONG:
+      if (reader_varint(r, &v) < 0) {
+        return NULL;
+      }
+      if (tag == SERIAL_INT && unzigzag(v) >= LONG_MIN &&
+          unzigzag(v) <= LONG_MAX) {
+        return PyInt_FromLong((long)unzigzag(v));
+      }
+      return PyLong_FromLongLong(unzigzag(v));
+
+    case SERIAL_BIGLONG:
+      if (reader_length(r, &size) < 0) {
+        return NULL;
+      }
+      result = _PyLong_FromByteArray(r->p, size, 1, 1);
+      r->p += size;
+      return result;
+
+    case SERIAL_FLOAT: {
+      double x;
+      if (r->end - r->p < 8) {
+        reader_truncated();
+        return NULL;
+      }
+      x = _PyFloat_Unpack8(r->p, 1);
+      r->p += 8;
+      if (x == -1.0 && PyErr_Occurred()) {
+        return NULL;
+      }
+      return PyFloat_FromDouble(x);
+    }
 
-  if (PyObject_HasAttrString(obj, attr_name)) {
-    Py_RETURN_TRUE;
-  } else {
-    Py_RETURN_FALSE;
+    case SERIAL_STR:
+    case SERIAL_UNICODE:
+      if (reader_length(r, &size) < 0) {
+        return NULL;
+      }
+      result = tag == SERIAL_STR
+                   ? PyString_FromStringAndSize((const char*)r->p, size)
+                   : PyUnicode_DecodeUTF8((const char*)r->p, size, "strict");
+      r->p += size;
+      return reader_memoize(r, result);
+
+    case SERIAL_MEMO:
+      if (reader_varint(r, &v) < 0) {
+        return NULL;
+      }
+      if (v >= (unsigned PY_LONG_LONG)PyList_GET_SIZE(r->memo)) {
+        PyErr_SetString(PyExc_ValueError,
+                        "serialized memo reference out of range");
+        return NULL;
+      }
+      result = PyList_GET_ITEM(r->memo, (Py_ssize_t)v);
+      Py_INCREF(result);
+      return result;
+
+    case SERIAL_LIST:
+    case SERIAL_TUPLE:
+    case SERIAL_DICT:
+    case SERIAL_SET:
+    case SERIAL_FROZENSET:
+      if (Py_EnterRecursiveCall(" while deserializing")) {
+        return NULL;
+      }
+      result = serial_load_container(r, tag);
+      Py_LeaveRecursiveCall();
+      return result;
+
+    default:
+      PyErr_Format(PyExc_ValueError, "invalid serialized tag 0x%02x",
+                   (int)tag);
+      return NULL;
   }
 }
 
-/* ============================================================================
- * TYPE CHECKING
- * ============================================================================
- */
-
-static PyObject* get_object_type(PyObject* self, PyObject* args) {
-  PyObject* obj;
-  const char* type_name;
+/* Decode one record starting at r->p; the memo starts empty per record */
+static PyObject* serial_load_record(SerialReader* r) {
+  PyObject* result;
 
-  if (!PyArg_ParseTuple(args, "O", &obj)) {
+  r->memo = PyList_New(0);
+  if (r->memo == NULL) {
     return NULL;
   }
+  result = serial_load(r);
+  Py_CLEAR(r->memo);
+  return result;
+}
+
+/* Get a read-only view of any buffer. New-style exporters stay locked
+ * while the view is held. Old-style buffers (mmap.mmap, array.array in
+ * Python 2.7) can be closed or resized at any time through their pointer,
+ * so their contents are copied into a str once and the view is of that. */
+static int serial_get_buffer(PyObject* obj, Py_buffer* view) {
+  const void* data;
+  Py_ssize_t size;
+  PyObject* copy;
+  int status;
+
+  if (PyObject_CheckBuffer(obj)) {
+    return PyObject_GetBuffer(obj, view, PyBUF_SIMPLE);
+  }
+  if (PyObject_AsReadBuffer(obj, &data, &size) < 0) {
+    return -1;
+  }
 
-  type_name = obj->ob_type->tp_name;
-  return PyString_FromString(type_name);
+  copy = PyString_FromStringAndSize((const char*)data, size);
+  if (copy == NULL) {
+    return -1;
+  }
+  status = PyObject_GetBuffer(copy, view, PyBUF_SIMPLE);
+  Py_DECREF(copy); /* the view holds its own reference */
+  return status;
 }
 
-static PyObject* check_type(PyObject* self, PyObject* args) {
-  PyObject* obj;
-  PyObject* dict;
+static PyObject* serial_loads(PyObject* self, PyObject* data) {
+  Py_buffer view;
+  SerialReader r;
+  PyObject* result;
 
-  if (!PyArg_ParseTuple(args, "O", &obj)) {
+  if (serial_get_buffer(data, &view) < 0) {
     return NULL;
   }
 
-  dict = PyDict_New();
-
-  PyDict_SetItemString(dict, "is_int", PyBool_FromLong(PyInt_Check(obj)));
-  PyDict_SetItemString(dict, "is_long", PyBool_FromLong(PyLong_Check(obj)));
-  PyDict_SetItemString(dict, "is_float", PyBool_FromLong(PyFloat_Check(obj)));
-  PyDict_SetItemString(dict, "is_string", PyBool_FromLong(PyString_Check(obj)));
-  PyDict_SetItemString(dict, "is_unicode",
-                       PyBool_FromLong(PyUnicode_Check(obj)));
-  PyDict_SetItemString(dict, "is_list", PyBool_FromLong(PyList_Check(obj)));
-  PyDict_SetItemString(dict, "is_tuple", PyBool_FromLong(PyTuple_Check(obj)));
-  PyDict_SetItemString(dict, "is_dict", PyBool_FromLong(PyDict_Check(obj)));
-  PyDict_SetItemString(dict, "is_set", PyBool_FromLong(PySet_Check(obj)));
+  r.p = (const unsigned char*)view.buf;
+  r.end = r.p + view.len;
+  result = serial_load_record(&r);
+  if (result != NULL && r.p != r.end) {
+    PyErr_Format(PyExc_ValueError,
+                 "%zd bytes of trailing data after the record (use "
+                 "load_iter for concatenated records)",
+                 (Py_ssize_t)(r.end - r.p));
+    Py_CLEAR(result);
+  }
 
-  return dict;
+  PyBuffer_Release(&view);
+  return result;
 }
 
-/* ============================================================================
- * OBJECT COMPARISON
- * ============================================================================
- */
+/* A LoadIterator walks records concatenated in one buffer, holding the
+ * buffer exported until it is exhausted or deallocated */
+typedef struct {
+  PyObject_HEAD Py_buffer view;
+  Py_ssize_t offset; /* start of the next record */
+  int active;        /* view is held */
+} LoadIterator;
 
-static PyObject* compare_objects(PyObject* self, PyObject* args) {
-  PyObject *obj1, *obj2;
-  int result;
+static PyTypeObject LoadIteratorType;
 
-  if (!PyArg_ParseTuple(args, "OO", &obj1, &obj2)) {
+static void load_iter_finish(LoadIterator* self) {
+  if (self->active) {
+    self->active = 0;
+    PyBuffer_Release(&self->view);
+  }
+}
+
+static PyObject* load_iter(PyObject* self, PyObject* data) {
+  LoadIterator* iter = PyObject_New(LoadIterator, &LoadIteratorType);
+  if (iter == NULL) {
     return NULL;
   }
 
-  result = PyObject_Compare(obj1, obj2);
+  iter->offset = 0;
+  iter->active = 0;
+  if (serial_get_buffer(data, &iter->view) < 0) {
+    Py_DECREF(iter);
+    return NULL;
+  }
+  iter->active = 1;
+  return (PyObject*)iter;
+}
 
-  if (PyErr_Occurred()) {
+static void LoadIterator_dealloc(LoadIterator* self) {
+  load_iter_finish(self);
+  PyObject_Del(self);
+}
+
+static PyObject* LoadIterator_iter(PyObject* self) {
+  Py_INCREF(self);
+  return self;
+}
+
+/* A corrupt record raises once and ends the iteration: there is no way to
+ * find where the next record would have started */
+static PyObject* LoadIterator_next(LoadIterator* self) {
+  SerialReader r;
+  PyObject* result;
+
+  if (!self->active || self->offset >= self->view.len) {
+    load_iter_finish(self);
     return NULL;
   }
 
-  return PyInt_FromLong(result);
+  r.p = (const unsigned char*)self->view.buf + self->offset;
+  r.end = (const unsigned char*)self->view.buf + self->view.len;
+  result = serial_load_record(&r);
+  if (result == NULL) {
+    load_iter_finish(self);
+    return NULL;
+  }
+
+  self->offset = r.p - (const unsigned char*)self->view.buf;
+  return result;
 }
 
+static PyMemberDef LoadIterator_members[] = {
+    {"offset", T_PYSSIZET, offsetof(LoadIterator, offset), READONLY,
+     "Byte offset of the next record"},
+    {NULL}};
+
+static PyTypeObject LoadIteratorType = {
+    PyObject_HEAD_INIT(NULL) 0,             /* ob_size */
+    "objects_module.LoadIterator",          /* tp_name */
+    sizeof(LoadIterator),                   /* tp_basicsize */
+    0,                                      /* tp_itemsize */
+    (destructor)LoadIterator_dealloc,       /* tp_dealloc */
+    0,                                      /* tp_print */
+    0,                                      /* tp_getattr */
+    0,                                      /* tp_setattr */
+    0,                                      /* tp_compare */
+    0,                                      /* tp_repr */
+    0,                                      /* tp_as_number */
+    0,                                      /* tp_as_sequence */
+    0,                                      /* tp_as_mapping */
+    0,                                      /* tp_hash */
+    0,                                      /* tp_call */
+    0,                                      /* tp_str */
+    0,                                      /* tp_getattro */
+    0,                                      /* tp_setattro */
+    0,                                      /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                     /* tp_flags */
+    "Iterator over concatenated records",   /* tp_doc */
+    0,                                      /* tp_traverse */
+    0,                                      /* tp_clear */
+    0,                                      /* tp_richcompare */
+    0,                                      /* tp_weaklistoffset */
+    LoadIterator_iter,                      /* tp_iter */
+    (iternextfunc)LoadIterator_next,        /* tp_iternext */
+    0,                                      /* tp_methods */
+    LoadIterator_members,                   /* tp_members */
+};
+
 /* ============================================================================
  * MODULE METHOD TABLE
  * ============================================================================
@@ -339,20 +2910,32 @@ static PyObject* compare_objects(PyObject* self, PyObject* args) {
 
 static PyMethodDef ObjectsMethods[] = {
     /* List operations */
-    {"create_list", create_list, METH_VARARGS,
-     "Create a list of squares.\n\nArgs:\n    size (int): Size of "
-     "list\n\nReturns:\n    list: List of squares [0, 1, 4, 9, ...]"},
-
-    {"sum_list", sum_list, METH_VARARGS,
+    {"create_list", (PyCFunction)create_list, METH_VARARGS | METH_KEYWORDS,
+     "Create a list of generated integers.\n\nArgs:\n    size (int): Size "
+     "of list\n    kind (str, optional): 'squares' (default), 'range' or "
+     "'const'\n    value (int, optional): Item value for kind='const' "
+     "(default: 0)\n    as_array (bool, optional): Return a compact "
+     "array.array('l') instead of a list\n\nReturns:\n    list: e.g. "
+     "squares [0, 1, 4, 9, ...]"},
+
+    {"sum_list", sum_list, METH_O,
      "Sum all integers in a list.\n\nArgs:\n    lst (list): List of "
      "integers\n\nReturns:\n    int: Sum of all elements"},
 
-    {"reverse_list", reverse_list, METH_VARARGS,
+    {"sum_buffer", (PyCFunction)sum_buffer, METH_VARARGS | METH_KEYWORDS,
+     "Sum the numbers in a buffer without boxing them.\n\nArgs:\n    obj: "
+     "Object exposing the buffer protocol (array.array, bytearray, "
+     "numpy array, ...)\n    pool (optional): advanced_module.Pool to "
+     "split large buffers over\n\nReturns:\n    int or float: Exact "
+     "integer sum, or float sum for 'f'/'d' buffers\n\nRaises:\n    "
+     "TypeError: If obj has no buffer or an unsupported format"},
+
+    {"reverse_list", reverse_list, METH_O,
      "Reverse a list in-place.\n\nArgs:\n    lst (list): List to "
      "reverse\n\nReturns:\n    list: The reversed list"},
 
     /* Dictionary operations */
-    {"create_dict", create_dict, METH_VARARGS,
+    {"create_dict", create_dict, METH_NOARGS,
      "Create a sample dictionary.\n\nReturns:\n    dict: Dictionary with "
      "key0-key4 mapping to 0, 10, 20, 30, 40"},
 
@@ -360,13 +2943,35 @@ static PyMethodDef ObjectsMethods[] = {
      "Check if dictionary has a key.\n\nArgs:\n    d (dict): Dictionary\n    "
      "key (str): Key to check\n\nReturns:\n    bool: True if key exists"},
 
-    {"merge_dicts", merge_dicts, METH_VARARGS,
+    {"merge_dicts", (PyCFunction)merge_dicts, METH_VARARGS | METH_KEYWORDS,
      "Merge two dictionaries.\n\nArgs:\n    dict1 (dict): First dictionary\n  "
-     "  dict2 (dict): Second dictionary\n\nReturns:\n    dict: Merged "
-     "dictionary"},
+     "  dict2 (dict): Second dictionary\n    inplace (bool): Update dict1 "
+     "instead of copying it\n    on_conflict: 'last' (default), 'first', "
+     "'sum' or a callable(key, existing, new)\n\nReturns:\n    dict: Merged "
+     "dictionary (dict1 itself when inplace)"},
+
+    {"merge_many", (PyCFunction)merge_many, METH_VARARGS | METH_KEYWORDS,
+     "Merge any number of dictionaries into a new presized one.\n\nArgs:\n"
+     "    *dicts (dict): Dictionaries, merged left to right\n    on_conflict: "
+     "'last' (default), 'first', 'sum' or a callable(key, existing, "
+     "new)\n\nReturns:\n    dict: Merged dictionary"},
+
+    {"dict_from_columns", (PyCFunction)dict_from_columns,
+     METH_VARARGS | METH_KEYWORDS,
+     "Build a presized dictionary from parallel key and value columns.\n\n"
+     "Args:\n    keys: Iterable of keys, or an int n to generate keys "
+     "prefix+'0' .. prefix+str(n-1)\n    values: Iterable of values, or a "
+     "numeric buffer (e.g. array.array) read in place\n    prefix (str): "
+     "Prefix for generated keys (default 'key_')\n\nReturns:\n    dict: "
+     "Dictionary mapping keys[i] to values[i]"},
+
+    {"dict_from_pairs", dict_from_pairs, METH_O,
+     "Build a presized dictionary from an iterable of pairs.\n\nArgs:\n    "
+     "pairs: Iterable of (key, value) sequences\n\nReturns:\n    dict: "
+     "Dictionary of the pairs, later keys winning"},
 
     /* Tuple operations */
-    {"create_tuple", create_tuple, METH_VARARGS,
+    {"create_tuple", create_tuple, METH_O,
      "Create a tuple of integers.\n\nArgs:\n    size (int): Size of "
      "tuple\n\nReturns:\n    tuple: Tuple of integers (1, 2, 3, ...)"},
 
@@ -375,13 +2980,35 @@ static PyMethodDef ObjectsMethods[] = {
      "Index\n\nReturns:\n    object: Element at index"},
 
     /* Set operations */
-    {"create_set", create_set, METH_VARARGS,
-     "Create a set from a list.\n\nArgs:\n    lst (list): Input "
-     "list\n\nReturns:\n    set: Set containing unique elements"},
-
-    {"set_union", set_operations, METH_VARARGS,
-     "Union of two sets.\n\nArgs:\n    set1 (set): First set\n    set2 (set): "
-     "Second set\n\nReturns:\n    set: Union of sets"},
+    {"create_set", create_set, METH_O,
+     "Create a set from an iterable.\n\nArgs:\n    iterable: Input "
+     "elements\n\nReturns:\n    set: Set containing unique elements"},
+
+    {"set_union", (PyCFunction)set_operations, METH_VARARGS | METH_KEYWORDS,
+     "Union of any number of sets.\n\nArgs:\n    *sets: Sets, frozensets or "
+     "iterables\n    count_only (bool): Return the cardinality without "
+     "building the set\n\nReturns:\n    set or int: Union of sets"},
+
+    {"set_intersection", (PyCFunction)set_intersection,
+     METH_VARARGS | METH_KEYWORDS,
+     "Intersection of one or more sets, iterating the smallest.\n\nArgs:\n"
+     "    *sets: Sets, frozensets or iterables\n    count_only (bool): "
+     "Return the cardinality without building the set\n\nReturns:\n    "
+     "set or int: Elements present in every operand"},
+
+    {"set_difference", (PyCFunction)set_difference,
+     METH_VARARGS | METH_KEYWORDS,
+     "Elements of the first set missing from all the others.\n\nArgs:\n    "
+     "first: Set, frozenset or iterable\n    *others: Sets to subtract\n    "
+     "count_only (bool): Return the cardinality without building the "
+     "set\n\nReturns:\n    set or int: first - others[0] - ..."},
+
+    {"set_symmetric_difference", (PyCFunction)set_symmetric_difference,
+     METH_VARARGS | METH_KEYWORDS,
+     "Elements present in an odd number of sets.\n\nArgs:\n    *sets: Sets, "
+     "frozensets or iterables\n    count_only (bool): Return the "
+     "cardinality instead of the set\n\nReturns:\n    set or int: "
+     "sets[0] ^ sets[1] ^ ..."},
 
     /* Attribute access */
     {"get_attr", get_object_attr, METH_VARARGS,
@@ -398,18 +3025,46 @@ static PyMethodDef ObjectsMethods[] = {
      "Attribute name\n\nReturns:\n    bool: True if attribute exists"},
 
     /* Type checking */
-    {"get_type", get_object_type, METH_VARARGS,
+    {"get_type", get_object_type, METH_O,
      "Get object type name.\n\nArgs:\n    obj: Object\n\nReturns:\n    str: "
      "Type name"},
 
-    {"check_type", check_type, METH_VARARGS,
+    {"check_type", check_type, METH_O,
      "Check object against all basic types.\n\nArgs:\n    obj: "
-     "Object\n\nReturns:\n    dict: Dictionary of type checks"},
+     "Object\n\nReturns:\n    int: Bitmask of the TYPE_* constants the "
+     "object matches"},
 
     {"compare", compare_objects, METH_VARARGS,
      "Compare two objects.\n\nArgs:\n    obj1: First object\n    obj2: Second "
      "object\n\nReturns:\n    int: -1, 0, or 1"},
 
+    {"sort_homogeneous", (PyCFunction)sort_homogeneous,
+     METH_VARARGS | METH_KEYWORDS,
+     "Sort a list in place, unboxed when all keys share one type.\n\nArgs:\n"
+     "    list (list): List to sort\n    key (callable, optional): Key "
+     "function, called once per item\n    reverse (bool): Sort in "
+     "descending order\n\nReturns:\n    str: The kernel used: 'int', "
+     "'float', 'str', or 'generic' for list.sort()"},
+
+    /* Serialization */
+    {"dumps", (PyCFunction)serial_dumps, METH_VARARGS | METH_KEYWORDS,
+     "Serialize to the compact tagged binary format.\n\nArgs:\n    obj: "
+     "None, bool, int, long, float, str, unicode, or a list, tuple, dict, "
+     "set or frozenset of them\n    size_hint (int, optional): Initial "
+     "output buffer size in bytes\n\nReturns:\n    str: Serialized "
+     "record"},
+
+    {"loads", serial_loads, METH_O,
+     "Deserialize one record written by dumps().\n\nArgs:\n    data: str "
+     "or other buffer holding exactly one record\n\nReturns:\n    The "
+     "deserialized object"},
+
+    {"load_iter", load_iter, METH_O,
+     "Iterate over records concatenated in one buffer.\n\nArgs:\n    "
+     "data: str, bytearray, mmap or other buffer; old-style buffers such "
+     "as mmap are copied first\n\nReturns:\n    "
+     "LoadIterator: Yields each deserialized record"},
+
     {NULL, NULL, 0, NULL}};
 
 /* ============================================================================
@@ -420,13 +3075,31 @@ static PyMethodDef ObjectsMethods[] = {
 PyMODINIT_FUNC initobjects_module(void) {
   PyObject* m;
 
+  if (PyType_Ready(&LoadIteratorType) < 0) return;
+
   m = Py_InitModule3("objects_module", ObjectsMethods,
                      "Python 2.7 C-API Tutorial: Objects Module\n\n"
                      "This module demonstrates object manipulation:\n"
                      "- List, dict, tuple, and set operations\n"
                      "- Attribute access\n"
                      "- Type checking\n"
-                     "- Object comparison");
+                     "- Object comparison and sorting\n"
+                     "- Binary serialization (dumps/loads)");
 
   if (m == NULL) return;
+  if (pycapi_instrument_module(m, ObjectsMethods) < 0) return;
+
+  Py_INCREF(&LoadIteratorType);
+  PyModule_AddObject(m, "LoadIterator", (PyObject*)&LoadIteratorType);
+
+  /* check_type() bits */
+  PyModule_AddIntConstant(m, "TYPE_INT", TYPE_INT);
+  PyModule_AddIntConstant(m, "TYPE_LONG", TYPE_LONG);
+  PyModule_AddIntConstant(m, "TYPE_FLOAT", TYPE_FLOAT);
+  PyModule_AddIntConstant(m, "TYPE_STRING", TYPE_STRING);
+  PyModule_AddIntConstant(m, "TYPE_UNICODE", TYPE_UNICODE);
+  PyModule_AddIntConstant(m, "TYPE_LIST", TYPE_LIST);
+  PyModule_AddIntConstant(m, "TYPE_TUPLE", TYPE_TUPLE);
+  PyModule_AddIntConstant(m, "TYPE_DICT", TYPE_DICT);
+  PyModule_AddIntConstant(m, "TYPE_SET", TYPE_SET);
 }
@@ -0,0 +1,87 @@
+/*
+ * Python 2.7 C-API Tutorial: Shared Module State
+ *
+ * Compiled into every tutorial module. In the separate-module build each
+ * shared object gets its own copy; in the combined _pycapi build there is
+ * one copy, so objects_module and advanced_module share the name cache.
+ * State is created on first use rather than at import.
+ */
+
+#include "shared.h"
+
+/* Attribute names seen by the attribute and method helpers, mapped to
+ * their interned copies. Bounded so a stream of unique names cannot grow
+ * it forever. */
+#define NAME_CACHE_MAX 1024
+static PyObject* name_cache = NULL;
+
+PyObject* pycapi_intern_name(PyObject* name) {
+  PyObject* cached;
+
+  if (PyUnicode_Check(name)) {
+    /* The PyObject_*Attr functions encode unicode names themselves */
+    Py_INCREF(name);
+    return name;
+  }
+
+  if (!PyString_Check(name)) {
+    PyErr_Format(PyExc_TypeError,
+                 "attribute name must be a string, not %.200s",
+                 Py_TYPE(name)->tp_name);
+    return NULL;
+  }
+
+  if (PyString_CHECK_INTERNED(name)) {
+    Py_INCREF(name);
+    return name;
+  }
+
+  if (name_cache == NULL && (name_cache = PyDict_New()) == NULL) {
+    return NULL;
+  }
+
+  cached = PyDict_GetItem(name_cache, name);
+  if (cached != NULL) {
+    Py_INCREF(cached);
+    return cached;
+  }
+
+  Py_INCREF(name);
+  if (!PyString_CheckExact(name)) {
+    return name; /* str subclasses cannot be interned */
+  }
+
+  PyString_InternInPlace(&name);
+  if (PyDict_Size(name_cache) < NAME_CACHE_MAX &&
+      PyDict_SetItem(name_cache, name, name) < 0) {
+    Py_DECREF(name);
+    return NULL;
+  }
+  return name;
+}
+
+/* Imported once; the capsule lives as long as advanced_module */
+static const PycapiPoolAPI* pool_api = NULL;
+
+int pycapi_get_pool(PyObject* obj, const PycapiPoolAPI** api) {
+  *api = NULL;
+  if (obj == NULL || obj == Py_None) {
+    return 0;
+  }
+
+  if (pool_api == NULL) {
+    pool_api = (const PycapiPoolAPI*)PyCapsule_Import(PYCAPI_POOL_CAPSULE, 0);
+    if (pool_api == NULL) {
+      return -1;
+    }
+  }
+
+  if (!PyObject_TypeCheck(obj, pool_api->pool_type)) {
+    PyErr_Format(PyExc_TypeError,
+                 "pool must be an advanced_module.Pool or None, not %.200s",
+                 Py_TYPE(obj)->tp_name);
+    return -1;
+  }
+  *api = pool_api;
+  return 1;
+}
@@ -0,0 +1,37 @@
+/*
+ * Python 2.7 C-API Tutorial: Shared Module State
+ *
+ * State used by more than one tutorial module; see shared.c.
+ */
+
+#ifndef PYCAPI_SHARED_H
+#define PYCAPI_SHARED_H
+
+#include <Python.h>
+
+/* New reference to the interned form of a str attribute name. Unicode
+ * passes through unchanged and other types raise TypeError. */
+PyObject* pycapi_intern_name(PyObject* name);
+
+/* advanced_module.Pool exports its C API as a capsule, so kernels in any
+ * module can spread work over a pool's threads. */
+#define PYCAPI_POOL_CAPSULE "advanced_module._pool_api"
+
+/* One work item: ctx is shared by every call, index runs over [0, ntasks) */
+typedef void (*pycapi_pool_fn)(void* ctx, Py_ssize_t index);
+
+typedef struct {
+  PyTypeObject* pool_type;
+  /* Call fn for every index on the pool's threads and the calling thread,
+   * returning once all calls are done. Must be called without the GIL;
+   * fn must take the GIL itself before touching Python objects. */
+  void (*run)(PyObject* pool, Py_ssize_t ntasks, pycapi_pool_fn fn,
+              void* ctx);
+} PycapiPoolAPI;
+
+/* Check a pool= argument. Returns 1 and sets *api for a Pool, 0 for NULL
+ * or None, or -1 with an exception set. Imports advanced_module on first
+ * use. */
+int pycapi_get_pool(PyObject* obj, const PycapiPoolAPI** api);
+
+#endif /* PYCAPI_SHARED_H */
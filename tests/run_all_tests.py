@@ -22,6 +22,7 @@ def discover_tests():
         'test_memory_module',
         'test_exceptions_module',
         'test_advanced_module',
+        'test_combined_module',
     ]
 
     suites = []
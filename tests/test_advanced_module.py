@@ -11,7 +11,12 @@ Tests advanced C-API topics:
 - Unicode handling
 """
 
+import array
+import os
+import struct
 import sys
+import tempfile
+import types
 import unittest
 
 
@@ -70,6 +75,64 @@ class TestAdvancedModule(unittest.TestCase):
         result = self.module.call_with_kwargs(greet, ("Bob",), {})
         self.assertEqual(result, "Hello, Bob!")
 
+    def test_call_many(self):
+        """Test mapping a callable over argument tuples"""
+
+        def add(a, b):
+            return a + b
+
+        result = self.module.call_many(add, [(1, 2), (3, 4), (5, 6)])
+        self.assertEqual(result, [3, 7, 11])
+        self.assertEqual(self.module.call_many(add, []), [])
+
+    def test_call_many_single_arguments(self):
+        """Test that non-tuple items are passed as one argument"""
+        result = self.module.call_many(len, ["a", [1, 2], "abc"])
+        self.assertEqual(result, [1, 2, 3])
+
+        squares = self.module.call_many(lambda x: x * x, (i for i in range(5)))
+        self.assertEqual(squares, [0, 1, 4, 9, 16])
+
+    def test_call_many_kept_arguments(self):
+        """Test that argument tuples kept by the callee are not reused"""
+        kept = []
+
+        def keep(*args):
+            kept.append(args)
+
+        self.module.call_many(keep, [1, 2, 3])
+        self.assertEqual(kept, [(1,), (2,), (3,)])
+
+    def test_call_many_kwargs_and_collect(self):
+        """Test shared keyword arguments and discarding results"""
+
+        def greet(name, greeting="Hello"):
+            return "%s, %s!" % (greeting, name)
+
+        result = self.module.call_many(greet, ["Ann", "Bob"], {"greeting": "Hi"})
+        self.assertEqual(result, ["Hi, Ann!", "Hi, Bob!"])
+        self.assertEqual(self.module.call_many(greet, ["Ann"], collect=False), 1)
+
+        with self.assertRaises(TypeError):
+            self.module.call_many(greet, ["Ann"], ["not", "a", "dict"])
+
+    def test_call_many_stops_on_error(self):
+        """Test that the first exception stops the batch"""
+        calls = []
+
+        def check(x):
+            calls.append(x)
+            if x == 2:
+                raise ValueError("bad item")
+            return x
+
+        with self.assertRaises(ValueError):
+            self.module.call_many(check, [1, 2, 3])
+        self.assertEqual(calls, [1, 2])
+
+        with self.assertRaises(TypeError):
+            self.module.call_many(123, [1])
+
     def test_call_method(self):
         """Test calling object methods"""
         test_list = [1, 2, 3]
@@ -86,6 +149,50 @@ class TestAdvancedModule(unittest.TestCase):
         self.assertEqual(result, 1)
         self.assertEqual(test_list, [2, 3])
 
+    def test_call_method_dynamic_name(self):
+        """Test method names built at runtime"""
+        test_list = [3, 1, 2]
+        name = "".join(["so", "rt"])
+        self.assertIsNone(self.module.call_method(test_list, name, None))
+        self.assertEqual(test_list, [1, 2, 3])
+
+        with self.assertRaises(TypeError):
+            self.module.call_method(test_list, 42, None)
+
+    def test_bound_method(self):
+        """Test resolving a method once and calling it repeatedly"""
+        test_list = []
+        append = self.module.bound_method(test_list, "append")
+        self.assertIsInstance(append, self.module.BoundMethod)
+        for i in range(3):
+            append(i)
+        self.assertEqual(test_list, [0, 1, 2])
+        self.assertIs(append.obj, test_list)
+        self.assertEqual(append.name, "append")
+
+    def test_bound_method_kwargs(self):
+        """Test that handles forward keyword arguments"""
+        handle = self.module.bound_method({"a": 1}, "get")
+        self.assertEqual(handle("a"), 1)
+
+        class Greeter(object):
+            def greet(self, name, greeting="Hello"):
+                return "%s, %s!" % (greeting, name)
+
+        handle = self.module.bound_method(Greeter(), "greet")
+        self.assertEqual(handle("Ann", greeting="Hi"), "Hi, Ann!")
+
+    def test_bound_method_errors(self):
+        """Test missing and non-callable attributes"""
+        with self.assertRaises(AttributeError):
+            self.module.bound_method([], "missing_method")
+
+        class Holder(object):
+            value = 42
+
+        with self.assertRaises(TypeError):
+            self.module.bound_method(Holder(), "value")
+
     # ========================================================================
     # Iterator Protocol
     # ========================================================================
@@ -109,8 +216,12 @@ class TestAdvancedModule(unittest.TestCase):
         """Test range iterator with negative step"""
         iterator = self.module.range_iterator(10, 0, -2)
         result = list(iterator)
-        # Will produce values from 10 down
-        self.assertTrue(len(result) == 0 or result[0] == 10)
+        self.assertEqual(result, [10, 8, 6, 4, 2])
+
+    def test_range_iterator_zero_step(self):
+        """Test that a zero step is rejected"""
+        with self.assertRaises(ValueError):
+            self.module.range_iterator(0, 10, 0)
 
     def test_range_iterator_empty(self):
         """Test range iterator that produces no values"""
@@ -208,6 +319,118 @@ class TestAdvancedModule(unittest.TestCase):
         # Name should be truncated to 49 chars (+ null terminator)
         self.assertLessEqual(len(data['name']), 50)
 
+    def test_point_in_shared_buffer(self):
+        """Test points stored in and read back from a caller's buffer"""
+        import memory_module
+
+        size = self.module.POINT_SIZE
+        shared = memory_module.SharedBuffer(2 * size)
+        point = self.module.create_point(3, 4, "shm", buffer=shared, offset=size)
+        self.assertEqual(
+            self.module.get_point(point), {'x': 3, 'y': 4, 'name': 'shm'}
+        )
+
+        other = memory_module.attach_shared(shared.name)
+        again = self.module.point_at(other, size)
+        self.assertEqual(self.module.get_point(again)['name'], 'shm')
+        self.assertEqual(self.module.get_point(self.module.point_at(other))['x'], 0)
+
+        # Capsules keep the buffer exported
+        self.assertRaises(BufferError, other.close)
+        del again
+        other.close()
+        del point
+        shared.close()
+
+    def test_point_in_buffer_errors(self):
+        """Test bad buffers and offsets for point_at and create_point"""
+        size = self.module.POINT_SIZE
+        data = bytearray(size)
+        self.assertRaises(ValueError, self.module.point_at, data, 2)
+        self.assertRaises(ValueError, self.module.point_at, data, -4)
+        self.assertRaises(ValueError, self.module.point_at, data, 4)
+        self.assertRaises(BufferError, self.module.point_at, "x" * size)
+        self.assertRaises(
+            ValueError, self.module.create_point, 1, 2, "a", buffer=data, offset=8
+        )
+
+    def test_point_at_unterminated_name(self):
+        """Test a name field without a NUL stops at the end of the field"""
+        size = self.module.POINT_SIZE
+        data = bytearray('n' * (2 * size))
+        point = self.module.point_at(data)
+        self.assertEqual(self.module.get_point(point)['name'], 'n' * 50)
+        del point
+
+    def test_point_array_from_points(self):
+        """Test building a PointArray from (x, y, name) tuples"""
+        points = self.module.PointArray([(1, 2, "a"), (5, -3, "b"), (0, 0, "a")])
+        self.assertEqual(len(points), 3)
+        self.assertEqual(points[1], (5, -3, "b"))
+        self.assertEqual(points.names, ["a", "b"])
+
+        with self.assertRaises(IndexError):
+            points[3]
+
+        with self.assertRaises(TypeError):
+            self.module.PointArray([(1, 2)])
+
+        with self.assertRaises(TypeError):
+            self.module.PointArray([[1, 2, "a"]])
+
+    def test_point_array_from_columns(self):
+        """Test the column-wise bulk constructor"""
+        points = self.module.PointArray.from_columns(range(100), range(100, 0, -1))
+        self.assertEqual(len(points), 100)
+        self.assertEqual(points[99], (99, 1, ""))
+
+        named = self.module.PointArray.from_columns([1, 2], [3, 4], ["p", "q"])
+        self.assertEqual(named[1], (2, 4, "q"))
+
+        with self.assertRaises(ValueError):
+            self.module.PointArray.from_columns([1], [1, 2])
+
+    def test_point_array_append(self):
+        """Test appending points one at a time"""
+        points = self.module.PointArray()
+        for i in range(20):
+            points.append(i, -i, "p%d" % (i % 2))
+        self.assertEqual(len(points), 20)
+        self.assertEqual(points[19], (19, -19, "p1"))
+        self.assertEqual(points.names, ["p0", "p1"])
+
+    def test_point_array_geometry(self):
+        """Test bounding box, translate and nearest neighbour"""
+        points = self.module.PointArray([(1, 2, "a"), (5, -3, "b"), (0, 0, "c")])
+        self.assertEqual(points.bounding_box(), (0, -3, 5, 2))
+        self.assertEqual(points.nearest(4, -2), 1)
+        self.assertEqual(points.nearest(0, 1), 2)
+
+        points.translate(10, 1)
+        self.assertEqual(points[0], (11, 3, "a"))
+        self.assertEqual(points.bounding_box(), (10, -2, 15, 3))
+
+        with self.assertRaises(OverflowError):
+            points.translate(2**31 - 1, 0)
+        self.assertEqual(points[0], (11, 3, "a"))
+
+        with self.assertRaises(ValueError):
+            self.module.PointArray().bounding_box()
+
+    def test_point_array_column_buffers(self):
+        """Test that columns are exposed through the buffer protocol"""
+        points = self.module.PointArray([(1, 2, ""), (5, -3, ""), (0, 7, "")])
+        view = memoryview(points.x)
+        self.assertEqual(view.format, "i")
+        self.assertEqual(array.array("i", view.tobytes()).tolist(), [1, 5, 0])
+
+        # The column stays valid, so resizing is refused while it is exported
+        with self.assertRaises(BufferError):
+            points.append(9, 9)
+        del view
+        points.append(9, 9)
+        self.assertEqual(len(points.y), 4)
+
     # ========================================================================
     # Module Importing
     # ========================================================================
@@ -237,6 +460,59 @@ class TestAdvancedModule(unittest.TestCase):
         with self.assertRaises(AttributeError):
             self.module.import_and_call("sys", "nonexistent_function_xyz")
 
+    def test_import_and_call_follows_sys_modules(self):
+        """Test cached lookups notice rebinding and module replacement"""
+        name = "advanced_module_plugin_test"
+        plugin = types.ModuleType(name)
+        plugin.entry = lambda: 1
+        sys.modules[name] = plugin
+        try:
+            self.assertEqual(self.module.import_and_call(name, "entry"), 1)
+            plugin.entry = lambda: 2
+            self.assertEqual(self.module.import_and_call(name, "entry"), 2)
+
+            replacement = types.ModuleType(name)
+            replacement.entry = lambda: 3
+            sys.modules[name] = replacement
+            self.assertEqual(self.module.import_and_call(name, "entry"), 3)
+
+            del sys.modules[name]
+            with self.assertRaises(ImportError):
+                self.module.import_and_call(name, "entry")
+        finally:
+            sys.modules.pop(name, None)
+
+    def test_import_and_call_not_callable(self):
+        """Test non-callable attributes are rejected"""
+        with self.assertRaises(TypeError):
+            self.module.import_and_call("sys", "maxint")
+
+    def test_resolve(self):
+        """Test resolving a callable handle"""
+        join = self.module.resolve("os.path", "join")
+        self.assertIsInstance(join, self.module.ResolvedCallable)
+        self.assertEqual(join.module_name, "os.path")
+        self.assertEqual(join.func_name, "join")
+        self.assertEqual(join("a", "b"), os.path.join("a", "b"))
+        self.assertIs(self.module.resolve("os.path", "join"), join)
+        with self.assertRaises(AttributeError):
+            self.module.resolve("os.path", "nonexistent_function_xyz")
+
+    def test_resolve_rebinding(self):
+        """Test a handle follows the attribute it was resolved from"""
+        name = "advanced_module_resolve_test"
+        plugin = types.ModuleType(name)
+        plugin.entry = lambda x: x + 1
+        sys.modules[name] = plugin
+        try:
+            handle = self.module.resolve(name, "entry")
+            self.assertEqual(handle(1), 2)
+            plugin.entry = lambda x: x * 10
+            self.assertEqual(handle(x=1), 10)
+            self.assertIs(handle.func, plugin.entry)
+        finally:
+            sys.modules.pop(name, None)
+
     # ========================================================================
     # String Formatting
     # ========================================================================
@@ -263,6 +539,74 @@ class TestAdvancedModule(unittest.TestCase):
         )
         self.assertEqual(result, "apples: 5, oranges: 3")
 
+    def test_format_string_matches_operator(self):
+        """Test cached templates agree with the % operator"""
+        cases = [
+            ("%5.2f|%-4d|%x|%%", (3.14159, 7, 255)),
+            ("%r and %s", ("quoted", [1, 2])),
+            ("%d %s", (True, True)),
+            ("%s", ((1, 2),)),
+        ]
+        for template, values in cases:
+            self.assertEqual(
+                self.module.format_string(template, values), template % values
+            )
+            # Second call goes through the cached formatter
+            self.assertEqual(
+                self.module.format_string(template, values), template % values
+            )
+
+    def test_compile_format_render(self):
+        """Test rendering a compiled template"""
+        formatter = self.module.compile_format("%s has %d items")
+        self.assertIsInstance(formatter, self.module.Formatter)
+        self.assertEqual(formatter.fields, 2)
+        self.assertEqual(formatter.template, "%s has %d items")
+        self.assertEqual(formatter.render(("cart", 3)), "cart has 3 items")
+        self.assertEqual(formatter.render(("box", -10)), "box has -10 items")
+
+    def test_compile_format_dict(self):
+        """Test rendering keyed placeholders from a mapping"""
+        formatter = self.module.compile_format("%(name)s=%(value)05.1f")
+        self.assertEqual(formatter.render({"name": "x", "value": 2.5}), "x=002.5")
+        with self.assertRaises(KeyError):
+            formatter.render({"name": "x"})
+        with self.assertRaises(TypeError):
+            formatter.render(("x", 2.5))
+
+    def test_compile_format_argument_count(self):
+        """Test argument count errors match the % operator"""
+        formatter = self.module.compile_format("%s %s")
+        with self.assertRaises(TypeError):
+            formatter.render(("one",))
+        with self.assertRaises(TypeError):
+            formatter.render(("one", "two", "three"))
+        self.assertEqual(self.module.compile_format("%s").render(5), "5")
+
+    def test_compile_format_unicode_value(self):
+        """Test a unicode value makes the result unicode"""
+        result = self.module.compile_format("<%s>").render((u"\xe9",))
+        self.assertEqual(result, u"<\xe9>")
+        self.assertIsInstance(result, unicode)
+
+    def test_compile_format_invalid(self):
+        """Test malformed templates are rejected when compiled"""
+        for template in ("%", "%(name", "%q"):
+            with self.assertRaises(ValueError):
+                self.module.compile_format(template)
+        with self.assertRaises(TypeError):
+            self.module.compile_format(42)
+
+    def test_render_many(self):
+        """Test rendering a batch of rows"""
+        formatter = self.module.compile_format("row %d: %s")
+        rows = [(i, "x" * i) for i in range(5)]
+        expected = ["row %d: %s" % row for row in rows]
+        self.assertEqual(formatter.render_many(rows), expected)
+        self.assertEqual(formatter.render_many([]), [])
+        with self.assertRaises(TypeError):
+            formatter.render_many([(1, "a"), (2,)])
+
     # ========================================================================
     # Unicode Handling
     # ========================================================================
@@ -306,6 +650,82 @@ class TestAdvancedModule(unittest.TestCase):
         result = self.module.unicode_to_str(u"")
         self.assertEqual(result, "")
 
+    def test_str_to_unicode_encoding(self):
+        """Test the encoding argument is honored"""
+        self.assertEqual(self.module.str_to_unicode("caf\xe9", "latin-1"), u"caf\xe9")
+        self.assertEqual(self.module.str_to_unicode("a\0b"), u"a\0b")
+        self.assertRaises(
+            UnicodeDecodeError, self.module.str_to_unicode, "caf\xe9", "utf-8"
+        )
+
+    # ========================================================================
+    # Streaming Transcoders
+    # ========================================================================
+
+    TEXT = u"plain ascii, caf\xe9, \u20ac5, \U0001f600 and more " * 50
+
+    def test_decoder_every_split(self):
+        """Test a character split at any chunk boundary is carried over"""
+        data = self.TEXT.encode('utf-8')
+        for size in (1, 2, 3, 5, 7, 64):
+            decoder = self.module.Utf8Decoder()
+            chunks = [data[i : i + size] for i in range(0, len(data), size)]
+            parts = [decoder.feed(chunk) for chunk in chunks]
+            parts.append(decoder.feed("", final=True))
+            self.assertEqual(u"".join(parts), self.TEXT)
+            self.assertEqual(decoder.pending, 0)
+
+    def test_decoder_large_ascii_chunk(self):
+        """Test the ASCII fast path on chunks above the GIL threshold"""
+        data = "x" * 200000
+        decoder = self.module.Utf8Decoder()
+        self.assertEqual(decoder.feed(bytearray(data)), unicode(data))
+        self.assertEqual(decoder.feed(data + "\xc3"), unicode(data))
+        self.assertEqual(decoder.pending, 1)
+        self.assertEqual(decoder.feed("\xa9"), u"\xe9")
+
+    def test_decoder_errors(self):
+        """Test strict, replace and truncated input"""
+        decoder = self.module.Utf8Decoder()
+        self.assertRaises(UnicodeDecodeError, decoder.feed, "ok\xff")
+        decoder.feed("\xe2\x82")
+        self.assertRaises(UnicodeDecodeError, decoder.feed, "", True)
+        decoder.reset()
+        self.assertEqual(decoder.pending, 0)
+
+        decoder = self.module.Utf8Decoder(errors='replace')
+        self.assertEqual(decoder.feed("a\xffb", final=True), u"a\ufffdb")
+        self.assertRaises(TypeError, decoder.feed, u"text")
+
+    def test_decoder_other_encodings(self):
+        """Test Latin-1, ASCII and codec-delegated encodings"""
+        self.assertEqual(self.module.Utf8Decoder('latin_1').feed("\xe9"), u"\xe9")
+        self.assertRaises(
+            UnicodeDecodeError, self.module.Utf8Decoder('ascii').feed, "\xe9"
+        )
+
+        decoder = self.module.Utf8Decoder('utf-16-le')
+        data = self.TEXT.encode('utf-16-le')
+        parts = [decoder.feed(data[i : i + 3]) for i in range(0, len(data), 3)]
+        self.assertEqual(u"".join(parts), self.TEXT)
+        self.assertRaises(LookupError, self.module.Utf8Decoder, 'no-such-codec')
+
+    def test_encoder(self):
+        """Test chunked encoding matches one-shot encoding"""
+        for encoding in ('utf-8', 'utf-16', 'latin-1'):
+            text = self.TEXT if encoding != 'latin-1' else u"caf\xe9 " * 10000
+            encoder = self.module.Utf8Encoder(encoding)
+            parts = [encoder.feed(text[i : i + 7]) for i in range(0, len(text), 7)]
+            parts.append(encoder.feed(u"", final=True))
+            self.assertEqual("".join(parts), text.encode(encoding))
+
+        encoder = self.module.Utf8Encoder()
+        self.assertEqual(encoder.feed(u"y" * 100000), "y" * 100000)
+        self.assertRaises(TypeError, encoder.feed, "bytes")
+        ascii_encoder = self.module.Utf8Encoder('ascii')
+        self.assertRaises(UnicodeEncodeError, ascii_encoder.feed, u"\xe9")
+        self.assertEqual(self.module.Utf8Encoder('ascii', 'replace').feed(u"\xe9"), "?")
+
 
 class TestAdvancedModuleEdgeCases(unittest.TestCase):
     """Test edge cases and complex scenarios"""
@@ -394,6 +814,119 @@ class TestAdvancedModuleIteratorDetails(unittest.TestCase):
         result2 = list(iterator)
         self.assertEqual(result2, [])
 
+    def test_range_iterator_len(self):
+        """Test len() tracks the values not yet consumed"""
+        iterator = self.module.range_iterator(0, 10, 3)
+        self.assertEqual(len(iterator), 4)
+        iterator.next()
+        self.assertEqual(len(iterator), 3)
+        self.assertEqual(len(self.module.range_iterator(5, -5, -3)), 4)
+        self.assertEqual(len(self.module.range_iterator(5, 0, 1)), 0)
+
+    def test_range_iterator_getitem(self):
+        """Test indexing into the remaining values"""
+        iterator = self.module.range_iterator(0, 10, 3)
+        self.assertEqual(iterator[0], 0)
+        self.assertEqual(iterator[-1], 9)
+        iterator.next()
+        self.assertEqual(iterator[0], 3)
+
+        with self.assertRaises(IndexError):
+            iterator[3]
+
+        with self.assertRaises(TypeError):
+            iterator['a']
+
+    def test_range_iterator_slicing(self):
+        """Test that slices are lazy RangeIterators"""
+        iterator = self.module.range_iterator(0, 20, 2)
+        part = iterator[2:8:2]
+        self.assertIsInstance(part, self.module.RangeIterator)
+        self.assertEqual(list(part), range(0, 20, 2)[2:8:2])
+        self.assertEqual(list(iterator[::-1]), range(0, 20, 2)[::-1])
+        self.assertEqual(list(iterator[5:2]), [])
+
+    def test_range_iterator_single_item_slice_step(self):
+        """Test a one-item slice with a huge step keeps a usable step"""
+        part = self.module.range_iterator(0, 2**40, 2**32)[::2**32]
+        self.assertTrue(0 in part)
+        self.assertFalse(2**32 in part)
+        self.assertEqual(list(part[::2**40]), [0])
+        self.assertEqual(list(part), [0])
+
+    def test_range_iterator_contains(self):
+        """Test O(1) membership including negative steps"""
+        iterator = self.module.range_iterator(10, -10, -3)
+        for value in range(-15, 15):
+            self.assertEqual(value in iterator, value in range(10, -10, -3))
+        self.assertFalse('a' in iterator)
+        self.assertFalse(2**100 in iterator)
+
+    def test_range_iterator_next_n(self):
+        """Test batched consumption into a list"""
+        iterator = self.module.range_iterator(0, 10)
+        self.assertEqual(iterator.next_n(4), [0, 1, 2, 3])
+        self.assertEqual(iterator.next(), 4)
+        self.assertEqual(iterator.next_n(10), [5, 6, 7, 8, 9])
+        self.assertEqual(iterator.next_n(3), [])
+
+    def test_range_iterator_next_n_buffer(self):
+        """Test batched consumption into a caller buffer"""
+        out = array.array('l', [0] * 4)
+        iterator = self.module.range_iterator(-5, 5)
+        self.assertEqual(iterator.next_n(10, out), 4)
+        self.assertEqual(out.tolist(), [-5, -4, -3, -2])
+        self.assertEqual(len(iterator), 6)
+
+    def test_iterate_length_hint(self):
+        """Test iterables whose length hint is wrong or missing"""
+
+        class Hinted(object):
+            def __init__(self, items, hint):
+                self.items = items
+                self.hint = hint
+
+            def __iter__(self):
+                return iter(self.items)
+
+            def __length_hint__(self):
+                return self.hint
+
+        self.assertEqual(self.module.iterate(Hinted([1, 2, 3], 10)), [1, 2, 3])
+        self.assertEqual(self.module.iterate(Hinted([1, 2, 3], 1)), [1, 2, 3])
+        self.assertEqual(self.module.iterate(xrange(5)), [0, 1, 2, 3, 4])
+
+    def test_iterate_returns_copy(self):
+        """Test that list input is copied, not aliased"""
+        source = [1, 2, 3]
+        result = self.module.iterate(source)
+        self.assertEqual(result, source)
+        self.assertIsNot(result, source)
+
+    def test_iterate_chunked(self):
+        """Test chunk_size mode over lists, tuples and generators"""
+        expected = [[0, 1, 2], [3, 4, 5], [6]]
+        self.assertEqual(list(self.module.iterate(range(7), chunk_size=3)), expected)
+        self.assertEqual(list(self.module.iterate(tuple(range(7)), 3)), expected)
+        chunks = self.module.iterate((i for i in range(7)), chunk_size=3)
+        self.assertIsInstance(chunks, self.module.ChunkIterator)
+        self.assertEqual(list(chunks), expected)
+        self.assertEqual(list(self.module.iterate([], chunk_size=2)), [])
+
+    def test_iterate_chunked_error(self):
+        """Test that errors inside a chunk propagate"""
+
+        def failing():
+            yield 1
+            raise ValueError("boom")
+
+        chunks = self.module.iterate(failing(), chunk_size=4)
+        with self.assertRaises(ValueError):
+            chunks.next()
+
+        with self.assertRaises(ValueError):
+            self.module.iterate([1], chunk_size=-1)
+
     def test_iterate_generator(self):
         """Test iterating over generator"""
 
@@ -406,12 +939,238 @@ class TestAdvancedModuleIteratorDetails(unittest.TestCase):
         self.assertEqual(result, [1, 2, 3])
 
 
+class TestAdvancedModulePool(unittest.TestCase):
+    """Test cases for the Pool worker threads"""
+
+    @classmethod
+    def setUpClass(cls):
+        """Import the module once for all tests"""
+        import advanced_module
+
+        cls.module = advanced_module
+
+    def test_pool_map_order(self):
+        """Test results come back in input order for any chunk size"""
+        with self.module.Pool(4) as pool:
+            self.assertEqual(pool.size, 4)
+            expected = [x * x for x in range(1000)]
+            self.assertEqual(pool.map(lambda x: x * x, range(1000)), expected)
+            self.assertEqual(pool.map(lambda x: x * x, xrange(1000), 7), expected)
+            self.assertEqual(pool.map(str, iter([1, 2])), ['1', '2'])
+            self.assertEqual(pool.map(str, []), [])
+
+    def test_pool_map_error(self):
+        """Test the exception of the lowest failing item is raised"""
+
+        def check(x):
+            if x in (300, 700):
+                raise ValueError(x)
+            return x
+
+        pool = self.module.Pool(3)
+        with self.assertRaises(ValueError) as context:
+            pool.map(check, range(1000), chunk_size=10)
+        self.assertEqual(context.exception.args, (300,))
+        self.assertRaises(TypeError, pool.map, check, 5)
+        self.assertRaises(ValueError, pool.map, check, [], chunk_size=-1)
+
+    def test_pool_map_mutating_func(self):
+        """Test func emptying the input list does not change the items mapped"""
+        items = [object() for _ in range(200)]
+        expected = [id(item) for item in items]
+
+        def clear(item):
+            del items[:]
+            return id(item)
+
+        pool = self.module.Pool(4)
+        self.assertEqual(pool.map(clear, items, 1), expected)
+        self.assertEqual(items, [])
+
+    def test_pool_nested_map(self):
+        """Test a job submitted from inside a job runs inline"""
+        pool = self.module.Pool(2)
+        result = pool.map(lambda x: sum(pool.map(abs, [x, -x])), range(20), 1)
+        self.assertEqual(result, [2 * x for x in range(20)])
+
+    def test_pool_close_from_job(self):
+        """Test closing a pool from inside its own job raises"""
+        pool = self.module.Pool(2)
+
+        def close(x):
+            try:
+                pool.close()
+            except RuntimeError:
+                return x
+            return None
+
+        self.assertEqual(pool.map(close, range(8), 1), list(range(8)))
+        pool.close()
+        self.assertIn("closed", repr(pool))
+
+    def test_pool_map_after_fork(self):
+        """Test a forked child runs the inherited pool's jobs inline"""
+        import time
+
+        pool = self.module.Pool(4)
+        pool.map(abs, range(100))
+        pid = os.fork()
+        if pid == 0:
+            status = 1
+            try:
+                if pool.map(abs, range(-50, 50)) == [abs(x) for x in range(-50, 50)]:
+                    pool.close()
+                    status = 0
+            finally:
+                os._exit(status)
+
+        deadline = time.time() + 10
+        while True:
+            done, status = os.waitpid(pid, os.WNOHANG)
+            if done or time.time() > deadline:
+                break
+            time.sleep(0.01)
+        if not done:
+            os.kill(pid, 9)
+            os.waitpid(pid, 0)
+            self.fail("map() in a forked child did not return")
+        self.assertEqual(status, 0)
+        self.assertEqual(pool.map(abs, [-1, -2]), [1, 2])
+        pool.close()
+
+    def test_pool_close(self):
+        """Test a closed pool still runs jobs on the calling thread"""
+        pool = self.module.Pool(2)
+        pool.close()
+        pool.close()
+        self.assertIn('closed', repr(pool))
+        self.assertEqual(pool.map(abs, [-1, -2]), [1, 2])
+
+    def test_pool_size(self):
+        """Test the default size and size validation"""
+        self.assertGreaterEqual(self.module.Pool().size, 1)
+        self.assertEqual(self.module.Pool(size=1).map(abs, [-3]), [3])
+        self.assertRaises(ValueError, self.module.Pool, -1)
+        self.assertRaises(TypeError, self.module.Pool, 'x')
+
+
+class TestAdvancedModuleMappedRecords(unittest.TestCase):
+    """Test cases for the MappedRecords memory-mapped reader"""
+
+    @classmethod
+    def setUpClass(cls):
+        """Import the module once for all tests"""
+        import advanced_module
+
+        cls.module = advanced_module
+
+    def write_records(self, data):
+        """Write data to a temporary file removed after the test"""
+        handle, path = tempfile.mkstemp(suffix='.bin')
+        os.write(handle, data)
+        os.close(handle)
+        self.addCleanup(os.remove, path)
+        return path
+
+    def test_scalar_records(self):
+        """Test iteration, len and indexing describe the remaining records"""
+        path = self.write_records(array.array('d', range(10)).tostring())
+        records = self.module.MappedRecords(path, 'd')
+        self.assertEqual(records.record_size, 8)
+        self.assertEqual(len(records), 10)
+        self.assertEqual((records[0], records[-1]), (0.0, 9.0))
+
+        self.assertEqual(next(records), 0.0)
+        self.assertEqual(records.next_n(3), [1.0, 2.0, 3.0])
+        self.assertEqual(len(records), 6)
+        self.assertEqual(records[0], 4.0)
+        self.assertIn(9.0, records)
+        self.assertNotIn(1.0, records)
+        self.assertEqual(len(records), 6)  # `in` does not consume
+        self.assertEqual(list(records), [4.0, 5.0, 6.0, 7.0, 8.0, 9.0])
+        self.assertRaises(IndexError, lambda: records[0])
+        records.close()
+
+    def test_compound_records(self):
+        """Test struct formats decode to tuples"""
+        data = ''.join(struct.pack('<iq', i, -i) for i in range(5))
+        path = self.write_records(data)
+        with self.module.MappedRecords(path, '<iq') as records:
+            self.assertEqual(records.record_size, 12)
+            self.assertEqual(records[2], (2, -2))
+            self.assertEqual(list(records[3:]), [(3, -3), (4, -4)])
+            self.assertEqual(memoryview(records).shape, (5, 12))
+            self.assertEqual(memoryview(records).tobytes(), data)
+        self.assertTrue(records.closed)
+
+    def test_slices_share_mapping(self):
+        """Test slices are lazy readers over the same mapping"""
+        path = self.write_records(array.array('i', range(10)).tostring())
+        records = self.module.MappedRecords(path, 'i', readahead=2)
+        backwards = records[::-3]
+        self.assertIsInstance(backwards, self.module.MappedRecords)
+        self.assertEqual(list(backwards), [9, 6, 3, 0])
+        self.assertEqual(list(records[2:8][1::2]), [3, 5, 7])
+
+        view = memoryview(records[::2])
+        self.assertEqual((view.format, view.shape, view.strides), ('i', (5,), (8,)))
+        self.assertRaises(BufferError, records.close)
+        del view, backwards
+        records.close()
+        self.assertRaises(ValueError, lambda: records[0])
+
+    def test_views_keep_their_shape(self):
+        """Test a later export after the cursor moves leaves earlier views alone"""
+        path = self.write_records(array.array('i', range(10)).tostring())
+        records = self.module.MappedRecords(path, 'i')
+        first = memoryview(records)
+        records.next_n(4)
+        second = memoryview(records)
+        self.assertEqual((first.shape, second.shape), ((10,), (6,)))
+        self.assertEqual(first.strides, (4,))
+        del first, second
+
+        one = records[2 : 2**62 : 2**61]
+        self.assertEqual(list(one), [6])
+        self.assertEqual(memoryview(one).strides, (4,))
+        del one
+        records.close()
+
+    def test_next_n_into_buffer(self):
+        """Test next_n copies raw records into a caller's buffer"""
+        path = self.write_records(array.array('d', range(6)).tostring())
+        records = self.module.MappedRecords(path, 'd', readahead=1)
+        out = array.array('d', [0.0] * 4)
+        self.assertEqual(records.next_n(10, out), 4)
+        self.assertEqual(list(out), [0.0, 1.0, 2.0, 3.0])
+        self.assertEqual(records[::-1].next_n(2, out), 2)
+        self.assertEqual(list(out[:2]), [5.0, 4.0])
+        records.advise(self.module.MADV_SEQUENTIAL)
+        records.advise(self.module.MADV_WILLNEED, 0, 1)
+        self.assertRaises(ValueError, records.next_n, -1)
+
+    def test_mapped_records_errors(self):
+        """Test bad files and dtypes are rejected"""
+        path = self.write_records('x' * 10)
+        self.assertRaises(ValueError, self.module.MappedRecords, path, 'i')
+        self.assertRaises(struct.error, self.module.MappedRecords, path, 'Z')
+        self.assertRaises(ValueError, self.module.MappedRecords, path, '0s')
+        self.assertRaises(IOError, self.module.MappedRecords, path + '.missing', 'b')
+        self.assertRaises(ValueError, self.module.MappedRecords, path, 'b', -1)
+
+        empty = self.module.MappedRecords(self.write_records(''), 'i')
+        self.assertEqual(list(empty), [])
+        self.assertEqual(memoryview(empty).tobytes(), '')
+
+
 def suite():
     """Create test suite"""
     test_suite = unittest.TestSuite()
     test_suite.addTest(unittest.makeSuite(TestAdvancedModule))
     test_suite.addTest(unittest.makeSuite(TestAdvancedModuleEdgeCases))
     test_suite.addTest(unittest.makeSuite(TestAdvancedModuleIteratorDetails))
+    test_suite.addTest(unittest.makeSuite(TestAdvancedModulePool))
+    test_suite.addTest(unittest.makeSuite(TestAdvancedModuleMappedRecords))
     return test_suite
 
 
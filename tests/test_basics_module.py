@@ -11,6 +11,8 @@ Tests fundamental C-API concepts:
 - Multiple return values
 """
 
+import array
+import ctypes
 import sys
 import unittest
 
@@ -48,6 +50,23 @@ class TestBasicsModule(unittest.TestCase):
         self.assertIn("Bob", self.module.greet_name("Bob"))
         self.assertIn("", self.module.greet_name(""))
 
+    def test_hello_world_shared_constant(self):
+        """Test hello_world returns the same interned object every call"""
+        self.assertIs(self.module.hello_world(), self.module.hello_world())
+        self.assertIs(self.module.accept_optional(), self.module.accept_optional(None))
+
+    def test_greet_name_exact_output(self):
+        """Test the presized greeting for str, unicode and subclasses"""
+
+        class Name(str):
+            pass
+
+        self.assertEqual(self.module.greet_name("Alice"), "Hello, Alice!")
+        self.assertEqual(self.module.greet_name(""), "Hello, !")
+        self.assertEqual(self.module.greet_name(u"Bob"), "Hello, Bob!")
+        self.assertEqual(self.module.greet_name(Name("Eve")), "Hello, Eve!")
+        self.assertRaises(TypeError, self.module.greet_name, "a\0b")
+
     def test_greet_name_invalid_args(self):
         """Test error handling for invalid arguments"""
         with self.assertRaises(TypeError):
@@ -192,6 +211,15 @@ class TestBasicsModule(unittest.TestCase):
         self.assertAlmostEqual(stats['square'], 9.0)
         self.assertAlmostEqual(stats['cube'], -27.0)
 
+    def test_calling_conventions(self):
+        """Test METH_NOARGS / METH_O functions enforce their arity"""
+        self.assertRaises(TypeError, self.module.hello_world, 1)
+        self.assertRaises(TypeError, self.module.return_none, None)
+        self.assertRaises(TypeError, self.module.greet_name)
+        self.assertRaises(TypeError, self.module.greet_name, "a", "b")
+        self.assertRaises(TypeError, self.module.is_even, 2.0)
+        self.assertRaises(TypeError, self.module.get_statistics, "x")
+
     def test_return_none(self):
         """Test None return value"""
         result = self.module.return_none()
@@ -266,11 +294,201 @@ class TestBasicsModuleEdgeCases(unittest.TestCase):
         self.assertIn(long_str, result)
 
 
+class TestBasicsModuleBatch(unittest.TestCase):
+    """Test cases for the buffer-based batch kernels"""
+
+    @classmethod
+    def setUpClass(cls):
+        """Import the module"""
+        import basics_module
+
+        cls.module = basics_module
+
+    def test_add_many(self):
+        """Test element-wise addition into an output array"""
+        a = array.array('l', [1, 2, 3])
+        b = array.array('l', [10, 20, 30])
+        out = array.array('l', [0] * 3)
+        self.assertIs(self.module.add_many(a, b, out), out)
+        self.assertEqual(out.tolist(), [11, 22, 33])
+
+        # In place, and wrapping like the hardware on overflow
+        big = array.array('l', [sys.maxint])
+        self.module.add_many(big, array.array('l', [1]), big)
+        self.assertEqual(big[0], -sys.maxint - 1)
+
+    def test_mul_and_pow_many(self):
+        """Test float kernels against their scalar counterparts"""
+        a = array.array('d', [0.5, -2.0, 3.0])
+        b = array.array('d', [4.0, 0.25, 3.0])
+        out = array.array('d', [0.0] * 3)
+        self.module.mul_many(a, b, out)
+        expected = [self.module.multiply_floats(x, y) for x, y in zip(a, b)]
+        self.assertEqual(out.tolist(), expected)
+
+        self.module.pow_many(a, out)
+        self.assertEqual(out.tolist(), [0.25, 4.0, 9.0])
+        self.module.pow_many(a, out, exponent=3)
+        self.assertEqual(out.tolist(), [0.125, -8.0, 27.0])
+        self.module.pow_many(b, out, exponent=a)
+        expected = [self.module.power(y, x) for x, y in zip(a, b)]
+        self.assertEqual(out.tolist(), expected)
+
+    def test_is_even_mask(self):
+        """Test the even mask and count"""
+        values = array.array('l', [0, 1, -2, -3, 4])
+        mask = bytearray(5)
+        self.assertEqual(self.module.is_even_mask(values, mask), 3)
+        self.assertEqual(list(mask), [1, 0, 1, 0, 1])
+
+    def test_divide_safe_many(self):
+        """Test zero divisors are masked instead of raising"""
+        a = array.array('d', [1.0, 2.0, 3.0, 4.0])
+        b = array.array('d', [2.0, 0.0, -0.0, 8.0])
+        out = array.array('d', [9.0] * 4)
+        mask = bytearray(4)
+        self.assertEqual(self.module.divide_safe_many(a, b, out, mask), 2)
+        self.assertEqual(out.tolist(), [0.5, 0.0, 0.0, 0.5])
+        self.assertEqual(list(mask), [0, 1, 1, 0])
+        self.assertEqual(self.module.divide_safe_many(a, b, out), 2)
+
+    def test_large_locked_buffers(self):
+        """Test the GIL-free path with new-style (ctypes) buffers"""
+        n = 100000
+        a = (ctypes.c_double * n)(*range(n))
+        b = (ctypes.c_double * n)(*([2.0] * n))
+        out = (ctypes.c_double * n)()
+        self.module.mul_many(a, b, out)
+        self.assertEqual(out[n - 1], 2.0 * (n - 1))
+
+        mask = bytearray(n)
+        b[7] = 0.0
+        self.assertEqual(self.module.divide_safe_many(a, b, out, mask), 1)
+        self.assertEqual((out[7], mask[7], out[8]), (0.0, 1, 4.0))
+
+    def test_batch_pool(self):
+        """Test pool= splits large batches with the same results"""
+        import advanced_module
+
+        pool = advanced_module.Pool(3)
+        n = 100000
+        a = (ctypes.c_double * n)(*range(n))
+        b = (ctypes.c_double * n)(*([2.0] * n))
+        out = (ctypes.c_double * n)()
+        self.assertIs(self.module.mul_many(a, b, out, pool=pool), out)
+        self.assertEqual(list(out), [2.0 * i for i in range(n)])
+        self.module.pow_many(a, out, pool=pool)
+        self.assertEqual(out[n - 1], float(n - 1) ** 2)
+        self.module.pow_many(a, out, b, pool)
+        self.assertEqual(out[12345], 12345.0**2)
+
+        longs = (ctypes.c_long * n)(*range(n))
+        self.module.add_many(longs, longs, longs, pool=pool)
+        self.assertEqual(list(longs), [2 * i for i in range(n)])
+
+        small = array.array('l', [1, 2])
+        self.assertEqual(self.module.add_many(small, small, small, None), small)
+        self.assertRaises(TypeError, self.module.add_many, small, small, small, 1)
+
+    def test_batch_errors(self):
+        """Test type, length and writability checks"""
+        longs = array.array('l', [1, 2])
+        doubles = array.array('d', [1.0, 2.0])
+        self.assertRaises(TypeError, self.module.add_many, doubles, longs, longs)
+        self.assertRaises(TypeError, self.module.add_many, [1, 2], longs, longs)
+        short = array.array('l', [1])
+        self.assertRaises(ValueError, self.module.add_many, longs, short, longs)
+        self.assertRaises(
+            (TypeError, BufferError), self.module.mul_many, doubles, doubles, 'x' * 16
+        )
+        shorts = array.array('h', [0, 0])
+        self.assertRaises(TypeError, self.module.is_even_mask, longs, shorts)
+
+    def test_batch_foreign_byte_order(self):
+        """Test buffers in the other byte order are rejected, not misread"""
+        if sys.byteorder == 'little':
+            swapped = ctypes.c_double.__ctype_be__
+        else:
+            swapped = ctypes.c_double.__ctype_le__
+        a = (swapped * 4)(1.0, 2.0, 3.0, 4.0)
+        out = (ctypes.c_double * 4)()
+        with self.assertRaises(TypeError):
+            self.module.mul_many(a, a, out)
+        with self.assertRaises(TypeError):
+            self.module.mul_many(out, out, a)
+        self.assertEqual(list(out), [0.0] * 4)
+
+
+class TestBasicsModuleStats(unittest.TestCase):
+    """Test the stats() / reset_stats() instrumentation API"""
+
+    MODULES = [
+        'example_module',
+        'basics_module',
+        'objects_module',
+        'memory_module',
+        'exceptions_module',
+        'advanced_module',
+    ]
+
+    @classmethod
+    def setUpClass(cls):
+        """Import the module"""
+        import basics_module
+
+        cls.module = basics_module
+
+    def test_every_module_has_stats(self):
+        """Test all tutorial modules expose the same API"""
+        for name in self.MODULES:
+            module = __import__(name)
+            self.assertIsInstance(module.INSTRUMENTED, bool)
+            self.assertIsInstance(module.stats(), dict)
+            self.assertIsNone(module.reset_stats())
+
+    def test_stats_empty_when_compiled_out(self):
+        """Test stats() reports nothing without PYCAPI_INSTRUMENT"""
+        if self.module.INSTRUMENTED:
+            self.skipTest("built with PYCAPI_INSTRUMENT")
+        self.module.add_numbers(1, 2)
+        self.assertEqual(self.module.stats(), {})
+
+    def test_stats_counts_calls(self):
+        """Test calls, errors and the histogram are recorded"""
+        if not self.module.INSTRUMENTED:
+            self.skipTest("built without PYCAPI_INSTRUMENT")
+        self.module.reset_stats()
+        for _ in range(10):
+            self.module.add_numbers(1, 2)
+        with self.assertRaises(TypeError):
+            self.module.add_numbers("x", 2)
+        self.module.hello_world()
+
+        entry = self.module.stats()['add_numbers']
+        self.assertEqual(entry['calls'], 11)
+        self.assertEqual(entry['errors'], 1)
+        self.assertEqual(sum(entry['histogram']), 11)
+        self.assertEqual(len(entry['histogram']), 32)
+        self.assertGreaterEqual(entry['total_ns'], 0)
+        self.assertEqual(self.module.stats()['hello_world']['calls'], 1)
+
+        self.module.reset_stats()
+        self.assertEqual(self.module.stats()['add_numbers']['calls'], 0)
+
+    def test_instrumented_arity_checks(self):
+        """Test wrapped functions keep their calling conventions"""
+        self.assertRaises(TypeError, self.module.hello_world, 1)
+        self.assertRaises(TypeError, self.module.is_even)
+        self.assertEqual(self.module.power(base=3.0, exponent=2.0), 9.0)
+
+
 def suite():
     """Create test suite"""
     test_suite = unittest.TestSuite()
     test_suite.addTest(unittest.makeSuite(TestBasicsModule))
     test_suite.addTest(unittest.makeSuite(TestBasicsModuleEdgeCases))
+    test_suite.addTest(unittest.makeSuite(TestBasicsModuleBatch))
+    test_suite.addTest(unittest.makeSuite(TestBasicsModuleStats))
     return test_suite
 
 
@@ -0,0 +1,83 @@
+#!/usr/bin/env python2.7
+# -*- coding: utf-8 -*-
+"""
+Test suite for the combined _pycapi extension
+
+Only runs when setup.py was run with PYCAPI_COMBINED=1. Each check starts
+a fresh interpreter, because _pycapi reuses any tutorial module this
+process has already imported from its own shared object.
+"""
+
+import os
+import subprocess
+import sys
+import unittest
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+
+def run_python(code, stderr=None):
+    """Run code in a fresh interpreter from the repo root; return stdout"""
+    return subprocess.check_output(
+        [sys.executable, '-c', code], cwd=ROOT, stderr=stderr
+    )
+
+
+class TestCombinedModule(unittest.TestCase):
+    """Test cases for _pycapi"""
+
+    @classmethod
+    def setUpClass(cls):
+        """Skip everything when _pycapi was not built"""
+        try:
+            with open(os.devnull, 'w') as devnull:
+                run_python('import _pycapi', stderr=devnull)
+        except subprocess.CalledProcessError:
+            raise unittest.SkipTest("_pycapi not built (PYCAPI_COMBINED=1)")
+
+    def test_registers_all_modules(self):
+        """Test importing _pycapi makes every module importable as before"""
+        output = run_python(
+            "import _pycapi\n"
+            "import basics_module, objects_module, advanced_module\n"
+            "print basics_module is _pycapi.basics_module\n"
+            "print getattr(basics_module, '__file__', None)\n"
+            "print basics_module.add_numbers(2, 3)\n"
+            "print objects_module.sum_list([1, 2, 3])\n"
+        )
+        self.assertEqual(output.split(), ['True', 'None', '5', '6'])
+
+    def test_reuses_imported_modules(self):
+        """Test modules imported before _pycapi are not initialized again"""
+        output = run_python(
+            "import basics_module\n"
+            "import _pycapi\n"
+            "print _pycapi.basics_module is basics_module\n"
+            "print basics_module.__file__.endswith('basics_module.so')\n"
+        )
+        self.assertEqual(output.split(), ['True', 'True'])
+
+    def test_separate_stats(self):
+        """Test each module keeps its own stats() inside one shared object"""
+        output = run_python(
+            "import _pycapi, basics_module, objects_module\n"
+            "basics_module.add_numbers(1, 2)\n"
+            "print 'sum_list' in basics_module.stats()\n"
+            "print 'add_numbers' in objects_module.stats()\n"
+        )
+        self.assertEqual(output.split(), ['False', 'False'])
+
+
+def suite():
+    """Create test suite"""
+    test_suite = unittest.TestSuite()
+    test_suite.addTest(unittest.makeSuite(TestCombinedModule))
+    return test_suite
+
+
+if __name__ == '__main__':
+    print "Testing _pycapi..."
+    print "=" * 70
+    runner = unittest.TextTestRunner(verbosity=2)
+    result = runner.run(suite())
+    sys.exit(0 if result.wasSuccessful() else 1)
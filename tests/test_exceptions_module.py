@@ -357,6 +357,187 @@ class TestExceptionsModuleCustomExceptions(unittest.TestCase):
         self.assertNotEqual(self.module.CustomError, self.module.ValidationError)
 
 
+class TestExceptionsModuleErrorCodes(unittest.TestCase):
+    """Test the non-raising error-code mode and preallocated exceptions"""
+
+    @classmethod
+    def setUpClass(cls):
+        """Import the module"""
+        import exceptions_module
+
+        cls.module = exceptions_module
+
+    def test_error_code_constants(self):
+        """Test the ERR_* constants are distinct and ERR_OK is zero"""
+        codes = [
+            self.module.ERR_OK,
+            self.module.ERR_ZERO_DIVISION,
+            self.module.ERR_OUT_OF_RANGE,
+            self.module.ERR_NOT_A_NUMBER,
+        ]
+        self.assertEqual(self.module.ERR_OK, 0)
+        self.assertEqual(len(set(codes)), len(codes))
+
+    def test_safe_divide_as_result(self):
+        """Test safe_divide returning (ok, value_or_errcode)"""
+        self.assertEqual(self.module.safe_divide(9.0, 3.0, as_result=True), (True, 3.0))
+        self.assertEqual(
+            self.module.safe_divide(1.0, 0.0, as_result=True),
+            (False, self.module.ERR_ZERO_DIVISION),
+        )
+        self.assertEqual(self.module.safe_divide(9.0, 3.0, as_result=False), 3.0)
+
+    def test_safe_divide_message(self):
+        """Test the preallocated ZeroDivisionError keeps its message"""
+        for _ in range(3):
+            with self.assertRaises(ZeroDivisionError) as cm:
+                self.module.safe_divide(1.0, 0.0)
+            self.assertEqual(str(cm.exception), "Cannot divide by zero")
+
+    def test_raise_custom_error_singleton(self):
+        """Test raise_custom_error(None) raises one shared instance"""
+        caught = []
+        for _ in range(2):
+            try:
+                self.module.raise_custom_error(None)
+            except self.module.CustomError as e:
+                caught.append(e)
+        self.assertIs(caught[0], caught[1])
+        self.assertEqual(str(caught[0]), "Custom error")
+
+    def test_validate_range(self):
+        """Test validate_range in raising and as_result modes"""
+        self.assertEqual(self.module.validate_range(5, 0, 10), 5)
+        with self.assertRaises(self.module.ValidationError):
+            self.module.validate_range(11, 0, 10)
+        with self.assertRaises(self.module.ValidationError):
+            self.module.validate_range(float("nan"), 0, 10)
+        with self.assertRaises(TypeError):
+            self.module.validate_range("5", 0, 10)
+
+        self.assertEqual(
+            self.module.validate_range(2.5, 0, 10, as_result=True), (True, 2.5)
+        )
+        self.assertEqual(
+            self.module.validate_range(-1, 0, 10, as_result=True),
+            (False, self.module.ERR_OUT_OF_RANGE),
+        )
+        self.assertEqual(
+            self.module.validate_range(None, 0, 10, as_result=True),
+            (False, self.module.ERR_NOT_A_NUMBER),
+        )
+
+    def test_validate_range_many_mask(self):
+        """Test batch validation writing one code per value"""
+        values = [1, 20, 3.5, "x", -4, 10**400, 7]
+        mask = bytearray(len(values))
+        failures = self.module.validate_range_many(values, 0, 10, mask)
+        self.assertEqual(failures, 4)
+        expected = [
+            self.module.ERR_OK,
+            self.module.ERR_OUT_OF_RANGE,
+            self.module.ERR_OK,
+            self.module.ERR_NOT_A_NUMBER,
+            self.module.ERR_OUT_OF_RANGE,
+            self.module.ERR_OUT_OF_RANGE,
+            self.module.ERR_OK,
+        ]
+        self.assertEqual(list(mask), expected)
+
+    def test_validate_range_many_without_mask(self):
+        """Test batch validation counting failures only"""
+        self.assertEqual(self.module.validate_range_many(xrange(100), 10, 19), 90)
+        self.assertEqual(self.module.validate_range_many([], 0, 1), 0)
+
+    def test_validate_range_many_short_mask(self):
+        """Test a mask shorter than the values is rejected"""
+        with self.assertRaises(ValueError):
+            self.module.validate_range_many([1, 2, 3], 0, 10, bytearray(2))
+        with self.assertRaises((TypeError, BufferError)):
+            self.module.validate_range_many([1], 0, 10, "read-only")
+
+    def test_validate_range_many_mutating_float(self):
+        """Test a __float__ that empties the values list is harmless"""
+        values = []
+
+        class Clearing(object):
+            def __float__(self):
+                del values[:]
+                return 5.0
+
+        values.extend([Clearing(), 1, 20, Clearing(), 3])
+        self.assertEqual(self.module.validate_range_many(values, 0, 10), 1)
+        self.assertEqual(values, [])
+
+
+class TestExceptionsModuleCapture(unittest.TestCase):
+    """Test raw exception records and batch capture"""
+
+    @classmethod
+    def setUpClass(cls):
+        """Import the module"""
+        import exceptions_module
+
+        cls.module = exceptions_module
+
+    def test_get_exception_info_raw(self):
+        """Test raw mode hands back the fetched objects"""
+
+        def failing_func():
+            raise KeyError("missing")
+
+        record = self.module.get_exception_info(failing_func, raw=True)
+        self.assertIsInstance(record, self.module.ExceptionRecord)
+        self.assertIs(record.type, KeyError)
+        self.assertTrue(record.has_traceback)
+        self.assertIsNotNone(record.traceback)
+        self.assertEqual(record.index, -1)
+        self.assertEqual(record.type_str, str(KeyError))
+        self.assertIs(record.type_str, record.type_str)  # cached
+        self.assertIn("missing", record.value_str)
+
+    def test_record_as_dict(self):
+        """Test as_dict matches the default get_exception_info result"""
+
+        def failing_func():
+            raise ValueError("bad")
+
+        record = self.module.get_exception_info(failing_func, raw=True)
+        info = self.module.get_exception_info(failing_func)
+        self.assertEqual(record.as_dict(), info)
+
+    def test_get_exception_info_raw_no_exception(self):
+        """Test raw mode returns None when nothing is raised"""
+        self.assertIsNone(self.module.get_exception_info(lambda: 1, raw=True))
+
+    def test_capture_many(self):
+        """Test capture_many records failures and keeps going"""
+
+        def fail():
+            raise RuntimeError("boom")
+
+        callables = [lambda: 1, fail, lambda: 3, lambda: 1 / 0]
+        results, failures = self.module.capture_many(callables)
+        self.assertEqual(results, [1, None, 3, None])
+        self.assertEqual([record.index for record in failures], [1, 3])
+        self.assertIs(failures[0].type, RuntimeError)
+        self.assertIs(failures[1].type, ZeroDivisionError)
+        self.assertIn("index 1", repr(failures[0]))
+
+    def test_capture_many_empty(self):
+        """Test capture_many with nothing to call"""
+        self.assertEqual(self.module.capture_many(iter([])), ([], []))
+
+    def test_capture_many_propagates_interrupts(self):
+        """Test exceptions outside Exception are not captured"""
+
+        def interrupt():
+            raise KeyboardInterrupt
+
+        with self.assertRaises(KeyboardInterrupt):
+            self.module.capture_many([lambda: 1, interrupt])
+
+
 class TestExceptionsModuleArguments(unittest.TestCase):
     """Test argument handling in exception functions"""
 
@@ -390,6 +571,8 @@ def suite():
     test_suite.addTest(unittest.makeSuite(TestExceptionsModule))
     test_suite.addTest(unittest.makeSuite(TestExceptionsModuleEdgeCases))
     test_suite.addTest(unittest.makeSuite(TestExceptionsModuleCustomExceptions))
+    test_suite.addTest(unittest.makeSuite(TestExceptionsModuleErrorCodes))
+    test_suite.addTest(unittest.makeSuite(TestExceptionsModuleCapture))
     test_suite.addTest(unittest.makeSuite(TestExceptionsModuleArguments))
     return test_suite
 
@@ -11,6 +11,8 @@ Tests memory management:
 """
 
 import gc
+import multiprocessing
+import pickle
 import sys
 import unittest
 
@@ -102,6 +104,27 @@ class TestMemoryModule(unittest.TestCase):
         result = self.module.allocate_buffer(3)
         self.assertEqual(result, "ABC")
 
+    def test_allocate_buffer_pattern_across_blocks(self):
+        """Test the pattern stays aligned past the bulk copy block size"""
+        alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+        for size in (0, 25, 27, 26 * 1024 + 7, 200003):
+            expected = (alphabet * (size // 26 + 1))[:size]
+            self.assertEqual(self.module.allocate_buffer(size), expected)
+
+    def test_allocate_buffer_zero_copy(self):
+        """Test in-place modes return the same data as the copying path"""
+        expected = self.module.allocate_buffer(70000)
+
+        result = self.module.allocate_buffer(70000, copy=False)
+        self.assertIsInstance(result, str)
+        self.assertEqual(result, expected)
+
+        result = self.module.allocate_buffer(70000, writable=True)
+        self.assertIsInstance(result, bytearray)
+        self.assertEqual(result, expected)
+        result[0] = 'z'
+        self.assertEqual(result[:2], "zB")
+
     def test_copy_string(self):
         """Test safe string copying"""
         original = "Python C-API"
@@ -293,12 +316,298 @@ class TestMemoryModuleRefcountDetails(unittest.TestCase):
         self.assertNotEqual(original2, copied)
 
 
+class TestMemoryModuleArena(unittest.TestCase):
+    """Test cases for the Arena bump allocator"""
+
+    @classmethod
+    def setUpClass(cls):
+        """Import the module once for all tests"""
+        import memory_module
+
+        cls.module = memory_module
+
+    def test_arena_allocate_buffer(self):
+        """Test allocate_buffer produces the same data from an arena"""
+        arena = self.module.Arena()
+        expected = self.module.allocate_buffer(100)
+        self.assertEqual(self.module.allocate_buffer(100, arena=arena), expected)
+        self.assertEqual(self.module.copy_string("hello", arena), "hello")
+
+    def test_arena_stats(self):
+        """Test stats track usage and reset releases it"""
+        arena = self.module.Arena(slab_size=1024)
+        for _ in range(10):
+            self.module.allocate_buffer(200, arena)
+
+        stats = arena.stats()
+        self.assertEqual(stats['allocations'], 10)
+        self.assertGreaterEqual(stats['in_use'], 2000)
+        self.assertGreater(stats['slabs'], 1)
+        self.assertGreaterEqual(stats['reserved'], stats['in_use'])
+
+        arena.reset()
+        stats = arena.stats()
+        self.assertEqual(stats['in_use'], 0)
+        self.assertEqual(stats['slabs'], 1)
+        self.assertGreaterEqual(stats['high_water'], 2000)
+
+    def test_arena_oversized_allocation(self):
+        """Test requests larger than a slab get their own slab"""
+        arena = self.module.Arena(slab_size=64)
+        result = self.module.allocate_buffer(10000, arena)
+        self.assertEqual(len(result), 10000)
+        self.assertGreaterEqual(arena.stats()['reserved'], 10000)
+
+    def test_arena_context_manager(self):
+        """Test leaving a with-block resets the arena"""
+        with self.module.Arena() as arena:
+            self.module.allocate_buffer(500, arena)
+            self.assertGreater(arena.stats()['in_use'], 0)
+        self.assertEqual(arena.stats()['in_use'], 0)
+
+    def test_arena_invalid_arguments(self):
+        """Test bad arena and slab_size arguments are rejected"""
+        self.assertRaises(ValueError, self.module.Arena, 0)
+        self.assertRaises(TypeError, self.module.allocate_buffer, 10, arena=[])
+        self.assertRaises(ValueError, self.module.allocate_buffer, -1)
+
+    def test_arena_zero_copy_rejected(self):
+        """Test arena= is refused by the paths that have no scratch buffer"""
+        arena = self.module.Arena()
+        for flag in ({'copy': False}, {'writable': True}, {'shared': True}):
+            with self.assertRaises(TypeError):
+                self.module.allocate_buffer(10, arena=arena, **flag)
+        self.assertEqual(arena.stats()['allocations'], 0)
+
+
+class TestMemoryModuleAllocationTracker(unittest.TestCase):
+    """Test cases for the AllocationTracker context manager"""
+
+    @classmethod
+    def setUpClass(cls):
+        """Import the module once for all tests"""
+        import memory_module
+
+        cls.module = memory_module
+
+    def test_tracker_counts_sites(self):
+        """Test allocations and frees are counted per call site"""
+        with self.module.AllocationTracker() as tracker:
+            self.assertTrue(tracker.active)
+            self.module.allocate_buffer(100)
+            self.module.allocate_buffer(50)
+            self.module.copy_string("hello")
+        self.assertFalse(tracker.active)
+
+        sites = tracker.report()['sites']
+        self.assertEqual(sites['allocate_buffer']['allocations'], 2)
+        self.assertEqual(sites['allocate_buffer']['frees'], 2)
+        self.assertEqual(sites['allocate_buffer']['bytes_allocated'], 150)
+        self.assertEqual(sites['allocate_buffer']['outstanding_bytes'], 0)
+        self.assertEqual(sites['copy_string']['bytes_allocated'], 6)
+        self.assertNotIn('proper_cleanup', sites)
+
+    def test_tracker_inactive_records_nothing(self):
+        """Test nothing is counted outside the with-block"""
+        tracker = self.module.AllocationTracker()
+        self.module.allocate_buffer(100)
+        with tracker:
+            pass
+        self.module.allocate_buffer(100)
+        self.assertEqual(tracker.report(), {'sites': {}, 'leaks': []})
+
+    def test_tracker_outstanding_arena_slabs(self):
+        """Test slabs held by a live arena show up as outstanding bytes"""
+        with self.module.AllocationTracker() as tracker:
+            arena = self.module.Arena(slab_size=1024)
+            self.module.allocate_buffer(100, arena)
+            self.assertGreaterEqual(
+                tracker.report()['sites']['Arena']['outstanding_bytes'], 1024
+            )
+            del arena
+        site = tracker.report()['sites']['Arena']
+        self.assertEqual(site['allocations'], site['frees'])
+        self.assertEqual(site['outstanding_bytes'], 0)
+
+    def test_tracker_reports_leaks(self):
+        """Test watched objects whose refcount grew are reported"""
+        keep = []
+        value = object()
+        clean = object()
+        with self.module.AllocationTracker() as tracker:
+            self.assertIs(tracker.watch(value), value)
+            tracker.watch(clean)
+            keep.append(value)
+
+        leaks = tracker.report()['leaks']
+        self.assertEqual(len(leaks), 1)
+        self.assertIs(leaks[0]['object'], value)
+        self.assertEqual(leaks[0]['site'], 'watch')
+        self.assertEqual(leaks[0]['refcount'], leaks[0]['baseline'] + 1)
+
+        del leaks
+        keep.pop()
+        self.assertEqual(tracker.report()['leaks'], [])
+
+    def test_tracker_watches_refcount_demos(self):
+        """Test refcount demos are watched and balanced while tracking"""
+        item = object()
+        data = [item]
+        before = self.module.get_refcount(item)
+        with self.module.AllocationTracker() as tracker:
+            self.assertEqual(self.module.get_refcount(item), before)
+            self.module.incref_demo(data)
+            self.module.borrowed_ref_demo(data)
+            self.assertEqual(self.module.get_refcount(item), before)
+
+        self.assertEqual(tracker.report()['leaks'], [])
+
+    def test_tracker_nesting(self):
+        """Test nested trackers must exit innermost first"""
+        outer = self.module.AllocationTracker()
+        inner = self.module.AllocationTracker()
+        with outer:
+            with inner:
+                self.module.allocate_buffer(10)
+                self.assertRaises(RuntimeError, outer.__exit__, None, None, None)
+            self.module.allocate_buffer(20)
+            self.assertRaises(RuntimeError, outer.__enter__)
+
+        self.assertEqual(
+            inner.report()['sites']['allocate_buffer']['bytes_allocated'], 10
+        )
+        self.assertEqual(
+            outer.report()['sites']['allocate_buffer']['bytes_allocated'], 20
+        )
+
+
+def _fill_shared(conn):
+    """Child process: receive a pickled SharedBuffer and write into it"""
+    shared = conn.recv()
+    view = memoryview(shared)
+    view[:5] = 'child'
+    del view
+    conn.send(shared.refs)
+    shared.close()
+
+
+def _close_inherited(shared):
+    """Child process: write into a SharedBuffer inherited by fork, then close it"""
+    view = memoryview(shared)
+    view[:6] = 'forked'
+    del view
+    shared.close()
+
+
+class TestMemoryModuleSharedBuffer(unittest.TestCase):
+    """Test cases for SharedBuffer and attach_shared"""
+
+    @classmethod
+    def setUpClass(cls):
+        """Import the module once for all tests"""
+        import memory_module
+
+        cls.module = memory_module
+
+    def test_shared_buffer_basics(self):
+        """Test a new shared buffer is a writable zeroed buffer"""
+        with self.module.SharedBuffer(16) as shared:
+            self.assertEqual(len(shared), 16)
+            self.assertEqual(shared.size, 16)
+            self.assertEqual(shared.refs, 1)
+            self.assertTrue(shared.name.startswith('/pycapi-'))
+
+            view = memoryview(shared)
+            self.assertEqual(view.tobytes(), '\0' * 16)
+            view[:4] = 'abcd'
+            self.assertEqual(view[:4].tobytes(), 'abcd')
+            del view
+        self.assertTrue(shared.closed)
+        self.assertRaises(ValueError, memoryview, shared)
+
+    def test_shared_buffer_close_with_views(self):
+        """Test close() refuses while views are exported"""
+        shared = self.module.SharedBuffer(8)
+        view = memoryview(shared)
+        self.assertRaises(BufferError, shared.close)
+        del view
+        shared.close()
+        shared.close()  # closing twice is a no-op
+
+    def test_shared_buffer_attach(self):
+        """Test handles attached by name share memory and a refcount"""
+        shared = self.module.SharedBuffer(8)
+        other = pickle.loads(pickle.dumps(shared, pickle.HIGHEST_PROTOCOL))
+        self.assertEqual(other.name, shared.name)
+        self.assertEqual(shared.refs, 2)
+
+        memoryview(other)[:2] = 'hi'
+        self.assertEqual(memoryview(shared)[:2].tobytes(), 'hi')
+
+        other.close()
+        self.assertEqual(shared.refs, 1)
+        shared.close()
+        self.assertRaises(OSError, self.module.attach_shared, shared.name)
+
+    def test_shared_buffer_named(self):
+        """Test explicit names are used as given and must be unused"""
+        name = '/pycapi-test-named-%d' % id(self)
+        with self.module.SharedBuffer(4, name=name) as shared:
+            self.assertEqual(shared.name, name)
+            self.assertRaises(OSError, self.module.SharedBuffer, 4, name)
+        self.assertRaises(ValueError, self.module.SharedBuffer, -1)
+        self.assertRaises(TypeError, self.module.attach_shared, 1)
+
+    def test_shared_buffer_other_process(self):
+        """Test a pickled handle maps the same memory in a child process"""
+        shared = self.module.SharedBuffer(32)
+        parent_conn, child_conn = multiprocessing.Pipe()
+        child = multiprocessing.Process(target=_fill_shared, args=(child_conn,))
+        child.start()
+        parent_conn.send(shared)
+        refs_in_child = parent_conn.recv()
+        child.join()
+
+        self.assertEqual(child.exitcode, 0)
+        self.assertEqual(refs_in_child, 2)
+        self.assertEqual(shared.refs, 1)
+        self.assertEqual(memoryview(shared)[:5].tobytes(), 'child')
+        shared.close()
+
+    def test_shared_buffer_fork(self):
+        """Test closing a handle inherited by fork leaves the region alive"""
+        shared = self.module.SharedBuffer(16)
+        child = multiprocessing.Process(target=_close_inherited, args=(shared,))
+        child.start()
+        child.join()
+
+        self.assertEqual(child.exitcode, 0)
+        self.assertEqual(shared.refs, 1)
+        self.assertEqual(memoryview(shared)[:6].tobytes(), 'forked')
+        other = self.module.attach_shared(shared.name)
+        self.assertEqual(shared.refs, 2)
+        other.close()
+        shared.close()
+
+    def test_allocate_buffer_shared(self):
+        """Test allocate_buffer(shared=True) fills a SharedBuffer"""
+        shared = self.module.allocate_buffer(30, shared=True)
+        self.assertIsInstance(shared, self.module.SharedBuffer)
+        self.assertEqual(
+            memoryview(shared).tobytes(), self.module.allocate_buffer(30)
+        )
+        shared.close()
+
+
 def suite():
     """Create test suite"""
     test_suite = unittest.TestSuite()
     test_suite.addTest(unittest.makeSuite(TestMemoryModule))
     test_suite.addTest(unittest.makeSuite(TestMemoryModuleStressTests))
     test_suite.addTest(unittest.makeSuite(TestMemoryModuleRefcountDetails))
+    test_suite.addTest(unittest.makeSuite(TestMemoryModuleArena))
+    test_suite.addTest(unittest.makeSuite(TestMemoryModuleAllocationTracker))
+    test_suite.addTest(unittest.makeSuite(TestMemoryModuleSharedBuffer))
     return test_suite
 
 
@@ -11,7 +11,11 @@ Tests object manipulation:
 - Type checking
 """
 
+import array
+import ctypes
+import mmap
 import sys
+import tempfile
 import unittest
 
 
@@ -53,6 +57,46 @@ class TestObjectsModule(unittest.TestCase):
         self.assertEqual(result[10], 100)
         self.assertEqual(result[99], 99 * 99)
 
+    def test_create_list_kinds(self):
+        """Test the range and const generators"""
+        self.assertEqual(self.module.create_list(5, 'range'), [0, 1, 2, 3, 4])
+        self.assertEqual(self.module.create_list(3, kind='const', value=7), [7, 7, 7])
+        self.assertEqual(self.module.create_list(2, kind='const'), [0, 0])
+
+    def test_create_list_const_shares_item(self):
+        """Test that const lists reuse a single object"""
+        result = self.module.create_list(4, kind='const', value=10**6)
+        self.assertTrue(all(item is result[0] for item in result))
+
+    def test_create_list_as_array(self):
+        """Test returning a compact array.array"""
+        result = self.module.create_list(5, as_array=True)
+        self.assertIsInstance(result, array.array)
+        self.assertEqual(result.typecode, 'l')
+        self.assertEqual(result.tolist(), [0, 1, 4, 9, 16])
+
+        result = self.module.create_list(3, kind='const', value=-2, as_array=True)
+        self.assertEqual(result.tolist(), [-2, -2, -2])
+        self.assertEqual(len(self.module.create_list(0, as_array=True)), 0)
+
+    def test_create_list_as_array_error(self):
+        """Test an as_array flag whose truth test raises is an error"""
+
+        class Flag(object):
+            def __nonzero__(self):
+                raise ZeroDivisionError
+
+        with self.assertRaises(ZeroDivisionError):
+            self.module.create_list(3, as_array=Flag())
+
+    def test_create_list_invalid(self):
+        """Test create_list argument validation"""
+        with self.assertRaises(ValueError):
+            self.module.create_list(3, 'cubes')
+
+        with self.assertRaises(ValueError):
+            self.module.create_list(-1)
+
     def test_sum_list(self):
         """Test summing list elements"""
         self.assertEqual(self.module.sum_list([1, 2, 3, 4, 5]), 15)
@@ -80,6 +124,77 @@ class TestObjectsModule(unittest.TestCase):
         with self.assertRaises(TypeError):
             self.module.sum_list(123)
 
+    def test_sum_buffer_bytearray(self):
+        """Test summing a bytearray through the buffer protocol"""
+        self.assertEqual(self.module.sum_buffer(bytearray([1, 2, 255])), 258)
+        self.assertEqual(self.module.sum_buffer(bytearray()), 0)
+
+    def test_sum_buffer_array(self):
+        """Test summing typed arrays"""
+        values = range(-500, 1000)
+        for typecode in ('h', 'i', 'l'):
+            data = array.array(typecode, values)
+            self.assertEqual(self.module.sum_buffer(data), sum(values))
+
+        self.assertEqual(self.module.sum_buffer(array.array('d', [0.5] * 10)), 5.0)
+        self.assertEqual(self.module.sum_buffer(array.array('f', [1.5] * 3)), 4.5)
+
+    def test_sum_buffer_large(self):
+        """Test summing a buffer large enough to release the GIL"""
+        data = bytearray(range(256)) * 4096
+        self.assertEqual(self.module.sum_buffer(data), sum(range(256)) * 4096)
+        self.assertEqual(self.module.sum_buffer(memoryview(data)), 4096 * 32640)
+
+    def test_sum_buffer_pool(self):
+        """Test pool= gives the same sums as the serial path"""
+        import advanced_module
+
+        pool = advanced_module.Pool(3)
+        n = 300000
+        longs = (ctypes.c_long * n)(*range(-n, n, 2))
+        self.assertEqual(self.module.sum_buffer(longs, pool=pool), sum(longs))
+        halves = (ctypes.c_double * n)(*([0.5] * n))
+        self.assertEqual(self.module.sum_buffer(halves, pool), n * 0.5)
+        self.assertEqual(self.module.sum_buffer(bytearray(10), pool=None), 0)
+        self.assertRaises(TypeError, self.module.sum_buffer, halves, pool=[])
+
+    def test_sum_buffer_no_overflow(self):
+        """Test that 64-bit sums are exact past the 64-bit range"""
+        big = array.array('L', [2**64 - 1] * 4)
+        self.assertEqual(self.module.sum_buffer(big), 4 * (2**64 - 1))
+
+        small = array.array('l', [-(2**63)] * 3)
+        self.assertEqual(self.module.sum_buffer(small), -3 * 2**63)
+
+    def test_sum_buffer_invalid(self):
+        """Test sum_buffer with objects that are not numeric buffers"""
+        with self.assertRaises(TypeError):
+            self.module.sum_buffer([1, 2, 3])
+
+        with self.assertRaises(TypeError):
+            self.module.sum_buffer(123)
+
+        with self.assertRaises(TypeError):
+            self.module.sum_buffer(array.array('c', 'abc'))
+
+        class Pair(ctypes.Structure):
+            _fields_ = [('a', ctypes.c_int), ('b', ctypes.c_int)]
+
+        with self.assertRaises(TypeError):
+            self.module.sum_buffer((Pair * 4)())
+
+    def test_sum_buffer_typecode_resizes(self):
+        """Test a typecode lookup that shrinks the array is seen first"""
+
+        class Shrinking(array.array):
+            @property
+            def typecode(self):
+                del self[1:]
+                return 'l'
+
+        data = Shrinking('l', range(1, 10001))
+        self.assertEqual(self.module.sum_buffer(data), 1)
+
     def test_reverse_list(self):
         """Test list reversal"""
         test_list = [1, 2, 3, 4, 5]
@@ -153,6 +268,116 @@ class TestObjectsModule(unittest.TestCase):
         result = self.module.merge_dicts({'a': 1}, {})
         self.assertEqual(result, {'a': 1})
 
+    def test_merge_dicts_inplace(self):
+        """Test inplace=True updates and returns the first dict"""
+        base = {'a': 1, 'b': 2}
+        result = self.module.merge_dicts(base, {'b': 3}, inplace=True)
+        self.assertIs(result, base)
+        self.assertEqual(base, {'a': 1, 'b': 3})
+
+        original = {'a': 1}
+        self.module.merge_dicts(original, {'a': 2})
+        self.assertEqual(original, {'a': 1})
+
+    def test_merge_dicts_conflict_policies(self):
+        """Test first, last, sum and callable conflict policies"""
+        d1 = {'a': 1, 'b': 2}
+        d2 = {'b': 10, 'c': 3}
+        merge = self.module.merge_dicts
+        self.assertEqual(merge(d1, d2, on_conflict='last'), {'a': 1, 'b': 10, 'c': 3})
+        self.assertEqual(merge(d1, d2, on_conflict='first'), {'a': 1, 'b': 2, 'c': 3})
+        self.assertEqual(merge(d1, d2, on_conflict='sum'), {'a': 1, 'b': 12, 'c': 3})
+
+        calls = []
+
+        def resolve(key, old, new):
+            calls.append((key, old, new))
+            return max(old, new)
+
+        self.assertEqual(merge(d1, d2, on_conflict=resolve)['b'], 10)
+        self.assertEqual(calls, [('b', 2, 10)])
+
+    def test_merge_dicts_policy_errors(self):
+        """Test bad policies and failing resolvers raise"""
+        merge = self.module.merge_dicts
+        self.assertRaises(ValueError, merge, {}, {}, on_conflict='max')
+        self.assertRaises(TypeError, merge, {}, {}, on_conflict=1)
+        self.assertRaises(TypeError, merge, {'a': 1}, {'a': 'x'}, on_conflict='sum')
+
+        def fail(key, old, new):
+            raise KeyError(key)
+
+        self.assertRaises(KeyError, merge, {'a': 1}, {'a': 2}, on_conflict=fail)
+
+    def test_merge_many(self):
+        """Test k-way merging with conflict policies"""
+        layers = [{'a': 1}, {'a': 2, 'b': 1}, {'b': 5, 'c': 0}]
+        self.assertEqual(self.module.merge_many(*layers), {'a': 2, 'b': 5, 'c': 0})
+        self.assertEqual(
+            self.module.merge_many(*layers, on_conflict='first'),
+            {'a': 1, 'b': 1, 'c': 0},
+        )
+        self.assertEqual(
+            self.module.merge_many(*layers, on_conflict='sum'),
+            {'a': 3, 'b': 6, 'c': 0},
+        )
+        self.assertEqual(self.module.merge_many(), {})
+        self.assertEqual(layers[0], {'a': 1})
+
+    def test_merge_many_errors(self):
+        """Test non-dict arguments and unknown keywords are rejected"""
+        self.assertRaises(TypeError, self.module.merge_many, {}, [])
+        self.assertRaises(TypeError, self.module.merge_many, {}, policy='sum')
+
+    def test_dict_from_columns(self):
+        """Test building a dict from key and value sequences"""
+        result = self.module.dict_from_columns(['a', 'b', 'c'], (1, 2, 3))
+        self.assertEqual(result, {'a': 1, 'b': 2, 'c': 3})
+        self.assertEqual(self.module.dict_from_columns([], []), {})
+
+    def test_dict_from_columns_generated_keys(self):
+        """Test an int key count generates prefixed keys"""
+        result = self.module.dict_from_columns(12, range(12))
+        self.assertEqual(result, dict(('key_%d' % i, i) for i in range(12)))
+
+        result = self.module.dict_from_columns(3, 'xyz', prefix='k')
+        self.assertEqual(result, {'k0': 'x', 'k1': 'y', 'k2': 'z'})
+
+    def test_dict_from_columns_buffer_values(self):
+        """Test numeric buffers are read in place as values"""
+        values = array.array('l', [0, -5, 2**31])
+        result = self.module.dict_from_columns(3, values)
+        self.assertEqual(result, {'key_0': 0, 'key_1': -5, 'key_2': 2**31})
+
+        values = array.array('d', [0.5, 1.5])
+        result = self.module.dict_from_columns(['x', 'y'], values)
+        self.assertEqual(result, {'x': 0.5, 'y': 1.5})
+
+        result = self.module.dict_from_columns(['x'], memoryview(b'A'))
+        self.assertEqual(result, {'x': 65})
+
+    def test_dict_from_columns_errors(self):
+        """Test mismatched lengths and bad inputs are rejected"""
+        self.assertRaises(ValueError, self.module.dict_from_columns, 2, [1])
+        self.assertRaises(ValueError, self.module.dict_from_columns, -1, [])
+        self.assertRaises(TypeError, self.module.dict_from_columns, [[]], [1])
+        self.assertRaises(
+            TypeError, self.module.dict_from_columns, 1, array.array('c', 'x')
+        )
+
+    def test_dict_from_pairs(self):
+        """Test building a dict from pairs like dict() does"""
+        pairs = [('a', 1), ['b', 2], 'cd', ('a', 3)]
+        self.assertEqual(self.module.dict_from_pairs(pairs), dict(pairs))
+        self.assertEqual(self.module.dict_from_pairs(iter([(1, 2)])), {1: 2})
+        self.assertEqual(self.module.dict_from_pairs(x for x in ()), {})
+
+    def test_dict_from_pairs_errors(self):
+        """Test malformed pairs raise like dict()"""
+        self.assertRaises(ValueError, self.module.dict_from_pairs, [(1, 2, 3)])
+        self.assertRaises(TypeError, self.module.dict_from_pairs, [1])
+        self.assertRaises(TypeError, self.module.dict_from_pairs, [([], 1)])
+
     # ========================================================================
     # Tuple Operations
     # ========================================================================
@@ -216,6 +441,86 @@ class TestObjectsModule(unittest.TestCase):
         result = self.module.set_union(set1, set2)
         self.assertEqual(result, {1, 2, 3, 4})
 
+    def test_create_set_any_iterable(self):
+        """Test create_set accepts any iterable"""
+        self.assertEqual(self.module.create_set(x % 3 for x in range(9)), {0, 1, 2})
+        self.assertEqual(self.module.create_set("abca"), {'a', 'b', 'c'})
+
+    def test_set_operations_match_python(self):
+        """Test every operation and count_only against Python's set ops"""
+        a = set(range(0, 60, 2))
+        b = frozenset(range(0, 60, 3))
+        c = range(10, 40)
+        cases = [
+            (self.module.set_union, a | b | set(c)),
+            (self.module.set_intersection, a & b & set(c)),
+            (self.module.set_difference, a - b - set(c)),
+            (self.module.set_symmetric_difference, a ^ b ^ set(c)),
+        ]
+        for func, expected in cases:
+            self.assertEqual(func(a, b, c), expected)
+            self.assertIsInstance(func(a, b, c), set)
+            self.assertEqual(func(a, b, c, count_only=True), len(expected))
+
+        self.assertEqual(
+            self.module.set_intersection(b, a, count_only=True), len(a & b)
+        )
+        self.assertEqual(
+            self.module.set_symmetric_difference(a, b, count_only=True), len(a ^ b)
+        )
+        self.assertEqual(self.module.set_difference(b, a), b - a)
+
+    def test_set_operations_unary_and_empty(self):
+        """Test operations with one or zero operands"""
+        self.assertEqual(self.module.set_union(), set())
+        self.assertEqual(self.module.set_union(count_only=True), 0)
+        self.assertEqual(self.module.set_symmetric_difference(), set())
+        self.assertEqual(self.module.set_intersection([1, 2]), {1, 2})
+        self.assertEqual(self.module.set_difference({1}, set()), {1})
+
+    def test_set_operations_do_not_modify_inputs(self):
+        """Test operands are left untouched"""
+        a = {1, 2, 3}
+        b = {2, 3, 4}
+        self.module.set_intersection(a, b)
+        self.module.set_difference(a, b)
+        self.module.set_symmetric_difference(a, b)
+        self.assertEqual((a, b), ({1, 2, 3}, {2, 3, 4}))
+
+    def test_set_operations_mutating_keys(self):
+        """Test keys whose __eq__ empties an operand stay alive while used"""
+        victims = []
+
+        class Clearing(object):
+            def __hash__(self):
+                return 1
+
+            def __eq__(self, other):
+                for victim in victims:
+                    victim.clear()
+                return False
+
+        operations = (
+            self.module.set_union,
+            self.module.set_intersection,
+            self.module.set_difference,
+            self.module.set_symmetric_difference,
+        )
+        for operation in operations:
+            a = {Clearing() for _ in range(4)}
+            b = {Clearing()}
+            victims[:] = [a, b]
+            for result in (operation(a, b), operation(b, a)):
+                self.assertTrue(all(isinstance(key, Clearing) for key in result))
+        del victims[:]
+
+    def test_set_operations_errors(self):
+        """Test missing operands and bad keywords are rejected"""
+        self.assertRaises(TypeError, self.module.set_intersection)
+        self.assertRaises(TypeError, self.module.set_difference)
+        self.assertRaises(TypeError, self.module.set_union, 1)
+        self.assertRaises(TypeError, self.module.set_union, {1}, count=True)
+
     # ========================================================================
     # Attribute Access
     # ========================================================================
@@ -275,6 +580,26 @@ class TestObjectsModule(unittest.TestCase):
         self.assertTrue(self.module.has_attr(obj, "exists"))
         self.assertFalse(self.module.has_attr(obj, "missing"))
 
+    def test_attr_dynamic_names(self):
+        """Test attribute names built at runtime"""
+
+        class TestObj(object):
+            pass
+
+        obj = TestObj()
+        name = "".join(["dyn", "amic"])
+        self.module.set_attr(obj, name, 1)
+        self.assertEqual(self.module.get_attr(obj, "dyn" + "amic"), 1)
+        self.assertTrue(self.module.has_attr(obj, u"dynamic"))
+
+    def test_attr_invalid_name(self):
+        """Test that non-string attribute names raise TypeError"""
+        with self.assertRaises(TypeError):
+            self.module.get_attr(object(), 42)
+
+        with self.assertRaises(TypeError):
+            self.module.set_attr(object(), None, 1)
+
     # ========================================================================
     # Type Checking
     # ========================================================================
@@ -291,35 +616,44 @@ class TestObjectsModule(unittest.TestCase):
     def test_check_type_int(self):
         """Test type checking for integer"""
         result = self.module.check_type(42)
-        self.assertTrue(result['is_int'])
-        self.assertFalse(result['is_string'])
-        self.assertFalse(result['is_list'])
+        self.assertEqual(result, self.module.TYPE_INT)
+        self.assertFalse(result & self.module.TYPE_STRING)
+        self.assertFalse(result & self.module.TYPE_LIST)
 
     def test_check_type_string(self):
         """Test type checking for string"""
         result = self.module.check_type("hello")
-        self.assertTrue(result['is_string'])
-        self.assertFalse(result['is_int'])
-        self.assertFalse(result['is_list'])
+        self.assertTrue(result & self.module.TYPE_STRING)
+        self.assertFalse(result & self.module.TYPE_INT)
+        self.assertFalse(result & self.module.TYPE_LIST)
 
     def test_check_type_list(self):
         """Test type checking for list"""
         result = self.module.check_type([1, 2, 3])
-        self.assertTrue(result['is_list'])
-        self.assertFalse(result['is_dict'])
-        self.assertFalse(result['is_tuple'])
+        self.assertTrue(result & self.module.TYPE_LIST)
+        self.assertFalse(result & self.module.TYPE_DICT)
+        self.assertFalse(result & self.module.TYPE_TUPLE)
 
     def test_check_type_dict(self):
         """Test type checking for dictionary"""
         result = self.module.check_type({'a': 1})
-        self.assertTrue(result['is_dict'])
-        self.assertFalse(result['is_list'])
+        self.assertTrue(result & self.module.TYPE_DICT)
+        self.assertFalse(result & self.module.TYPE_LIST)
 
     def test_check_type_unicode(self):
         """Test type checking for unicode"""
         result = self.module.check_type(u"hello")
-        self.assertTrue(result['is_unicode'])
-        self.assertFalse(result['is_string'])
+        self.assertTrue(result & self.module.TYPE_UNICODE)
+        self.assertFalse(result & self.module.TYPE_STRING)
+
+    def test_check_type_bits(self):
+        """Test every TYPE_* bit is distinct and unmatched objects give 0"""
+        names = ['INT', 'LONG', 'FLOAT', 'STRING', 'UNICODE']
+        names += ['LIST', 'TUPLE', 'DICT', 'SET']
+        bits = [getattr(self.module, 'TYPE_' + name) for name in names]
+        self.assertEqual(sorted(bits), [1 << i for i in range(9)])
+        self.assertEqual(self.module.check_type(None), 0)
+        self.assertEqual(self.module.check_type(True), self.module.TYPE_INT)
 
     # ========================================================================
     # Object Comparison
@@ -376,11 +710,196 @@ class TestObjectsModuleEdgeCases(unittest.TestCase):
         self.assertEqual(obj.__custom__, "value")
 
 
+class TestObjectsModuleSort(unittest.TestCase):
+    """Test cases for sort_homogeneous"""
+
+    @classmethod
+    def setUpClass(cls):
+        """Import the module once for all tests"""
+        import objects_module
+
+        cls.module = objects_module
+
+    def assertSortsLikeList(self, values, kernel, **kwargs):
+        """Check the result, item identity and kernel against list.sort()"""
+        result = list(values)
+        expected = list(values)
+        self.assertEqual(self.module.sort_homogeneous(result, **kwargs), kernel)
+        expected.sort(**kwargs)
+        self.assertEqual(result, expected)
+        self.assertTrue(all(a is b for a, b in zip(result, expected)))
+
+    def test_sort_kernels(self):
+        """Test homogeneous lists use the unboxed kernels"""
+        ints = [(i * 7919) % 1000 - 500 for i in range(1000)]
+        for kwargs in [{}, {'reverse': True}]:
+            self.assertSortsLikeList(ints, 'int', **kwargs)
+            self.assertSortsLikeList([x / 7.0 for x in ints], 'float', **kwargs)
+            self.assertSortsLikeList(['s%d' % x for x in ints], 'str', **kwargs)
+        self.assertSortsLikeList([sys.maxint, -sys.maxint - 1, 2**63 - 1, 5L], 'int')
+        self.assertSortsLikeList(['b', 'ab', 'a', '', 'a\0'], 'str')
+
+    def test_sort_stable_with_key(self):
+        """Test equal keys keep their order, also when reversed"""
+        rows = [(i % 5, i) for i in range(200)]
+        for kwargs in [{}, {'reverse': True}]:
+            self.assertSortsLikeList(rows, 'int', key=lambda row: row[0], **kwargs)
+            self.assertSortsLikeList(
+                rows, 'str', key=lambda row: str(row[0]), **kwargs
+            )
+        self.assertSortsLikeList([0.0, -0.0, 0.0, -0.0], 'float')
+
+    def test_sort_generic_fallback(self):
+        """Test mixed, non-exact or unordered keys use list.sort()"""
+        self.assertSortsLikeList([1, 1.5, 0], 'generic')
+        self.assertSortsLikeList([True, False, 2], 'generic')
+        self.assertSortsLikeList([2**64, 1], 'generic')
+        self.assertSortsLikeList([float('nan'), 1.0], 'generic')
+        self.assertSortsLikeList([(2, 1), (1, 2)], 'generic')
+        self.assertSortsLikeList([3, 1, 2], 'generic', key=lambda x: (x,))
+        self.assertSortsLikeList([1], 'generic')
+        self.assertSortsLikeList([], 'generic')
+
+        calls = []
+        self.module.sort_homogeneous([3, 1, 2], key=lambda x: calls.append(x) or [x])
+        self.assertEqual(calls, [3, 1, 2])  # key called once per item
+
+    def test_sort_errors(self):
+        """Test bad arguments, key errors and mutation during key calls"""
+        self.assertRaises(TypeError, self.module.sort_homogeneous, (2, 1))
+        self.assertRaises(
+            ZeroDivisionError, self.module.sort_homogeneous, [0], key=lambda x: 1 / x
+        )
+        values = [1, 2]
+        self.assertRaises(
+            ValueError,
+            self.module.sort_homogeneous,
+            values,
+            key=lambda x: values.append(x) or x,
+        )
+
+
+class TestObjectsModuleSerialization(unittest.TestCase):
+    """Test cases for dumps, loads and load_iter"""
+
+    VALUES = [
+        None,
+        True,
+        False,
+        0,
+        -1,
+        sys.maxint,
+        -sys.maxint - 1,
+        5L,
+        2**63,
+        -(2**200),
+        1.5,
+        float('-inf'),
+        '',
+        'text',
+        u'',
+        u'h\xe9llo',
+        [],
+        (),
+        {},
+        set(),
+        frozenset(),
+        [1, 'a', u'a', 'a', u'a'],
+        {'k': [1, 2, (3, 4)], 'j': {'x': None}},
+        {1, 2, 3},
+        frozenset(['a']),
+    ]
+
+    @classmethod
+    def setUpClass(cls):
+        """Import the module once for all tests"""
+        import objects_module
+
+        cls.module = objects_module
+
+    def test_round_trip(self):
+        """Test every supported type comes back equal and the same type"""
+        for value in self.VALUES:
+            result = self.module.loads(self.module.dumps(value))
+            self.assertEqual(result, value)
+            self.assertIs(type(result), type(value))
+        result = self.module.loads(self.module.dumps([1, 'a', u'a', 'a', u'a']))
+        types = [type(item) for item in result]
+        self.assertEqual(types, [int, str, unicode, str, unicode])
+
+    def test_compact_encoding(self):
+        """Test small ints are one varint byte and repeated strings memoized"""
+        self.assertEqual(self.module.dumps(1), 'i\x02')
+        self.assertEqual(self.module.dumps(-1), 'i\x01')
+        self.assertEqual(self.module.dumps(300), 'i\xd8\x04')
+
+        rows = [{'name': 'x'}] * 100
+        single = len(self.module.dumps(rows[:1]))
+        # Each repeat is the dict tag, its size and two memo references
+        self.assertEqual(len(self.module.dumps(rows)), single + 6 * 99)
+        self.assertEqual(self.module.dumps(rows, size_hint=1), self.module.dumps(rows))
+
+    def test_load_iter(self):
+        """Test concatenated records are read back one at a time"""
+        blob = ''.join(self.module.dumps(value) for value in self.VALUES)
+        self.assertEqual(list(self.module.load_iter(blob)), self.VALUES)
+        self.assertEqual(list(self.module.load_iter(bytearray(blob))), self.VALUES)
+
+        with tempfile.TemporaryFile() as handle:
+            handle.write(blob)
+            handle.flush()
+            mapped = mmap.mmap(handle.fileno(), 0)
+            self.assertEqual(list(self.module.load_iter(mapped)), self.VALUES)
+
+            # Closing the mmap mid-iteration must not pull memory away
+            records = self.module.load_iter(mapped)
+            self.assertEqual(next(records), self.VALUES[0])
+            mapped.close()
+            self.assertEqual(list(records), self.VALUES[1:])
+
+        # Nor shrinking an old-style array
+        data = array.array('c', blob)
+        records = self.module.load_iter(data)
+        self.assertEqual(next(records), self.VALUES[0])
+        del data[:]
+        self.assertEqual(list(records), self.VALUES[1:])
+
+        records = self.module.load_iter(self.module.dumps(1) + 'Z')
+        self.assertEqual(next(records), 1)
+        self.assertEqual(records.offset, 2)
+        self.assertRaises(ValueError, next, records)
+        self.assertEqual(list(records), [])
+
+    def test_serialization_errors(self):
+        """Test unsupported objects and corrupt data are rejected"""
+        self.assertRaises(TypeError, self.module.dumps, object())
+        self.assertRaises(TypeError, self.module.dumps, [1, {'a': object()}])
+
+        class MyList(list):
+            pass
+
+        self.assertRaises(TypeError, self.module.dumps, MyList())
+        cycle = []
+        cycle.append(cycle)
+        self.assertRaises(RuntimeError, self.module.dumps, cycle)
+
+        data = self.module.dumps([1, 'abc'])
+        self.assertRaises(ValueError, self.module.loads, data[:-1])
+        self.assertRaises(ValueError, self.module.loads, data + data)
+        self.assertRaises(ValueError, self.module.loads, 'Z')
+        self.assertRaises(ValueError, self.module.loads, '')
+        self.assertRaises(ValueError, self.module.loads, 'm\x00')
+        self.assertRaises(ValueError, self.module.loads, '[\xff\xff\xff\x7f')
+        self.assertRaises(TypeError, self.module.loads, 5)
+
+
 def suite():
     """Create test suite"""
     test_suite = unittest.TestSuite()
     test_suite.addTest(unittest.makeSuite(TestObjectsModule))
     test_suite.addTest(unittest.makeSuite(TestObjectsModuleEdgeCases))
+    test_suite.addTest(unittest.makeSuite(TestObjectsModuleSort))
+    test_suite.addTest(unittest.makeSuite(TestObjectsModuleSerialization))
     return test_suite
 
 